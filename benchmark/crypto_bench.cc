@@ -0,0 +1,153 @@
+#include <uvgrtp/crypto.hh>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/* Measures how many SRTP packets per second one core can protect.
+ *
+ * Each packet is encrypted with AES-128 in counter mode and authenticated
+ * with HMAC-SHA1, which is what SRTP does with the default crypto suite.
+ *
+ * "per packet" constructs the cipher and HMAC for every packet, i.e. the
+ * key schedule and HMAC key are recomputed each time, and "cached" keys them
+ * once and only sets the IV for each packet, like uvgRTP does.
+ *
+ * "gcm" protects the packet with AEAD_AES_128_GCM (RFC 7714) instead,
+ * which is what uvgRTP does when RCE_SRTP_AES_GCM is given. */
+
+constexpr size_t KEY_SIZE      = 16;
+constexpr size_t AUTH_KEY_SIZE = 20;
+constexpr size_t IV_SIZE       = 16;
+constexpr size_t TAG_SIZE      = 10;
+constexpr size_t GCM_IV_SIZE   = 12;
+constexpr size_t GCM_TAG_SIZE  = 16;
+constexpr size_t HEADER_SIZE   = 12;
+
+constexpr auto BENCHMARK_DURATION = std::chrono::seconds(2);
+
+/* 160-byte payload is 20 ms of G.711 audio, 1200 bytes is a typical video packet */
+const std::vector<size_t> PAYLOAD_SIZES = { 160, 1200 };
+
+static void set_iv(uint8_t *iv, uint64_t index)
+{
+    memset(iv, 0, IV_SIZE);
+
+    for (int i = 0; i < 8; ++i)
+        iv[6 + i] = (uint8_t)(index >> (56 - 8 * i));
+}
+
+static double per_packet(const uint8_t *key, const uint8_t *auth_key, uint8_t *packet, size_t len)
+{
+    uint8_t iv[IV_SIZE];
+    uint8_t tag[TAG_SIZE];
+    uint64_t packets = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    auto end   = start + BENCHMARK_DURATION;
+
+    while (std::chrono::steady_clock::now() < end) {
+        for (int i = 0; i < 1000; ++i, ++packets) {
+            set_iv(iv, packets);
+
+            uvgrtp::crypto::aes::ctr ctr(key, KEY_SIZE, iv);
+            ctr.encrypt(packet, packet, len);
+
+            uvgrtp::crypto::hmac::sha1 hmac(auth_key, AUTH_KEY_SIZE);
+            hmac.update(packet, len);
+            hmac.final(tag, TAG_SIZE);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return packets / elapsed.count();
+}
+
+static double cached(const uint8_t *key, const uint8_t *auth_key, uint8_t *packet, size_t len)
+{
+    uint8_t iv[IV_SIZE];
+    uint8_t tag[TAG_SIZE];
+    uint64_t packets = 0;
+
+    uvgrtp::crypto::aes::ctr ctr(key, KEY_SIZE);
+    uvgrtp::crypto::hmac::sha1 hmac(auth_key, AUTH_KEY_SIZE);
+
+    auto start = std::chrono::steady_clock::now();
+    auto end   = start + BENCHMARK_DURATION;
+
+    while (std::chrono::steady_clock::now() < end) {
+        for (int i = 0; i < 1000; ++i, ++packets) {
+            set_iv(iv, packets);
+
+            ctr.set_iv(iv);
+            ctr.encrypt(packet, packet, len);
+
+            hmac.update(packet, len);
+            hmac.final(tag, TAG_SIZE);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return packets / elapsed.count();
+}
+
+static double gcm(const uint8_t *key, uint8_t *packet, size_t len)
+{
+    uint8_t iv[IV_SIZE];
+    uint8_t tag[GCM_TAG_SIZE];
+    uint8_t header[HEADER_SIZE] = { 0x80 };
+    uint64_t packets = 0;
+
+    uvgrtp::crypto::aes::gcm gcm(key, KEY_SIZE);
+
+    auto start = std::chrono::steady_clock::now();
+    auto end   = start + BENCHMARK_DURATION;
+
+    while (std::chrono::steady_clock::now() < end) {
+        for (int i = 0; i < 1000; ++i, ++packets) {
+            set_iv(iv, packets);
+
+            gcm.encrypt_init(iv, GCM_IV_SIZE);
+            gcm.update_aad(header, HEADER_SIZE);
+            gcm.encrypt(packet, packet, len);
+            gcm.final(tag, GCM_TAG_SIZE);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return packets / elapsed.count();
+}
+
+int main(void)
+{
+    if (!uvgrtp::crypto::enabled()) {
+        std::cerr << "Cannot run the crypto benchmark if crypto is not included in uvgRTP!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Crypto backend: " << uvgrtp::crypto::backend() << std::endl;
+
+    uint8_t key[KEY_SIZE];
+    uint8_t auth_key[AUTH_KEY_SIZE];
+
+    uvgrtp::crypto::random::generate_random(key, KEY_SIZE);
+    uvgrtp::crypto::random::generate_random(auth_key, AUTH_KEY_SIZE);
+
+    for (auto& size : PAYLOAD_SIZES) {
+        std::unique_ptr<uint8_t[]> packet = std::unique_ptr<uint8_t[]>(new uint8_t[size]);
+        memset(packet.get(), 'a', size);
+
+        double before = per_packet(key, auth_key, packet.get(), size);
+        double after  = cached(key, auth_key, packet.get(), size);
+        double aead   = gcm(key, packet.get(), size);
+
+        std::cout << size << " bytes: per packet " << (uint64_t)before << " pkts/s, cached "
+                  << (uint64_t)after << " pkts/s (" << after / before << "x), gcm "
+                  << (uint64_t)aead << " pkts/s (" << aead / after << "x of cached)" << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
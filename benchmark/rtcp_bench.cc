@@ -0,0 +1,172 @@
+#include "rtcp_packets.hh"
+#include "srtp/srtcp.hh"
+
+#include <uvgrtp/crypto.hh>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/* Measures the cost of one RTCP report interval with SRTCP in sessions of
+ * PARTICIPANTS members.
+ *
+ * "build" writes the compound packet the way rtcp::generate_report() does:
+ * an SR with a report block for each reported source followed by SDES. An
+ * RTCP packet holds at most 31 report blocks so the number of blocks is capped
+ * at that.
+ *
+ * "per participant" protects a separate copy of the report with SRTCP for every
+ * member and "once" protects it once and reuses the same datagram for everyone,
+ * which is what uvgRTP does since all members share the SRTCP keys of the stream.
+ * The cached session keys of the stream are used in both.
+ *
+ * "verify" is the cost at the receiving end for one report, first with one master
+ * key and then with two (key rollover without MKI) where the newer key is tried
+ * first and the packet only verifies with the older one.
+ *
+ * Sending is left out, the datagrams would be the same in both cases. */
+
+constexpr size_t   KEY_SIZE    = 16;
+constexpr size_t   SALT_SIZE   = 14;
+constexpr size_t   MAX_REPORTS = 31;
+constexpr uint32_t OUR_SSRC    = 0x11223344;
+
+constexpr auto BENCHMARK_DURATION = std::chrono::seconds(1);
+
+const std::vector<size_t> PARTICIPANTS = { 10, 100, 1000, 5000 };
+
+static void build(uint8_t *frame, size_t size, uint16_t reports,
+                  const std::vector<uvgrtp::frame::rtcp_sdes_item>& items)
+{
+    int ptr = 0;
+
+    memset(frame, 0, size);
+
+    uvgrtp::construct_rtcp_header(frame, ptr, uvgrtp::get_sr_packet_size(reports), reports, uvgrtp::frame::RTCP_FT_SR);
+    uvgrtp::construct_ssrc(frame, ptr, OUR_SSRC);
+    uvgrtp::construct_sender_info(frame, ptr, 0x0102030405060708, 90000, 1000, 1200000);
+
+    for (uint16_t i = 0; i < reports; ++i)
+        uvgrtp::construct_report_block(frame, ptr, 0x1000 + i, 0, 1, 0, i, 10, 0, 0);
+
+    uvgrtp::construct_rtcp_header(frame, ptr, uvgrtp::get_sdes_packet_size(items), 1, uvgrtp::frame::RTCP_FT_SDES);
+    uvgrtp::construct_sdes_chunk(frame, ptr, { OUR_SSRC, items });
+}
+
+/* Return the time one report interval takes in microseconds */
+template <typename F>
+static double measure(F&& interval)
+{
+    uint64_t intervals = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    auto end   = start + BENCHMARK_DURATION;
+
+    while (std::chrono::steady_clock::now() < end || intervals == 0) {
+        interval();
+        ++intervals;
+    }
+
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / intervals;
+}
+
+static void run(const char *name, int flags, uint8_t *key, uint8_t *other_key, uint8_t *salt)
+{
+    int srtp_flags = flags | RCE_SRTP | RCE_SRTP_KMNGMNT_USER;
+
+    /* CNAME is SDES item type 1 */
+    char cname[] = "rtcp_bench@127.0.0.1";
+    std::vector<uvgrtp::frame::rtcp_sdes_item> items = {
+        { 1, (uint8_t)strlen(cname), cname }
+    };
+
+    uvgrtp::srtcp sender;
+    uvgrtp::srtcp receiver;
+    uvgrtp::srtcp rollover;
+
+    if (sender.init(uvgrtp::SRTCP, srtp_flags, key, key, salt, salt) != RTP_OK ||
+        receiver.init(uvgrtp::SRTCP, srtp_flags, key, key, salt, salt) != RTP_OK ||
+        rollover.init(uvgrtp::SRTCP, srtp_flags, key, key, salt, salt) != RTP_OK ||
+        rollover.add_master_key(other_key, other_key, salt, salt, 0, 0) != RTP_OK) {
+        std::cerr << "Failed to initialize SRTCP" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::cout << name << std::endl;
+
+    for (auto& participants : PARTICIPANTS) {
+        uint16_t reports = (uint16_t)std::min(participants, MAX_REPORTS);
+        size_t size      = uvgrtp::get_sr_packet_size(reports) + uvgrtp::get_sdes_packet_size(items)
+            + uvgrtp::base_srtp::get_rtcp_trailer_length(srtp_flags);
+
+        std::unique_ptr<uint8_t[]> frame(new uint8_t[size]);
+        std::unique_ptr<uint8_t[]> copy(new uint8_t[size]);
+        uint64_t index = 0;
+
+        double build_us = measure([&] {
+            build(frame.get(), size, reports, items);
+        });
+
+        double per_participant_us = measure([&] {
+            build(frame.get(), size, reports, items);
+            ++index;
+
+            for (size_t i = 0; i < participants; ++i) {
+                memcpy(copy.get(), frame.get(), size);
+                sender.handle_rtcp_encryption(srtp_flags, index, OUR_SSRC, copy.get(), size);
+            }
+        });
+
+        double once_us = measure([&] {
+            build(frame.get(), size, reports, items);
+            sender.handle_rtcp_encryption(srtp_flags, ++index, OUR_SSRC, frame.get(), size);
+        });
+
+        /* the receivers do not check the index, the replay window is not enabled */
+        build(frame.get(), size, reports, items);
+        sender.handle_rtcp_encryption(srtp_flags, ++index, OUR_SSRC, frame.get(), size);
+
+        double verify_us = measure([&] {
+            memcpy(copy.get(), frame.get(), size);
+            if (receiver.handle_rtcp_decryption(srtp_flags, OUR_SSRC, copy.get(), size) != RTP_OK)
+                exit(EXIT_FAILURE);
+        });
+
+        double rollover_us = measure([&] {
+            memcpy(copy.get(), frame.get(), size);
+            if (rollover.handle_rtcp_decryption(srtp_flags, OUR_SSRC, copy.get(), size) != RTP_OK)
+                exit(EXIT_FAILURE);
+        });
+
+        std::cout << "  " << participants << " participants (" << size << " bytes): build "
+                  << build_us << " us, per participant " << per_participant_us << " us, once "
+                  << once_us << " us (" << per_participant_us / once_us << "x), verify "
+                  << verify_us << " us, verify with two keys " << rollover_us << " us" << std::endl;
+    }
+}
+
+int main(void)
+{
+    if (!uvgrtp::crypto::enabled()) {
+        std::cerr << "Cannot run the RTCP benchmark if crypto is not included in uvgRTP!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    uint8_t key[KEY_SIZE];
+    uint8_t other_key[KEY_SIZE];
+    uint8_t salt[SALT_SIZE];
+
+    uvgrtp::crypto::random::generate_random(key, KEY_SIZE);
+    uvgrtp::crypto::random::generate_random(other_key, KEY_SIZE);
+    uvgrtp::crypto::random::generate_random(salt, SALT_SIZE);
+
+    run("AES-CM + HMAC-SHA1", 0, key, other_key, salt);
+    run("AES-GCM",            RCE_SRTP_AES_GCM, key, other_key, salt);
+
+    return EXIT_SUCCESS;
+}
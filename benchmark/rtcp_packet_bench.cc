@@ -0,0 +1,173 @@
+#include "rtcp_packets.hh"
+#include "rtp.hh"
+
+#include <uvgrtp/frame.hh>
+#include <uvgrtp/rtcp.hh>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/* Measures building and parsing of RTCP compound packets.
+ *
+ * "allocating" builds the report the way rtcp::generate_report() used to: a new
+ * buffer is allocated and cleared for every report and the SDES chunk is copied
+ * into a temporary before it is written. "preallocated" writes the same report
+ * to a buffer that is reused between the reports, like generate_report() does now.
+ *
+ * "frame hook" parses a received SR + SDES compound packet and gives the report
+ * to a receiver hook as an allocated rtcp_sender_report with a vector of report
+ * blocks. "view hook" gives the same report to install_report_view_hook() which
+ * reads it from the receive buffer. The SDES packet is handled the same way in both. */
+
+constexpr uint32_t OUR_SSRC    = 0x11223344;
+constexpr uint32_t PEER_SSRC   = 0x55667788;
+constexpr size_t   MTU         = 1492;
+
+constexpr auto BENCHMARK_DURATION = std::chrono::seconds(1);
+
+const std::vector<uint16_t> REPORTS = { 1, 8, 31 };
+
+/* Return the time one operation takes in nanoseconds */
+template <typename F>
+static double measure(F&& operation)
+{
+    uint64_t operations = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    auto end   = start + BENCHMARK_DURATION;
+
+    while (std::chrono::steady_clock::now() < end || operations == 0) {
+        for (int i = 0; i < 100; ++i)
+            operation();
+        operations += 100;
+    }
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / operations;
+}
+
+static size_t write_report(uint8_t *frame, uint32_t ssrc, uint16_t reports,
+                           const std::vector<uvgrtp::frame::rtcp_sdes_item>& items)
+{
+    int ptr = 0;
+
+    uvgrtp::construct_rtcp_header(frame, ptr, uvgrtp::get_sr_packet_size(reports), reports, uvgrtp::frame::RTCP_FT_SR);
+    uvgrtp::construct_ssrc(frame, ptr, ssrc);
+    uvgrtp::construct_sender_info(frame, ptr, 0x0102030405060708, 90000, 1000, 1200000);
+
+    for (uint16_t i = 0; i < reports; ++i)
+        uvgrtp::construct_report_block(frame, ptr, 0x1000 + i, 0, 1, 0, i, 10, 0, 0);
+
+    uvgrtp::construct_rtcp_header(frame, ptr, uvgrtp::get_sdes_packet_size(items), 1, uvgrtp::frame::RTCP_FT_SDES);
+    uvgrtp::construct_sdes_chunk(frame, ptr, ssrc, items);
+
+    return ptr;
+}
+
+static void build(uint16_t reports, const std::vector<uvgrtp::frame::rtcp_sdes_item>& items)
+{
+    size_t size = uvgrtp::get_sr_packet_size(reports) + uvgrtp::get_sdes_packet_size(items);
+    std::atomic<size_t> written(0);
+
+    double allocating_ns = measure([&] {
+        uint8_t *frame = new uint8_t[size];
+        int ptr = 0;
+
+        memset(frame, 0, size);
+
+        uvgrtp::construct_rtcp_header(frame, ptr, uvgrtp::get_sr_packet_size(reports), reports, uvgrtp::frame::RTCP_FT_SR);
+        uvgrtp::construct_ssrc(frame, ptr, OUR_SSRC);
+        uvgrtp::construct_sender_info(frame, ptr, 0x0102030405060708, 90000, 1000, 1200000);
+
+        for (uint16_t i = 0; i < reports; ++i)
+            uvgrtp::construct_report_block(frame, ptr, 0x1000 + i, 0, 1, 0, i, 10, 0, 0);
+
+        uvgrtp::frame::rtcp_sdes_chunk chunk = { OUR_SSRC, items };
+        uvgrtp::construct_rtcp_header(frame, ptr, uvgrtp::get_sdes_packet_size(items), 1, uvgrtp::frame::RTCP_FT_SDES);
+        uvgrtp::construct_sdes_chunk(frame, ptr, chunk);
+
+        written += frame[ptr - 1];
+        delete[] frame;
+    });
+
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[MTU]);
+
+    double preallocated_ns = measure([&] {
+        written += write_report(buffer.get(), OUR_SSRC, reports, items);
+    });
+
+    std::cout << "  build, " << reports << " report blocks (" << size << " bytes): allocating "
+              << allocating_ns << " ns, preallocated " << preallocated_ns << " ns ("
+              << allocating_ns / preallocated_ns << "x)" << std::endl;
+}
+
+static void parse(uint16_t reports, const std::vector<uvgrtp::frame::rtcp_sdes_item>& items)
+{
+    std::unique_ptr<uint8_t[]> packet(new uint8_t[MTU]);
+    std::unique_ptr<uint8_t[]> copy(new uint8_t[MTU]);
+
+    size_t size = write_report(packet.get(), PEER_SSRC, reports, items);
+    std::atomic<uint64_t> blocks(0);
+
+    double frame_ns = 0;
+    double view_ns  = 0;
+
+    {
+        auto rtp = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_GENERIC);
+        uvgrtp::rtcp rtcp(rtp, "rtcp_packet_bench@127.0.0.1", RCE_RTCP);
+
+        rtcp.install_sender_hook([&](std::unique_ptr<uvgrtp::frame::rtcp_sender_report> sr) {
+            blocks += sr->report_blocks.size();
+        });
+
+        /* the packet is parsed in place so it is copied back every time */
+        frame_ns = measure([&] {
+            memcpy(copy.get(), packet.get(), size);
+            if (rtcp.handle_incoming_packet(copy.get(), size) != RTP_OK)
+                exit(EXIT_FAILURE);
+        });
+    }
+
+    {
+        auto rtp = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_GENERIC);
+        uvgrtp::rtcp rtcp(rtp, "rtcp_packet_bench@127.0.0.1", RCE_RTCP);
+
+        rtcp.install_report_view_hook([&](const uvgrtp::frame::rtcp_report_view& view) {
+            for (size_t i = 0; i < view.header.count; ++i)
+                blocks += uvgrtp::frame::get_report_block(view, i).ssrc != 0;
+        });
+
+        view_ns = measure([&] {
+            memcpy(copy.get(), packet.get(), size);
+            if (rtcp.handle_incoming_packet(copy.get(), size) != RTP_OK)
+                exit(EXIT_FAILURE);
+        });
+    }
+
+    std::cout << "  parse, " << reports << " report blocks (" << size << " bytes): frame hook "
+              << frame_ns << " ns, view hook " << view_ns << " ns ("
+              << frame_ns / view_ns << "x)" << std::endl;
+}
+
+int main(void)
+{
+    /* CNAME is SDES item type 1 */
+    char cname[] = "rtcp_packet_bench@127.0.0.1";
+    std::vector<uvgrtp::frame::rtcp_sdes_item> items = {
+        { 1, (uint8_t)strlen(cname), cname }
+    };
+
+    std::cout << "RTCP compound packets" << std::endl;
+
+    for (auto& reports : REPORTS) {
+        build(reports, items);
+        parse(reports, items);
+    }
+
+    return EXIT_SUCCESS;
+}
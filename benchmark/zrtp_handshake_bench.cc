@@ -0,0 +1,242 @@
+#include <uvgrtp/lib.hh>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+/* Measures how long it takes to negotiate SRTP keys with ZRTP over loopback.
+ *
+ * Both ends create a media stream with RCE_SRTP_KMNGMNT_ZRTP and the time is
+ * taken from the start until both create_stream() calls have returned, i.e.
+ * the whole DHMode handshake from Hello to Conf2ACK.
+ *
+ * "default" lets uvgRTP pick the key agreement, which is X25519 (E255) when
+ * both ends offer it, and "dh3k" restricts one end to the mandatory
+ * 3072-bit finite field Diffie-Hellman with RCE_ZRTP_DH3K_ONLY.
+ *
+ * The cost of the key agreement alone is printed for each type as well.
+ *
+ * Both are also measured with the key pair pool of the context enabled, after
+ * giving the pool time to fill up. The key pairs then do not have to be generated
+ * during the handshake.
+ *
+ * "async" brings up SESSIONS session pairs with RCE_ZRTP_ASYNC from one thread
+ * and measures how long the create_stream() calls took and the time until all
+ * of the streams have been keyed. The handshakes run in parallel so on a multicore
+ * machine, or with a real network round-trip time, the total is well below the
+ * sequential time.
+ *
+ * "multistream" keys STREAMS streams of one session pair. The first stream does
+ * a DHMode handshake and the rest use Multistream Mode with the session key it
+ * produced. The streams are created one by one, waiting for each handshake, and
+ * then all at once with RCE_ZRTP_ASYNC so that the Multistream handshakes run
+ * concurrently after the DHMode handshake has finished. */
+
+constexpr char     ADDRESS[]      = "127.0.0.1";
+constexpr uint16_t SENDER_PORT    = 8888;
+constexpr uint16_t RECEIVER_PORT  = 8890;
+
+constexpr int HANDSHAKES = 10;
+constexpr int SESSIONS   = 20;
+constexpr int AGREEMENTS = 50;
+constexpr int STREAMS    = 16;
+
+/* both ends of the handshake take a key pair from the same pool */
+constexpr size_t POOL_DEPTH = 2;
+constexpr auto POOL_FILL_TIME = std::chrono::milliseconds(500);
+
+static double handshake(int flags, size_t pool_depth)
+{
+    uvgrtp::context ctx;
+
+    if (pool_depth) {
+        ctx.enable_keypair_pool(pool_depth);
+        std::this_thread::sleep_for(POOL_FILL_TIME);
+    }
+
+    uvgrtp::session *sender_session   = ctx.create_session(ADDRESS);
+    uvgrtp::session *receiver_session = ctx.create_session(ADDRESS);
+    uvgrtp::media_stream *send = nullptr;
+    uvgrtp::media_stream *recv = nullptr;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread receiver([&] {
+        recv = receiver_session->create_stream(RECEIVER_PORT, SENDER_PORT, RTP_FORMAT_GENERIC,
+                                               RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP | flags);
+    });
+
+    send = sender_session->create_stream(SENDER_PORT, RECEIVER_PORT, RTP_FORMAT_GENERIC,
+                                         RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP);
+    receiver.join();
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (!send || !recv) {
+        std::cerr << "ZRTP negotiation failed" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    sender_session->destroy_stream(send);
+    receiver_session->destroy_stream(recv);
+    ctx.destroy_session(sender_session);
+    ctx.destroy_session(receiver_session);
+
+    return elapsed.count();
+}
+
+static double async_handshakes(double& create_time)
+{
+    uvgrtp::context ctx;
+    uvgrtp::session *sessions[2 * SESSIONS];
+    uvgrtp::media_stream *streams[2 * SESSIONS];
+
+    int flags = RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP | RCE_ZRTP_ASYNC;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < SESSIONS; ++i) {
+        uint16_t port = SENDER_PORT + 4 * i;
+
+        sessions[2 * i]     = ctx.create_session(ADDRESS);
+        sessions[2 * i + 1] = ctx.create_session(ADDRESS);
+        streams[2 * i]      = sessions[2 * i]->create_stream(port, port + 2, RTP_FORMAT_GENERIC, flags);
+        streams[2 * i + 1]  = sessions[2 * i + 1]->create_stream(port + 2, port, RTP_FORMAT_GENERIC, flags);
+    }
+
+    create_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (int i = 0; i < 2 * SESSIONS; ++i) {
+        if (!streams[i] || streams[i]->wait_for_zrtp(10000) != RTP_OK) {
+            std::cerr << "ZRTP negotiation failed" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (int i = 0; i < 2 * SESSIONS; ++i) {
+        sessions[i]->destroy_stream(streams[i]);
+        ctx.destroy_session(sessions[i]);
+    }
+
+    return elapsed.count();
+}
+
+static double multistream_handshakes(bool async)
+{
+    uvgrtp::context ctx;
+    uvgrtp::session *sender_session   = ctx.create_session(ADDRESS);
+    uvgrtp::session *receiver_session = ctx.create_session(ADDRESS);
+    uvgrtp::media_stream *send[STREAMS];
+    uvgrtp::media_stream *recv[STREAMS];
+
+    int flags = RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP | (async ? RCE_ZRTP_ASYNC : 0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < STREAMS; ++i) {
+        uint16_t port = SENDER_PORT + 4 * i;
+
+        if (async) {
+            send[i] = sender_session->create_stream(port, port + 2, RTP_FORMAT_GENERIC, flags);
+            recv[i] = receiver_session->create_stream(port + 2, port, RTP_FORMAT_GENERIC, flags);
+            continue;
+        }
+
+        std::thread receiver([&] {
+            recv[i] = receiver_session->create_stream(port + 2, port, RTP_FORMAT_GENERIC, flags);
+        });
+
+        send[i] = sender_session->create_stream(port, port + 2, RTP_FORMAT_GENERIC, flags);
+        receiver.join();
+    }
+
+    for (int i = 0; i < STREAMS; ++i) {
+        if (!send[i] || !recv[i] ||
+            (async && (send[i]->wait_for_zrtp(10000) != RTP_OK || recv[i]->wait_for_zrtp(10000) != RTP_OK))) {
+            std::cerr << "ZRTP negotiation failed" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (int i = 0; i < STREAMS; ++i) {
+        sender_session->destroy_stream(send[i]);
+        receiver_session->destroy_stream(recv[i]);
+    }
+    ctx.destroy_session(sender_session);
+    ctx.destroy_session(receiver_session);
+
+    return elapsed.count();
+}
+
+/* Time one side of a key agreement: generating the key pair and computing the shared secret */
+template <typename T>
+static double agreement(size_t pk_size, size_t ss_size)
+{
+    uint8_t pk[384], ss[384];
+    T remote;
+
+    remote.generate_keys();
+    remote.get_pk(pk, pk_size);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < AGREEMENTS; ++i) {
+        T local;
+
+        local.generate_keys();
+        local.set_remote_pk(pk, pk_size);
+        local.get_shared_secret(ss, ss_size);
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / AGREEMENTS;
+}
+
+int main(void)
+{
+    if (!uvgrtp::crypto::enabled()) {
+        std::cerr << "Cannot run the ZRTP benchmark if crypto is not included in uvgRTP!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Crypto backend: " << uvgrtp::crypto::backend() << std::endl;
+
+    std::cout << "Key agreement: DH3k "
+              << agreement<uvgrtp::crypto::dh>(384, 384) << " ms, EC25 "
+              << agreement<uvgrtp::crypto::ecdh::p256>(uvgrtp::crypto::ecdh::p256::PK_SIZE,
+                                                       uvgrtp::crypto::ecdh::p256::SS_SIZE) << " ms, E255 "
+              << agreement<uvgrtp::crypto::ecdh::x25519>(uvgrtp::crypto::ecdh::x25519::PK_SIZE,
+                                                         uvgrtp::crypto::ecdh::x25519::SS_SIZE) << " ms"
+              << std::endl;
+
+    for (int flags : { (int)RCE_ZRTP_DH3K_ONLY, 0 }) {
+        double total  = 0;
+        double pooled = 0;
+
+        for (int i = 0; i < HANDSHAKES; ++i) {
+            total  += handshake(flags, 0);
+            pooled += handshake(flags, POOL_DEPTH);
+        }
+
+        std::cout << (flags ? "dh3k" : "default") << " handshake: "
+                  << total / HANDSHAKES << " ms, with key pair pool "
+                  << pooled / HANDSHAKES << " ms" << std::endl;
+    }
+
+    double sequential  = SESSIONS * handshake(0, 0);
+    double create_time = 0;
+    double total       = async_handshakes(create_time);
+
+    std::cout << SESSIONS << " sessions: sequential " << sequential << " ms, async "
+              << total << " ms of which create_stream() " << create_time << " ms" << std::endl;
+
+    std::cout << STREAMS << " streams (multistream): sequential " << multistream_handshakes(false)
+              << " ms, async " << multistream_handshakes(true) << " ms" << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -3,12 +3,32 @@
 #include "util.hh"
 
 #include <map>
+#include <memory>
 #include <string>
 
 
 namespace uvgrtp {
 
     class session;
+    class keypair_pool;
+    class rtcp_scheduler;
+
+    /**
+     * \brief Counters of the ZRTP key pair pool, see context::get_keypair_pool_statistics()
+     */
+    struct keypair_pool_statistics {
+        /** \brief Number of key pairs generated by the pool */
+        uint64_t generated = 0;
+
+        /** \brief Number of key pairs taken from the pool by handshakes */
+        uint64_t taken = 0;
+
+        /** \brief Number of handshakes that found the pool empty and generated their keys themselves */
+        uint64_t missed = 0;
+
+        /** \brief Number of key pairs ready in the pool */
+        uint64_t ready = 0;
+    };
 
     class context {
         public:
@@ -78,12 +98,51 @@ namespace uvgrtp {
 
             bool crypto_enabled() const;
 
+            /**
+             * \brief Generate ZRTP key pairs ahead of time
+             *
+             * \details Generating the ephemeral key pair is part of every ZRTP handshake in
+             * Diffie-Hellman mode. With the key pair pool enabled, a background thread keeps
+             * "depth" key pairs of each supported key agreement type ready and the handshakes
+             * of sessions created by this context take a ready key pair instead of generating one.
+             * This makes the stream setup faster and its latency predictable when many sessions
+             * start at once. Each key pair is used only once. If the pool has run out, the keys
+             * are generated during the handshake as usual.
+             *
+             * The pool is used by the sessions created after this call.
+             *
+             * \param depth Number of key pairs of each type to keep ready, 0 disables the pool
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK            On success
+             * \retval RTP_NOT_SUPPORTED If uvgRTP has been compiled without crypto support
+             */
+            rtp_error_t enable_keypair_pool(size_t depth);
+
+            /**
+             * \brief Get the counters of the ZRTP key pair pool
+             *
+             * \details A key pair is removed from the pool when it is taken, so the number of
+             * key pairs generated is always the number of key pairs taken plus the number
+             * still ready in the pool.
+             *
+             * \return The counters of the current pool, all zero if the pool is not enabled
+             */
+            uvgrtp::keypair_pool_statistics get_keypair_pool_statistics() const;
+
         private:
             /* Generate CNAME for participant using host and login names */
             std::string generate_cname() const;
 
             /* CNAME is the same for all connections */
             std::string cname_;
+
+            /* ZRTP key pairs generated ahead of time, nullptr if the pool is not enabled */
+            std::shared_ptr<uvgrtp::keypair_pool> keypool_;
+
+            /* Sends the RTCP reports of all media streams created through this context */
+            std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler_;
         };
 }
 
@@ -1,48 +1,49 @@
 #pragma once
 
-#if __cplusplus >= 201703L || _MSC_VER >= 1911
+/* The classes below are the interface between uvgRTP and its crypto backend.
+ * The backend is selected when uvgRTP is built and it does not show in this header:
+ *
+ *   __RTP_CRYPTO_CRYPTOPP__  Crypto++ (src/crypto/cryptopp.cc)
+ *   __RTP_CRYPTO_BUILTIN__   built-in implementation that uses AES-NI, PCLMULQDQ and
+ *                            SHA extensions if the CPU has them and portable code otherwise
+ *                            (src/crypto/builtin.cc)
+ *   __RTP_NO_CRYPTO__        SRTP/ZRTP are disabled (src/crypto/none.cc)
+ *
+ * CMake defines one of these based on CRYPTO_BACKEND and DISABLE_CRYPTO. Builds that do not
+ * use CMake get Crypto++ if its headers are found and the built-in backend otherwise */
+#ifndef __RTP_NO_CRYPTO__
+
+#if !defined(__RTP_CRYPTO_CRYPTOPP__) && !defined(__RTP_CRYPTO_BUILTIN__)
+#if defined(__has_include)
 #if __has_include(<cryptopp/aes.h>) && \
-    __has_include(<cryptopp/base32.h>) && \
     __has_include(<cryptopp/cryptlib.h>) && \
     __has_include(<cryptopp/dh.h>) && \
+    __has_include(<cryptopp/eccrypto.h>) && \
+    __has_include(<cryptopp/gcm.h>) && \
     __has_include(<cryptopp/hmac.h>) && \
     __has_include(<cryptopp/modes.h>) && \
     __has_include(<cryptopp/osrng.h>) && \
     __has_include(<cryptopp/sha.h>) && \
-    __has_include(<cryptopp/crc.h>) && \
-    !defined(__RTP_NO_CRYPTO__)
-
-#define __RTP_CRYPTO__
-
-#include <cryptopp/aes.h>
-#include <cryptopp/base32.h>
-#include <cryptopp/cryptlib.h>
-#include <cryptopp/dh.h>
-#include <cryptopp/hmac.h>
-#include <cryptopp/modes.h>
-#include <cryptopp/osrng.h>
-#include <cryptopp/sha.h>
-#include <cryptopp/crc.h>
+    __has_include(<cryptopp/xed25519.h>)
+#define __RTP_CRYPTO_CRYPTOPP__
+#endif
+#endif
+#endif
 
+#ifndef __RTP_CRYPTO_CRYPTOPP__
+#ifndef __RTP_CRYPTO_BUILTIN__
+#define __RTP_CRYPTO_BUILTIN__
+#endif
 #endif
-#else // __cplusplus < 201703L
-#ifndef __RTP_NO_CRYPTO__
-#define __RTP_CRYPTO__
 
-#include <cryptopp/aes.h>
-#include <cryptopp/base32.h>
-#include <cryptopp/cryptlib.h>
-#include <cryptopp/dh.h>
-#include <cryptopp/hmac.h>
-#include <cryptopp/modes.h>
-#include <cryptopp/osrng.h>
-#include <cryptopp/sha.h>
-#include <cryptopp/crc.h>
+#define __RTP_CRYPTO__
 
-#endif
-#endif // __cplusplus
+#endif // __RTP_NO_CRYPTO__
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 
 namespace uvgrtp {
 
@@ -50,6 +51,8 @@ namespace uvgrtp {
 
         /* hash-based message authentication code */
         namespace hmac {
+            /* The key is processed only once when the object is constructed and
+             * the object is reset after final() so it can be reused for the next message */
             class sha1 {
                 public:
                     sha1(const uint8_t *key, size_t key_size);
@@ -62,9 +65,8 @@ namespace uvgrtp {
                     void final(uint8_t *digest, size_t size);
 
                 private:
-#ifdef __RTP_CRYPTO__
-                    CryptoPP::HMAC<CryptoPP::SHA1> hmac_;
-#endif
+                    struct impl;
+                    std::unique_ptr<impl> impl_;
             };
 
             class sha256 {
@@ -76,9 +78,8 @@ namespace uvgrtp {
                     void final(uint8_t *digest);
 
                 private:
-#ifdef __RTP_CRYPTO__
-                    CryptoPP::HMAC<CryptoPP::SHA256> hmac_;
-#endif
+                    struct impl;
+                    std::unique_ptr<impl> impl_;
             };
         }
 
@@ -91,9 +92,8 @@ namespace uvgrtp {
                 void final(uint8_t *digest);
 
             private:
-#ifdef __RTP_CRYPTO__
-                CryptoPP::SHA256 sha_;
-#endif
+                struct impl;
+                std::unique_ptr<impl> impl_;
         };
 
         namespace aes {
@@ -107,10 +107,8 @@ namespace uvgrtp {
                     void decrypt(uint8_t *output, const uint8_t *input, size_t len);
 
                 private:
-#ifdef __RTP_CRYPTO__
-                    CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption enc_;
-                    CryptoPP::ECB_Mode<CryptoPP::AES>::Decryption dec_;
-#endif
+                    struct impl;
+                    std::unique_ptr<impl> impl_;
             };
 
             class cfb {
@@ -122,25 +120,59 @@ namespace uvgrtp {
                     void decrypt(uint8_t *output, const uint8_t *input, size_t len);
 
                 private:
-#ifdef __RTP_CRYPTO__
-                    CryptoPP::CFB_Mode<CryptoPP::AES>::Encryption enc_;
-                    CryptoPP::CFB_Mode<CryptoPP::AES>::Decryption dec_;
-#endif
+                    struct impl;
+                    std::unique_ptr<impl> impl_;
             };
 
+            /* In counter mode encryption and decryption are the same operation
+             * so only one key schedule is needed. The key can be expanded once
+             * and then only the IV is changed for each message with set_iv() */
             class ctr {
                 public:
+                    ctr(const uint8_t *key, size_t key_size);
                     ctr(const uint8_t *key, size_t key_size, const uint8_t *iv);
                     ~ctr();
 
+                    void set_iv(const uint8_t *iv);
+
                     void encrypt(uint8_t *output, const uint8_t *input, size_t len);
                     void decrypt(uint8_t *output, const uint8_t *input, size_t len);
 
                 private:
-#ifdef __RTP_CRYPTO__
-                    CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption enc_;
-                    CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption dec_;
-#endif
+                    struct impl;
+                    std::unique_ptr<impl> impl_;
+            };
+
+            /* Galois/Counter Mode (authenticated encryption with associated data)
+             *
+             * The key is expanded once when the object is constructed. A message is processed
+             * by calling encrypt_init()/decrypt_init() with the IV of the message, then update_aad()
+             * for the associated data, encrypt()/decrypt() for the confidential data and finally
+             * final()/verify() to create or check the authentication tag */
+            class gcm {
+                public:
+                    gcm(const uint8_t *key, size_t key_size);
+                    ~gcm();
+
+                    void encrypt_init(const uint8_t *iv, size_t iv_len);
+                    void decrypt_init(const uint8_t *iv, size_t iv_len);
+
+                    /* must be called before encrypt()/decrypt() */
+                    void update_aad(const uint8_t *data, size_t len);
+
+                    void encrypt(uint8_t *output, const uint8_t *input, size_t len);
+                    void decrypt(uint8_t *output, const uint8_t *input, size_t len);
+
+                    /* write the first "size" bytes of the authentication tag of the encrypted message to "tag" */
+                    void final(uint8_t *tag, size_t size);
+
+                    /* Return true if the first "size" bytes of the authentication
+                     * tag of the decrypted message match "tag" */
+                    bool verify(const uint8_t *tag, size_t size);
+
+                private:
+                    struct impl;
+                    std::unique_ptr<impl> impl_;
             };
         }
 
@@ -163,13 +195,63 @@ namespace uvgrtp {
                 void get_shared_secret(uint8_t *ss, size_t len);
 
             private:
-#ifdef __RTP_CRYPTO__
-                CryptoPP::AutoSeededRandomPool prng_;
-                CryptoPP::DH dh_;
-                CryptoPP::Integer sk_, pk_, rpk_;
-#endif
+                struct impl;
+                std::unique_ptr<impl> impl_;
         };
 
+        /* elliptic curve diffie-hellman key agreement
+         *
+         * The keys are in the formats ZRTP uses: a P-256 public key is the affine x and y
+         * coordinates and the shared secret is the x coordinate of the resulting point, all
+         * big-endian, and X25519 keys and shared secret are the little-endian u-coordinates
+         * of RFC 7748. Unlike with "dh", the remote public key is validated */
+        namespace ecdh {
+            class p256 {
+                public:
+                    static const size_t PK_SIZE = 64;
+                    static const size_t SS_SIZE = 32;
+
+                    p256();
+                    ~p256();
+
+                    void generate_keys();
+                    void get_pk(uint8_t *pk, size_t len);
+
+                    /* Return false if "pk" is not a point on the curve */
+                    bool set_remote_pk(const uint8_t *pk, size_t len);
+
+                    /* Return false if the remote public key has not been set */
+                    bool get_shared_secret(uint8_t *ss, size_t len);
+
+                private:
+                    struct impl;
+                    std::unique_ptr<impl> impl_;
+            };
+
+            class x25519 {
+                public:
+                    static const size_t PK_SIZE = 32;
+                    static const size_t SS_SIZE = 32;
+
+                    x25519();
+                    ~x25519();
+
+                    void generate_keys();
+                    void get_pk(uint8_t *pk, size_t len);
+
+                    /* Return false if "pk" has an invalid size */
+                    bool set_remote_pk(const uint8_t *pk, size_t len);
+
+                    /* Return false if the remote public key is a low-order point
+                     * (the shared secret would be all zeros) or it has not been set */
+                    bool get_shared_secret(uint8_t *ss, size_t len);
+
+                private:
+                    struct impl;
+                    std::unique_ptr<impl> impl_;
+            };
+        }
+
         /* base32 */
         class b32 {
             public:
@@ -177,11 +259,6 @@ namespace uvgrtp {
                 ~b32();
 
                 void encode(const uint8_t *input, uint8_t *output, size_t len);
-
-            private:
-#ifdef __RTP_CRYPTO__
-                CryptoPP::Base32Encoder enc_;
-#endif
         };
 
         namespace random {
@@ -195,6 +272,10 @@ namespace uvgrtp {
         }
 
         bool enabled();
+
+        /* Return a human-readable name of the crypto backend uvgRTP was built with,
+         * including the CPU extensions the built-in backend uses on this machine */
+        const char *backend();
     }
 }
 
@@ -29,6 +29,18 @@ namespace uvgrtp {
             HEADER_SIZE_H266_FU        =  1,
         };
 
+        /* Limits of the RFC 8285 header extension support.
+         * Extension data is stored inside the frame so receiving extensions requires no allocations */
+        enum RTP_EXT_LIMITS {
+            RTP_EXT_MAX_ELEMENTS  = 16,  /* maximum number of extension elements per packet */
+            RTP_EXT_MAX_DATA_SIZE = 256, /* maximum size of the extension block, excluding the 4-byte header */
+        };
+
+        enum RTP_EXT_PROFILES {
+            RTP_EXT_ONE_BYTE = 0xbede, /* RFC 8285 one-byte header, IDs 1-14, 1-16 bytes of data */
+            RTP_EXT_TWO_BYTE = 0x1000, /* RFC 8285 two-byte header, IDs 1-255, 0-255 bytes of data */
+        };
+
         enum RTP_FRAME_TYPE {
             RTP_FT_GENERIC = 0, /* payload length + RTP Header size (N + 12) */
             RTP_FT_OPUS    = 1, /* payload length + RTP Header size + Opus header (N + 12 + 0 [for now]) */
@@ -41,7 +53,30 @@ namespace uvgrtp {
             RTCP_FT_RR   = 201, /* Receiver report */
             RTCP_FT_SDES = 202, /* Source description */
             RTCP_FT_BYE  = 203, /* Goodbye */
-            RTCP_FT_APP  = 204  /* Application-specific message */
+            RTCP_FT_APP  = 204, /* Application-specific message */
+            RTCP_FT_RTPFB = 205, /* Transport layer feedback (RFC 4585) */
+            RTCP_FT_PSFB = 206, /* Payload-specific feedback (RFC 4585) */
+            RTCP_FT_XR   = 207  /* Extended report (RFC 3611) */
+        };
+
+        /* Feedback message types (FMT) of RTCP_FT_RTPFB packets */
+        enum RTCP_RTPFB_FORMAT {
+            RTCP_RTPFB_NACK = 1  /* Generic NACK */
+        };
+
+        /* Feedback message types (FMT) of RTCP_FT_PSFB packets */
+        enum RTCP_PSFB_FORMAT {
+            RTCP_PSFB_PLI = 1,   /* Picture Loss Indication */
+            RTCP_PSFB_SLI = 2,   /* Slice Loss Indication */
+            RTCP_PSFB_RPSI = 3,  /* Reference Picture Selection Indication */
+            RTCP_PSFB_AFB = 15   /* Application layer feedback */
+        };
+
+        enum RTCP_XR_BLOCK_TYPE {
+            RTCP_XR_LOSS_RLE      = 1, /* Loss RLE Report Block */
+            RTCP_XR_DUPLICATE_RLE = 2, /* Duplicate RLE Report Block */
+            RTCP_XR_RECEIPT_TIMES = 3, /* Packet Receipt Times Report Block */
+            RTCP_XR_VOIP_METRICS  = 7  /* VoIP Metrics Report Block */
         };
 
         PACK(struct rtp_header {
@@ -62,11 +97,23 @@ namespace uvgrtp {
             uint8_t *data = nullptr;
         });
 
+        /* One RFC 8285 header extension element. "data" points to the extension
+         * block of the frame and is valid for as long as the frame is */
+        struct ext_element {
+            uint8_t id = 0;
+            uint8_t len = 0;
+            uint8_t *data = nullptr;
+        };
+
         struct rtp_frame {
             struct rtp_header header;
             uint32_t *csrc = nullptr;
             struct ext_header *ext;
 
+            /* If the extension block uses RFC 8285 format, its elements are listed here */
+            size_t ext_count = 0;
+            struct ext_element ext_elements[RTP_EXT_MAX_ELEMENTS];
+
             size_t padding_len = 0; /* non-zero if frame is padded */
             size_t payload_len = 0; /* payload_len: total_len - header_len - padding length (if padded) */
 
@@ -90,6 +137,15 @@ namespace uvgrtp {
             rtp_format_t format = RTP_FORMAT_GENERIC;
             int  type = 0;
             sockaddr_in src_addr;
+
+            /* Monotonic time in microseconds when the packet was taken for processing,
+             * shared by all packets processed in the same batch (for internal use only) */
+            uint64_t arrival = 0;
+
+            /* Inline storage for the extension block, "ext" points here
+             * if the block fits to RTP_EXT_MAX_DATA_SIZE (for internal use only) */
+            struct ext_header ext_inline;
+            uint8_t ext_data[RTP_EXT_MAX_DATA_SIZE];
         };
 
         struct rtcp_header {
@@ -98,6 +154,7 @@ namespace uvgrtp {
             union {
                 uint8_t count;
                 uint8_t pkt_subtype; /* for app packets */
+                uint8_t fmt;         /* for feedback messages */
             };
             uint8_t pkt_type = 0;
             uint16_t length = 0;
@@ -157,6 +214,92 @@ namespace uvgrtp {
             uint8_t *payload = nullptr;
         };
 
+        /* Loss RLE or Duplicate RLE Report Block (RFC 3611 sections 4.1 and 4.2)
+         *
+         * "chunks" are the run length and bit vector chunks of the packets from "begin_seq"
+         * up to but not including "end_seq", they are expanded with get_rle_packets() */
+        struct rtcp_xr_rle_block {
+            uint8_t  thinning = 0;
+            uint32_t ssrc = 0;
+            uint16_t begin_seq = 0;
+            uint16_t end_seq = 0;
+            std::vector<uint16_t> chunks;
+        };
+
+        /* Packet Receipt Times Report Block (RFC 3611 section 4.3)
+         *
+         * The receipt times of the packets received from "begin_seq" up to but
+         * not including "end_seq" in the RTP timestamp units of the source */
+        struct rtcp_xr_receipt_times_block {
+            uint8_t  thinning = 0;
+            uint32_t ssrc = 0;
+            uint16_t begin_seq = 0;
+            uint16_t end_seq = 0;
+            std::vector<uint32_t> receipt_times;
+        };
+
+        /* VoIP Metrics Report Block (RFC 3611 section 4.7)
+         *
+         * The rates and densities are fractions scaled by 256, the durations and delays are in
+         * milliseconds and 127 in the signal, noise and quality fields means that it is unavailable */
+        struct rtcp_xr_voip_metrics_block {
+            uint32_t ssrc = 0;
+            uint8_t  loss_rate = 0;
+            uint8_t  discard_rate = 0;
+            uint8_t  burst_density = 0;
+            uint8_t  gap_density = 0;
+            uint16_t burst_duration = 0;
+            uint16_t gap_duration = 0;
+            uint16_t round_trip_delay = 0;
+            uint16_t end_system_delay = 0;
+            uint8_t  signal_level = 127;
+            uint8_t  noise_level = 127;
+            uint8_t  rerl = 127;
+            uint8_t  gmin = 16;
+            uint8_t  r_factor = 127;
+            uint8_t  ext_r_factor = 127;
+            uint8_t  mos_lq = 127;
+            uint8_t  mos_cq = 127;
+            uint8_t  rx_config = 0;
+            uint16_t jb_nominal = 0;
+            uint16_t jb_maximum = 0;
+            uint16_t jb_abs_max = 0;
+        };
+
+        /* RTCP Extended Report (RFC 3611), the blocks of unsupported types are skipped */
+        struct rtcp_xr_packet {
+            struct rtcp_header header;
+            uint32_t ssrc = 0;
+            std::vector<rtcp_xr_rle_block> loss_rle;
+            std::vector<rtcp_xr_rle_block> duplicate_rle;
+            std::vector<rtcp_xr_receipt_times_block> receipt_times;
+            std::vector<rtcp_xr_voip_metrics_block> voip_metrics;
+        };
+
+        /* RTCP feedback message (RFC 4585 section 6.1)
+         *
+         * "header.count" is the feedback message type (FMT) and "header.pkt_type" either
+         * RTCP_FT_RTPFB or RTCP_FT_PSFB. The Feedback Control Information is given as is,
+         * the lost packets of a Generic NACK are expanded with get_nack_packets() */
+        struct rtcp_fb_packet {
+            struct rtcp_header header;
+            uint32_t sender_ssrc = 0;
+            uint32_t media_ssrc = 0;
+            std::vector<uint8_t> fci;
+        };
+
+        /* Read-only view of a received RTCP Sender or Receiver Report
+         *
+         * The view points to the buffer the packet was received to so it is only valid
+         * during the hook call it was given to. The sender info and the report blocks
+         * are decoded with get_sender_info() and get_report_block() */
+        struct rtcp_report_view {
+            struct rtcp_header header;                  /* header.count is the number of report blocks */
+            uint32_t ssrc = 0;
+            const uint8_t *sender_info = nullptr;       /* nullptr for Receiver Reports */
+            const uint8_t *report_blocks = nullptr;
+        };
+
         PACK(struct zrtp_frame {
             uint8_t version:4;
             uint16_t unused:12;
@@ -197,6 +340,30 @@ namespace uvgrtp {
          * Return RTP_INVALID_VALUE if "frame" is nullptr */
         rtp_error_t dealloc_frame(uvgrtp::frame::rtp_frame *frame);
 
+        /* Find header extension element with identifier "id" from "frame"
+         *
+         * Return pointer to the element on success
+         * Return nullptr if "frame" is nullptr or the frame does not carry the extension */
+        const ext_element *get_ext_element(const uvgrtp::frame::rtp_frame *frame, uint8_t id);
+
+        /* Decode the sender info of "view"
+         *
+         * Return all zeros if "view" is a Receiver Report */
+        rtcp_sender_info get_sender_info(const uvgrtp::frame::rtcp_report_view& view);
+
+        /* Decode report block "index" of "view", "index" must be smaller than view.header.count */
+        rtcp_report_block get_report_block(const uvgrtp::frame::rtcp_report_view& view, size_t index);
+
+        /* Expand the chunks of "block" to one value per packet from begin_seq up to end_seq
+         *
+         * The value is true if the packet was received (Loss RLE) or duplicated (Duplicate RLE) */
+        std::vector<bool> get_rle_packets(const uvgrtp::frame::rtcp_xr_rle_block& block);
+
+        /* Return the sequence numbers of the lost packets of a Generic NACK (RFC 4585 section 6.2.1)
+         *
+         * Return an empty vector if "packet" is not a Generic NACK */
+        std::vector<uint16_t> get_nack_packets(const uvgrtp::frame::rtcp_fb_packet& packet);
+
         /* Deallocate ZRTP frame
          *
          * Return RTP_OK on successs
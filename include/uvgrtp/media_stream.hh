@@ -2,9 +2,13 @@
 
 #include "util.hh"
 
+#include <atomic>
+#include <condition_variable>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
 
 #ifndef _WIN32
@@ -17,6 +21,7 @@ namespace uvgrtp {
     // forward declarations
     class rtp;
     class rtcp;
+    class rtcp_scheduler;
 
     class zrtp;
     class base_srtp;
@@ -35,13 +40,35 @@ namespace uvgrtp {
         class media;
     }
 
+    /**
+     * \brief Counters of the reassembly of RCE_FRAGMENT_GENERIC frames, see media_stream::get_reassembly_statistics()
+     */
+    struct reassembly_statistics {
+        /** \brief Number of frames reassembled from their fragments */
+        uint64_t completed_frames = 0;
+
+        /** \brief Number of frames dropped because they were not completed within RCC_PKT_MAX_DELAY */
+        uint64_t dropped_frames = 0;
+
+        /** \brief Number of fragments received after their frame was completed or dropped */
+        uint64_t late_fragments = 0;
+
+        /** \brief Number of fragments known to be missing from the dropped frames */
+        uint64_t lost_fragments = 0;
+
+        /** \brief Number of fragments received more than once */
+        uint64_t duplicate_fragments = 0;
+    };
+
     // Corresponds to one RTP session in RFC 3550
 
     class media_stream {
         public:
             /// \cond DO_NOT_DOCUMENT
-            media_stream(std::string cname, std::string addr, int src_port, int dst_port, rtp_format_t fmt, int flags);
-            media_stream(std::string cname, std::string remote_addr, std::string local_addr, int src_port, int dst_port, rtp_format_t fmt, int flags);
+            media_stream(std::string cname, std::string addr, int src_port, int dst_port, rtp_format_t fmt, int flags,
+                std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler);
+            media_stream(std::string cname, std::string remote_addr, std::string local_addr, int src_port, int dst_port,
+                rtp_format_t fmt, int flags, std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler);
             ~media_stream();
 
             /* Initialize traditional RTP session
@@ -86,6 +113,93 @@ namespace uvgrtp {
              * \retval  RTP_NOT_SUPPORTED If user-managed SRTP was not specified in create_stream() */
             rtp_error_t add_srtp_ctx(uint8_t *key, uint8_t *salt);
 
+            /**
+             *
+             * \brief Add keying information with a Master Key Identifier for user-managed SRTP session
+             *
+             * \details Same as add_srtp_ctx(uint8_t *, uint8_t *) but the master key is identified
+             * by "mki" in packets if ::RCE_SRTP_MKI was given to create_stream(). Without
+             * ::RCE_SRTP_MKI, "mki" is ignored. The other add_srtp_ctx() uses an MKI of 0
+             *
+             * \param key SRTP master key, default is 128-bit long
+             * \param salt 112-bit long salt
+             * \param mki Master Key Identifier of the key
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK On success
+             * \retval  RTP_INVALID_VALUE If key or salt is invalid
+             * \retval  RTP_NOT_SUPPORTED If user-managed SRTP was not specified in create_stream() */
+            rtp_error_t add_srtp_ctx(uint8_t *key, uint8_t *salt, uint32_t mki);
+
+            /**
+             *
+             * \brief Add a new master key to a user-managed SRTP session
+             *
+             * \details The key can be added while media is sent and received. We start to protect
+             * SRTP packets with the new key from the packet with index "from_index" onwards and
+             * SRTCP packets from the next packet. The keys that were used before are kept so that
+             * packets that arrive late can still be received. Both participants must add the key.
+             *
+             * With ::RCE_SRTP_MKI, the remote tells which key protects a packet so the key should be
+             * added on the receiving side before the sender starts to use it, and "from_index" only
+             * affects our own packets. Without MKI, both participants must use the same "from_index"
+             * and SRTCP packets are verified with the newest key first.
+             *
+             * The packet index of an SRTP packet is ROC * 65536 + sequence number, where ROC
+             * is the number of times the sequence number has wrapped around.
+             *
+             * \param key SRTP master key, same size as the one given to add_srtp_ctx()
+             * \param salt 112-bit long salt
+             * \param mki Master Key Identifier of the key, ignored without ::RCE_SRTP_MKI
+             * \param from_index Index of the first SRTP packet protected with this key
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK On success
+             * \retval  RTP_INVALID_VALUE If key or salt is invalid, if "from_index" is smaller than
+             * the one of the previously added key or if a key with the same MKI exists already
+             * \retval  RTP_NOT_READY If four keys are kept already and the oldest of them is still
+             * the active key or the key the active key replaced
+             * \retval  RTP_NOT_INITIALIZED If add_srtp_ctx() has not been called
+             * \retval  RTP_NOT_SUPPORTED If user-managed SRTP was not specified in create_stream() */
+            rtp_error_t add_srtp_key(uint8_t *key, uint8_t *salt, uint32_t mki, uint64_t from_index);
+
+            /**
+             * \brief Install a hook that is called when the ZRTP handshake has finished
+             *
+             * \details With ::RCE_ZRTP_ASYNC, the handshake is performed in the background
+             * and the hook is called from the handshake thread once the SRTP keys have been
+             * installed or the handshake has failed. The result of the handshake is given
+             * to the hook. If the handshake has already finished, the hook is called
+             * immediately from the calling thread.
+             *
+             * Until the handshake has finished successfully, all other calls to the media
+             * stream fail with ::RTP_NOT_INITIALIZED. No media is sent or received unencrypted.
+             *
+             * \param arg Optional argument that is passed to the hook when it is called, can be set to nullptr
+             * \param hook Function pointer to the hook
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr
+             * \retval RTP_NOT_SUPPORTED If the media stream does not use ZRTP */
+            rtp_error_t install_zrtp_hook(void *arg, void (*hook)(void *, rtp_error_t));
+
+            /**
+             * \brief Wait until the ZRTP handshake has finished
+             *
+             * \param timeout_ms How long the handshake is waited, in milliseconds
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK If the SRTP keys have been installed
+             * \retval RTP_TIMEOUT If the handshake did not finish within the specified time limit
+             * \retval RTP_NOT_SUPPORTED If the media stream does not use ZRTP
+             * \retval Other error codes are returned if the handshake failed */
+            rtp_error_t wait_for_zrtp(size_t timeout_ms);
+
             /**
              * \brief Send data to remote participant with a custom timestamp
              *
@@ -196,6 +310,76 @@ namespace uvgrtp {
              */
             rtp_error_t push_frame(std::unique_ptr<uint8_t[]> data, size_t data_len, uint32_t ts, int flags);
 
+            /**
+             * \brief Start sending an H.264/H.265/H.266 access unit incrementally
+             *
+             * \details Instead of giving the whole access unit to push_frame(), the application
+             * may push the NAL units one by one with push_nal() as soon as the encoder outputs them.
+             * Each NAL unit is packetized and sent immediately so the first packets of the access unit
+             * are on the wire before the encoder has finished the rest of it. All packets of the
+             * access unit share the same RTP timestamp and the last packet, sent by end_frame(),
+             * has the marker bit set.
+             *
+             * push_frame() cannot be called between begin_frame() and end_frame().
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INITIALIZED   If the previous access unit has not been ended with end_frame()
+             * \retval  RTP_NOT_SUPPORTED If the media format of the stream is not H.264, H.265 or H.266
+             */
+            rtp_error_t begin_frame();
+
+            /**
+             * \brief Start sending an access unit incrementally with a custom timestamp
+             *
+             * \details See begin_frame() and push_frame() for more details
+             *
+             * \param ts 32-bit timestamp value for the access unit
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INITIALIZED   If the previous access unit has not been ended with end_frame()
+             * \retval  RTP_NOT_SUPPORTED If the media format of the stream is not H.264, H.265 or H.266
+             */
+            rtp_error_t begin_frame(uint32_t ts);
+
+            /**
+             * \brief Send NAL unit(s) of the access unit started with begin_frame()
+             *
+             * \details The NAL units are packetized like in push_frame() and all but the
+             * last packet are sent before the function returns. The last packet is copied
+             * and held back until the next call so that end_frame() can set its marker bit.
+             * The memory pointed to by data can be released as soon as push_nal() returns.
+             *
+             * \param data Pointer to the NAL unit(s), with or without start code prefixes
+             * \param data_len Length of data
+             * \param flags Optional flags, see ::RTP_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK              On success
+             * \retval  RTP_INVALID_VALUE   If one of the parameters are invalid
+             * \retval  RTP_NOT_INITIALIZED If begin_frame() has not been called
+             * \retval  RTP_SEND_ERROR      If uvgRTP failed to send the data to remote
+             */
+            rtp_error_t push_nal(uint8_t *data, size_t data_len, int flags);
+
+            /**
+             * \brief Finish the access unit started with begin_frame()
+             *
+             * \details Sends the last packet of the access unit with the marker bit set
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK              On success
+             * \retval  RTP_INVALID_VALUE   If no NAL units were pushed to the access unit
+             * \retval  RTP_NOT_INITIALIZED If begin_frame() has not been called
+             * \retval  RTP_SEND_ERROR      If uvgRTP failed to send the data to remote
+             */
+            rtp_error_t end_frame();
+
             /**
              * \brief Poll a frame indefinitely from the media stream object
              *
@@ -300,6 +484,82 @@ namespace uvgrtp {
 
             uint32_t get_ssrc() const;
 
+            /**
+             * \brief Get the counters of the reassembly of fragmented generic frames
+             *
+             * \details The counters are only updated if RCE_FRAGMENT_GENERIC has been given
+             * to uvgrtp::session::create_stream() and the format is RTP_FORMAT_GENERIC
+             *
+             * \return Reassembly counters of the received frames
+             */
+            uvgrtp::reassembly_statistics get_reassembly_statistics() const;
+
+            /**
+             * \brief Map an RTP header extension identifier to a URI
+             *
+             * \details Header extensions use the RFC 8285 one-byte or two-byte format.
+             * Both the sender and the receiver should register the same mapping,
+             * usually negotiated with SDP (a=extmap).
+             *
+             * \param id Local identifier of the extension, 1-255
+             * \param uri URI of the extension, for example "urn:ietf:params:rtp-hdrext:toffset"
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If id is 0, uri is empty or either has already been registered
+             * \retval RTP_NOT_INITIALIZED If the media stream has not been initialized
+             */
+            rtp_error_t register_header_extension(uint8_t id, std::string uri);
+
+            /**
+             * \brief Get the identifier registered for a header extension URI
+             *
+             * \details Use uvgrtp::frame::get_ext_element() to find the extension from a received frame
+             *
+             * \param uri URI of the extension
+             *
+             * \return Extension identifier
+             *
+             * \retval 1-255 On success
+             * \retval 0 If the URI has not been registered
+             */
+            uint8_t get_header_extension_id(std::string uri);
+
+            /**
+             * \brief Attach a header extension to all outgoing RTP packets
+             *
+             * \details The extension is included in every packet sent after this call
+             * until it is replaced with a new value or removed with clear_header_extension().
+             * The size of the extension block is taken from the maximum payload size of the packets.
+             *
+             * \param id Registered extension identifier
+             * \param data Extension data
+             * \param len Length of the data, 0-255 bytes
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If the data is invalid
+             * \retval RTP_NOT_FOUND If the identifier has not been registered
+             * \retval RTP_MEMORY_ERROR If the extensions do not fit to one extension block
+             * \retval RTP_NOT_INITIALIZED If the media stream has not been initialized
+             */
+            rtp_error_t set_header_extension(uint8_t id, uint8_t *data, size_t len);
+
+            /**
+             * \brief Stop sending a header extension
+             *
+             * \param id Registered extension identifier
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_NOT_FOUND If the extension was not being sent
+             * \retval RTP_NOT_INITIALIZED If the media stream has not been initialized
+             */
+            rtp_error_t clear_header_extension(uint8_t id);
+
         private:
             /* Initialize the connection by initializing the socket
              * and binding ourselves to specified interface and creating
@@ -312,8 +572,15 @@ namespace uvgrtp {
             /* free all allocated resources */
             rtp_error_t free_resources(rtp_error_t ret);
 
-            rtp_error_t init_srtp_with_zrtp(int flags, int type, std::shared_ptr<uvgrtp::base_srtp> srtp,
-                                            std::shared_ptr<uvgrtp::zrtp> zrtp);
+            /* Initialize SRTP and SRTCP with the master keys negotiated by "zrtp" */
+            rtp_error_t init_srtp_with_zrtp(int flags, std::shared_ptr<uvgrtp::zrtp> zrtp);
+
+            /* Wait for the turn of this stream, perform the ZRTP handshake, install the
+             * SRTP keys and start the stream. The result is reported to the ZRTP hook */
+            rtp_error_t negotiate_zrtp(std::shared_ptr<uvgrtp::zrtp> zrtp, uint64_t ticket);
+
+            /* Perform the ZRTP handshake and start the stream */
+            rtp_error_t init_zrtp_keys(std::shared_ptr<uvgrtp::zrtp> zrtp);
 
             rtp_error_t start_components();
 
@@ -327,6 +594,9 @@ namespace uvgrtp {
             std::shared_ptr<uvgrtp::rtp>    rtp_;
             std::shared_ptr<uvgrtp::rtcp>   rtcp_;
 
+            /* Sends the RTCP reports of all media streams of the context */
+            std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler_;
+
             sockaddr_in addr_out_;
             std::string addr_;
             std::string laddr_;
@@ -342,7 +612,19 @@ namespace uvgrtp {
             void *media_config_;
 
             /* Has the media stream been initialized */
-            bool initialized_;
+            std::atomic<bool> initialized_;
+
+            /* Thread performing the ZRTP handshake if RCE_ZRTP_ASYNC was given */
+            std::thread zrtp_thread_;
+
+            /* Result of the ZRTP handshake, RTP_NOT_READY while it is in progress
+             * and RTP_NOT_SUPPORTED if the stream does not use ZRTP */
+            std::mutex zrtp_mtx_;
+            std::condition_variable zrtp_cv_;
+            rtp_error_t zrtp_status_;
+
+            void *zrtp_hook_arg_;
+            void (*zrtp_hook_)(void *, rtp_error_t);
 
             /* Primary handler keys for the RTP reception flow */
             uint32_t rtp_handler_key_;
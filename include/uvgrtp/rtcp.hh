@@ -6,6 +6,7 @@
 #include "frame.hh"
 
 
+#include <atomic>
 #include <bitset>
 #include <map>
 #include <thread>
@@ -19,6 +20,81 @@ namespace uvgrtp {
 
     class rtp;
     class srtcp;
+    class rtcp_scheduler;
+    class receive_history;
+    class rtcp_dispatcher;
+    struct rtcp_hook_event;
+
+    /**
+     * \brief Analytics of an RTCP participant derived from the reports it has sent
+     *
+     * \details The loss, jitter and round-trip time tell how the participant receives our
+     * stream and they are computed from the report blocks it sends about our SSRC. The
+     * bitrate is the rate the participant itself sends at, computed from its Sender Reports.
+     *
+     * The smoothed values are exponentially weighted moving averages with a gain of 1/8
+     */
+    struct rtcp_analytics {
+        /** \brief SSRC of the participant */
+        uint32_t ssrc = 0;
+
+        /** \brief Number of report blocks about our stream received from the participant */
+        uint32_t reports = 0;
+
+        /** \brief Round-trip time of the latest report in milliseconds (see RFC 3550 section 6.4.1)
+         *
+         * Negative until the participant has reported on a Sender Report it has received from us */
+        double rtt_ms = -1.0;
+
+        /** \brief Smoothed round-trip time in milliseconds, negative until known */
+        double smoothed_rtt_ms = -1.0;
+
+        /** \brief Fraction of our packets lost since the previous report, between 0 and 1 */
+        double fraction_lost = 0.0;
+
+        /** \brief Smoothed fraction of our packets lost, between 0 and 1 */
+        double smoothed_fraction_lost = 0.0;
+
+        /** \brief Total number of our packets lost, negative if duplicates were received */
+        int32_t cumulative_lost = 0;
+
+        /** \brief Extended highest sequence number of our packets received */
+        uint32_t highest_seq = 0;
+
+        /** \brief Interarrival jitter of our packets in milliseconds */
+        double jitter_ms = 0.0;
+
+        /** \brief Bitrate of the participant in kbit/s between its two latest Sender Reports
+         *
+         * Zero until two Sender Reports have been received */
+        double bitrate_kbps = 0.0;
+    };
+
+    /**
+     * \brief Counters of the RTCP packets given to the hooks with RCE_RTCP_ASYNC_HOOKS
+     */
+    struct rtcp_hook_statistics {
+        /** \brief Number of packets given to the hooks */
+        uint64_t delivered = 0;
+
+        /** \brief Number of packets dropped because the queue of the hooks was full */
+        uint64_t dropped = 0;
+
+        /** \brief Number of reports skipped because a later report of the same type
+         * from the same participant was already waiting for the hook */
+        uint64_t coalesced = 0;
+    };
+
+    /**
+     * \brief Counters of the conflicts of our SSRC, see rtcp::get_conflict_statistics()
+     */
+    struct rtcp_conflict_statistics {
+        /** \brief Number of times our SSRC collided with another participant and was changed */
+        uint64_t collisions = 0;
+
+        /** \brief Number of received packets dropped as our own packets looped back */
+        uint64_t loops = 0;
+    };
 
     /// \cond DO_NOT_DOCUMENT
     enum RTCP_ROLE {
@@ -34,18 +110,20 @@ namespace uvgrtp {
     };
 
     struct receiver_statistics {
-        /* receiver stats */
+        /* receiver stats
+         *
+         * These are only accessed by the thread processing the RTP packets of the stream,
+         * the values used in reports are published to shared_statistics after each packet */
         uint32_t received_pkts = 0;  /* Number of packets received */
         uint32_t dropped_pkts = 0;   /* Number of dropped RTP packets */
         uint32_t received_bytes = 0; /* Number of bytes received excluding RTP Header */
-        bool received_rtp_packet = false; // since last report
 
-        double jitter = 0;            /* The estimation of jitter (see RFC 3550 A.8) */
-        uint32_t transit = 0;        /* TODO: */
+        uint32_t jitter = 0;         /* The estimation of jitter scaled by 16 (see RFC 3550 A.8) */
+        uint32_t transit = 0;        /* Relative transit time of the previous packet */
 
 
         /* Receiver clock related stuff */
-        uint64_t initial_ntp = 0;    /* Wallclock reading when the first RTP packet was received */
+        uint64_t initial_arrival = 0; /* Monotonic arrival time of the first RTP packet in microseconds */
         uint32_t initial_rtp = 0;    /* RTP timestamp of the first RTP packet received */
         uint32_t clock_rate = 0;     /* Rate of the clock (used for jitter calculations) */
 
@@ -58,20 +136,90 @@ namespace uvgrtp {
         uint16_t cycles = 0;         /* Number of sequence cycles */
     };
 
+    /* The receiver statistics of a participant that go to report blocks
+     *
+     * The packet processing thread is the only writer and publishes the values after each
+     * RTP packet. Report generation reads them without taking a lock: "sequence" is odd
+     * while the values are being written and the reader retries until it gets a copy
+     * that was not modified during the read (see read_statistics()) */
+    struct shared_statistics {
+        std::atomic<uint32_t> sequence{0};
+
+        std::atomic<uint32_t> received_pkts{0};
+        std::atomic<uint32_t> dropped_pkts{0};
+        std::atomic<uint32_t> received_bytes{0};
+        std::atomic<uint32_t> jitter{0};
+        std::atomic<uint32_t> max_seq{0};
+        std::atomic<uint32_t> cycles{0};
+
+        std::atomic<bool> received_rtp_packet{false}; // since last report
+    };
+
+    /* A consistent copy of shared_statistics */
+    struct statistics_snapshot {
+        uint32_t received_pkts = 0;
+        uint32_t dropped_pkts = 0;
+        uint32_t received_bytes = 0;
+        uint32_t jitter = 0;
+        uint16_t max_seq = 0;
+        uint16_t cycles = 0;
+    };
+
+    /* The analytics of a participant, see rtcp::get_analytics()
+     *
+     * The thread receiving RTCP is the only writer and publishes the values after each
+     * report. They are read without a lock the same way as shared_statistics */
+    struct shared_analytics {
+        std::atomic<uint32_t> sequence{0};
+
+        std::atomic<uint32_t> reports{0};
+        std::atomic<double>   rtt_ms{-1.0};
+        std::atomic<double>   smoothed_rtt_ms{-1.0};
+        std::atomic<double>   fraction_lost{0.0};
+        std::atomic<double>   smoothed_fraction_lost{0.0};
+        std::atomic<int32_t>  cumulative_lost{0};
+        std::atomic<uint32_t> highest_seq{0};
+        std::atomic<double>   jitter_ms{0.0};
+        std::atomic<double>   bitrate_kbps{0.0};
+
+        /* The NTP and RTP timestamps of the latest SR, which map the RTP timestamps of
+         * the participant to its wallclock. "sync_ntp" is zero before the first SR */
+        std::atomic<uint64_t> sync_ntp{0};
+        std::atomic<uint32_t> sync_rtp{0};
+        std::atomic<uint32_t> sync_clock_rate{0};
+
+        /* Only used by the writer */
+        rtcp_analytics current;
+        uint64_t sr_ntp = 0;    /* NTP timestamp of the previous SR of the participant */
+        uint32_t sr_octets = 0; /* octet count of the previous SR */
+    };
+
+    /* The analytics of the participants by SSRC. It is replaced when participants join or leave */
+    typedef std::map<uint32_t, std::shared_ptr<shared_analytics>> analytics_index;
+
     struct rtcp_participant {
         std::shared_ptr<uvgrtp::socket> socket = nullptr; /* socket associated with this participant */
         sockaddr_in address;                              /* address of the participant */
         struct receiver_statistics stats;                 /* RTCP session statistics of the participant */
+        struct shared_statistics published;               /* statistics read by report generation */
 
         uint32_t probation = 0;                           /* has the participant been fully accepted to the session */
         int role = 0;                                     /* is the participant a sender or a receiver */
 
+        uint64_t last_active = 0;                         /* when the participant joined or last sent RTCP (RTCP scheduler clock) */
+        uint64_t last_rtp = 0;                            /* the report time when the participant was last seen sending RTP */
+
+        std::shared_ptr<shared_analytics> analytics;      /* analytics derived from the reports of the participant */
+        std::shared_ptr<receive_history> history;         /* received packets for Extended Reports, only with RCE_RTCP_XR */
+
         /* Save the latest RTCP packets received from this participant
          * Users can query these packets using the SSRC of participant */
         uvgrtp::frame::rtcp_sender_report   *sr_frame = nullptr;
         uvgrtp::frame::rtcp_receiver_report *rr_frame = nullptr;
         uvgrtp::frame::rtcp_sdes_packet     *sdes_frame = nullptr;
         uvgrtp::frame::rtcp_app_packet      *app_frame = nullptr;
+        uvgrtp::frame::rtcp_xr_packet       *xr_frame = nullptr;
+        uvgrtp::frame::rtcp_fb_packet       *fb_frame = nullptr;
     };
 
     struct rtcp_app_packet {
@@ -91,10 +239,13 @@ namespace uvgrtp {
             rtcp(std::shared_ptr<uvgrtp::rtp> rtp, std::string cname, std::shared_ptr<uvgrtp::srtcp> srtcp, int flags);
             ~rtcp();
 
-            /* start the RTCP runner thread
+            /* Start sending reports and receiving RTCP packets using "scheduler"
+             *
+             * The scheduler is shared by all media streams of a context. If "scheduler"
+             * is nullptr, this instance gets a scheduler of its own
              *
-             * return RTP_OK on success and RTP_MEMORY_ERROR if the allocation fails */
-            rtp_error_t start();
+             * return RTP_OK on success and RTP_INVALID_VALUE if there are no participants */
+            rtp_error_t start(std::shared_ptr<uvgrtp::rtcp_scheduler> scheduler);
 
             /* End the RTCP session and send RTCP BYE to all participants
              *
@@ -105,11 +256,27 @@ namespace uvgrtp {
              * Return RTP_OK on success and RTP_ERROR on error */
             rtp_error_t generate_report();
 
+            /* Called by the RTCP scheduler when the report timer has expired at "now"
+             *
+             * The transmission interval is reconsidered (see RFC 3550 section 6.3.6) and
+             * a report is sent if it is still due
+             *
+             * Return the time when the timer should expire next */
+            uint64_t report_timer_expired(uint64_t now);
+
+            /* Return the time of the next report or of the scheduled early packet if that is
+             * sooner. The report may have been moved forward by a received RTCP packet
+             * (see RFC 3550 section 6.3.4) and an early packet scheduled by a hook */
+            uint64_t next_report() const;
+
             /* Handle incoming RTCP packet (first make sure it's a valid RTCP packet)
              * This function will call one of the above functions internally
              *
+             * "src_addr" is the source transport address of the packet used to tell SSRC
+             * collisions from loops, nullptr if it is not known
+             *
              * Return RTP_OK on success and RTP_ERROR on error */
-            rtp_error_t handle_incoming_packet(uint8_t *buffer, size_t size);
+            rtp_error_t handle_incoming_packet(uint8_t *buffer, size_t size, const sockaddr_in *src_addr = nullptr);
             /// \endcond
 
             /* Send "frame" to all participants
@@ -161,6 +328,64 @@ namespace uvgrtp {
              */
             rtp_error_t send_bye_packet(std::vector<uint32_t> ssrcs);
 
+            /**
+             * \brief Send a Generic NACK (RFC 4585 section 6.2.1)
+             *
+             * \details Tell the sender of "media_ssrc" which of its RTP packets were lost so it can
+             * retransmit them. With ::RCE_RTCP_FEEDBACK, the NACK is sent as early feedback,
+             * otherwise it is sent with the next regular report
+             *
+             * \param media_ssrc SSRC of the media source that lost packets
+             * \param lost_packets Sequence numbers of the lost packets
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "lost_packets" is empty
+             * \retval RTP_GENERIC_ERROR If sending fails
+             */
+            rtp_error_t send_nack(uint32_t media_ssrc, const std::vector<uint16_t>& lost_packets);
+
+            /**
+             * \brief Send a Picture Loss Indication (RFC 4585 section 6.3.1)
+             *
+             * \details Ask the sender of "media_ssrc" for a new intra picture. With ::RCE_RTCP_FEEDBACK,
+             * the PLI is sent as early feedback, otherwise it is sent with the next regular report
+             *
+             * \param media_ssrc SSRC of the media source
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_GENERIC_ERROR If sending fails
+             */
+            rtp_error_t send_pli(uint32_t media_ssrc);
+
+            /**
+             * \brief Send an RTCP feedback message (RFC 4585 section 6.1)
+             *
+             * \details Send a feedback message of any type. See send_nack() and send_pli()
+             *
+             * \param type Either uvgrtp::frame::RTCP_FT_RTPFB or uvgrtp::frame::RTCP_FT_PSFB
+             * \param fmt Feedback message type, less than 32
+             * \param media_ssrc SSRC of the media source the feedback is about
+             * \param fci Feedback Control Information
+             * \param fci_len Length of "fci", a multiple of 4
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If the type, the format or the length is invalid
+             * \retval RTP_GENERIC_ERROR If sending fails
+             */
+            rtp_error_t send_fb_packet(uvgrtp::frame::RTCP_FRAME_TYPE type, uint8_t fmt, uint32_t media_ssrc,
+                const uint8_t *fci, size_t fci_len);
+
+            /**
+             * \brief Set the minimum interval of regular reports with ::RCE_RTCP_FEEDBACK
+             *
+             * \details This is T_rr_interval of RFC 4585 section 3.5.3. A regular report due sooner
+             * than this after the previous one is not sent unless it carries feedback, which
+             * saves RTCP bandwidth for early feedback. Zero, the default, sends every regular report
+             *
+             * \param interval_ms Minimum interval of regular reports in milliseconds
+             */
+            void set_trr_interval(uint32_t interval_ms);
+
             /// \cond DO_NOT_DOCUMENT
             /* Return the latest RTCP packet received from participant of "ssrc"
              * Return nullptr if we haven't received this kind of packet or if "ssrc" doesn't exist
@@ -170,9 +395,11 @@ namespace uvgrtp {
             uvgrtp::frame::rtcp_receiver_report *get_receiver_packet(uint32_t ssrc);
             uvgrtp::frame::rtcp_sdes_packet     *get_sdes_packet(uint32_t ssrc);
             uvgrtp::frame::rtcp_app_packet      *get_app_packet(uint32_t ssrc);
+            uvgrtp::frame::rtcp_xr_packet       *get_xr_packet(uint32_t ssrc);
+            uvgrtp::frame::rtcp_fb_packet       *get_fb_packet(uint32_t ssrc);
 
             /* Return a reference to vector that contains the sockets of all participants */
-            std::vector<uvgrtp::socket>& get_sockets();
+            std::vector<std::shared_ptr<uvgrtp::socket>>& get_sockets();
 
             /* Somebody joined the multicast group the owner of this RTCP instance is part of
              * Add it to RTCP participant list so we can start listening for reports
@@ -188,11 +415,11 @@ namespace uvgrtp {
             void sender_update_stats(const uvgrtp::frame::rtp_frame *frame);
 
             /* If we've detected that our SSRC has collided with someone else's SSRC, we need to
-             * generate new random SSRC and reinitialize our own RTCP state.
-             * RTCP object still has the participants of "last session", we can use their SSRCs
-             * to detected new collision
+             * switch to the new random SSRC "ssrc". The participants, their statistics and the
+             * timing of the reports are kept, only the counters of our Sender Reports start
+             * from zero (RFC 3550 section 6.4.1). The stream keeps its sockets and buffers
              *
-             * Return RTP_OK if reinitialization succeeded
+             * Return RTP_OK if the SSRC was changed
              * Return RTP_SSRC_COLLISION if our new SSRC has collided and we need to generate new SSRC */
             rtp_error_t reset_rtcp_state(uint32_t ssrc);
 
@@ -210,7 +437,9 @@ namespace uvgrtp {
              *
              * \details If the application wishes to timestamp the stream itself AND it has
              * enabled RTCP by using ::RCE_RTCP, it must provide timestamping information for
-             * RTCP so sensible synchronization values can be calculated for Sender Reports
+             * RTCP so sensible synchronization values can be calculated for Sender Reports.
+             * Otherwise the timestamps of the Sender Reports are extrapolated from the time
+             * the latest frame was sent
              *
              * The application can call uvgrtp::clock::ntp::now() to get the current wall clock
              * reading as an NTP timestamp value
@@ -281,12 +510,130 @@ namespace uvgrtp {
             rtp_error_t install_app_hook(std::function<void(std::shared_ptr<uvgrtp::frame::rtcp_app_packet>)> app_handler);
             rtp_error_t install_app_hook(std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_app_packet>)> app_handler);
 
+            /**
+             * \brief Install an RTCP Extended Report hook
+             *
+             * \details This function is called when an RTCP Extended Report (RFC 3611) is received.
+             * Extended Reports are sent by the participants that have enabled ::RCE_RTCP_XR
+             *
+             * \param hook Function pointer to the hook
+             *
+             * \retval RTP_OK on success
+             * \retval RTP_INVALID_VALUE If hook is nullptr
+             */
+            rtp_error_t install_xr_hook(void (*hook)(uvgrtp::frame::rtcp_xr_packet *));
+            rtp_error_t install_xr_hook(std::function<void(std::shared_ptr<uvgrtp::frame::rtcp_xr_packet>)> xr_handler);
+            rtp_error_t install_xr_hook(std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_xr_packet>)> xr_handler);
+
+            /**
+             * \brief Install an RTCP feedback message hook
+             *
+             * \details This function is called when a transport layer or payload-specific feedback
+             * message (RFC 4585), such as a NACK or PLI, is received
+             *
+             * \param hook Function pointer to the hook
+             *
+             * \retval RTP_OK on success
+             * \retval RTP_INVALID_VALUE If hook is nullptr
+             */
+            rtp_error_t install_fb_hook(void (*hook)(uvgrtp::frame::rtcp_fb_packet *));
+            rtp_error_t install_fb_hook(std::function<void(std::shared_ptr<uvgrtp::frame::rtcp_fb_packet>)> fb_handler);
+            rtp_error_t install_fb_hook(std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_fb_packet>)> fb_handler);
+
+            /**
+             * \brief Install a zero-copy hook for RTCP Sender and Receiver Reports
+             *
+             * \details This function is called with a read-only view of each received Sender
+             * and Receiver Report instead of a copy of it. The view points to the receive
+             * buffer of uvgRTP and must not be used after the hook returns. When this hook is
+             * installed, the reports are not given to the Sender and Receiver Report hooks
+             * and they are not saved for get_sender_packet() and get_receiver_packet()
+             *
+             * \param report_handler Function called with the view of each report
+             *
+             * \retval RTP_OK on success
+             * \retval RTP_INVALID_VALUE If report_handler is empty
+             */
+            rtp_error_t install_report_view_hook(std::function<void(const uvgrtp::frame::rtcp_report_view&)> report_handler);
+
+            /**
+             * \brief Get the analytics of a participant
+             *
+             * \details The analytics are updated as Sender and Receiver Reports arrive from
+             * the participant. This function does not take any locks of the RTCP instance
+             * and does not wait for the reports being processed, so it can be called from any
+             * thread as often as needed. The list of participants is read with std::atomic_load(),
+             * which the standard library may implement with a short internal lock
+             *
+             * \param ssrc SSRC of the participant
+             * \param analytics Filled with the analytics of the participant
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "ssrc" is not a participant of the session
+             */
+            rtp_error_t get_analytics(uint32_t ssrc, uvgrtp::rtcp_analytics& analytics) const;
+
+            /**
+             * \brief Get the analytics of all participants
+             *
+             * \details See get_analytics(uint32_t, uvgrtp::rtcp_analytics&)
+             *
+             * \return Analytics of each participant of the session
+             */
+            std::vector<uvgrtp::rtcp_analytics> get_analytics() const;
+
+            /**
+             * \brief Convert an RTP timestamp of a participant to its wallclock time
+             *
+             * \details The latest Sender Report of the participant maps its RTP timestamps to the
+             * NTP timestamps of its wallclock (RFC 3550 section 6.4.1), and this function
+             * extrapolates from that mapping with the clock rate of the stream. The streams of
+             * a participant, for example its audio and video, share the wallclock, so
+             * comparing the wallclock times of their frames synchronizes the playout of the
+             * streams. Like get_analytics(), this can be called from any thread
+             *
+             * \param ssrc SSRC of the participant
+             * \param rtp_ts RTP timestamp of a packet from the participant
+             * \param ntp_ts Set to the wallclock time of "rtp_ts" as a 64-bit NTP timestamp
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "ssrc" is not a participant of the session
+             * \retval RTP_NOT_READY If no Sender Report has been received from the participant
+             */
+            rtp_error_t get_sender_ntp(uint32_t ssrc, uint32_t rtp_ts, uint64_t& ntp_ts) const;
+
+            /**
+             * \brief Get the counters of the packets given to the hooks
+             *
+             * \details With RCE_RTCP_ASYNC_HOOKS, the hooks of Sender Reports, Receiver Reports,
+             * SDES, APP and XR packets are called from a dispatcher thread. A received packet
+             * waits for its hook in a bounded queue and if the hooks do not keep up, the older
+             * reports of a participant are skipped and packets that do not fit are dropped.
+             * The report view hook is always called from the thread receiving RTCP.
+             *
+             * \return The counters, all zero without RCE_RTCP_ASYNC_HOOKS
+             */
+            uvgrtp::rtcp_hook_statistics get_hook_statistics() const;
+
+            /**
+             * \brief Get the counters of the conflicts of our SSRC
+             *
+             * \details When a packet with our SSRC arrives from a new source transport address,
+             * another participant has chosen the same SSRC. A BYE is sent for our old SSRC
+             * and the stream continues with a new random SSRC (RFC 3550 section 8.2), see
+             * uvgrtp::media_stream::get_ssrc(). Further packets with our old SSRC from that
+             * address are taken as our own packets looped back and dropped.
+             *
+             * \return The counters
+             */
+            uvgrtp::rtcp_conflict_statistics get_conflict_statistics() const;
+
 
             rtp_error_t remove_all_hooks();
 
             /// \cond DO_NOT_DOCUMENT
-            /* Update RTCP-related sender statistics */
-            rtp_error_t update_sender_stats(size_t pkt_size);
+            /* Update RTCP-related sender statistics, "rtp_ts" is the RTP timestamp of the sent packet */
+            rtp_error_t update_sender_stats(size_t pkt_size, uint32_t rtp_ts);
 
             /* Update RTCP-related receiver statistics */
             static rtp_error_t recv_packet_handler(void *arg, int flags, frame::rtp_frame **out);
@@ -331,8 +678,32 @@ namespace uvgrtp {
                 uvgrtp::frame::rtcp_header& header);
             rtp_error_t handle_app_packet(uint8_t* buffer, size_t& read_ptr, size_t packet_end,
                 uvgrtp::frame::rtcp_header& header);
+            rtp_error_t handle_xr_packet(uint8_t* buffer, size_t& read_ptr, size_t packet_end,
+                uvgrtp::frame::rtcp_header& header);
+            rtp_error_t handle_fb_packet(uint8_t* buffer, size_t& read_ptr, size_t packet_end,
+                uvgrtp::frame::rtcp_header& header);
+
+            /* Write the oldest APP packet of each name to "frame" (packet_mutex_ must be held) */
+            bool construct_app_packets(uint8_t* frame, int& ptr);
 
-            static void rtcp_runner(rtcp *rtcp, int interval);
+            /* Queue a feedback message for the next RTCP packet and send
+             * an early RTCP packet if the AVPF timing rules allow it */
+            rtp_error_t queue_feedback(std::vector<uint8_t> packet);
+
+            /* Send an early RTCP packet now or schedule it (RFC 4585 section 3.5.2) if
+             * feedback is waiting and an early packet is allowed (packet_mutex_ must be held)
+             *
+             * Return the time the early packet is scheduled at, 0 if it was sent or is not sent */
+            uint64_t request_early_report(rtp_error_t& ret);
+
+            /* Send the waiting feedback and APP packets in an early RTCP packet (packet_mutex_ must be held) */
+            rtp_error_t send_early_report();
+
+            /* Write an XR packet with the blocks about the sources of report_sources_ to "frame",
+             * as many as fit to "max_size" bytes (packet_mutex_ must be held)
+             *
+             * Return the size of the packet or 0 if there is nothing to report */
+            size_t construct_xr_packet(uint8_t* frame, size_t max_size);
 
             /* when we start the RTCP instance, we don't know what the SSRC of the remote is
              * when an RTP packet is received, we must check if we've already received a packet
@@ -347,6 +718,13 @@ namespace uvgrtp {
              * we need to send RTCP BYE and rejoin to the session */
             bool collision_detected(uint32_t ssrc, const sockaddr_in& src_addr) const;
 
+            /* A packet with our SSRC came from "src_addr" (RFC 3550 section 8.2). If the address has
+             * sent our SSRC before, the packet is ours looped back. Otherwise it is a collision and
+             * we send a BYE for our SSRC and switch to a new one
+             *
+             * Return true if the packet is looped and should be dropped */
+            bool resolve_own_ssrc_conflict(const sockaddr_in *src_addr);
+
             /* Move participant from initial_peers_ to participants_ */
             rtp_error_t add_participant(uint32_t ssrc);
 
@@ -355,22 +733,65 @@ namespace uvgrtp {
             rtp_error_t init_new_participant(const uvgrtp::frame::rtp_frame *frame);
 
             /* Initialize the RTP Sequence related stuff of peer
-             * This function assumes that the peer already exists in the participants_ map */
+             * This function assumes that the peer already exists in the participants_ map
+             *
+             * This and the other functions updating the receiver statistics are only
+             * called from the thread processing the RTP packets */
             rtp_error_t init_participant_seq(uint32_t ssrc, uint16_t base_seq);
 
             /* Update the SSRC's sequence related data in participants_ map
+             *
+             * "arrival" is the monotonic arrival time of the packet in microseconds,
+             * it is recorded to the receive history with RCE_RTCP_XR
              *
              * Return RTP_OK if the received packet was OK
              * Return RTP_GENERIC_ERROR if it wasn't and
              * packet-related statistics should not be updated */
-            rtp_error_t update_participant_seq(uint32_t ssrc, uint16_t seq);
+            rtp_error_t update_participant_seq(uint32_t ssrc, uint16_t seq, uint64_t arrival);
+
+            /* Return the participant of "ssrc" for the RTP packet processing thread
+             *
+             * The participant of the previous packet is cached so a stream with one sender
+             * does not have to search participants_ for every packet. Return nullptr if
+             * "ssrc" is not a participant */
+            rtcp_participant *find_sender(uint32_t ssrc);
+
+            /* Publish the report statistics of "p" to its shared_statistics */
+            void publish_statistics(rtcp_participant *p);
+
+            /* Take a consistent copy of the published statistics of "p" without locking */
+            static statistics_snapshot read_statistics(const rtcp_participant *p);
+
+            /* Remove participant "ssrc" from participants_ (packet_mutex_ must be held)
+             *
+             * The RTP packet processing thread may still hold the participant in its cache
+             * so it is not freed until that thread notices the removal */
+            void retire_participant(uint32_t ssrc);
 
             /* Update the RTCP bandwidth variables
              *
              * "pkt_size" tells how much rtcp_byte_count_
-             * should be increased before calculating the new average */
+             * should be increased before calculating the new average.
+             * Packets are sent and received on different threads so packet_mutex_ must be held */
             void update_rtcp_bandwidth(size_t pkt_size);
 
+            /* Compute the deterministic RTCP transmission interval in milliseconds
+             * for the current session state (see RFC 3550 appendix A.7) */
+            double deterministic_interval();
+
+            /* Compute a randomized RTCP transmission interval in milliseconds */
+            uint64_t rtcp_interval();
+
+            /* Remove the members that have not been heard from in five deterministic
+             * intervals, reconsider the report times if any were removed and count the
+             * participants that have sent RTP in the last two intervals as senders
+             * (see RFC 3550 section 6.3.5) */
+            void timeout_members(uint64_t now);
+
+            /* Move the next report and the previous report time closer to "now" after
+             * the session has shrunk, packet_mutex_ must be held (see RFC 3550 section 6.3.4) */
+            void reverse_reconsideration(uint64_t now);
+
             /* Because struct statistics contains uvgRTP clock object we cannot
              * zero it out without compiler complaining about it so all the fields
              * must be set to zero manually */
@@ -378,9 +799,34 @@ namespace uvgrtp {
 
             void zero_stats(uvgrtp::receiver_statistics *stats);
 
-            /* Takes ownership of the frame */
+            /* Send "frame" to all participants, the frame is protected in place if SRTCP is used */
             rtp_error_t send_rtcp_packet_to_participants(uint8_t* frame, size_t frame_size, bool encrypt);
 
+            /* Make a view of the SR or RR starting at "packet_start" */
+            uvgrtp::frame::rtcp_report_view make_report_view(const uint8_t* buffer, size_t packet_start,
+                size_t packet_end, const uvgrtp::frame::rtcp_header& header, uint32_t ssrc, bool sender_report) const;
+
+            /* Give "view" to the report view hook
+             *
+             * Return true if the hook is installed and the report was given to it */
+            bool call_report_view_hook(const uvgrtp::frame::rtcp_report_view& view);
+
+            /* Update the analytics of participant "ssrc" from its report "view" and publish them */
+            void update_analytics(uint32_t ssrc, const uvgrtp::frame::rtcp_report_view& view);
+
+            /* Take a consistent copy of "analytics" without locking */
+            static rtcp_analytics read_analytics(const shared_analytics& analytics);
+
+            /* Give a packet queued with RCE_RTCP_ASYNC_HOOKS to its hook, called by the dispatcher thread */
+            void deliver_hook_event(uvgrtp::rtcp_hook_event& event);
+
+            /* Deallocate the packet of a hook event that is not delivered */
+            static void free_hook_event(uvgrtp::rtcp_hook_event& event);
+
+            /* Replace analytics_index_ with the analytics of the current participants,
+             * packet_mutex_ must be held */
+            void publish_analytics_index();
+
             void free_participant(rtcp_participant* participant);
 
             /* Secure RTCP context */
@@ -392,11 +838,11 @@ namespace uvgrtp {
             /* are we a sender (and possible a receiver) or just a receiver */
             int our_role_;
 
-            /* TODO: time_t?? */
-            // TODO: Check these, they don't seem to be used
-            size_t tp_;       /* the last time an RTCP packet was transmitted */
-            size_t tc_;       /* the current time */
-            size_t tn_;       /* the next scheduled transmission time of an RTCP packet */
+            /* The times are in milliseconds of the RTCP scheduler clock */
+            /* The times are also read by the threads sending early feedback */
+            std::atomic<uint64_t> tp_; /* the last time an RTCP packet was transmitted */
+            size_t tc_;                /* the current time */
+            std::atomic<uint64_t> tn_; /* the next scheduled transmission time of an RTCP packet */
             size_t pmembers_; /* the estimated number of session members at the time tn was last recomputed */
             size_t members_;  /* the most current estimate for the number of session members */
             size_t senders_;  /* the most current estimate for the number of senders in the session */
@@ -405,19 +851,16 @@ namespace uvgrtp {
              * that will be used for RTCP packets by all members of this session,
              * in octets per second.  This will be a specified fraction of the
              * "session bandwidth" parameter supplied to the application at startup. */
-            // TODO: Not used anywhere at the moment
             size_t rtcp_bandwidth_;
 
             /* Flag that is true if the application has sent data since
              * the 2nd previous RTCP report was transmitted. */
-            // TODO: Only set, never read
             bool we_sent_;
 
             /* The average compound RTCP packet size, in octets,
              * over all RTCP packets sent and received by this participant. The
              * size includes lower-layer transport and network protocol headers
              * (e.g., UDP and IP) as explained in Section 6.2 */
-             // TODO: Only set, never read
             size_t avg_rtcp_pkt_pize_;
 
             /* Number of RTCP packets and bytes sent and received by this participant */
@@ -429,11 +872,20 @@ namespace uvgrtp {
             uint32_t rtcp_pkt_sent_count_;
 
             /* Flag that is true if the application has not yet sent an RTCP packet. */
-            // TODO: Only set, never read
             bool initial_;
 
-            /* Copy of our own current SSRC */
-            const uint32_t ssrc_;
+            /* The SSRC of the RTP packets we send is changed on a collision */
+            std::shared_ptr<uvgrtp::rtp> rtp_;
+
+            /* Copy of our own current SSRC. The packet threads compare every received SSRC
+             * to it so it is the only check done for packets that do not collide with us */
+            std::atomic<uint32_t> ssrc_;
+
+            /* The source transport addresses that have sent packets with our SSRC and when they
+             * last did (RFC 3550 section 8.2), packet_mutex_ must be held */
+            std::map<uint64_t, uint64_t> conflicting_addresses_;
+            std::atomic<uint64_t> collisions_;
+            std::atomic<uint64_t> loops_;
 
             /* NTP timestamp associated with initial RTP timestamp (aka t = 0) */
             uint64_t clock_start_;
@@ -444,8 +896,37 @@ namespace uvgrtp {
             /* The first value of RTP timestamp (aka t = 0) */
             uint32_t rtp_ts_start_;
 
+            /* Record the wallclock time of "rtp_ts" if it is the timestamp of a new frame */
+            void record_sent_timestamp(uint32_t rtp_ts);
+
+            /* Return the RTP timestamp of the wallclock time "ntp_ts" for our Sender Report */
+            uint32_t sender_rtp_timestamp(uint64_t ntp_ts);
+
+            /* Without set_ts_info(), the RTP timestamps of the SRs are extrapolated from the
+             * wallclock time when the latest frame was sent. It is taken when the first packet
+             * of the frame is sent, which is the closest to its capture we see */
+            std::mutex sync_mutex_;
+            uint64_t sync_ntp_;                    /* wallclock time of "sync_rtp_", 0 if none */
+            uint32_t sync_rtp_;
+            std::atomic<uint64_t> last_sent_ts_;  /* RTP timestamp of the latest sent packet */
+
             std::map<uint32_t, rtcp_participant *> participants_;
-            uint8_t num_receivers_; // maximum is 32 at the moment (5 bits)
+
+            /* Report blocks are sent starting from this SSRC when the reports of
+             * all sources do not fit in one compound packet */
+            uint32_t next_report_ssrc_;
+
+            /* Participants removed from participants_ while the RTP packet
+             * processing thread may still have them cached, see retire_participant() */
+            std::vector<rtcp_participant *> retired_participants_;
+
+            /* Incremented every time a participant is removed from participants_ */
+            std::atomic<uint32_t> participants_generation_;
+
+            /* The participant of the previous RTP packet, only used by the packet processing thread */
+            rtcp_participant *cached_sender_;
+            uint32_t cached_ssrc_;
+            uint32_t cached_generation_;
 
             /* statistics for RTCP Sender and Receiver Reports */
             struct sender_statistics our_stats;
@@ -458,7 +939,7 @@ namespace uvgrtp {
              *
              * The socket are also stored here (in addition to participants_ map) so they're easier
              * to pass to poll when RTCP runner is listening to incoming packets */
-            std::vector<uvgrtp::socket> sockets_;
+            std::vector<std::shared_ptr<uvgrtp::socket>> sockets_;
 
             void (*sender_hook_)(uvgrtp::frame::rtcp_sender_report *);
             void (*receiver_hook_)(uvgrtp::frame::rtcp_receiver_report *);
@@ -474,17 +955,26 @@ namespace uvgrtp {
             std::function<void(std::shared_ptr<uvgrtp::frame::rtcp_app_packet>)>      app_hook_f_;
             std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_app_packet>)>      app_hook_u_;
 
+            void (*xr_hook_)(uvgrtp::frame::rtcp_xr_packet *);
+            std::function<void(std::shared_ptr<uvgrtp::frame::rtcp_xr_packet>)>       xr_hook_f_;
+            std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_xr_packet>)>       xr_hook_u_;
+
+            void (*fb_hook_)(uvgrtp::frame::rtcp_fb_packet *);
+            std::function<void(std::shared_ptr<uvgrtp::frame::rtcp_fb_packet>)>       fb_hook_f_;
+            std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_fb_packet>)>       fb_hook_u_;
+
+            std::function<void(const uvgrtp::frame::rtcp_report_view&)>               report_view_hook_;
+
             std::mutex sr_mutex_;
             std::mutex rr_mutex_;
+            std::mutex report_view_mutex_;
             std::mutex sdes_mutex_;
             std::mutex app_mutex_;
+            std::mutex xr_mutex_;
+            std::mutex fb_mutex_;
 
-            std::unique_ptr<std::thread> report_generator_;
-
-            bool is_active() const
-            {
-                return active_;
-            }
+            /* Sends our reports and receives RTCP packets, see rtcp_scheduler.hh */
+            std::shared_ptr<uvgrtp::rtcp_scheduler> scheduler_;
 
             bool active_;
 
@@ -496,11 +986,39 @@ namespace uvgrtp {
             std::vector<uvgrtp::frame::rtcp_sdes_item> ourItems_; // always sent
             std::vector<uint32_t> bye_ssrcs_; // sent once
             std::map<std::string, std::deque<rtcp_app_packet>> app_packets_; // sent one at a time per name
+            std::deque<std::vector<uint8_t>> fb_packets_; // feedback messages, sent in the next RTCP packet
+
+            /* The timing of early feedback, see RFC 4585 section 3.5 */
+            std::atomic<bool> allow_early_;       /* may an early packet be sent before the next regular report */
+            std::atomic<uint64_t> early_report_;  /* when the scheduled early packet is sent, 0 if none is */
+            uint64_t last_regular_;               /* when the previous regular report was sent */
+            uint32_t trr_interval_ms_;            /* the minimum interval of regular reports */
 
             uvgrtp::frame::rtcp_sdes_item cnameItem_;
             char cname_[255];
 
             size_t mtu_size_;
+
+            /* Our reports are written here. It only grows if a report does not fit */
+            std::unique_ptr<uint8_t[]> report_buffer_;
+            size_t report_buffer_size_;
+
+            /* The XR packet of the report is written here before it is added to the report */
+            std::unique_ptr<uint8_t[]> xr_buffer_;
+
+            /* Early RTCP packets are written here with RCE_RTCP_FEEDBACK */
+            std::unique_ptr<uint8_t[]> early_buffer_;
+
+            /* Calls the hooks with RCE_RTCP_ASYNC_HOOKS, exists while RTCP is running */
+            std::unique_ptr<uvgrtp::rtcp_dispatcher> dispatcher_;
+
+            /* The statistics of the sources reported in the report being generated */
+            std::vector<std::pair<uint32_t, statistics_snapshot>> report_sources_;
+
+            /* Read and replaced with std::atomic_load() and std::atomic_store(). These are not
+             * lock-free with every standard library, libstdc++ guards the pointer with a small
+             * pool of mutexes, but they are only held while the pointer is copied */
+            std::shared_ptr<const analytics_index> analytics_index_;
     };
 }
 
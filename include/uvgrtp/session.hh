@@ -12,6 +12,8 @@ namespace uvgrtp {
 
     class media_stream;
     class zrtp;
+    class keypair_pool;
+    class rtcp_scheduler;
 
     /* This session is not the same as RTP session. One uvgRTP session 
      * houses multiple RTP sessions.
@@ -20,9 +22,12 @@ namespace uvgrtp {
     class session {
         public:
             /// \cond DO_NOT_DOCUMENT
-            session(std::string cname, std::string addr);
+            session(std::string cname, std::string addr,
+                std::shared_ptr<uvgrtp::keypair_pool> keypool,
+                std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler);
             session(std::string cname, std::string remote_addr, 
-                std::string local_addr);
+                std::string local_addr, std::shared_ptr<uvgrtp::keypair_pool> keypool,
+                std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler);
             ~session();
             /// \endcond
 
@@ -51,7 +56,8 @@ namespace uvgrtp {
              * \retval nullptr                 If src_port or dst_port is 0
              * \retval nullptr                 If fmt is not a supported media format
              * \retval nullptr                 If socket initialization failed
-             * \retval nullptr                 If ZRTP was enabled and it failed to finish handshaking
+             * \retval nullptr                 If ZRTP was enabled and it failed to finish handshaking,
+             *                                 unless RCE_ZRTP_ASYNC was given
              * \retval nullptr                 If RCE_SRTP is given but uvgRTP has not been compiled with Crypto++ enabled
              * \retval nullptr                 If RCE_SRTP is given but RCE_SRTP_KMNGMNT_* flag is not given
              * \retval nullptr                 If memory allocation failed
@@ -81,6 +87,12 @@ namespace uvgrtp {
             /* Each RTP multimedia session shall have one ZRTP session from which all session are derived */
             std::shared_ptr<uvgrtp::zrtp> zrtp_;
 
+            /* Key pairs generated ahead of time for ZRTP, shared by the sessions of a context */
+            std::shared_ptr<uvgrtp::keypair_pool> keypool_;
+
+            /* RTCP scheduler of the context, shared by the media streams of the sessions */
+            std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler_;
+
             /* Each RTP multimedia session is always IP-specific */
             std::string addr_;
 
@@ -31,10 +31,12 @@ namespace uvgrtp {
     typedef std::vector<std::vector<std::pair<size_t, uint8_t *>>> pkt_vec;
 
     typedef rtp_error_t (*packet_handler_vec)(void *, buf_vec&);
+    typedef rtp_error_t (*packet_handler_batch)(void *, pkt_vec&);
 
     struct socket_packet_handler {
         void *arg = nullptr;
         packet_handler_vec handler = nullptr;
+        packet_handler_batch batch_handler = nullptr;
     };
 
     class socket {
@@ -137,6 +139,12 @@ namespace uvgrtp {
              * "arg" is an optional parameter that can be passed to the handler when it's called */
             rtp_error_t install_handler(void *arg, packet_handler_vec handler);
 
+            /* Install a packet handler that also has a batch variant.
+             *
+             * When multiple packets are sent at once, "batch_handler" is called once
+             * for all of them instead of calling "handler" for each packet separately */
+            rtp_error_t install_handler(void *arg, packet_handler_vec handler, packet_handler_batch batch_handler);
+
         private:
             /* helper function for sending UPD packets, see documentation for sendto() above */
             rtp_error_t __sendto(sockaddr_in& addr, uint8_t *buf, size_t buf_len, int flags, int *bytes_sent);
@@ -147,6 +155,9 @@ namespace uvgrtp {
             rtp_error_t __sendtov(sockaddr_in& addr, buf_vec& buffers, int flags, int *bytes_sent);
             rtp_error_t __sendtov(sockaddr_in& addr, uvgrtp::pkt_vec& buffers, int flags, int *bytes_sent);
 
+            /* Call the installed handlers in order for all packets of "buffers" */
+            rtp_error_t call_handlers(uvgrtp::pkt_vec& buffers);
+
             socket_t socket_;
             sockaddr_in addr_;
             int flags_;
@@ -227,7 +227,62 @@ enum RTP_CTX_ENABLE_FLAGS {
     /** Use 256-bit keys with SRTP */
     RCE_SRTP_KEYSIZE_256          = 1 << 14,
 
-    RCE_LAST                      = 1 << 15,
+    /** Protect SRTP and SRTCP packets with AES-GCM (RFC 7714) instead of AES-CM and HMAC-SHA1
+     *
+     * AEAD_AES_128_GCM is used by default and AEAD_AES_256_GCM if RCE_SRTP_KEYSIZE_256
+     * is also given. Every packet is authenticated with a 16-byte tag.
+     *
+     * With ZRTP, the profile is used only if the remote supports it too,
+     * otherwise AES-CM and HMAC-SHA1 are used */
+    RCE_SRTP_AES_GCM              = 1 << 15,
+
+    /** Use only the DH3k key agreement with ZRTP
+     *
+     * By default, uvgRTP offers X25519 (E255) and P-256 (EC25) before DH3k and
+     * uses the first of them that the remote supports too. Elliptic curve key
+     * agreement makes the ZRTP handshake considerably faster */
+    RCE_ZRTP_DH3K_ONLY            = 1 << 16,
+
+    /** Perform the ZRTP handshake in the background
+     *
+     * uvgrtp::session::create_stream() returns as soon as the socket has been created
+     * and the stream becomes usable once the SRTP keys have been installed. Until then
+     * the stream does not send or receive media. The handshakes of different sessions
+     * run in parallel. Use uvgrtp::media_stream::install_zrtp_hook() or
+     * uvgrtp::media_stream::wait_for_zrtp() to know when the stream is ready */
+    RCE_ZRTP_ASYNC                = 1 << 17,
+
+    /** Add a 32-bit Master Key Identifier (MKI) to every SRTP and SRTCP packet
+     *
+     * The MKI tells the receiver which master key protects the packet so that
+     * new master keys can be installed with uvgrtp::media_stream::add_srtp_key()
+     * and taken into use without the receiver knowing when the sender switches.
+     * Valid only with RCE_SRTP_KMNGMNT_USER */
+    RCE_SRTP_MKI                  = 1 << 18,
+
+    /** Send RTCP Extended Reports (RFC 3611) about the reported sources with each
+     * RTCP report: Loss RLE, Duplicate RLE, Packet Receipt Times and VoIP Metrics.
+     * Valid only with RCE_RTCP */
+    RCE_RTCP_XR                   = 1 << 19,
+
+    /** Call the RTCP hooks from a thread of their own instead of the thread receiving RTCP.
+     * The received packets wait for their hooks in a bounded queue so that slow hooks do not
+     * delay RTCP processing. See uvgrtp::rtcp::get_hook_statistics().
+     * Valid only with RCE_RTCP */
+    RCE_RTCP_ASYNC_HOOKS          = 1 << 20,
+
+    /** Send RTCP feedback early (RTP/AVPF, RFC 4585). NACK, PLI and APP packets are sent
+     * at once in point-to-point sessions and after a short random delay in larger ones,
+     * instead of waiting for the next regular report.
+     * Valid only with RCE_RTCP */
+    RCE_RTCP_FEEDBACK             = 1 << 21,
+
+    /** Send early feedback in reduced-size RTCP packets (RFC 5506) that only contain the
+     * feedback messages instead of a compound packet with a report and SDES.
+     * Valid only with RCE_RTCP_FEEDBACK */
+    RCE_RTCP_REDUCED_SIZE         = 1 << 22,
+
+    RCE_LAST                      = 1 << 23,
 };
 
 /**
@@ -278,6 +333,37 @@ enum RTP_CTX_CONFIGURATION_FLAGS {
      * to use jumbo frames, it can set the MTU size to 9000 bytes */
     RCC_MTU_SIZE         = 5,
 
+    /** How many packets the SRTP and SRTCP replay windows cover
+     *
+     * Default is 1024 packets
+     *
+     * Valid only if RCE_SRTP_REPLAY_PROTECTION has been given. Packets that
+     * are older than the window are discarded so for high bitrate streams
+     * with a lot of reordering, a larger window may be needed. Setting the
+     * window size resets the window */
+    RCC_SRTP_REPLAY_WINDOW = 6,
+
+    /** How many worker threads help the sending thread encrypt and authenticate
+     * the packets of a frame
+     *
+     * Default is 0, i.e., all packets are protected by the thread that calls push_frame()
+     *
+     * Valid only if SRTP has been enabled. Large frames, such as intra frames of
+     * a high bitrate video stream, consist of hundreds of packets and protecting them
+     * in parallel reduces the latency of push_frame(). Small frames are always protected
+     * by the sending thread */
+    RCC_SRTP_CRYPTO_THREADS = 7,
+
+    /** How many packets are protected with the same session keys before they are
+     * derived again from the master key (RFC 3711 section 4.3.1)
+     *
+     * Default is 0, i.e., the session keys are derived only once per master key
+     *
+     * Valid only if SRTP has been enabled. The value must be a power of two that is
+     * at most 2^24 and both participants must use the same value. It applies to
+     * SRTP and SRTCP packet indices separately */
+    RCC_SRTP_KEY_DERIVATION_RATE = 8,
+
     RCC_LAST
 };
 
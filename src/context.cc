@@ -5,8 +5,10 @@
 #include "uvgrtp/debug.hh"
 #include "uvgrtp/crypto.hh"
 
+#include "zrtp/keypair_pool.hh"
 #include "hostname.hh"
 #include "random.hh"
+#include "rtcp_scheduler.hh"
 
 #include <cstdlib>
 #include <cstring>
@@ -29,6 +31,8 @@ uvgrtp::context::context()
 #endif
 
     uvgrtp::random::init();
+
+    rtcp_scheduler_ = std::make_shared<uvgrtp::rtcp_scheduler>();
 }
 
 uvgrtp::context::~context()
@@ -43,7 +47,7 @@ uvgrtp::session *uvgrtp::context::create_session(std::string remote_addr)
     if (remote_addr == "")
         return nullptr;
 
-    return new uvgrtp::session(get_cname(), remote_addr);
+    return new uvgrtp::session(get_cname(), remote_addr, keypool_, rtcp_scheduler_);
 }
 
 uvgrtp::session *uvgrtp::context::create_session(std::string remote_addr, std::string local_addr)
@@ -51,7 +55,7 @@ uvgrtp::session *uvgrtp::context::create_session(std::string remote_addr, std::s
     if (remote_addr == "" || local_addr == "")
         return nullptr;
 
-    return new uvgrtp::session(get_cname(), remote_addr, local_addr);
+    return new uvgrtp::session(get_cname(), remote_addr, local_addr, keypool_, rtcp_scheduler_);
 }
 
 rtp_error_t uvgrtp::context::destroy_session(uvgrtp::session *session)
@@ -64,6 +68,28 @@ rtp_error_t uvgrtp::context::destroy_session(uvgrtp::session *session)
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::context::enable_keypair_pool(size_t depth)
+{
+    if (!uvgrtp::crypto::enabled())
+        return RTP_NOT_SUPPORTED;
+
+    /* sessions that use the previous pool keep it alive until they are destroyed */
+    if (depth == 0)
+        keypool_ = nullptr;
+    else
+        keypool_ = std::shared_ptr<uvgrtp::keypair_pool> (new uvgrtp::keypair_pool(depth));
+
+    return RTP_OK;
+}
+
+uvgrtp::keypair_pool_statistics uvgrtp::context::get_keypair_pool_statistics() const
+{
+    if (!keypool_)
+        return uvgrtp::keypair_pool_statistics();
+
+    return keypool_->statistics();
+}
+
 std::string uvgrtp::context::generate_cname() const
 {
     std::string host = uvgrtp::hostname::get_hostname();
@@ -0,0 +1,613 @@
+#include "aes.hh"
+
+#include "cpu.hh"
+#include "endian.hh"
+
+#ifdef UVG_CRYPTO_X86
+#include <immintrin.h>
+#endif
+
+#include <cstring>
+
+/* ***************** portable aes ***************** */
+
+static inline uint32_t ror32(uint32_t v, int n)
+{
+    return (v >> n) | (v << (32 - n));
+}
+
+static inline uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    uint8_t p = 0;
+
+    while (b) {
+        if (b & 1)
+            p ^= a;
+
+        a = (uint8_t)((a << 1) ^ ((a & 0x80) ? 0x1b : 0));
+        b >>= 1;
+    }
+
+    return p;
+}
+
+/* S-boxes and the round tables that combine SubBytes, ShiftRows and MixColumns
+ * are generated once instead of spelling out 10 kB of constants */
+struct aes_tables {
+    uint8_t sbox[256];
+    uint8_t inv_sbox[256];
+    uint32_t te[4][256];
+    uint32_t td[4][256];
+
+    aes_tables()
+    {
+        uint8_t p = 1, q = 1;
+
+        /* p runs through all non-zero elements of GF(2^8) as powers of 3 and q is its inverse */
+        do {
+            p = (uint8_t)(p ^ (p << 1) ^ ((p & 0x80) ? 0x1b : 0));
+
+            q ^= (uint8_t)(q << 1);
+            q ^= (uint8_t)(q << 2);
+            q ^= (uint8_t)(q << 4);
+
+            if (q & 0x80)
+                q ^= 0x09;
+
+            uint8_t x = q ^ (uint8_t)((q << 1) | (q >> 7)) ^ (uint8_t)((q << 2) | (q >> 6))
+                          ^ (uint8_t)((q << 3) | (q >> 5)) ^ (uint8_t)((q << 4) | (q >> 4));
+
+            sbox[p] = x ^ 0x63;
+        } while (p != 1);
+
+        sbox[0] = 0x63;
+
+        for (int i = 0; i < 256; ++i)
+            inv_sbox[sbox[i]] = (uint8_t)i;
+
+        for (int i = 0; i < 256; ++i) {
+            uint8_t s  = sbox[i];
+            uint8_t si = inv_sbox[i];
+
+            te[0][i] = ((uint32_t)gf_mul(s, 2) << 24) | ((uint32_t)s << 16) |
+                       ((uint32_t)s << 8) | gf_mul(s, 3);
+            td[0][i] = ((uint32_t)gf_mul(si, 14) << 24) | ((uint32_t)gf_mul(si, 9) << 16) |
+                       ((uint32_t)gf_mul(si, 13) << 8) | gf_mul(si, 11);
+
+            for (int k = 1; k < 4; ++k) {
+                te[k][i] = ror32(te[0][i], 8 * k);
+                td[k][i] = ror32(td[0][i], 8 * k);
+            }
+        }
+    }
+};
+
+static const aes_tables& tables()
+{
+    static const aes_tables t;
+    return t;
+}
+
+static inline uint32_t sub_word(const aes_tables& t, uint32_t w)
+{
+    return ((uint32_t)t.sbox[w >> 24] << 24) | ((uint32_t)t.sbox[(w >> 16) & 0xff] << 16) |
+           ((uint32_t)t.sbox[(w >> 8) & 0xff] << 8) | t.sbox[w & 0xff];
+}
+
+static void portable_encrypt(const uint32_t *rk, int rounds, const uint8_t *in, uint8_t *out)
+{
+    const aes_tables& t = tables();
+
+    uint32_t s0 = uvgrtp::crypto::builtin::load_be32(in)      ^ rk[0];
+    uint32_t s1 = uvgrtp::crypto::builtin::load_be32(in + 4)  ^ rk[1];
+    uint32_t s2 = uvgrtp::crypto::builtin::load_be32(in + 8)  ^ rk[2];
+    uint32_t s3 = uvgrtp::crypto::builtin::load_be32(in + 12) ^ rk[3];
+    uint32_t t0, t1, t2, t3;
+
+    for (int r = 1; r < rounds; ++r) {
+        rk += 4;
+
+        t0 = t.te[0][s0 >> 24] ^ t.te[1][(s1 >> 16) & 0xff] ^ t.te[2][(s2 >> 8) & 0xff] ^ t.te[3][s3 & 0xff] ^ rk[0];
+        t1 = t.te[0][s1 >> 24] ^ t.te[1][(s2 >> 16) & 0xff] ^ t.te[2][(s3 >> 8) & 0xff] ^ t.te[3][s0 & 0xff] ^ rk[1];
+        t2 = t.te[0][s2 >> 24] ^ t.te[1][(s3 >> 16) & 0xff] ^ t.te[2][(s0 >> 8) & 0xff] ^ t.te[3][s1 & 0xff] ^ rk[2];
+        t3 = t.te[0][s3 >> 24] ^ t.te[1][(s0 >> 16) & 0xff] ^ t.te[2][(s1 >> 8) & 0xff] ^ t.te[3][s2 & 0xff] ^ rk[3];
+
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+
+    rk += 4;
+
+    t0 = ((uint32_t)t.sbox[s0 >> 24] << 24) ^ ((uint32_t)t.sbox[(s1 >> 16) & 0xff] << 16) ^
+         ((uint32_t)t.sbox[(s2 >> 8) & 0xff] << 8) ^ t.sbox[s3 & 0xff] ^ rk[0];
+    t1 = ((uint32_t)t.sbox[s1 >> 24] << 24) ^ ((uint32_t)t.sbox[(s2 >> 16) & 0xff] << 16) ^
+         ((uint32_t)t.sbox[(s3 >> 8) & 0xff] << 8) ^ t.sbox[s0 & 0xff] ^ rk[1];
+    t2 = ((uint32_t)t.sbox[s2 >> 24] << 24) ^ ((uint32_t)t.sbox[(s3 >> 16) & 0xff] << 16) ^
+         ((uint32_t)t.sbox[(s0 >> 8) & 0xff] << 8) ^ t.sbox[s1 & 0xff] ^ rk[2];
+    t3 = ((uint32_t)t.sbox[s3 >> 24] << 24) ^ ((uint32_t)t.sbox[(s0 >> 16) & 0xff] << 16) ^
+         ((uint32_t)t.sbox[(s1 >> 8) & 0xff] << 8) ^ t.sbox[s2 & 0xff] ^ rk[3];
+
+    uvgrtp::crypto::builtin::store_be32(out,      t0);
+    uvgrtp::crypto::builtin::store_be32(out + 4,  t1);
+    uvgrtp::crypto::builtin::store_be32(out + 8,  t2);
+    uvgrtp::crypto::builtin::store_be32(out + 12, t3);
+}
+
+static void portable_decrypt(const uint32_t *rk, int rounds, const uint8_t *in, uint8_t *out)
+{
+    const aes_tables& t = tables();
+
+    uint32_t s0 = uvgrtp::crypto::builtin::load_be32(in)      ^ rk[0];
+    uint32_t s1 = uvgrtp::crypto::builtin::load_be32(in + 4)  ^ rk[1];
+    uint32_t s2 = uvgrtp::crypto::builtin::load_be32(in + 8)  ^ rk[2];
+    uint32_t s3 = uvgrtp::crypto::builtin::load_be32(in + 12) ^ rk[3];
+    uint32_t t0, t1, t2, t3;
+
+    for (int r = 1; r < rounds; ++r) {
+        rk += 4;
+
+        t0 = t.td[0][s0 >> 24] ^ t.td[1][(s3 >> 16) & 0xff] ^ t.td[2][(s2 >> 8) & 0xff] ^ t.td[3][s1 & 0xff] ^ rk[0];
+        t1 = t.td[0][s1 >> 24] ^ t.td[1][(s0 >> 16) & 0xff] ^ t.td[2][(s3 >> 8) & 0xff] ^ t.td[3][s2 & 0xff] ^ rk[1];
+        t2 = t.td[0][s2 >> 24] ^ t.td[1][(s1 >> 16) & 0xff] ^ t.td[2][(s0 >> 8) & 0xff] ^ t.td[3][s3 & 0xff] ^ rk[2];
+        t3 = t.td[0][s3 >> 24] ^ t.td[1][(s2 >> 16) & 0xff] ^ t.td[2][(s1 >> 8) & 0xff] ^ t.td[3][s0 & 0xff] ^ rk[3];
+
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+
+    rk += 4;
+
+    t0 = ((uint32_t)t.inv_sbox[s0 >> 24] << 24) ^ ((uint32_t)t.inv_sbox[(s3 >> 16) & 0xff] << 16) ^
+         ((uint32_t)t.inv_sbox[(s2 >> 8) & 0xff] << 8) ^ t.inv_sbox[s1 & 0xff] ^ rk[0];
+    t1 = ((uint32_t)t.inv_sbox[s1 >> 24] << 24) ^ ((uint32_t)t.inv_sbox[(s0 >> 16) & 0xff] << 16) ^
+         ((uint32_t)t.inv_sbox[(s3 >> 8) & 0xff] << 8) ^ t.inv_sbox[s2 & 0xff] ^ rk[1];
+    t2 = ((uint32_t)t.inv_sbox[s2 >> 24] << 24) ^ ((uint32_t)t.inv_sbox[(s1 >> 16) & 0xff] << 16) ^
+         ((uint32_t)t.inv_sbox[(s0 >> 8) & 0xff] << 8) ^ t.inv_sbox[s3 & 0xff] ^ rk[2];
+    t3 = ((uint32_t)t.inv_sbox[s3 >> 24] << 24) ^ ((uint32_t)t.inv_sbox[(s2 >> 16) & 0xff] << 16) ^
+         ((uint32_t)t.inv_sbox[(s1 >> 8) & 0xff] << 8) ^ t.inv_sbox[s0 & 0xff] ^ rk[3];
+
+    uvgrtp::crypto::builtin::store_be32(out,      t0);
+    uvgrtp::crypto::builtin::store_be32(out + 4,  t1);
+    uvgrtp::crypto::builtin::store_be32(out + 8,  t2);
+    uvgrtp::crypto::builtin::store_be32(out + 12, t3);
+}
+
+/* Advance the counter (hi || lo) by one block */
+static inline void next_counter(uint64_t& hi, uint64_t& lo, bool inc32)
+{
+    if (inc32) {
+        lo = (lo & 0xffffffff00000000ULL) | (uint32_t)(lo + 1);
+    } else if (++lo == 0) {
+        ++hi;
+    }
+}
+
+/* ***************** aes-ni ***************** */
+
+#ifdef UVG_CRYPTO_X86
+
+#define AESNI_PARALLEL 8
+
+UVG_TARGET("aes,sse2")
+static void aesni_encrypt(const uint8_t *rk_bytes, int rounds, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    __m128i rk[15];
+    __m128i b[AESNI_PARALLEL];
+
+    for (int r = 0; r <= rounds; ++r)
+        rk[r] = _mm_load_si128((const __m128i *)(rk_bytes + 16 * r));
+
+    for (; blocks >= AESNI_PARALLEL; blocks -= AESNI_PARALLEL) {
+        for (int i = 0; i < AESNI_PARALLEL; ++i)
+            b[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + 16 * i)), rk[0]);
+
+        for (int r = 1; r < rounds; ++r) {
+            for (int i = 0; i < AESNI_PARALLEL; ++i)
+                b[i] = _mm_aesenc_si128(b[i], rk[r]);
+        }
+
+        for (int i = 0; i < AESNI_PARALLEL; ++i)
+            _mm_storeu_si128((__m128i *)(out + 16 * i), _mm_aesenclast_si128(b[i], rk[rounds]));
+
+        in  += 16 * AESNI_PARALLEL;
+        out += 16 * AESNI_PARALLEL;
+    }
+
+    for (; blocks > 0; --blocks) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in), rk[0]);
+
+        for (int r = 1; r < rounds; ++r)
+            x = _mm_aesenc_si128(x, rk[r]);
+
+        _mm_storeu_si128((__m128i *)out, _mm_aesenclast_si128(x, rk[rounds]));
+
+        in  += 16;
+        out += 16;
+    }
+}
+
+UVG_TARGET("aes,sse2")
+static void aesni_decrypt(const uint8_t *rk_bytes, int rounds, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    __m128i rk[15];
+    __m128i b[AESNI_PARALLEL];
+
+    for (int r = 0; r <= rounds; ++r)
+        rk[r] = _mm_load_si128((const __m128i *)(rk_bytes + 16 * r));
+
+    for (; blocks >= AESNI_PARALLEL; blocks -= AESNI_PARALLEL) {
+        for (int i = 0; i < AESNI_PARALLEL; ++i)
+            b[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + 16 * i)), rk[0]);
+
+        for (int r = 1; r < rounds; ++r) {
+            for (int i = 0; i < AESNI_PARALLEL; ++i)
+                b[i] = _mm_aesdec_si128(b[i], rk[r]);
+        }
+
+        for (int i = 0; i < AESNI_PARALLEL; ++i)
+            _mm_storeu_si128((__m128i *)(out + 16 * i), _mm_aesdeclast_si128(b[i], rk[rounds]));
+
+        in  += 16 * AESNI_PARALLEL;
+        out += 16 * AESNI_PARALLEL;
+    }
+
+    for (; blocks > 0; --blocks) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in), rk[0]);
+
+        for (int r = 1; r < rounds; ++r)
+            x = _mm_aesdec_si128(x, rk[r]);
+
+        _mm_storeu_si128((__m128i *)out, _mm_aesdeclast_si128(x, rk[rounds]));
+
+        in  += 16;
+        out += 16;
+    }
+}
+
+static inline uint64_t byte_swap64(uint64_t v)
+{
+    v = ((v & 0x00ff00ff00ff00ffULL) << 8)  | ((v >> 8)  & 0x00ff00ff00ff00ffULL);
+    v = ((v & 0x0000ffff0000ffffULL) << 16) | ((v >> 16) & 0x0000ffff0000ffffULL);
+
+    return (v << 32) | (v >> 32);
+}
+
+/* Counter block (hi || lo) as it is laid out in memory, built in registers
+ * so that the AES rounds do not wait for byte stores to be forwarded */
+UVG_TARGET("aes,sse2")
+static inline __m128i counter_block(uint64_t hi, uint64_t lo)
+{
+    return _mm_set_epi64x((long long)byte_swap64(lo), (long long)byte_swap64(hi));
+}
+
+UVG_TARGET("aes,sse2")
+static void aesni_ctr_xor(const uint8_t *rk_bytes, int rounds, uint8_t *counter,
+                          const uint8_t *in, uint8_t *out, size_t blocks, bool inc32)
+{
+    __m128i rk[15];
+    __m128i b[AESNI_PARALLEL];
+
+    uint64_t hi = uvgrtp::crypto::builtin::load_be64(counter);
+    uint64_t lo = uvgrtp::crypto::builtin::load_be64(counter + 8);
+
+    for (int r = 0; r <= rounds; ++r)
+        rk[r] = _mm_load_si128((const __m128i *)(rk_bytes + 16 * r));
+
+    for (; blocks >= AESNI_PARALLEL; blocks -= AESNI_PARALLEL) {
+        for (int i = 0; i < AESNI_PARALLEL; ++i) {
+            b[i] = _mm_xor_si128(counter_block(hi, lo), rk[0]);
+            next_counter(hi, lo, inc32);
+        }
+
+        for (int r = 1; r < rounds; ++r) {
+            for (int i = 0; i < AESNI_PARALLEL; ++i)
+                b[i] = _mm_aesenc_si128(b[i], rk[r]);
+        }
+
+        for (int i = 0; i < AESNI_PARALLEL; ++i) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(in + 16 * i));
+
+            _mm_storeu_si128((__m128i *)(out + 16 * i), _mm_xor_si128(x, _mm_aesenclast_si128(b[i], rk[rounds])));
+        }
+
+        in  += 16 * AESNI_PARALLEL;
+        out += 16 * AESNI_PARALLEL;
+    }
+
+    for (; blocks > 0; --blocks) {
+        __m128i x = _mm_xor_si128(counter_block(hi, lo), rk[0]);
+
+        next_counter(hi, lo, inc32);
+
+        for (int r = 1; r < rounds; ++r)
+            x = _mm_aesenc_si128(x, rk[r]);
+
+        x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in), _mm_aesenclast_si128(x, rk[rounds]));
+        _mm_storeu_si128((__m128i *)out, x);
+
+        in  += 16;
+        out += 16;
+    }
+
+    uvgrtp::crypto::builtin::store_be64(counter,     hi);
+    uvgrtp::crypto::builtin::store_be64(counter + 8, lo);
+}
+
+#endif // UVG_CRYPTO_X86
+
+/* ***************** aes ***************** */
+
+uvgrtp::crypto::builtin::aes::aes():
+    ek_(),
+    dk_(),
+    ek_bytes_(),
+    dk_bytes_(),
+    rounds_(0),
+    aesni_(false)
+{
+#ifdef UVG_CRYPTO_X86
+    aesni_ = uvgrtp::crypto::cpu::has_aesni();
+#endif
+}
+
+void uvgrtp::crypto::builtin::aes::set_key(const uint8_t *key, size_t key_size)
+{
+    static const uint8_t rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+
+    const aes_tables& t = tables();
+    int nk = (int)key_size / 4;
+
+    rounds_ = nk + 6;
+
+    for (int i = 0; i < nk; ++i)
+        ek_[i] = load_be32(key + 4 * i);
+
+    for (int i = nk; i < 4 * (rounds_ + 1); ++i) {
+        uint32_t w = ek_[i - 1];
+
+        if (i % nk == 0)
+            w = sub_word(t, (w << 8) | (w >> 24)) ^ ((uint32_t)rcon[i / nk - 1] << 24);
+        else if (nk > 6 && i % nk == 4)
+            w = sub_word(t, w);
+
+        ek_[i] = ek_[i - nk] ^ w;
+    }
+
+    /* Round keys of the equivalent inverse cipher: reversed order and
+     * InvMixColumns applied to all but the first and the last round key */
+    for (int r = 0; r <= rounds_; ++r) {
+        for (int c = 0; c < 4; ++c)
+            dk_[4 * r + c] = ek_[4 * (rounds_ - r) + c];
+    }
+
+    for (int i = 4; i < 4 * rounds_; ++i) {
+        uint32_t w = dk_[i];
+
+        dk_[i] = t.td[0][t.sbox[w >> 24]] ^ t.td[1][t.sbox[(w >> 16) & 0xff]] ^
+                 t.td[2][t.sbox[(w >> 8) & 0xff]] ^ t.td[3][t.sbox[w & 0xff]];
+    }
+
+    for (int i = 0; i < 4 * (rounds_ + 1); ++i) {
+        store_be32(ek_bytes_ + 4 * i, ek_[i]);
+        store_be32(dk_bytes_ + 4 * i, dk_[i]);
+    }
+}
+
+void uvgrtp::crypto::builtin::aes::encrypt_block(const uint8_t *in, uint8_t *out) const
+{
+    encrypt_blocks(in, out, 1);
+}
+
+void uvgrtp::crypto::builtin::aes::decrypt_block(const uint8_t *in, uint8_t *out) const
+{
+    decrypt_blocks(in, out, 1);
+}
+
+void uvgrtp::crypto::builtin::aes::encrypt_blocks(const uint8_t *in, uint8_t *out, size_t blocks) const
+{
+#ifdef UVG_CRYPTO_X86
+    if (aesni_)
+        return aesni_encrypt(ek_bytes_, rounds_, in, out, blocks);
+#endif
+
+    for (size_t i = 0; i < blocks; ++i)
+        portable_encrypt(ek_, rounds_, in + 16 * i, out + 16 * i);
+}
+
+void uvgrtp::crypto::builtin::aes::decrypt_blocks(const uint8_t *in, uint8_t *out, size_t blocks) const
+{
+#ifdef UVG_CRYPTO_X86
+    if (aesni_)
+        return aesni_decrypt(dk_bytes_, rounds_, in, out, blocks);
+#endif
+
+    for (size_t i = 0; i < blocks; ++i)
+        portable_decrypt(dk_, rounds_, in + 16 * i, out + 16 * i);
+}
+
+void uvgrtp::crypto::builtin::aes::ctr_xor(uint8_t *counter, const uint8_t *in, uint8_t *out,
+                                           size_t blocks, bool inc32) const
+{
+#ifdef UVG_CRYPTO_X86
+    if (aesni_)
+        return aesni_ctr_xor(ek_bytes_, rounds_, counter, in, out, blocks, inc32);
+#endif
+
+    uint64_t hi = load_be64(counter);
+    uint64_t lo = load_be64(counter + 8);
+    uint8_t ks[16];
+
+    for (size_t i = 0; i < blocks; ++i) {
+        store_be64(counter,     hi);
+        store_be64(counter + 8, lo);
+        next_counter(hi, lo, inc32);
+
+        portable_encrypt(ek_, rounds_, counter, ks);
+
+        for (int k = 0; k < 16; ++k)
+            out[16 * i + k] = in[16 * i + k] ^ ks[k];
+    }
+
+    store_be64(counter,     hi);
+    store_be64(counter + 8, lo);
+}
+
+/* ***************** ghash ***************** */
+
+#ifdef UVG_CRYPTO_X86
+
+/* Carry-less multiplication of two byte-reflected field elements followed by the reduction
+ * modulo x^128 + x^7 + x^2 + x + 1, as in Intel's "Carry-Less Multiplication Instruction
+ * and its Usage for Computing the GCM Mode" white paper */
+UVG_TARGET("pclmul,ssse3")
+static inline __m128i clmul_gfmul(__m128i a, __m128i b)
+{
+    __m128i t2, t3, t4, t5, t6, t7, t8, t9;
+
+    t3 = _mm_clmulepi64_si128(a, b, 0x00);
+    t4 = _mm_clmulepi64_si128(a, b, 0x10);
+    t5 = _mm_clmulepi64_si128(a, b, 0x01);
+    t6 = _mm_clmulepi64_si128(a, b, 0x11);
+
+    t4 = _mm_xor_si128(t4, t5);
+    t5 = _mm_slli_si128(t4, 8);
+    t4 = _mm_srli_si128(t4, 8);
+    t3 = _mm_xor_si128(t3, t5);
+    t6 = _mm_xor_si128(t6, t4);
+
+    /* shift the 256-bit product left by one because the operands are bit-reflected */
+    t7 = _mm_srli_epi32(t3, 31);
+    t8 = _mm_srli_epi32(t6, 31);
+    t3 = _mm_slli_epi32(t3, 1);
+    t6 = _mm_slli_epi32(t6, 1);
+    t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    t3 = _mm_or_si128(t3, t7);
+    t6 = _mm_or_si128(t6, t8);
+    t6 = _mm_or_si128(t6, t9);
+
+    /* reduction */
+    t7 = _mm_slli_epi32(t3, 31);
+    t8 = _mm_slli_epi32(t3, 30);
+    t9 = _mm_slli_epi32(t3, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    t3 = _mm_xor_si128(t3, t7);
+
+    t2 = _mm_srli_epi32(t3, 1);
+    t4 = _mm_srli_epi32(t3, 2);
+    t5 = _mm_srli_epi32(t3, 7);
+    t2 = _mm_xor_si128(t2, t4);
+    t2 = _mm_xor_si128(t2, t5);
+    t2 = _mm_xor_si128(t2, t8);
+    t3 = _mm_xor_si128(t3, t2);
+
+    return _mm_xor_si128(t6, t3);
+}
+
+UVG_TARGET("pclmul,ssse3")
+static void clmul_ghash(const uint8_t *h, uint8_t *y, const uint8_t *in, size_t blocks)
+{
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    __m128i hv = _mm_shuffle_epi8(_mm_load_si128((const __m128i *)h), bswap);
+    __m128i yv = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)y), bswap);
+
+    for (size_t i = 0; i < blocks; ++i) {
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 16 * i)), bswap);
+        yv = clmul_gfmul(_mm_xor_si128(yv, x), hv);
+    }
+
+    _mm_storeu_si128((__m128i *)y, _mm_shuffle_epi8(yv, bswap));
+}
+
+#endif // UVG_CRYPTO_X86
+
+uvgrtp::crypto::builtin::ghash::ghash():
+    hh_(),
+    hl_(),
+    h_(),
+    pclmul_(false)
+{
+#ifdef UVG_CRYPTO_X86
+    pclmul_ = uvgrtp::crypto::cpu::has_pclmul();
+#endif
+}
+
+void uvgrtp::crypto::builtin::ghash::set_key(const uint8_t *h)
+{
+    memcpy(h_, h, sizeof(h_));
+
+    /* Multiples of H by all 4-bit values for Shoup's method */
+    uint64_t vh = load_be64(h);
+    uint64_t vl = load_be64(h + 8);
+
+    hh_[8] = vh;
+    hl_[8] = vl;
+    hh_[0] = 0;
+    hl_[0] = 0;
+
+    for (int i = 4; i > 0; i >>= 1) {
+        uint64_t t = (vl & 1) ? 0xe100000000000000ULL : 0;
+
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ t;
+
+        hh_[i] = vh;
+        hl_[i] = vl;
+    }
+
+    for (int i = 2; i <= 8; i *= 2) {
+        for (int j = 1; j < i; ++j) {
+            hh_[i + j] = hh_[i] ^ hh_[j];
+            hl_[i + j] = hl_[i] ^ hl_[j];
+        }
+    }
+}
+
+void uvgrtp::crypto::builtin::ghash::update(uint8_t *y, const uint8_t *in, size_t blocks) const
+{
+#ifdef UVG_CRYPTO_X86
+    if (pclmul_)
+        return clmul_ghash(h_, y, in, blocks);
+#endif
+
+    static const uint64_t last4[16] = {
+        0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+        0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+    };
+
+    for (size_t b = 0; b < blocks; ++b) {
+        uint8_t x[16];
+
+        for (int i = 0; i < 16; ++i)
+            x[i] = y[i] ^ in[16 * b + i];
+
+        uint8_t lo  = x[15] & 0xf;
+        uint64_t zh = hh_[lo];
+        uint64_t zl = hl_[lo];
+
+        for (int i = 15; i >= 0; --i) {
+            uint8_t hi = (x[i] >> 4) & 0xf;
+            uint8_t rem;
+
+            lo = x[i] & 0xf;
+
+            if (i != 15) {
+                rem = (uint8_t)(zl & 0xf);
+                zl  = (zh << 60) | (zl >> 4);
+                zh  = (zh >> 4) ^ (last4[rem] << 48) ^ hh_[lo];
+                zl ^= hl_[lo];
+            }
+
+            rem = (uint8_t)(zl & 0xf);
+            zl  = (zh << 60) | (zl >> 4);
+            zh  = (zh >> 4) ^ (last4[rem] << 48) ^ hh_[hi];
+            zl ^= hl_[hi];
+        }
+
+        store_be64(y,     zh);
+        store_be64(y + 8, zl);
+    }
+}
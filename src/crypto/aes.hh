@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uvgrtp {
+    namespace crypto {
+        namespace builtin {
+
+            /* AES block cipher (FIPS-197) with 128, 192 and 256-bit keys
+             *
+             * Uses AES-NI if the CPU supports it, in which case the multi-block
+             * functions keep eight blocks in flight to hide the latency of the
+             * AES instructions. Otherwise a portable table-based implementation is used */
+            class aes {
+                public:
+                    aes();
+
+                    /* Expand "key" of "key_size" bytes (16, 24 or 32) */
+                    void set_key(const uint8_t *key, size_t key_size);
+
+                    void encrypt_block(const uint8_t *in, uint8_t *out) const;
+                    void decrypt_block(const uint8_t *in, uint8_t *out) const;
+
+                    /* Encrypt/decrypt "blocks" full blocks in ECB mode */
+                    void encrypt_blocks(const uint8_t *in, uint8_t *out, size_t blocks) const;
+                    void decrypt_blocks(const uint8_t *in, uint8_t *out, size_t blocks) const;
+
+                    /* XOR "blocks" full blocks of "in" with a keystream that is created by encrypting
+                     * "counter", a 128-bit big-endian integer that is incremented after each block.
+                     * If "inc32" is true, only the last 32 bits of the counter are incremented (GCM).
+                     * "counter" is updated to the value following the last block */
+                    void ctr_xor(uint8_t *counter, const uint8_t *in, uint8_t *out, size_t blocks, bool inc32) const;
+
+                private:
+                    /* round keys as 32-bit words for the portable code */
+                    uint32_t ek_[60];
+                    uint32_t dk_[60];
+
+                    /* the same round keys in byte order for AES-NI */
+                    alignas(16) uint8_t ek_bytes_[240];
+                    alignas(16) uint8_t dk_bytes_[240];
+
+                    int rounds_;
+                    bool aesni_;
+            };
+
+            /* GHASH function of GCM (NIST SP 800-38D)
+             *
+             * Uses PCLMULQDQ if the CPU supports it and 4-bit multiplication tables otherwise */
+            class ghash {
+                public:
+                    ghash();
+
+                    /* Set the hash subkey H */
+                    void set_key(const uint8_t *h);
+
+                    /* Y = (Y ^ X_i) * H for each of the "blocks" full blocks X_i of "in" */
+                    void update(uint8_t *y, const uint8_t *in, size_t blocks) const;
+
+                private:
+                    uint64_t hh_[16];
+                    uint64_t hl_[16];
+
+                    alignas(16) uint8_t h_[16];
+
+                    bool pclmul_;
+            };
+        }
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
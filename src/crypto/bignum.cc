@@ -0,0 +1,141 @@
+#include "bignum.hh"
+
+/* Return true if a >= b */
+static bool geq(const uint32_t *a, const uint32_t *b, size_t limbs)
+{
+    for (size_t i = limbs; i-- > 0; ) {
+        if (a[i] != b[i])
+            return a[i] > b[i];
+    }
+
+    return true;
+}
+
+/* a -= b, return the borrow */
+static uint32_t sub(uint32_t *a, const uint32_t *b, size_t limbs)
+{
+    uint64_t borrow = 0;
+
+    for (size_t i = 0; i < limbs; ++i) {
+        uint64_t d = (uint64_t)a[i] - b[i] - borrow;
+
+        a[i]   = (uint32_t)d;
+        borrow = (d >> 32) & 1;
+    }
+
+    return (uint32_t)borrow;
+}
+
+uvgrtp::crypto::builtin::montgomery::montgomery(const uint32_t *modulus, size_t limbs):
+    n_(modulus, modulus + limbs),
+    r2_(limbs, 0),
+    n0inv_(0)
+{
+    /* -n^-1 mod 2^32 with Newton's iteration, each step doubles the correct bits */
+    uint32_t inv = 1;
+
+    for (int i = 0; i < 5; ++i)
+        inv *= 2 - n_[0] * inv;
+
+    n0inv_ = (uint32_t)0 - inv;
+
+    /* R^2 mod n where R = 2^(32 * limbs) by doubling 1 modulo n */
+    r2_[0] = 1;
+
+    for (size_t i = 0; i < 64 * limbs; ++i) {
+        uint32_t carry = 0;
+
+        for (size_t k = 0; k < limbs; ++k) {
+            uint32_t next = r2_[k] >> 31;
+
+            r2_[k] = (r2_[k] << 1) | carry;
+            carry  = next;
+        }
+
+        if (carry || geq(r2_.data(), n_.data(), limbs))
+            (void)sub(r2_.data(), n_.data(), limbs);
+    }
+}
+
+size_t uvgrtp::crypto::builtin::montgomery::limbs() const
+{
+    return n_.size();
+}
+
+void uvgrtp::crypto::builtin::montgomery::mul(uint32_t *out, const uint32_t *a, const uint32_t *b) const
+{
+    size_t s = n_.size();
+    std::vector<uint32_t> t(s + 2, 0);
+
+    /* coarsely integrated operand scanning (CIOS) */
+    for (size_t i = 0; i < s; ++i) {
+        uint64_t c = 0;
+
+        for (size_t j = 0; j < s; ++j) {
+            c    = (uint64_t)t[j] + (uint64_t)a[j] * b[i] + (c >> 32);
+            t[j] = (uint32_t)c;
+        }
+
+        c        = (uint64_t)t[s] + (c >> 32);
+        t[s]     = (uint32_t)c;
+        t[s + 1] = (uint32_t)(c >> 32);
+
+        uint32_t m = t[0] * n0inv_;
+
+        c = (uint64_t)t[0] + (uint64_t)m * n_[0];
+
+        for (size_t j = 1; j < s; ++j) {
+            c        = (uint64_t)t[j] + (uint64_t)m * n_[j] + (c >> 32);
+            t[j - 1] = (uint32_t)c;
+        }
+
+        c        = (uint64_t)t[s] + (c >> 32);
+        t[s - 1] = (uint32_t)c;
+        t[s]     = t[s + 1] + (uint32_t)(c >> 32);
+    }
+
+    if (t[s] || geq(t.data(), n_.data(), s))
+        (void)sub(t.data(), n_.data(), s);
+
+    for (size_t i = 0; i < s; ++i)
+        out[i] = t[i];
+}
+
+void uvgrtp::crypto::builtin::montgomery::exp(uint32_t *out, const uint32_t *base,
+                                              const uint32_t *exp, size_t exp_limbs) const
+{
+    size_t s = n_.size();
+    std::vector<uint32_t> one(s, 0), x(s), b(s), t(s);
+
+    one[0] = 1;
+
+    mul(x.data(), one.data(), r2_.data()); /* 1 in Montgomery form */
+    mul(b.data(), base, r2_.data());
+
+    for (size_t i = exp_limbs * 32; i-- > 0; ) {
+        uint32_t mask = (uint32_t)0 - ((exp[i / 32] >> (i % 32)) & 1);
+
+        mul(x.data(), x.data(), x.data());
+        mul(t.data(), x.data(), b.data());
+
+        for (size_t k = 0; k < s; ++k)
+            x[k] = (t[k] & mask) | (x[k] & ~mask);
+    }
+
+    mul(out, x.data(), one.data());
+}
+
+void uvgrtp::crypto::builtin::from_bytes(uint32_t *out, size_t limbs, const uint8_t *in, size_t len)
+{
+    for (size_t i = 0; i < limbs; ++i)
+        out[i] = 0;
+
+    for (size_t i = 0; i < len && i < limbs * 4; ++i)
+        out[i / 4] |= (uint32_t)in[len - 1 - i] << (8 * (i % 4));
+}
+
+void uvgrtp::crypto::builtin::to_bytes(uint8_t *out, size_t len, const uint32_t *in, size_t limbs)
+{
+    for (size_t i = 0; i < len; ++i)
+        out[len - 1 - i] = (i < limbs * 4) ? (uint8_t)(in[i / 4] >> (8 * (i % 4))) : 0;
+}
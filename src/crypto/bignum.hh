@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace uvgrtp {
+    namespace crypto {
+        namespace builtin {
+
+            /* Modular exponentiation with Montgomery multiplication for finite field Diffie-Hellman
+             *
+             * Numbers are arrays of 32-bit limbs, least significant limb first,
+             * and they must be smaller than the modulus which must be odd */
+            class montgomery {
+                public:
+                    montgomery(const uint32_t *modulus, size_t limbs);
+
+                    size_t limbs() const;
+
+                    /* out = base ^ exp mod modulus where "exp" has "exp_limbs" limbs
+                     *
+                     * The exponent is processed with square-and-multiply-always
+                     * so that the running time does not depend on its bits */
+                    void exp(uint32_t *out, const uint32_t *base, const uint32_t *exp, size_t exp_limbs) const;
+
+                private:
+                    /* out = a * b * R^-1 mod modulus, "out" may alias "a" or "b" */
+                    void mul(uint32_t *out, const uint32_t *a, const uint32_t *b) const;
+
+                    std::vector<uint32_t> n_;
+                    std::vector<uint32_t> r2_;
+                    uint32_t n0inv_;
+            };
+
+            /* Convert big-endian bytes to limbs and back */
+            void from_bytes(uint32_t *out, size_t limbs, const uint8_t *in, size_t len);
+            void to_bytes(uint8_t *out, size_t len, const uint32_t *in, size_t limbs);
+        }
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,722 @@
+#include "uvgrtp/crypto.hh"
+
+#ifdef __RTP_CRYPTO_BUILTIN__
+
+#include "aes.hh"
+#include "bignum.hh"
+#include "cpu.hh"
+#include "ec.hh"
+#include "endian.hh"
+#include "sha.hh"
+
+#include "../random.hh"
+
+#include "uvgrtp/debug.hh"
+
+#include <cstring>
+#include <string>
+
+#define DH3K_LIMBS        96
+#define DH3K_SECRET_LIMBS 16
+
+/* HMAC (RFC 2104) over SHA-1 or SHA-256. The hash states after the inner and the outer
+ * padded key are saved so that each message costs only the message and two blocks */
+template <typename Hash>
+class hmac_state {
+    public:
+        hmac_state(const uint8_t *key, size_t key_size)
+        {
+            uint8_t k[Hash::BLOCK_SIZE] = { 0 };
+            uint8_t pad[Hash::BLOCK_SIZE];
+
+            if (key_size > Hash::BLOCK_SIZE) {
+                Hash h;
+                h.update(key, key_size);
+                h.final(k);
+            } else {
+                memcpy(k, key, key_size);
+            }
+
+            for (size_t i = 0; i < Hash::BLOCK_SIZE; ++i)
+                pad[i] = k[i] ^ 0x36;
+            inner_.update(pad, Hash::BLOCK_SIZE);
+
+            for (size_t i = 0; i < Hash::BLOCK_SIZE; ++i)
+                pad[i] = k[i] ^ 0x5c;
+            outer_.update(pad, Hash::BLOCK_SIZE);
+
+            msg_ = inner_;
+        }
+
+        void update(const uint8_t *data, size_t len)
+        {
+            msg_.update(data, len);
+        }
+
+        void final(uint8_t *digest)
+        {
+            uint8_t inner[Hash::DIGEST_SIZE];
+            Hash outer = outer_;
+
+            msg_.final(inner);
+            outer.update(inner, Hash::DIGEST_SIZE);
+            outer.final(digest);
+
+            msg_ = inner_;
+        }
+
+    private:
+        Hash inner_;
+        Hash outer_;
+        Hash msg_;
+};
+
+/* Keystream of counter mode that can be consumed in pieces of any size */
+struct ctr_stream {
+    uint8_t counter[16] = { 0 };
+    uint8_t ks[16]      = { 0 };
+    size_t pos          = 16;
+
+    void reset(const uint8_t *iv)
+    {
+        memcpy(counter, iv, sizeof(counter));
+        pos = 16;
+    }
+
+    void process(const uvgrtp::crypto::builtin::aes& aes, uint8_t *out, const uint8_t *in, size_t len, bool inc32)
+    {
+        while (pos < 16 && len) {
+            *out++ = *in++ ^ ks[pos++];
+            --len;
+        }
+
+        if (len >= 16) {
+            aes.ctr_xor(counter, in, out, len / 16, inc32);
+            in  += len - len % 16;
+            out += len - len % 16;
+            len %= 16;
+        }
+
+        if (len) {
+            uint8_t zero[16] = { 0 };
+
+            aes.ctr_xor(counter, zero, ks, 1, inc32);
+
+            for (pos = 0; pos < len; ++pos)
+                out[pos] = in[pos] ^ ks[pos];
+        }
+    }
+};
+
+/* ***************** hmac-sha1 ***************** */
+
+struct uvgrtp::crypto::hmac::sha1::impl {
+    impl(const uint8_t *key, size_t key_size):
+        hmac(key, key_size)
+    {
+    }
+
+    hmac_state<uvgrtp::crypto::builtin::sha1_state> hmac;
+};
+
+uvgrtp::crypto::hmac::sha1::sha1(const uint8_t *key, size_t key_size):
+    impl_(new impl(key, key_size))
+{
+}
+
+uvgrtp::crypto::hmac::sha1::~sha1()
+{
+}
+
+void uvgrtp::crypto::hmac::sha1::update(const uint8_t *data, size_t len)
+{
+    impl_->hmac.update(data, len);
+}
+
+void uvgrtp::crypto::hmac::sha1::final(uint8_t *digest)
+{
+    impl_->hmac.final(digest);
+}
+
+void uvgrtp::crypto::hmac::sha1::final(uint8_t *digest, size_t size)
+{
+    uint8_t d[uvgrtp::crypto::builtin::sha1_state::DIGEST_SIZE] = { 0 };
+
+    impl_->hmac.final(d);
+    memcpy(digest, d, size);
+}
+
+/* ***************** hmac-sha256 ***************** */
+
+struct uvgrtp::crypto::hmac::sha256::impl {
+    impl(const uint8_t *key, size_t key_size):
+        hmac(key, key_size)
+    {
+    }
+
+    hmac_state<uvgrtp::crypto::builtin::sha256_state> hmac;
+};
+
+uvgrtp::crypto::hmac::sha256::sha256(const uint8_t *key, size_t key_size):
+    impl_(new impl(key, key_size))
+{
+}
+
+uvgrtp::crypto::hmac::sha256::~sha256()
+{
+}
+
+void uvgrtp::crypto::hmac::sha256::update(const uint8_t *data, size_t len)
+{
+    impl_->hmac.update(data, len);
+}
+
+void uvgrtp::crypto::hmac::sha256::final(uint8_t *digest)
+{
+    impl_->hmac.final(digest);
+}
+
+/* ***************** sha256 ***************** */
+
+struct uvgrtp::crypto::sha256::impl {
+    uvgrtp::crypto::builtin::sha256_state sha;
+};
+
+uvgrtp::crypto::sha256::sha256():
+    impl_(new impl())
+{
+}
+
+uvgrtp::crypto::sha256::~sha256()
+{
+}
+
+void uvgrtp::crypto::sha256::update(const uint8_t *data, size_t len)
+{
+    impl_->sha.update(data, len);
+}
+
+void uvgrtp::crypto::sha256::final(uint8_t *digest)
+{
+    impl_->sha.final(digest);
+}
+
+/* ***************** aes-128 ***************** */
+
+struct uvgrtp::crypto::aes::ctr::impl {
+    uvgrtp::crypto::builtin::aes aes;
+    ctr_stream stream;
+};
+
+uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size):
+    impl_(new impl())
+{
+    impl_->aes.set_key(key, key_size);
+}
+
+uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size, const uint8_t *iv):
+    impl_(new impl())
+{
+    impl_->aes.set_key(key, key_size);
+    impl_->stream.reset(iv);
+}
+
+uvgrtp::crypto::aes::ctr::~ctr()
+{
+}
+
+void uvgrtp::crypto::aes::ctr::set_iv(const uint8_t *iv)
+{
+    impl_->stream.reset(iv);
+}
+
+void uvgrtp::crypto::aes::ctr::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    impl_->stream.process(impl_->aes, output, input, len, false);
+}
+
+void uvgrtp::crypto::aes::ctr::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    /* the keystream is XORed with the input in both directions */
+    impl_->stream.process(impl_->aes, output, input, len, false);
+}
+
+struct uvgrtp::crypto::aes::gcm::impl {
+    uvgrtp::crypto::builtin::aes aes;
+    uvgrtp::crypto::builtin::ghash ghash;
+    ctr_stream stream;
+
+    uint8_t j0[16]  = { 0 };
+    uint8_t y[16]   = { 0 };
+    uint8_t buf[16] = { 0 };
+    size_t buf_len  = 0;
+    uint64_t aad_len  = 0;
+    uint64_t data_len = 0;
+    bool in_data = false;
+
+    void init(const uint8_t *iv, size_t iv_len)
+    {
+        memset(y, 0, sizeof(y));
+
+        if (iv_len == 12) {
+            memcpy(j0, iv, 12);
+            uvgrtp::crypto::builtin::store_be32(j0 + 12, 1);
+        } else {
+            uint8_t len_block[16] = { 0 };
+
+            buf_len = 0;
+            absorb(iv, iv_len);
+            flush();
+
+            uvgrtp::crypto::builtin::store_be64(len_block + 8, (uint64_t)iv_len * 8);
+            ghash.update(y, len_block, 1);
+
+            memcpy(j0, y, sizeof(j0));
+            memset(y, 0, sizeof(y));
+        }
+
+        /* J0 is reserved for the tag, encryption starts from inc32(J0) */
+        uint8_t icb[16];
+
+        memcpy(icb, j0, sizeof(icb));
+        uvgrtp::crypto::builtin::store_be32(icb + 12, uvgrtp::crypto::builtin::load_be32(j0 + 12) + 1);
+        stream.reset(icb);
+
+        buf_len  = 0;
+        aad_len  = 0;
+        data_len = 0;
+        in_data  = false;
+    }
+
+    /* feed bytes to GHASH, buffering partial blocks */
+    void absorb(const uint8_t *data, size_t len)
+    {
+        if (buf_len) {
+            while (buf_len < 16 && len) {
+                buf[buf_len++] = *data++;
+                --len;
+            }
+
+            if (buf_len < 16)
+                return;
+
+            ghash.update(y, buf, 1);
+            buf_len = 0;
+        }
+
+        if (len >= 16) {
+            ghash.update(y, data, len / 16);
+            data += len - len % 16;
+            len  %= 16;
+        }
+
+        memcpy(buf, data, len);
+        buf_len = len;
+    }
+
+    /* pad the last partial block with zeros */
+    void flush()
+    {
+        if (buf_len) {
+            memset(buf + buf_len, 0, 16 - buf_len);
+            ghash.update(y, buf, 1);
+            buf_len = 0;
+        }
+    }
+
+    void start_data()
+    {
+        if (!in_data) {
+            flush();
+            in_data = true;
+        }
+    }
+
+    void tag(uint8_t *out)
+    {
+        uint8_t len_block[16];
+
+        start_data();
+        flush();
+
+        uvgrtp::crypto::builtin::store_be64(len_block,     aad_len * 8);
+        uvgrtp::crypto::builtin::store_be64(len_block + 8, data_len * 8);
+        ghash.update(y, len_block, 1);
+
+        aes.encrypt_block(j0, out);
+
+        for (int i = 0; i < 16; ++i)
+            out[i] ^= y[i];
+    }
+};
+
+uvgrtp::crypto::aes::gcm::gcm(const uint8_t *key, size_t key_size):
+    impl_(new impl())
+{
+    uint8_t h[16] = { 0 };
+
+    impl_->aes.set_key(key, key_size);
+    impl_->aes.encrypt_block(h, h);
+    impl_->ghash.set_key(h);
+}
+
+uvgrtp::crypto::aes::gcm::~gcm()
+{
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt_init(const uint8_t *iv, size_t iv_len)
+{
+    impl_->init(iv, iv_len);
+}
+
+void uvgrtp::crypto::aes::gcm::decrypt_init(const uint8_t *iv, size_t iv_len)
+{
+    impl_->init(iv, iv_len);
+}
+
+void uvgrtp::crypto::aes::gcm::update_aad(const uint8_t *data, size_t len)
+{
+    impl_->absorb(data, len);
+    impl_->aad_len += len;
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    impl_->start_data();
+    impl_->stream.process(impl_->aes, output, input, len, true);
+    impl_->absorb(output, len);
+    impl_->data_len += len;
+}
+
+void uvgrtp::crypto::aes::gcm::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    /* the ciphertext is authenticated so it must be hashed before it's overwritten */
+    impl_->start_data();
+    impl_->absorb(input, len);
+    impl_->stream.process(impl_->aes, output, input, len, true);
+    impl_->data_len += len;
+}
+
+void uvgrtp::crypto::aes::gcm::final(uint8_t *tag, size_t size)
+{
+    uint8_t t[16];
+
+    impl_->tag(t);
+    memcpy(tag, t, size);
+}
+
+bool uvgrtp::crypto::aes::gcm::verify(const uint8_t *tag, size_t size)
+{
+    uint8_t t[16];
+    uint8_t diff = 0;
+
+    impl_->tag(t);
+
+    for (size_t i = 0; i < size; ++i)
+        diff |= t[i] ^ tag[i];
+
+    return diff == 0;
+}
+
+struct uvgrtp::crypto::aes::cfb::impl {
+    uvgrtp::crypto::builtin::aes aes;
+
+    /* the previous ciphertext block (initially the IV) and its encryption */
+    uint8_t reg[16] = { 0 };
+    uint8_t ks[16]  = { 0 };
+    size_t pos      = 16;
+};
+
+uvgrtp::crypto::aes::cfb::cfb(const uint8_t *key, size_t key_size, const uint8_t *iv):
+    impl_(new impl())
+{
+    impl_->aes.set_key(key, key_size);
+    memcpy(impl_->reg, iv, sizeof(impl_->reg));
+}
+
+uvgrtp::crypto::aes::cfb::~cfb()
+{
+}
+
+void uvgrtp::crypto::aes::cfb::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        if (impl_->pos == 16) {
+            impl_->aes.encrypt_block(impl_->reg, impl_->ks);
+            impl_->pos = 0;
+        }
+
+        uint8_t c = input[i] ^ impl_->ks[impl_->pos];
+
+        impl_->reg[impl_->pos++] = c;
+        output[i] = c;
+    }
+}
+
+void uvgrtp::crypto::aes::cfb::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        if (impl_->pos == 16) {
+            impl_->aes.encrypt_block(impl_->reg, impl_->ks);
+            impl_->pos = 0;
+        }
+
+        uint8_t c = input[i];
+
+        output[i] = c ^ impl_->ks[impl_->pos];
+        impl_->reg[impl_->pos++] = c;
+    }
+}
+
+struct uvgrtp::crypto::aes::ecb::impl {
+    uvgrtp::crypto::builtin::aes aes;
+};
+
+uvgrtp::crypto::aes::ecb::ecb(const uint8_t *key, size_t key_size):
+    impl_(new impl())
+{
+    impl_->aes.set_key(key, key_size);
+}
+
+uvgrtp::crypto::aes::ecb::~ecb()
+{
+}
+
+void uvgrtp::crypto::aes::ecb::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    impl_->aes.encrypt_blocks(input, output, len / 16);
+}
+
+void uvgrtp::crypto::aes::ecb::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    impl_->aes.decrypt_blocks(input, output, len / 16);
+}
+
+/* ***************** diffie-hellman 3072 ***************** */
+
+/* 3072-bit MODP group of RFC 3526 with generator 2 */
+static const char DH3K_PRIME[] =
+    "FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD1"
+    "29024E088A67CC74020BBEA63B139B22514A08798E3404DD"
+    "EF9519B3CD3A431B302B0A6DF25F14374FE1356D6D51C245"
+    "E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+    "EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3D"
+    "C2007CB8A163BF0598DA48361C55D39A69163FA8FD24CF5F"
+    "83655D23DCA3AD961C62F356208552BB9ED529077096966D"
+    "670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+    "E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9"
+    "DE2BCBF6955817183995497CEA956AE515D2261898FA0510"
+    "15728E5A8AAAC42DAD33170D04507A33A85521ABDF1CBA64"
+    "ECFB850458DBEF0A8AEA71575D060C7DB3970F85A6E1E4C7"
+    "ABF5AE8CDB0933D71E8C94E04A25619DCEE3D2261AD2EE6B"
+    "F12FFA06D98A0864D87602733EC86A64521F2B18177B200C"
+    "BBE117577A615D6C770988C0BAD946E208E24FA074E5AB31"
+    "43DB5BFCE0FD108E4B82D120A93AD2CAFFFFFFFFFFFFFFFF";
+
+static const uvgrtp::crypto::builtin::montgomery& dh3k_group()
+{
+    static const uvgrtp::crypto::builtin::montgomery group([] {
+        uint32_t p[DH3K_LIMBS] = { 0 };
+        size_t digits = sizeof(DH3K_PRIME) - 1;
+
+        for (size_t i = 0; i < digits; ++i) {
+            char c    = DH3K_PRIME[digits - 1 - i];
+            uint32_t v = (c >= 'A') ? (uint32_t)(c - 'A' + 10) : (uint32_t)(c - '0');
+
+            p[i / 8] |= v << (4 * (i % 8));
+        }
+
+        return uvgrtp::crypto::builtin::montgomery(p, DH3K_LIMBS);
+    }());
+
+    return group;
+}
+
+struct uvgrtp::crypto::dh::impl {
+    uint32_t sk[DH3K_SECRET_LIMBS] = { 0 };
+    uint32_t pk[DH3K_LIMBS]        = { 0 };
+    uint32_t rpk[DH3K_LIMBS]       = { 0 };
+};
+
+uvgrtp::crypto::dh::dh():
+    impl_(new impl())
+{
+}
+
+uvgrtp::crypto::dh::~dh()
+{
+}
+
+void uvgrtp::crypto::dh::generate_keys()
+{
+    /* RFC 6189 requires the secret exponent to be twice as long as the AES key,
+     * 512 bits covers AES-256 and is far cheaper than a full-length exponent */
+    uint32_t g[DH3K_LIMBS] = { 2 };
+
+    uvgrtp::crypto::random::generate_random((uint8_t *)impl_->sk, sizeof(impl_->sk));
+    dh3k_group().exp(impl_->pk, g, impl_->sk, DH3K_SECRET_LIMBS);
+}
+
+void uvgrtp::crypto::dh::get_pk(uint8_t *pk, size_t len)
+{
+    uvgrtp::crypto::builtin::to_bytes(pk, len, impl_->pk, DH3K_LIMBS);
+}
+
+void uvgrtp::crypto::dh::set_remote_pk(uint8_t *pk, size_t len)
+{
+    uvgrtp::crypto::builtin::from_bytes(impl_->rpk, DH3K_LIMBS, pk, len);
+}
+
+void uvgrtp::crypto::dh::get_shared_secret(uint8_t *ss, size_t len)
+{
+    uint32_t result[DH3K_LIMBS];
+
+    dh3k_group().exp(result, impl_->rpk, impl_->sk, DH3K_SECRET_LIMBS);
+    uvgrtp::crypto::builtin::to_bytes(ss, len, result, DH3K_LIMBS);
+}
+
+/* ***************** elliptic curve diffie-hellman ***************** */
+
+struct uvgrtp::crypto::ecdh::p256::impl {
+    uint8_t sk[32]  = { 0 };
+    uint8_t pk[64]  = { 0 };
+    uint8_t rpk[64] = { 0 };
+    bool remote_set = false;
+};
+
+uvgrtp::crypto::ecdh::p256::p256():
+    impl_(new impl())
+{
+}
+
+uvgrtp::crypto::ecdh::p256::~p256()
+{
+}
+
+void uvgrtp::crypto::ecdh::p256::generate_keys()
+{
+    do {
+        uvgrtp::crypto::random::generate_random(impl_->sk, sizeof(impl_->sk));
+    } while (!uvgrtp::crypto::builtin::p256_valid_scalar(impl_->sk));
+
+    (void)uvgrtp::crypto::builtin::p256_mul(impl_->pk, impl_->sk, nullptr);
+}
+
+void uvgrtp::crypto::ecdh::p256::get_pk(uint8_t *pk, size_t len)
+{
+    memcpy(pk, impl_->pk, len < PK_SIZE ? len : PK_SIZE);
+}
+
+bool uvgrtp::crypto::ecdh::p256::set_remote_pk(const uint8_t *pk, size_t len)
+{
+    impl_->remote_set = (len == PK_SIZE) && uvgrtp::crypto::builtin::p256_valid_point(pk);
+
+    if (impl_->remote_set)
+        memcpy(impl_->rpk, pk, PK_SIZE);
+
+    return impl_->remote_set;
+}
+
+bool uvgrtp::crypto::ecdh::p256::get_shared_secret(uint8_t *ss, size_t len)
+{
+    uint8_t point[PK_SIZE];
+
+    if (!impl_->remote_set || !uvgrtp::crypto::builtin::p256_mul(point, impl_->sk, impl_->rpk))
+        return false;
+
+    memcpy(ss, point, len < SS_SIZE ? len : SS_SIZE);
+    return true;
+}
+
+struct uvgrtp::crypto::ecdh::x25519::impl {
+    uint8_t sk[32]  = { 0 };
+    uint8_t pk[32]  = { 0 };
+    uint8_t rpk[32] = { 0 };
+    bool remote_set = false;
+};
+
+uvgrtp::crypto::ecdh::x25519::x25519():
+    impl_(new impl())
+{
+}
+
+uvgrtp::crypto::ecdh::x25519::~x25519()
+{
+}
+
+void uvgrtp::crypto::ecdh::x25519::generate_keys()
+{
+    const uint8_t base[32] = { 9 };
+
+    uvgrtp::crypto::random::generate_random(impl_->sk, sizeof(impl_->sk));
+    uvgrtp::crypto::builtin::x25519(impl_->pk, impl_->sk, base);
+}
+
+void uvgrtp::crypto::ecdh::x25519::get_pk(uint8_t *pk, size_t len)
+{
+    memcpy(pk, impl_->pk, len < PK_SIZE ? len : PK_SIZE);
+}
+
+bool uvgrtp::crypto::ecdh::x25519::set_remote_pk(const uint8_t *pk, size_t len)
+{
+    impl_->remote_set = (len == PK_SIZE);
+
+    if (impl_->remote_set)
+        memcpy(impl_->rpk, pk, PK_SIZE);
+
+    return impl_->remote_set;
+}
+
+bool uvgrtp::crypto::ecdh::x25519::get_shared_secret(uint8_t *ss, size_t len)
+{
+    uint8_t result[SS_SIZE];
+    uint8_t acc = 0;
+
+    if (!impl_->remote_set)
+        return false;
+
+    uvgrtp::crypto::builtin::x25519(result, impl_->sk, impl_->rpk);
+
+    /* RFC 7748 section 6.1, an all-zero result means the remote key had a small order */
+    for (size_t i = 0; i < SS_SIZE; ++i)
+        acc |= result[i];
+
+    memcpy(ss, result, len < SS_SIZE ? len : SS_SIZE);
+    return acc != 0;
+}
+
+/* ***************** random ***************** */
+
+void uvgrtp::crypto::random::generate_random(uint8_t *out, size_t len)
+{
+    /* The OS returns up to 256 bytes at once without blocking or being interrupted */
+    for (size_t off = 0; off < len; off += 256) {
+        size_t n = (len - off) < 256 ? (len - off) : 256;
+
+        if (uvgrtp::random::generate(out + off, n) < 0) {
+            LOG_ERROR("Failed to get random bytes from the operating system!");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+const char *uvgrtp::crypto::backend()
+{
+    static const std::string name = [] {
+        std::string extensions;
+
+        if (uvgrtp::crypto::cpu::has_aesni())
+            extensions += ", AES-NI";
+        if (uvgrtp::crypto::cpu::has_pclmul())
+            extensions += ", PCLMULQDQ";
+        if (uvgrtp::crypto::cpu::has_sha())
+            extensions += ", SHA-NI";
+
+        return extensions.empty() ? std::string("built-in (portable)")
+                                  : "built-in (" + extensions.substr(2) + ")";
+    }();
+
+    return name.c_str();
+}
+
+#endif // __RTP_CRYPTO_BUILTIN__
@@ -0,0 +1,76 @@
+#include "cpu.hh"
+
+#ifdef UVG_CRYPTO_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#include <cstdint>
+
+struct cpu_features {
+    bool aesni  = false;
+    bool pclmul = false;
+    bool sha    = false;
+
+    cpu_features()
+    {
+#ifdef UVG_CRYPTO_X86
+        uint32_t leaf1[4] = { 0 };
+        uint32_t leaf7[4] = { 0 };
+
+#ifdef _MSC_VER
+        int regs[4];
+
+        __cpuid(regs, 0);
+        int max_leaf = regs[0];
+
+        __cpuid(regs, 1);
+        for (int i = 0; i < 4; ++i)
+            leaf1[i] = (uint32_t)regs[i];
+
+        if (max_leaf >= 7) {
+            __cpuidex(regs, 7, 0);
+            for (int i = 0; i < 4; ++i)
+                leaf7[i] = (uint32_t)regs[i];
+        }
+#else
+        unsigned max_leaf = __get_cpuid_max(0, nullptr);
+
+        __get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+
+        if (max_leaf >= 7)
+            __cpuid_count(7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3]);
+#endif
+        bool ssse3  = (leaf1[2] >> 9)  & 1;
+        bool sse41  = (leaf1[2] >> 19) & 1;
+
+        aesni  = ((leaf1[2] >> 25) & 1);
+        pclmul = ((leaf1[2] >> 1)  & 1) && ssse3;
+        sha    = ((leaf7[1] >> 29) & 1) && ssse3 && sse41;
+#endif
+    }
+};
+
+static const cpu_features& features()
+{
+    static const cpu_features f;
+    return f;
+}
+
+bool uvgrtp::crypto::cpu::has_aesni()
+{
+    return features().aesni;
+}
+
+bool uvgrtp::crypto::cpu::has_pclmul()
+{
+    return features().pclmul;
+}
+
+bool uvgrtp::crypto::cpu::has_sha()
+{
+    return features().sha;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+/* The built-in crypto backend has code paths for the AES-NI, PCLMULQDQ and SHA extensions
+ * of x86 CPUs. These functions are compiled with function-specific target attributes so
+ * that the rest of uvgRTP still runs on CPUs without the extensions and the extensions
+ * are detected at runtime. Compile with -D__RTP_NO_CRYPTO_INTRINSICS__ to use only the
+ * portable code */
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)) && \
+    !defined(__RTP_NO_CRYPTO_INTRINSICS__)
+#define UVG_CRYPTO_X86
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define UVG_TARGET(features) __attribute__((target(features)))
+#else
+#define UVG_TARGET(features)
+#endif
+
+namespace uvgrtp {
+    namespace crypto {
+        namespace cpu {
+
+            /* Return true if the CPU supports AES-NI */
+            bool has_aesni();
+
+            /* Return true if the CPU supports PCLMULQDQ and SSSE3 */
+            bool has_pclmul();
+
+            /* Return true if the CPU supports the SHA extensions, SSSE3 and SSE4.1 */
+            bool has_sha();
+        }
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
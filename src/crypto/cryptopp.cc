@@ -0,0 +1,472 @@
+#include "uvgrtp/crypto.hh"
+
+#ifdef __RTP_CRYPTO_CRYPTOPP__
+
+#include <cryptopp/aes.h>
+#include <cryptopp/cryptlib.h>
+#include <cryptopp/dh.h>
+#include <cryptopp/eccrypto.h>
+#include <cryptopp/gcm.h>
+#include <cryptopp/hmac.h>
+#include <cryptopp/modes.h>
+#include <cryptopp/oids.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/sha.h>
+#include <cryptopp/xed25519.h>
+
+#include <cstring>
+
+/* ***************** hmac-sha1 ***************** */
+
+struct uvgrtp::crypto::hmac::sha1::impl {
+    impl(const uint8_t *key, size_t key_size):
+        hmac(key, key_size)
+    {
+    }
+
+    CryptoPP::HMAC<CryptoPP::SHA1> hmac;
+};
+
+uvgrtp::crypto::hmac::sha1::sha1(const uint8_t *key, size_t key_size):
+    impl_(new impl(key, key_size))
+{
+}
+
+uvgrtp::crypto::hmac::sha1::~sha1()
+{
+}
+
+void uvgrtp::crypto::hmac::sha1::update(const uint8_t *data, size_t len)
+{
+    impl_->hmac.Update(data, len);
+}
+
+void uvgrtp::crypto::hmac::sha1::final(uint8_t *digest)
+{
+    impl_->hmac.Final(digest);
+}
+
+void uvgrtp::crypto::hmac::sha1::final(uint8_t *digest, size_t size)
+{
+    uint8_t d[20] = { 0 };
+
+    impl_->hmac.Final(d);
+    memcpy(digest, d, size);
+}
+
+/* ***************** hmac-sha256 ***************** */
+
+struct uvgrtp::crypto::hmac::sha256::impl {
+    impl(const uint8_t *key, size_t key_size):
+        hmac(key, key_size)
+    {
+    }
+
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac;
+};
+
+uvgrtp::crypto::hmac::sha256::sha256(const uint8_t *key, size_t key_size):
+    impl_(new impl(key, key_size))
+{
+}
+
+uvgrtp::crypto::hmac::sha256::~sha256()
+{
+}
+
+void uvgrtp::crypto::hmac::sha256::update(const uint8_t *data, size_t len)
+{
+    impl_->hmac.Update(data, len);
+}
+
+void uvgrtp::crypto::hmac::sha256::final(uint8_t *digest)
+{
+    impl_->hmac.Final(digest);
+}
+
+/* ***************** sha256 ***************** */
+
+struct uvgrtp::crypto::sha256::impl {
+    CryptoPP::SHA256 sha;
+};
+
+uvgrtp::crypto::sha256::sha256():
+    impl_(new impl())
+{
+}
+
+uvgrtp::crypto::sha256::~sha256()
+{
+}
+
+void uvgrtp::crypto::sha256::update(const uint8_t *data, size_t len)
+{
+    impl_->sha.Update(data, len);
+}
+
+void uvgrtp::crypto::sha256::final(uint8_t *digest)
+{
+    impl_->sha.Final(digest);
+}
+
+/* ***************** aes-128 ***************** */
+
+struct uvgrtp::crypto::aes::ctr::impl {
+    CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption enc;
+};
+
+uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size):
+    impl_(new impl())
+{
+    const uint8_t iv[CryptoPP::AES::BLOCKSIZE] = { 0 };
+
+    impl_->enc.SetKeyWithIV(key, key_size, iv);
+}
+
+uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size, const uint8_t *iv):
+    impl_(new impl())
+{
+    impl_->enc.SetKeyWithIV(key, key_size, iv);
+}
+
+uvgrtp::crypto::aes::ctr::~ctr()
+{
+}
+
+void uvgrtp::crypto::aes::ctr::set_iv(const uint8_t *iv)
+{
+    impl_->enc.Resynchronize(iv);
+}
+
+void uvgrtp::crypto::aes::ctr::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    impl_->enc.ProcessData(output, input, len);
+}
+
+void uvgrtp::crypto::aes::ctr::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    /* the keystream is XORed with the input in both directions */
+    impl_->enc.ProcessData(output, input, len);
+}
+
+struct uvgrtp::crypto::aes::gcm::impl {
+    bool decrypting = false;
+    CryptoPP::GCM<CryptoPP::AES>::Encryption enc;
+    CryptoPP::GCM<CryptoPP::AES>::Decryption dec;
+};
+
+uvgrtp::crypto::aes::gcm::gcm(const uint8_t *key, size_t key_size):
+    impl_(new impl())
+{
+    const uint8_t iv[12] = { 0 };
+
+    impl_->enc.SetKeyWithIV(key, key_size, iv, sizeof(iv));
+    impl_->dec.SetKeyWithIV(key, key_size, iv, sizeof(iv));
+}
+
+uvgrtp::crypto::aes::gcm::~gcm()
+{
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt_init(const uint8_t *iv, size_t iv_len)
+{
+    impl_->decrypting = false;
+    impl_->enc.Resynchronize(iv, (int)iv_len);
+}
+
+void uvgrtp::crypto::aes::gcm::decrypt_init(const uint8_t *iv, size_t iv_len)
+{
+    impl_->decrypting = true;
+    impl_->dec.Resynchronize(iv, (int)iv_len);
+}
+
+void uvgrtp::crypto::aes::gcm::update_aad(const uint8_t *data, size_t len)
+{
+    if (impl_->decrypting)
+        impl_->dec.Update(data, len);
+    else
+        impl_->enc.Update(data, len);
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    impl_->enc.ProcessData(output, input, len);
+}
+
+void uvgrtp::crypto::aes::gcm::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    impl_->dec.ProcessData(output, input, len);
+}
+
+void uvgrtp::crypto::aes::gcm::final(uint8_t *tag, size_t size)
+{
+    impl_->enc.TruncatedFinal(tag, size);
+}
+
+bool uvgrtp::crypto::aes::gcm::verify(const uint8_t *tag, size_t size)
+{
+    return impl_->dec.TruncatedVerify(tag, size);
+}
+
+struct uvgrtp::crypto::aes::cfb::impl {
+    impl(const uint8_t *key, size_t key_size, const uint8_t *iv):
+        enc(key, key_size, iv),
+        dec(key, key_size, iv)
+    {
+    }
+
+    CryptoPP::CFB_Mode<CryptoPP::AES>::Encryption enc;
+    CryptoPP::CFB_Mode<CryptoPP::AES>::Decryption dec;
+};
+
+uvgrtp::crypto::aes::cfb::cfb(const uint8_t *key, size_t key_size, const uint8_t *iv):
+    impl_(new impl(key, key_size, iv))
+{
+}
+
+uvgrtp::crypto::aes::cfb::~cfb()
+{
+}
+
+void uvgrtp::crypto::aes::cfb::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    impl_->enc.ProcessData(output, input, len);
+}
+
+void uvgrtp::crypto::aes::cfb::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    impl_->dec.ProcessData(output, input, len);
+}
+
+struct uvgrtp::crypto::aes::ecb::impl {
+    impl(const uint8_t *key, size_t key_size):
+        enc(key, key_size),
+        dec(key, key_size)
+    {
+    }
+
+    CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption enc;
+    CryptoPP::ECB_Mode<CryptoPP::AES>::Decryption dec;
+};
+
+uvgrtp::crypto::aes::ecb::ecb(const uint8_t *key, size_t key_size):
+    impl_(new impl(key, key_size))
+{
+}
+
+uvgrtp::crypto::aes::ecb::~ecb()
+{
+}
+
+void uvgrtp::crypto::aes::ecb::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    impl_->enc.ProcessData(output, input, len);
+}
+
+void uvgrtp::crypto::aes::ecb::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    impl_->dec.ProcessData(output, input, len);
+}
+
+/* ***************** diffie-hellman 3072 ***************** */
+
+static const CryptoPP::Integer& dh3k_prime()
+{
+    static const CryptoPP::Integer p(
+        "0xFFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD1"
+        "29024E088A67CC74020BBEA63B139B22514A08798E3404DD"
+        "EF9519B3CD3A431B302B0A6DF25F14374FE1356D6D51C245"
+        "E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+        "EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3D"
+        "C2007CB8A163BF0598DA48361C55D39A69163FA8FD24CF5F"
+        "83655D23DCA3AD961C62F356208552BB9ED529077096966D"
+        "670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+        "E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9"
+        "DE2BCBF6955817183995497CEA956AE515D2261898FA0510"
+        "15728E5A8AAAC42DAD33170D04507A33A85521ABDF1CBA64"
+        "ECFB850458DBEF0A8AEA71575D060C7DB3970F85A6E1E4C7"
+        "ABF5AE8CDB0933D71E8C94E04A25619DCEE3D2261AD2EE6B"
+        "F12FFA06D98A0864D87602733EC86A64521F2B18177B200C"
+        "BBE117577A615D6C770988C0BAD946E208E24FA074E5AB31"
+        "43DB5BFCE0FD108E4B82D120A93AD2CAFFFFFFFFFFFFFFFF"
+    );
+
+    return p;
+}
+
+struct uvgrtp::crypto::dh::impl {
+    CryptoPP::AutoSeededRandomPool prng;
+    CryptoPP::DH dh;
+    CryptoPP::Integer sk, pk, rpk;
+};
+
+uvgrtp::crypto::dh::dh():
+    impl_(new impl())
+{
+    impl_->dh.AccessGroupParameters().Initialize(dh3k_prime(), CryptoPP::Integer("0x02"));
+}
+
+uvgrtp::crypto::dh::~dh()
+{
+}
+
+void uvgrtp::crypto::dh::generate_keys()
+{
+    CryptoPP::SecByteBlock t1(impl_->dh.PrivateKeyLength()), t2(impl_->dh.PublicKeyLength());
+    impl_->dh.GenerateKeyPair(impl_->prng, t1, t2);
+
+    impl_->sk = CryptoPP::Integer(t1, t1.size());
+    impl_->pk = CryptoPP::Integer(t2, t2.size());
+}
+
+void uvgrtp::crypto::dh::get_pk(uint8_t *pk, size_t len)
+{
+    impl_->pk.Encode(pk, len);
+}
+
+void uvgrtp::crypto::dh::set_remote_pk(uint8_t *pk, size_t len)
+{
+    impl_->rpk.Decode(pk, len);
+}
+
+void uvgrtp::crypto::dh::get_shared_secret(uint8_t *ss, size_t len)
+{
+    CryptoPP::ModularArithmetic ma(dh3k_prime());
+    CryptoPP::Integer dhres = ma.Exponentiate(impl_->rpk, impl_->sk);
+
+    dhres.Encode(ss, len);
+}
+
+/* ***************** elliptic curve diffie-hellman ***************** */
+
+struct uvgrtp::crypto::ecdh::p256::impl {
+    impl():
+        domain(CryptoPP::ASN1::secp256r1()),
+        sk(domain.PrivateKeyLength()),
+        pk(domain.PublicKeyLength()),
+        rpk(domain.PublicKeyLength())
+    {
+    }
+
+    CryptoPP::AutoSeededRandomPool prng;
+    CryptoPP::ECDH<CryptoPP::ECP>::Domain domain;
+
+    /* Crypto++ public keys are in the uncompressed form 0x04 || x || y */
+    CryptoPP::SecByteBlock sk, pk, rpk;
+    bool remote_set = false;
+};
+
+uvgrtp::crypto::ecdh::p256::p256():
+    impl_(new impl())
+{
+}
+
+uvgrtp::crypto::ecdh::p256::~p256()
+{
+}
+
+void uvgrtp::crypto::ecdh::p256::generate_keys()
+{
+    impl_->domain.GenerateKeyPair(impl_->prng, impl_->sk, impl_->pk);
+}
+
+void uvgrtp::crypto::ecdh::p256::get_pk(uint8_t *pk, size_t len)
+{
+    memcpy(pk, impl_->pk.data() + 1, len < PK_SIZE ? len : PK_SIZE);
+}
+
+bool uvgrtp::crypto::ecdh::p256::set_remote_pk(const uint8_t *pk, size_t len)
+{
+    const auto& params = impl_->domain.GetGroupParameters();
+    CryptoPP::ECP::Point point;
+
+    impl_->remote_set = false;
+
+    if (len != PK_SIZE)
+        return false;
+
+    impl_->rpk[0] = 0x04;
+    memcpy(impl_->rpk.data() + 1, pk, PK_SIZE);
+
+    if (params.GetCurve().DecodePoint(point, impl_->rpk, impl_->rpk.size()))
+        impl_->remote_set = params.ValidateElement(3, point, nullptr);
+
+    return impl_->remote_set;
+}
+
+bool uvgrtp::crypto::ecdh::p256::get_shared_secret(uint8_t *ss, size_t len)
+{
+    uint8_t shared[SS_SIZE];
+
+    if (!impl_->remote_set || !impl_->domain.Agree(shared, impl_->sk, impl_->rpk, true))
+        return false;
+
+    memcpy(ss, shared, len < SS_SIZE ? len : SS_SIZE);
+    return true;
+}
+
+struct uvgrtp::crypto::ecdh::x25519::impl {
+    CryptoPP::AutoSeededRandomPool prng;
+    CryptoPP::x25519 x;
+
+    uint8_t sk[32]  = { 0 };
+    uint8_t pk[32]  = { 0 };
+    uint8_t rpk[32] = { 0 };
+    bool remote_set = false;
+};
+
+uvgrtp::crypto::ecdh::x25519::x25519():
+    impl_(new impl())
+{
+}
+
+uvgrtp::crypto::ecdh::x25519::~x25519()
+{
+}
+
+void uvgrtp::crypto::ecdh::x25519::generate_keys()
+{
+    impl_->x.GenerateKeyPair(impl_->prng, impl_->sk, impl_->pk);
+}
+
+void uvgrtp::crypto::ecdh::x25519::get_pk(uint8_t *pk, size_t len)
+{
+    memcpy(pk, impl_->pk, len < PK_SIZE ? len : PK_SIZE);
+}
+
+bool uvgrtp::crypto::ecdh::x25519::set_remote_pk(const uint8_t *pk, size_t len)
+{
+    impl_->remote_set = (len == PK_SIZE);
+
+    if (impl_->remote_set)
+        memcpy(impl_->rpk, pk, PK_SIZE);
+
+    return impl_->remote_set;
+}
+
+bool uvgrtp::crypto::ecdh::x25519::get_shared_secret(uint8_t *ss, size_t len)
+{
+    uint8_t shared[SS_SIZE];
+
+    /* Agree() rejects small-order public keys */
+    if (!impl_->remote_set || !impl_->x.Agree(shared, impl_->sk, impl_->rpk, true))
+        return false;
+
+    memcpy(ss, shared, len < SS_SIZE ? len : SS_SIZE);
+    return true;
+}
+
+/* ***************** random ***************** */
+
+void uvgrtp::crypto::random::generate_random(uint8_t *out, size_t len)
+{
+    /* do not block ever */
+    CryptoPP::OS_GenerateRandomBlock(false, out, len);
+}
+
+const char *uvgrtp::crypto::backend()
+{
+    return "Crypto++";
+}
+
+#endif // __RTP_CRYPTO_CRYPTOPP__
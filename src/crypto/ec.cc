@@ -0,0 +1,483 @@
+#include "ec.hh"
+
+#include "endian.hh"
+
+#include <cstring>
+
+/* ***************** field256 ***************** */
+
+uvgrtp::crypto::builtin::field256::field256(const uint8_t *modulus):
+    n_(),
+    r2_(),
+    n0inv_(0)
+{
+    for (size_t i = 0; i < LIMBS; ++i)
+        n_[i] = load_be32(modulus + 4 * (LIMBS - 1 - i));
+
+    /* -n^-1 mod 2^32 with Newton's iteration, each step doubles the correct bits */
+    uint32_t inv = 1;
+
+    for (int i = 0; i < 5; ++i)
+        inv *= 2 - n_[0] * inv;
+
+    n0inv_ = (uint32_t)0 - inv;
+
+    /* R^2 mod n where R = 2^256 by doubling 1 modulo n */
+    memset(r2_, 0, sizeof(r2_));
+    r2_[0] = 1;
+
+    for (size_t i = 0; i < 64 * LIMBS; ++i)
+        add(r2_, r2_, r2_);
+}
+
+void uvgrtp::crypto::builtin::field256::reduce_once(elem a, uint32_t carry) const
+{
+    elem t;
+    uint64_t borrow = 0;
+
+    for (size_t i = 0; i < LIMBS; ++i) {
+        uint64_t d = (uint64_t)a[i] - n_[i] - borrow;
+
+        t[i]   = (uint32_t)d;
+        borrow = (d >> 32) & 1;
+    }
+
+    /* "carry || a >= n" means that the value is at least n */
+    uint32_t mask = (uint32_t)0 - (carry | (uint32_t)(borrow ^ 1));
+
+    for (size_t i = 0; i < LIMBS; ++i)
+        a[i] = (t[i] & mask) | (a[i] & ~mask);
+}
+
+void uvgrtp::crypto::builtin::field256::add(elem out, const elem a, const elem b) const
+{
+    uint64_t carry = 0;
+
+    for (size_t i = 0; i < LIMBS; ++i) {
+        carry  = (uint64_t)a[i] + b[i] + (carry >> 32);
+        out[i] = (uint32_t)carry;
+    }
+
+    reduce_once(out, (uint32_t)(carry >> 32));
+}
+
+void uvgrtp::crypto::builtin::field256::sub(elem out, const elem a, const elem b) const
+{
+    uint64_t borrow = 0;
+
+    for (size_t i = 0; i < LIMBS; ++i) {
+        uint64_t d = (uint64_t)a[i] - b[i] - borrow;
+
+        out[i] = (uint32_t)d;
+        borrow = (d >> 32) & 1;
+    }
+
+    /* add the modulus back if the result went negative */
+    uint32_t mask  = (uint32_t)0 - (uint32_t)borrow;
+    uint64_t carry = 0;
+
+    for (size_t i = 0; i < LIMBS; ++i) {
+        carry  = (uint64_t)out[i] + (n_[i] & mask) + (carry >> 32);
+        out[i] = (uint32_t)carry;
+    }
+}
+
+void uvgrtp::crypto::builtin::field256::mul(elem out, const elem a, const elem b) const
+{
+    uint32_t t[LIMBS + 2] = { 0 };
+
+    /* coarsely integrated operand scanning (CIOS) */
+    for (size_t i = 0; i < LIMBS; ++i) {
+        uint64_t c = 0;
+
+        for (size_t j = 0; j < LIMBS; ++j) {
+            c    = (uint64_t)t[j] + (uint64_t)a[j] * b[i] + (c >> 32);
+            t[j] = (uint32_t)c;
+        }
+
+        c            = (uint64_t)t[LIMBS] + (c >> 32);
+        t[LIMBS]     = (uint32_t)c;
+        t[LIMBS + 1] = (uint32_t)(c >> 32);
+
+        uint32_t m = t[0] * n0inv_;
+
+        c = (uint64_t)t[0] + (uint64_t)m * n_[0];
+
+        for (size_t j = 1; j < LIMBS; ++j) {
+            c        = (uint64_t)t[j] + (uint64_t)m * n_[j] + (c >> 32);
+            t[j - 1] = (uint32_t)c;
+        }
+
+        c            = (uint64_t)t[LIMBS] + (c >> 32);
+        t[LIMBS - 1] = (uint32_t)c;
+        t[LIMBS]     = t[LIMBS + 1] + (uint32_t)(c >> 32);
+    }
+
+    reduce_once(t, t[LIMBS]);
+    memcpy(out, t, sizeof(elem));
+}
+
+void uvgrtp::crypto::builtin::field256::from_bytes(elem out, const uint8_t *in) const
+{
+    elem t;
+
+    for (size_t i = 0; i < LIMBS; ++i)
+        t[i] = load_be32(in + 4 * (LIMBS - 1 - i));
+
+    /* any value below 2^256 is brought into range by the Montgomery reduction */
+    mul(out, t, r2_);
+}
+
+void uvgrtp::crypto::builtin::field256::to_bytes(uint8_t *out, const elem in) const
+{
+    elem one = { 1 };
+    elem t;
+
+    mul(t, in, one);
+
+    for (size_t i = 0; i < LIMBS; ++i)
+        store_be32(out + 4 * (LIMBS - 1 - i), t[i]);
+}
+
+void uvgrtp::crypto::builtin::field256::set(elem out, uint32_t value) const
+{
+    elem t = { value };
+
+    mul(out, t, r2_);
+}
+
+void uvgrtp::crypto::builtin::field256::inv(elem out, const elem a) const
+{
+    /* Fermat's little theorem, a^(n - 2), the exponent is public so it may be branched on */
+    elem e, x;
+
+    memcpy(e, n_, sizeof(elem));
+    e[0] -= 2;
+
+    set(x, 1);
+
+    for (size_t i = 32 * LIMBS; i-- > 0; ) {
+        mul(x, x, x);
+
+        if ((e[i / 32] >> (i % 32)) & 1)
+            mul(x, x, a);
+    }
+
+    memcpy(out, x, sizeof(elem));
+}
+
+uint32_t uvgrtp::crypto::builtin::field256::is_zero(const elem a)
+{
+    uint32_t acc = 0;
+
+    for (size_t i = 0; i < LIMBS; ++i)
+        acc |= a[i];
+
+    return ((acc | ((uint32_t)0 - acc)) >> 31) - 1;
+}
+
+bool uvgrtp::crypto::builtin::field256::is_reduced(const uint8_t *in) const
+{
+    uint64_t borrow = 0;
+
+    for (size_t i = 0; i < LIMBS; ++i) {
+        uint64_t d = (uint64_t)load_be32(in + 4 * (LIMBS - 1 - i)) - n_[i] - borrow;
+
+        borrow = (d >> 32) & 1;
+    }
+
+    return borrow;
+}
+
+void uvgrtp::crypto::builtin::field256::cswap(elem a, elem b, uint32_t mask)
+{
+    for (size_t i = 0; i < LIMBS; ++i) {
+        uint32_t t = (a[i] ^ b[i]) & mask;
+
+        a[i] ^= t;
+        b[i] ^= t;
+    }
+}
+
+/* ***************** x25519 ***************** */
+
+typedef uvgrtp::crypto::builtin::field256::elem elem;
+
+static const uvgrtp::crypto::builtin::field256& f25519()
+{
+    /* 2^255 - 19 */
+    static const uint8_t p[32] = {
+        0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xed
+    };
+    static const uvgrtp::crypto::builtin::field256 f(p);
+
+    return f;
+}
+
+void uvgrtp::crypto::builtin::x25519(uint8_t *out, const uint8_t *scalar, const uint8_t *u)
+{
+    const field256& f = f25519();
+
+    uint8_t k[32];
+    uint8_t be[32];
+
+    /* clamp the scalar and decode u, ignoring its most significant bit (RFC 7748 section 5) */
+    memcpy(k, scalar, 32);
+    k[0]  &= 248;
+    k[31] &= 127;
+    k[31] |= 64;
+
+    for (int i = 0; i < 32; ++i)
+        be[i] = u[31 - i];
+    be[0] &= 0x7f;
+
+    elem x1, x2, z2, x3, z3, a24;
+    elem a, aa, b, bb, e, c, d, da, cb, t;
+
+    f.from_bytes(x1, be);
+    f.set(x2, 1);
+    f.set(z2, 0);
+    memcpy(x3, x1, sizeof(elem));
+    f.set(z3, 1);
+    f.set(a24, 121665);
+
+    uint32_t swap = 0;
+
+    for (int i = 254; i >= 0; --i) {
+        uint32_t bit = (k[i / 8] >> (i % 8)) & 1;
+
+        swap ^= bit;
+        field256::cswap(x2, x3, (uint32_t)0 - swap);
+        field256::cswap(z2, z3, (uint32_t)0 - swap);
+        swap = bit;
+
+        f.add(a,  x2, z2);
+        f.mul(aa, a,  a);
+        f.sub(b,  x2, z2);
+        f.mul(bb, b,  b);
+        f.sub(e,  aa, bb);
+        f.add(c,  x3, z3);
+        f.sub(d,  x3, z3);
+        f.mul(da, d,  a);
+        f.mul(cb, c,  b);
+
+        f.add(t,  da, cb);
+        f.mul(x3, t,  t);
+        f.sub(t,  da, cb);
+        f.mul(t,  t,  t);
+        f.mul(z3, x1, t);
+        f.mul(x2, aa, bb);
+        f.mul(t,  a24, e);
+        f.add(t,  aa, t);
+        f.mul(z2, e,  t);
+    }
+
+    field256::cswap(x2, x3, (uint32_t)0 - swap);
+    field256::cswap(z2, z3, (uint32_t)0 - swap);
+
+    f.inv(z2, z2);
+    f.mul(x2, x2, z2);
+    f.to_bytes(be, x2);
+
+    for (int i = 0; i < 32; ++i)
+        out[i] = be[31 - i];
+}
+
+/* ***************** p-256 ***************** */
+
+namespace {
+    struct p256_curve {
+        p256_curve(const uint8_t *p, const uint8_t *b_bytes, const uint8_t *gx_bytes, const uint8_t *gy_bytes):
+            f(p)
+        {
+            f.from_bytes(b,  b_bytes);
+            f.from_bytes(gx, gx_bytes);
+            f.from_bytes(gy, gy_bytes);
+        }
+
+        uvgrtp::crypto::builtin::field256 f;
+        elem b, gx, gy;
+    };
+
+    /* projective point (X : Y : Z), the point at infinity is (0 : 1 : 0) */
+    struct p256_point {
+        elem x, y, z;
+    };
+}
+
+static const uint8_t P256_N[32] = {
+    0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84, 0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x51
+};
+
+static const p256_curve& p256()
+{
+    static const uint8_t p[32] = {
+        0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+    };
+    static const uint8_t b[32] = {
+        0x5a, 0xc6, 0x35, 0xd8, 0xaa, 0x3a, 0x93, 0xe7, 0xb3, 0xeb, 0xbd, 0x55, 0x76, 0x98, 0x86, 0xbc,
+        0x65, 0x1d, 0x06, 0xb0, 0xcc, 0x53, 0xb0, 0xf6, 0x3b, 0xce, 0x3c, 0x3e, 0x27, 0xd2, 0x60, 0x4b
+    };
+    static const uint8_t gx[32] = {
+        0x6b, 0x17, 0xd1, 0xf2, 0xe1, 0x2c, 0x42, 0x47, 0xf8, 0xbc, 0xe6, 0xe5, 0x63, 0xa4, 0x40, 0xf2,
+        0x77, 0x03, 0x7d, 0x81, 0x2d, 0xeb, 0x33, 0xa0, 0xf4, 0xa1, 0x39, 0x45, 0xd8, 0x98, 0xc2, 0x96
+    };
+    static const uint8_t gy[32] = {
+        0x4f, 0xe3, 0x42, 0xe2, 0xfe, 0x1a, 0x7f, 0x9b, 0x8e, 0xe7, 0xeb, 0x4a, 0x7c, 0x0f, 0x9e, 0x16,
+        0x2b, 0xce, 0x33, 0x57, 0x6b, 0x31, 0x5e, 0xce, 0xcb, 0xb6, 0x40, 0x68, 0x37, 0xbf, 0x51, 0xf5
+    };
+    static const p256_curve curve(p, b, gx, gy);
+
+    return curve;
+}
+
+/* Complete addition for short Weierstrass curves with a = -3 (Renes, Costello and Batina,
+ * "Complete addition formulas for prime order elliptic curves", algorithm 4).
+ * It works for doubling and for the point at infinity too so the scalar
+ * multiplication does not need any special cases. "r" may alias "p" or "q" */
+static void p256_add(const p256_curve& c, p256_point& r, const p256_point& p, const p256_point& q)
+{
+    const uvgrtp::crypto::builtin::field256& f = c.f;
+    elem t0, t1, t2, t3, t4, x3, y3, z3;
+
+    f.mul(t0, p.x, q.x);
+    f.mul(t1, p.y, q.y);
+    f.mul(t2, p.z, q.z);
+    f.add(t3, p.x, p.y);
+    f.add(t4, q.x, q.y);
+    f.mul(t3, t3, t4);
+    f.add(t4, t0, t1);
+    f.sub(t3, t3, t4);
+    f.add(t4, p.y, p.z);
+    f.add(x3, q.y, q.z);
+    f.mul(t4, t4, x3);
+    f.add(x3, t1, t2);
+    f.sub(t4, t4, x3);
+    f.add(x3, p.x, p.z);
+    f.add(y3, q.x, q.z);
+    f.mul(x3, x3, y3);
+    f.add(y3, t0, t2);
+    f.sub(y3, x3, y3);
+    f.mul(z3, c.b, t2);
+    f.sub(x3, y3, z3);
+    f.add(z3, x3, x3);
+    f.add(x3, x3, z3);
+    f.sub(z3, t1, x3);
+    f.add(x3, t1, x3);
+    f.mul(y3, c.b, y3);
+    f.add(t1, t2, t2);
+    f.add(t2, t1, t2);
+    f.sub(y3, y3, t2);
+    f.sub(y3, y3, t0);
+    f.add(t1, y3, y3);
+    f.add(y3, t1, y3);
+    f.add(t1, t0, t0);
+    f.add(t0, t1, t0);
+    f.sub(t0, t0, t2);
+    f.mul(t1, t4, y3);
+    f.mul(t2, t0, y3);
+    f.mul(y3, x3, z3);
+    f.add(y3, y3, t2);
+    f.mul(x3, t3, x3);
+    f.sub(x3, x3, t1);
+    f.mul(z3, t4, z3);
+    f.mul(t1, t3, t0);
+    f.add(z3, z3, t1);
+
+    memcpy(r.x, x3, sizeof(elem));
+    memcpy(r.y, y3, sizeof(elem));
+    memcpy(r.z, z3, sizeof(elem));
+}
+
+/* Decode and validate an affine point, return false if it does not satisfy y^2 = x^3 - 3x + b */
+static bool p256_decode(const p256_curve& c, p256_point& p, const uint8_t *point)
+{
+    const uvgrtp::crypto::builtin::field256& f = c.f;
+    elem lhs, rhs, t;
+
+    if (!f.is_reduced(point) || !f.is_reduced(point + 32))
+        return false;
+
+    f.from_bytes(p.x, point);
+    f.from_bytes(p.y, point + 32);
+    f.set(p.z, 1);
+
+    f.mul(lhs, p.y, p.y);
+
+    f.mul(rhs, p.x, p.x);
+    f.mul(rhs, rhs, p.x);
+    f.add(t, p.x, p.x);
+    f.add(t, t, p.x);
+    f.sub(rhs, rhs, t);
+    f.add(rhs, rhs, c.b);
+
+    f.sub(t, lhs, rhs);
+    return uvgrtp::crypto::builtin::field256::is_zero(t) != 0;
+}
+
+bool uvgrtp::crypto::builtin::p256_valid_point(const uint8_t *point)
+{
+    p256_point p;
+
+    return p256_decode(p256(), p, point);
+}
+
+bool uvgrtp::crypto::builtin::p256_valid_scalar(const uint8_t *scalar)
+{
+    bool zero = true;
+
+    for (int i = 0; i < 32; ++i)
+        zero &= (scalar[i] == 0);
+
+    return !zero && memcmp(scalar, P256_N, 32) < 0;
+}
+
+bool uvgrtp::crypto::builtin::p256_mul(uint8_t *out, const uint8_t *scalar, const uint8_t *point)
+{
+    const p256_curve& c = p256();
+    const field256& f   = c.f;
+
+    p256_point p, r, t;
+
+    if (point) {
+        if (!p256_decode(c, p, point))
+            return false;
+    } else {
+        memcpy(p.x, c.gx, sizeof(elem));
+        memcpy(p.y, c.gy, sizeof(elem));
+        f.set(p.z, 1);
+    }
+
+    f.set(r.x, 0);
+    f.set(r.y, 1);
+    f.set(r.z, 0);
+
+    /* double-and-add-always, the sum is computed for every bit and kept only if the bit is set */
+    for (int i = 255; i >= 0; --i) {
+        uint32_t mask = (uint32_t)0 - (uint32_t)((scalar[31 - i / 8] >> (i % 8)) & 1);
+
+        p256_add(c, r, r, r);
+        p256_add(c, t, r, p);
+
+        field256::cswap(r.x, t.x, mask);
+        field256::cswap(r.y, t.y, mask);
+        field256::cswap(r.z, t.z, mask);
+    }
+
+    if (field256::is_zero(r.z))
+        return false;
+
+    elem zinv, x, y;
+
+    f.inv(zinv, r.z);
+    f.mul(x, r.x, zinv);
+    f.mul(y, r.y, zinv);
+
+    f.to_bytes(out,      x);
+    f.to_bytes(out + 32, y);
+
+    return true;
+}
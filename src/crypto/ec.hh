@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uvgrtp {
+    namespace crypto {
+        namespace builtin {
+
+            /* Arithmetic modulo an odd prime of at most 256 bits
+             *
+             * Elements are eight 32-bit limbs, least significant limb first, kept in
+             * Montgomery form. None of the operations branch on the values of the elements */
+            class field256 {
+                public:
+                    static const size_t LIMBS = 8;
+
+                    typedef uint32_t elem[LIMBS];
+
+                    /* "modulus" is given as 32 big-endian bytes */
+                    field256(const uint8_t *modulus);
+
+                    /* Convert 32 big-endian bytes to Montgomery form and back.
+                     * from_bytes() reduces the input if it is not smaller than the modulus */
+                    void from_bytes(elem out, const uint8_t *in) const;
+                    void to_bytes(uint8_t *out, const elem in) const;
+
+                    void set(elem out, uint32_t value) const;
+
+                    void add(elem out, const elem a, const elem b) const;
+                    void sub(elem out, const elem a, const elem b) const;
+                    void mul(elem out, const elem a, const elem b) const;
+
+                    /* out = a^-1, zero if "a" is zero */
+                    void inv(elem out, const elem a) const;
+
+                    /* Return all ones if "a" is zero and zero otherwise */
+                    static uint32_t is_zero(const elem a);
+
+                    /* Return true if big-endian "in" is smaller than the modulus */
+                    bool is_reduced(const uint8_t *in) const;
+
+                    /* Swap "a" and "b" if "mask" is all ones, do nothing if it is zero */
+                    static void cswap(elem a, elem b, uint32_t mask);
+
+                private:
+                    void reduce_once(elem a, uint32_t carry) const;
+
+                    elem n_;
+                    elem r2_;
+                    uint32_t n0inv_;
+            };
+
+            /* The X25519 function of RFC 7748: out = scalar * u, all little-endian.
+             * The scalar is clamped as the RFC requires */
+            void x25519(uint8_t *out, const uint8_t *scalar, const uint8_t *u);
+
+            /* Multiply a P-256 point by "scalar" (32 big-endian bytes)
+             *
+             * The points are the 32-byte big-endian affine coordinates x || y and the
+             * generator is used if "point" is null. Return false if "point" is not on the
+             * curve or if the result is the point at infinity */
+            bool p256_mul(uint8_t *out, const uint8_t *scalar, const uint8_t *point);
+
+            /* Return true if "point" (x || y) is on P-256. The curve has a cofactor of one
+             * so every such point is in the group and is safe to use with p256_mul() */
+            bool p256_valid_point(const uint8_t *point);
+
+            /* Return true if "scalar" is in [1, n - 1] where n is the order of P-256 */
+            bool p256_valid_scalar(const uint8_t *scalar);
+        }
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,9 @@
+SOURCES += \
+	src/crypto/aes.cc \
+	src/crypto/bignum.cc \
+	src/crypto/builtin.cc \
+	src/crypto/cpu.cc \
+	src/crypto/cryptopp.cc \
+	src/crypto/ec.cc \
+	src/crypto/none.cc \
+	src/crypto/sha.cc
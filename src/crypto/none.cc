@@ -0,0 +1,403 @@
+#include "uvgrtp/crypto.hh"
+
+#ifndef __RTP_CRYPTO__
+
+#include "uvgrtp/debug.hh"
+
+/* SRTP/ZRTP are disabled, the classes only exist so that uvgRTP links.
+ * session.cc refuses to create SRTP/ZRTP streams so none of these should be called */
+
+struct uvgrtp::crypto::hmac::sha1::impl {};
+struct uvgrtp::crypto::hmac::sha256::impl {};
+struct uvgrtp::crypto::sha256::impl {};
+struct uvgrtp::crypto::aes::ctr::impl {};
+struct uvgrtp::crypto::aes::gcm::impl {};
+struct uvgrtp::crypto::aes::cfb::impl {};
+struct uvgrtp::crypto::aes::ecb::impl {};
+struct uvgrtp::crypto::dh::impl {};
+struct uvgrtp::crypto::ecdh::p256::impl {};
+struct uvgrtp::crypto::ecdh::x25519::impl {};
+
+/* ***************** hmac-sha1 ***************** */
+
+uvgrtp::crypto::hmac::sha1::sha1(const uint8_t *key, size_t key_size)
+{
+    (void)key, (void)key_size;
+}
+
+uvgrtp::crypto::hmac::sha1::~sha1()
+{
+}
+
+void uvgrtp::crypto::hmac::sha1::update(const uint8_t *data, size_t len)
+{
+    (void)data, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::hmac::sha1::final(uint8_t *digest)
+{
+    (void)digest;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::hmac::sha1::final(uint8_t *digest, size_t size)
+{
+    (void)digest, (void)size;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+/* ***************** hmac-sha256 ***************** */
+
+uvgrtp::crypto::hmac::sha256::sha256(const uint8_t *key, size_t key_size)
+{
+    (void)key, (void)key_size;
+}
+
+uvgrtp::crypto::hmac::sha256::~sha256()
+{
+}
+
+void uvgrtp::crypto::hmac::sha256::update(const uint8_t *data, size_t len)
+{
+    (void)data, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::hmac::sha256::final(uint8_t *digest)
+{
+    (void)digest;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+/* ***************** sha256 ***************** */
+
+uvgrtp::crypto::sha256::sha256()
+{
+}
+
+uvgrtp::crypto::sha256::~sha256()
+{
+}
+
+void uvgrtp::crypto::sha256::update(const uint8_t *data, size_t len)
+{
+    (void)data, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::sha256::final(uint8_t *digest)
+{
+    (void)digest;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+/* ***************** aes-128 ***************** */
+
+uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size)
+{
+    (void)key, (void)key_size;
+}
+
+uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size, const uint8_t *iv)
+{
+    (void)key, (void)key_size, (void)iv;
+}
+
+uvgrtp::crypto::aes::ctr::~ctr()
+{
+}
+
+void uvgrtp::crypto::aes::ctr::set_iv(const uint8_t *iv)
+{
+    (void)iv;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::aes::ctr::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    (void)output, (void)input, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::aes::ctr::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    (void)output, (void)input, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+uvgrtp::crypto::aes::gcm::gcm(const uint8_t *key, size_t key_size)
+{
+    (void)key, (void)key_size;
+}
+
+uvgrtp::crypto::aes::gcm::~gcm()
+{
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt_init(const uint8_t *iv, size_t iv_len)
+{
+    (void)iv, (void)iv_len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::aes::gcm::decrypt_init(const uint8_t *iv, size_t iv_len)
+{
+    (void)iv, (void)iv_len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::aes::gcm::update_aad(const uint8_t *data, size_t len)
+{
+    (void)data, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    (void)output, (void)input, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::aes::gcm::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    (void)output, (void)input, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::aes::gcm::final(uint8_t *tag, size_t size)
+{
+    (void)tag, (void)size;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+bool uvgrtp::crypto::aes::gcm::verify(const uint8_t *tag, size_t size)
+{
+    (void)tag, (void)size;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+uvgrtp::crypto::aes::cfb::cfb(const uint8_t *key, size_t key_size, const uint8_t *iv)
+{
+    (void)key, (void)key_size, (void)iv;
+}
+
+uvgrtp::crypto::aes::cfb::~cfb()
+{
+}
+
+void uvgrtp::crypto::aes::cfb::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    (void)output, (void)input, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::aes::cfb::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    (void)output, (void)input, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+uvgrtp::crypto::aes::ecb::ecb(const uint8_t *key, size_t key_size)
+{
+    (void)key, (void)key_size;
+}
+
+uvgrtp::crypto::aes::ecb::~ecb()
+{
+}
+
+void uvgrtp::crypto::aes::ecb::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    (void)output, (void)input, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::aes::ecb::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    (void)output, (void)input, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+/* ***************** diffie-hellman 3072 ***************** */
+
+uvgrtp::crypto::dh::dh()
+{
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+uvgrtp::crypto::dh::~dh()
+{
+}
+
+void uvgrtp::crypto::dh::generate_keys()
+{
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::dh::get_pk(uint8_t *pk, size_t len)
+{
+    (void)pk, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::dh::set_remote_pk(uint8_t *pk, size_t len)
+{
+    (void)pk, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::dh::get_shared_secret(uint8_t *ss, size_t len)
+{
+    (void)ss, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+/* ***************** elliptic curve diffie-hellman ***************** */
+
+uvgrtp::crypto::ecdh::p256::p256()
+{
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+uvgrtp::crypto::ecdh::p256::~p256()
+{
+}
+
+void uvgrtp::crypto::ecdh::p256::generate_keys()
+{
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::ecdh::p256::get_pk(uint8_t *pk, size_t len)
+{
+    (void)pk, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+bool uvgrtp::crypto::ecdh::p256::set_remote_pk(const uint8_t *pk, size_t len)
+{
+    (void)pk, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+bool uvgrtp::crypto::ecdh::p256::get_shared_secret(uint8_t *ss, size_t len)
+{
+    (void)ss, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+uvgrtp::crypto::ecdh::x25519::x25519()
+{
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+uvgrtp::crypto::ecdh::x25519::~x25519()
+{
+}
+
+void uvgrtp::crypto::ecdh::x25519::generate_keys()
+{
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+void uvgrtp::crypto::ecdh::x25519::get_pk(uint8_t *pk, size_t len)
+{
+    (void)pk, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+bool uvgrtp::crypto::ecdh::x25519::set_remote_pk(const uint8_t *pk, size_t len)
+{
+    (void)pk, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+bool uvgrtp::crypto::ecdh::x25519::get_shared_secret(uint8_t *ss, size_t len)
+{
+    (void)ss, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+/* ***************** random ***************** */
+
+void uvgrtp::crypto::random::generate_random(uint8_t *out, size_t len)
+{
+    (void)out, (void)len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+}
+
+const char *uvgrtp::crypto::backend()
+{
+    return "none";
+}
+
+#endif // __RTP_CRYPTO__
@@ -0,0 +1,346 @@
+#include "sha.hh"
+
+#include "cpu.hh"
+#include "endian.hh"
+
+#ifdef UVG_CRYPTO_X86
+#include <immintrin.h>
+#endif
+
+#include <cstring>
+
+static const uint32_t SHA1_IV[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+static const uint32_t SHA256_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rol32(uint32_t v, int n)
+{
+    return (v << n) | (v >> (32 - n));
+}
+
+static inline uint32_t ror32(uint32_t v, int n)
+{
+    return (v >> n) | (v << (32 - n));
+}
+
+/* ***************** portable compression functions ***************** */
+
+static void sha1_portable(uint32_t *h, const uint8_t *data, size_t blocks)
+{
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32_t w[16];
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+        for (int t = 0; t < 16; ++t)
+            w[t] = uvgrtp::crypto::builtin::load_be32(data + 4 * t);
+
+        for (int t = 0; t < 80; ++t) {
+            uint32_t f, k;
+
+            if (t >= 16)
+                w[t & 15] = rol32(w[(t - 3) & 15] ^ w[(t - 8) & 15] ^ w[(t - 14) & 15] ^ w[t & 15], 1);
+
+            if (t < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            } else if (t < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            } else if (t < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+
+            uint32_t tmp = rol32(a, 5) + f + e + k + w[t & 15];
+
+            e = d;
+            d = c;
+            c = rol32(b, 30);
+            b = a;
+            a = tmp;
+        }
+
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+}
+
+static void sha256_portable(uint32_t *h, const uint8_t *data, size_t blocks)
+{
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32_t w[64];
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+
+        for (int t = 0; t < 16; ++t)
+            w[t] = uvgrtp::crypto::builtin::load_be32(data + 4 * t);
+
+        for (int t = 16; t < 64; ++t) {
+            uint32_t s0 = ror32(w[t - 15], 7) ^ ror32(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            uint32_t s1 = ror32(w[t - 2], 17) ^ ror32(w[t - 2], 19) ^ (w[t - 2] >> 10);
+
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+
+        for (int t = 0; t < 64; ++t) {
+            uint32_t s1  = ror32(e, 6) ^ ror32(e, 11) ^ ror32(e, 25);
+            uint32_t ch  = (e & f) ^ (~e & g);
+            uint32_t t1  = hh + s1 + ch + SHA256_K[t] + w[t];
+            uint32_t s0  = ror32(a, 2) ^ ror32(a, 13) ^ ror32(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2  = s0 + maj;
+
+            hh = g;
+            g  = f;
+            f  = e;
+            e  = d + t1;
+            d  = c;
+            c  = b;
+            b  = a;
+            a  = t1 + t2;
+        }
+
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+    }
+}
+
+/* ***************** sha extensions ***************** */
+
+#ifdef UVG_CRYPTO_X86
+
+/* Four rounds of SHA-1. "e" is the E value of the group combined with its message words
+ * and "prev" receives the ABCD before the rounds for computing the next E */
+template <int F>
+UVG_TARGET("sha,sse4.1,ssse3")
+static inline void sha1_rounds4(__m128i& abcd, __m128i& prev, __m128i e)
+{
+    prev = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e, F);
+}
+
+UVG_TARGET("sha,sse4.1,ssse3")
+static void sha1_shani(uint32_t *h, const uint8_t *data, size_t blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)h), 0x1b);
+    __m128i e0   = _mm_set_epi32((int)h[4], 0, 0, 0);
+
+    for (; blocks > 0; --blocks, data += 64) {
+        __m128i abcd_save = abcd;
+        __m128i e0_save   = e0;
+        __m128i prev;
+        __m128i m[4];
+
+        for (int i = 0; i < 4; ++i)
+            m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * i)), mask);
+
+        /* group g holds the message words W[4g..4g+3] in m[g % 4] */
+        sha1_rounds4<0>(abcd, prev, _mm_add_epi32(e0, m[0]));
+
+        for (int g = 1; g < 20; ++g) {
+            if (g >= 4) {
+                m[g % 4] = _mm_sha1msg2_epu32(
+                    _mm_xor_si128(_mm_sha1msg1_epu32(m[g % 4], m[(g + 1) % 4]), m[(g + 2) % 4]),
+                    m[(g + 3) % 4]
+                );
+            }
+
+            __m128i e = _mm_sha1nexte_epu32(prev, m[g % 4]);
+
+            switch (g / 5) {
+                case 0: sha1_rounds4<0>(abcd, prev, e); break;
+                case 1: sha1_rounds4<1>(abcd, prev, e); break;
+                case 2: sha1_rounds4<2>(abcd, prev, e); break;
+                default: sha1_rounds4<3>(abcd, prev, e); break;
+            }
+        }
+
+        e0   = _mm_sha1nexte_epu32(prev, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *)h, _mm_shuffle_epi32(abcd, 0x1b));
+    h[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+UVG_TARGET("sha,sse4.1,ssse3")
+static void sha256_shani(uint32_t *h, const uint8_t *data, size_t blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp    = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)h), 0xb1);       /* CDAB */
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(h + 4)), 0x1b); /* EFGH */
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);                                    /* ABEF */
+
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);                                         /* CDGH */
+
+    for (; blocks > 0; --blocks, data += 64) {
+        __m128i abef_save = state0;
+        __m128i cdgh_save = state1;
+        __m128i m[4];
+
+        for (int i = 0; i < 4; ++i)
+            m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * i)), mask);
+
+        /* group g holds the message words W[4g..4g+3] in m[g % 4] */
+        for (int g = 0; g < 16; ++g) {
+            if (g >= 4) {
+                __m128i w = _mm_sha256msg1_epu32(m[g % 4], m[(g + 1) % 4]);
+
+                w = _mm_add_epi32(w, _mm_alignr_epi8(m[(g + 3) % 4], m[(g + 2) % 4], 4));
+                m[g % 4] = _mm_sha256msg2_epu32(w, m[(g + 3) % 4]);
+            }
+
+            __m128i msg = _mm_add_epi32(m[g % 4], _mm_loadu_si128((const __m128i *)&SHA256_K[4 * g]));
+
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0e));
+        }
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp    = _mm_shuffle_epi32(state0, 0x1b);    /* FEBA */
+    state1 = _mm_shuffle_epi32(state1, 0xb1);    /* DCHG */
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0); /* DCBA */
+    state1 = _mm_alignr_epi8(state1, tmp, 8);    /* HGFE */
+
+    _mm_storeu_si128((__m128i *)h, state0);
+    _mm_storeu_si128((__m128i *)(h + 4), state1);
+}
+
+#endif // UVG_CRYPTO_X86
+
+static void sha1_compress(uint32_t *h, const uint8_t *data, size_t blocks)
+{
+#ifdef UVG_CRYPTO_X86
+    if (uvgrtp::crypto::cpu::has_sha())
+        return sha1_shani(h, data, blocks);
+#endif
+    sha1_portable(h, data, blocks);
+}
+
+static void sha256_compress(uint32_t *h, const uint8_t *data, size_t blocks)
+{
+#ifdef UVG_CRYPTO_X86
+    if (uvgrtp::crypto::cpu::has_sha())
+        return sha256_shani(h, data, blocks);
+#endif
+    sha256_portable(h, data, blocks);
+}
+
+/* ***************** merkle-damgård construction ***************** */
+
+static void md_update(uint32_t *h, uint8_t *buf, size_t& buf_len, uint64_t& total,
+                      const uint8_t *data, size_t len, void (*compress)(uint32_t *, const uint8_t *, size_t))
+{
+    total += len;
+
+    if (buf_len) {
+        size_t n = (64 - buf_len) < len ? (64 - buf_len) : len;
+
+        memcpy(buf + buf_len, data, n);
+        buf_len += n;
+        data    += n;
+        len     -= n;
+
+        if (buf_len < 64)
+            return;
+
+        compress(h, buf, 1);
+        buf_len = 0;
+    }
+
+    if (len >= 64) {
+        compress(h, data, len / 64);
+        data += len - len % 64;
+        len  %= 64;
+    }
+
+    memcpy(buf, data, len);
+    buf_len = len;
+}
+
+static void md_final(uint32_t *h, uint8_t *buf, size_t buf_len, uint64_t total,
+                     void (*compress)(uint32_t *, const uint8_t *, size_t))
+{
+    buf[buf_len++] = 0x80;
+
+    if (buf_len > 56) {
+        memset(buf + buf_len, 0, 64 - buf_len);
+        compress(h, buf, 1);
+        buf_len = 0;
+    }
+
+    memset(buf + buf_len, 0, 56 - buf_len);
+    uvgrtp::crypto::builtin::store_be64(buf + 56, total * 8);
+    compress(h, buf, 1);
+}
+
+/* ***************** sha1 ***************** */
+
+uvgrtp::crypto::builtin::sha1_state::sha1_state():
+    buf_(),
+    buf_len_(0),
+    total_(0)
+{
+    memcpy(h_, SHA1_IV, sizeof(h_));
+}
+
+void uvgrtp::crypto::builtin::sha1_state::update(const uint8_t *data, size_t len)
+{
+    md_update(h_, buf_, buf_len_, total_, data, len, sha1_compress);
+}
+
+void uvgrtp::crypto::builtin::sha1_state::final(uint8_t *digest)
+{
+    md_final(h_, buf_, buf_len_, total_, sha1_compress);
+
+    for (int i = 0; i < 5; ++i)
+        store_be32(digest + 4 * i, h_[i]);
+
+    *this = sha1_state();
+}
+
+/* ***************** sha256 ***************** */
+
+uvgrtp::crypto::builtin::sha256_state::sha256_state():
+    buf_(),
+    buf_len_(0),
+    total_(0)
+{
+    memcpy(h_, SHA256_IV, sizeof(h_));
+}
+
+void uvgrtp::crypto::builtin::sha256_state::update(const uint8_t *data, size_t len)
+{
+    md_update(h_, buf_, buf_len_, total_, data, len, sha256_compress);
+}
+
+void uvgrtp::crypto::builtin::sha256_state::final(uint8_t *digest)
+{
+    md_final(h_, buf_, buf_len_, total_, sha256_compress);
+
+    for (int i = 0; i < 8; ++i)
+        store_be32(digest + 4 * i, h_[i]);
+
+    *this = sha256_state();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uvgrtp {
+    namespace crypto {
+        namespace builtin {
+
+            /* SHA-1 and SHA-256 (FIPS 180-4)
+             *
+             * The compression functions use the SHA extensions if the CPU supports them.
+             * The objects are copyable so HMAC can save the state after the key has been
+             * processed and restore it for each message */
+            class sha1_state {
+                public:
+                    static constexpr size_t DIGEST_SIZE = 20;
+                    static constexpr size_t BLOCK_SIZE  = 64;
+
+                    sha1_state();
+
+                    void update(const uint8_t *data, size_t len);
+
+                    /* write the digest to "digest" and reset the state */
+                    void final(uint8_t *digest);
+
+                private:
+                    uint32_t h_[5];
+                    uint8_t buf_[BLOCK_SIZE];
+                    size_t buf_len_;
+                    uint64_t total_;
+            };
+
+            class sha256_state {
+                public:
+                    static constexpr size_t DIGEST_SIZE = 32;
+                    static constexpr size_t BLOCK_SIZE  = 64;
+
+                    sha256_state();
+
+                    void update(const uint8_t *data, size_t len);
+
+                    /* write the digest to "digest" and reset the state */
+                    void final(uint8_t *digest);
+
+                private:
+                    uint32_t h_[8];
+                    uint8_t buf_[BLOCK_SIZE];
+                    size_t buf_len_;
+                    uint64_t total_;
+            };
+        }
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
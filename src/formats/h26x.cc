@@ -279,11 +279,86 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(uint8_t* data, size_t data_l
     if (!data || !data_len)
         return RTP_INVALID_VALUE;
 
+    if (frame_open_) {
+        LOG_ERROR("Cannot push a frame while an incrementally sent frame is open, call end_frame() first");
+        return RTP_INITIALIZED;
+    }
+
     if ((ret = fqueue_->init_transaction(data)) != RTP_OK) {
         LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
         return ret;
     }
 
+    if ((ret = enqueue_nal_units(data, data_len, flags)) != RTP_OK) {
+        fqueue_->deinit_transaction();
+        return ret;
+    }
+
+    // actually send the packets, the last packet of the access unit has the marker bit set
+    ret = fqueue_->flush_queue(true);
+    clear_aggregation_info();
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::formats::h26x::begin_frame()
+{
+    rtp_error_t ret = RTP_OK;
+
+    if (frame_open_) {
+        LOG_ERROR("Previous frame has not been ended with end_frame()");
+        return RTP_INITIALIZED;
+    }
+
+    if ((ret = fqueue_->init_transaction()) != RTP_OK) {
+        LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
+        return ret;
+    }
+
+    frame_open_ = true;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::formats::h26x::push_nal(uint8_t* data, size_t data_len, int flags)
+{
+    rtp_error_t ret = RTP_OK;
+
+    if (!data || !data_len)
+        return RTP_INVALID_VALUE;
+
+    if (!frame_open_) {
+        LOG_ERROR("No open frame, call begin_frame() first");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    // the aggregation packet refers to the aggregation info so it is cleared only after the
+    // packets have been sent or, for the held back packet, copied to the transaction
+    if ((ret = enqueue_nal_units(data, data_len, flags)) != RTP_OK ||
+        (ret = fqueue_->flush_queue_partial()) != RTP_OK) {
+        fqueue_->deinit_transaction();
+        frame_open_ = false;
+    }
+    clear_aggregation_info();
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::formats::h26x::end_frame()
+{
+    if (!frame_open_) {
+        LOG_ERROR("No open frame, call begin_frame() first");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    frame_open_ = false;
+
+    // send the held back packet, it is the last packet of the access unit and has the marker bit set
+    return fqueue_->flush_queue(true);
+}
+
+rtp_error_t uvgrtp::formats::h26x::enqueue_nal_units(uint8_t* data, size_t data_len, int flags)
+{
+    rtp_error_t ret = RTP_OK;
     size_t payload_size = rtp_ctx_->get_payload_size();
 
     // find all the locations of NAL units using Start Code Lookup (SCL)
@@ -321,7 +396,6 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(uint8_t* data, size_t data_l
                 if ((ret = add_aggregate_packet(data + nal.offset, nal.size)) != RTP_OK)
                 {
                     clear_aggregation_info();
-                    fqueue_->deinit_transaction();
                     return ret;
                 }
             }
@@ -348,17 +422,12 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(uint8_t* data, size_t data_l
             if (ret != RTP_OK)
             {
                 clear_aggregation_info();
-                fqueue_->deinit_transaction();
                 return ret;
             }
         }
     }
 
-    // actually send the packets
-    ret = fqueue_->flush_queue();
-    clear_aggregation_info();
-
-    return ret;
+    return RTP_OK;
 }
 
 rtp_error_t uvgrtp::formats::h26x::fu_division(uint8_t *data, size_t data_len, size_t payload_size)
@@ -534,12 +603,6 @@ uint32_t uvgrtp::formats::h26x::drop_frame(uint32_t ts)
         return total_cleaned;
     }
 
-    uint16_t s_seq = frames_.at(ts).s_seq;
-    uint16_t e_seq = frames_.at(ts).e_seq;
-
-    //LOG_INFO("Dropping frame. Ts: %lu, Seq: %u <-> %u, received/expected: %lli/%lli", 
-    //    ts, s_seq, e_seq, frames_[ts].received_packet_seqs.size(), calculate_expected_fus(ts));
-
     for (auto& fragment_seq : frames_[ts].received_packet_seqs)
     {
         total_cleaned += fragments_[fragment_seq]->payload_len + sizeof(uvgrtp::frame::rtp_frame);
@@ -581,6 +644,10 @@ rtp_error_t uvgrtp::formats::h26x::handle_aggregation_packet(uvgrtp::frame::rtp_
         size_t fptr = 0;
         uvgrtp::frame::rtp_frame* retframe = 
             allocate_rtp_frame_with_startcode(flags, (*out)->header, nalus[i].first, fptr);
+
+        // only the last NAL unit of the packet can be the last NAL unit of the access unit
+        if (i != nalus.size() - 1)
+            retframe->header.marker = 0;
         
         std::memcpy(
             retframe->payload + fptr,
@@ -665,7 +732,6 @@ rtp_error_t uvgrtp::formats::h26x::packet_handler(int flags, uvgrtp::frame::rtp_
 
     // keep track of fragments belonging to this frame in case we need to delete them
     frames_[fragment_ts].received_packet_seqs.insert(fragment_seq);
-    frames_[fragment_ts].total_size += (frame->payload_len - sizeof_fu_headers);
 
     if (fragments_[fragment_seq] != nullptr)
     {
@@ -680,41 +746,37 @@ rtp_error_t uvgrtp::formats::h26x::packet_handler(int flags, uvgrtp::frame::rtp_
 
     // if this is first or last, save it to help with reconstruction
     if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_START) {
-        frames_[fragment_ts].s_seq = fragment_seq; 
-        frames_[fragment_ts].start_received = true;
+        frames_[fragment_ts].start_seqs.insert(fragment_seq);
     }
     else if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_END) {
-        frames_[fragment_ts].e_seq = fragment_seq;
-        frames_[fragment_ts].end_received = true;
+        frames_[fragment_ts].end_seqs.insert(fragment_seq);
     }
 
-    // have the first and last fragment arrived so we can possibly start reconstructing the frame?
-    if (frames_[fragment_ts].start_received && frames_[fragment_ts].end_received) {
-        size_t received = calculate_expected_fus(fragment_ts);
+    // has every fragment of this NAL unit arrived so that it can be returned without waiting for the rest of the access unit?
+    uint16_t s_seq = 0;
+    uint16_t e_seq = 0;
 
-        // have we received every fragment and can the frame can be reconstructed?
-        if (received == frames_[fragment_ts].received_packet_seqs.size()) {
+    if (is_nal_complete(fragment_ts, fragment_seq, s_seq, e_seq)) {
 
-            bool enable_reference_discarding = (flags & RCE_H26X_DEPENDENCY_ENFORCEMENT);
-            // here we discard inter frames if their references were not received correctly
-            if (discard_until_key_frame_ && enable_reference_discarding) {
-                if (nal_type == uvgrtp::formats::NAL_TYPE::NT_INTER) {
-                    LOG_WARN("Dropping h26x frame because of missing reference. Timestamp: %lu. Seq: %u - %u", 
-                        fragment_ts, frames_[fragment_ts].s_seq, frames_[fragment_ts].e_seq);
+        bool enable_reference_discarding = (flags & RCE_H26X_DEPENDENCY_ENFORCEMENT);
+        // here we discard inter frames if their references were not received correctly
+        if (discard_until_key_frame_ && enable_reference_discarding) {
+            if (nal_type == uvgrtp::formats::NAL_TYPE::NT_INTER) {
+                LOG_WARN("Dropping h26x frame because of missing reference. Timestamp: %lu. Seq: %u - %u", 
+                    fragment_ts, s_seq, e_seq);
 
-                    drop_frame(fragment_ts);
-                    return RTP_GENERIC_ERROR;
-                }
-                else if (nal_type == uvgrtp::formats::NAL_TYPE::NT_INTRA) {
-
-                    // we don't have to discard anymore
-                    LOG_INFO("Found a key frame at ts %lu", fragment_ts);
-                    discard_until_key_frame_ = false;
-                }
+                drop_frame(fragment_ts);
+                return RTP_GENERIC_ERROR;
             }
+            else if (nal_type == uvgrtp::formats::NAL_TYPE::NT_INTRA) {
 
-            return reconstruction(out, flags, fragment_ts, sizeof_fu_headers);
+                // we don't have to discard anymore
+                LOG_INFO("Found a key frame at ts %lu", fragment_ts);
+                discard_until_key_frame_ = false;
+            }
         }
+
+        return reconstruction(out, flags, fragment_ts, s_seq, e_seq, sizeof_fu_headers);
     }
 
     // make sure uvgRTP does not reserve increasing amounts of memory because some frames are not completed
@@ -763,32 +825,56 @@ void uvgrtp::formats::h26x::garbage_collect_lost_frames(size_t timout)
 void uvgrtp::formats::h26x::initialize_new_fragmented_frame(uint32_t ts, NAL_TYPE nal_type)
 {
     frames_[ts].nal_type = nal_type;
-    frames_[ts].s_seq = 0;
-    frames_[ts].start_received = false;
-    frames_[ts].e_seq = 0;
-    frames_[ts].end_received = false;
+    frames_[ts].start_seqs.clear();
+    frames_[ts].end_seqs.clear();
 
     frames_[ts].sframe_time = uvgrtp::clock::hrc::now();
-    frames_[ts].total_size = 0;
 }
 
-size_t uvgrtp::formats::h26x::calculate_expected_fus(uint32_t ts)
+bool uvgrtp::formats::h26x::is_nal_complete(uint32_t ts, uint16_t seq, uint16_t& s_seq, uint16_t& e_seq)
 {
-    size_t expected = 0;
-    size_t s_seq = frames_[ts].s_seq;
-    size_t e_seq = frames_[ts].e_seq;
+    h26x_info_t& info = frames_[ts];
 
-    if (frames_[ts].start_received && frames_[ts].end_received)
-    {
-        if (s_seq > e_seq) {
-            expected = (UINT16_MAX - s_seq) + e_seq + 2;
-        }
-        else {
-            expected = e_seq - s_seq + 1;
-        }
+    /* Distances are calculated in the 16-bit sequence number space so that
+     * NAL units spanning the wraparound are handled correctly.
+     * The NAL unit starts from the closest start fragment preceding "seq" */
+    uint16_t s_dist = UINT16_MAX;
+    for (auto& start : info.start_seqs) {
+        uint16_t dist = (uint16_t)(seq - start);
+
+        if (dist < 0x8000 && dist < s_dist)
+            s_dist = dist;
     }
 
-    return expected;
+    // ... and ends at the closest end fragment following it
+    uint16_t e_dist = UINT16_MAX;
+    for (auto& end : info.end_seqs) {
+        uint16_t dist = (uint16_t)(end - seq);
+
+        if (dist < 0x8000 && dist < e_dist)
+            e_dist = dist;
+    }
+
+    if (s_dist == UINT16_MAX || e_dist == UINT16_MAX)
+        return false;
+
+    // if a new NAL unit starts before the end fragment, the end belongs to that NAL unit
+    for (auto& start : info.start_seqs) {
+        uint16_t dist = (uint16_t)(start - seq);
+
+        if (dist > 0 && dist <= e_dist)
+            return false;
+    }
+
+    s_seq = (uint16_t)(seq - s_dist);
+    e_seq = (uint16_t)(seq + e_dist);
+
+    for (uint16_t i = s_seq; i != (uint16_t)(e_seq + 1); ++i) {
+        if (fragments_[i] == nullptr || fragments_[i]->header.timestamp != ts)
+            return false;
+    }
+
+    return true;
 }
 
 void uvgrtp::formats::h26x::free_fragment(uint16_t sequence_number)
@@ -855,32 +941,35 @@ void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_si
     can_be_aggregated = (aggregatable_packets >= 2);
 }
 
-rtp_error_t uvgrtp::formats::h26x::reconstruction(uvgrtp::frame::rtp_frame** out, 
-    int flags, uint32_t frame_timestamp, const uint8_t sizeof_fu_headers)
+rtp_error_t uvgrtp::formats::h26x::reconstruction(uvgrtp::frame::rtp_frame** out, int flags,
+    uint32_t frame_timestamp, uint16_t s_seq, uint16_t e_seq, const uint8_t sizeof_fu_headers)
 {
     uvgrtp::frame::rtp_frame* frame = *out;
+    h26x_info_t& info = frames_.at(frame_timestamp);
 
     // Reconstruction of frame from fragments
     size_t fptr = 0;
+    size_t total_size = 0;
+    uint16_t next_from_last = (uint16_t)(e_seq + 1);
+
+    for (uint16_t i = s_seq; i != next_from_last; ++i)
+    {
+        total_size += fragments_[i]->payload_len - sizeof_fu_headers;
+    }
+
+    // the end fragment tells whether this is the last NAL unit of the access unit
+    uvgrtp::frame::rtp_header header = fragments_[e_seq]->header;
 
     // allocating the frame with start code ready saves a copy operation for the frame
     uvgrtp::frame::rtp_frame* complete = allocate_rtp_frame_with_startcode((flags & RCE_H26X_PREPEND_SC),
-        frame->header, get_nal_header_size() + frames_[frame_timestamp].total_size, fptr);
+        header, get_nal_header_size() + total_size, fptr);
 
     // construct the NAL header from fragment header of current fragment
     get_nal_header_from_fu_headers(fptr, frame->payload, complete->payload); // NAL header
     fptr += get_nal_header_size();
 
-    uint16_t next_from_last = frames_.at(frame_timestamp).e_seq + 1;
-    for (uint16_t i = frames_.at(frame_timestamp).s_seq; i != next_from_last; ++i)
+    for (uint16_t i = s_seq; i != next_from_last; ++i)
     {
-        if (fragments_[i] == nullptr)
-        {
-            LOG_ERROR("Missing fragment in reconstruction. Seq range: %u - %u. Missing seq %u",
-                frames_.at(frame_timestamp).s_seq, frames_.at(frame_timestamp).e_seq, i);
-            return RTP_GENERIC_ERROR;
-        }
-
         // copy everything expect fu headers (which repeat for every fu)
         std::memcpy(
             &complete->payload[fptr],
@@ -889,9 +978,17 @@ rtp_error_t uvgrtp::formats::h26x::reconstruction(uvgrtp::frame::rtp_frame** out
         );
         fptr += fragments_[i]->payload_len - sizeof_fu_headers;
         free_fragment(i);
+        info.received_packet_seqs.erase(i);
     }
 
+    info.start_seqs.erase(s_seq);
+    info.end_seqs.erase(e_seq);
+
     *out = complete;      // save result to output
-    frames_.erase(frame_timestamp);  // erase data structures for this frame
+
+    // other NAL units of the access unit may still be in progress
+    if (info.received_packet_seqs.empty())
+        frames_.erase(frame_timestamp);  // erase data structures for this frame
+
     return RTP_PKT_READY; // indicate that we have a frame ready
 }
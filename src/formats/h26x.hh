@@ -9,6 +9,7 @@
 #include <deque>
 #include <memory>
 #include <set>
+#include <unordered_set>
 
 namespace uvgrtp {
 
@@ -40,17 +41,11 @@ namespace uvgrtp {
 
             uvgrtp::formats::NAL_TYPE nal_type;
 
-            bool start_received = false;
-            bool end_received = false;
-
-            /* sequence number of the fragment with s-bit (start) */
-            uint16_t s_seq = 0;
-
-            /* sequence number of the fragment with e-bit (end) */
-            uint16_t e_seq = 0;
-
-            /* total size of all fragments */
-            size_t total_size = 0;
+            /* Sequence numbers of the fragments with s-bit (start) and e-bit (end).
+             * An access unit may contain several fragmented NAL units (f.ex. slices)
+             * and each of them is returned as soon as all of its fragments have been received */
+            std::set<uint16_t> start_seqs;
+            std::set<uint16_t> end_seqs;
 
             // needed for cleaning fragments in case the frame is dropped
             std::set<uint16_t> received_packet_seqs;
@@ -83,6 +78,21 @@ namespace uvgrtp {
                  * Return RTP_INVALID_VALUE if one of the parameters is invalid */
                 rtp_error_t push_media_frame(uint8_t *data, size_t data_len, int flags);
 
+                /* Incremental sending of an access unit
+                 *
+                 * begin_frame() opens a transaction that shares the RTP timestamp of the access unit,
+                 * push_nal() packetizes the NAL unit(s) in "data" and sends them right away, holding back
+                 * only the last packet, and end_frame() sends the held packet with the marker bit set
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_INITIALIZED if begin_frame() is called while a frame is already open
+                 * Return RTP_NOT_INITIALIZED if push_nal() or end_frame() is called without an open frame
+                 * Return RTP_INVALID_VALUE if one of the parameters is invalid
+                 * Return RTP_SEND_ERROR if sending the packets fails */
+                rtp_error_t begin_frame();
+                rtp_error_t push_nal(uint8_t *data, size_t data_len, int flags);
+                rtp_error_t end_frame();
+
                 /* If the packet handler must return more than one frame, it can install a frame getter
                  * that is called by the auxiliary handler caller if packet_handler() returns RTP_MULTIPLE_PKTS_READY
                  *
@@ -156,7 +166,11 @@ namespace uvgrtp {
             bool is_frame_late(uvgrtp::formats::h26x_info_t& hinfo, size_t max_delay);
             uint32_t drop_frame(uint32_t ts);
 
-            inline size_t calculate_expected_fus(uint32_t ts);
+            /* Find the fragmented NAL unit of access unit "ts" that fragment "seq" belongs to
+             *
+             * Return true and set "s_seq" and "e_seq" if all fragments of the NAL unit have been received
+             * Return false if the NAL unit is not complete yet */
+            bool is_nal_complete(uint32_t ts, uint16_t seq, uint16_t& s_seq, uint16_t& e_seq);
             inline void initialize_new_fragmented_frame(uint32_t ts, NAL_TYPE nal_type);
 
             void free_fragment(uint16_t sequence_number);
@@ -164,13 +178,19 @@ namespace uvgrtp {
             void scl(uint8_t* data, size_t data_len, size_t packet_size, 
                 std::vector<nal_info>& nals, bool& can_be_aggregated);
 
+            /* Packetize the NAL units of "data" to the active transaction
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "data" does not contain NAL units */
+            rtp_error_t enqueue_nal_units(uint8_t* data, size_t data_len, int flags);
+
             // constructs and sends the RTP packets with format specific stuff
             rtp_error_t fu_division(uint8_t* data, size_t data_len, size_t payload_size);
 
             void garbage_collect_lost_frames(size_t timout);
 
-            rtp_error_t reconstruction(uvgrtp::frame::rtp_frame** out,
-                int flags, uint32_t frame_timestamp, const uint8_t sizeof_fu_headers);
+            rtp_error_t reconstruction(uvgrtp::frame::rtp_frame** out, int flags, uint32_t frame_timestamp,
+                uint16_t s_seq, uint16_t e_seq, const uint8_t sizeof_fu_headers);
 
             std::deque<uvgrtp::frame::rtp_frame*> queued_;
             std::unordered_map<uint32_t, h26x_info_t> frames_;
@@ -184,6 +204,9 @@ namespace uvgrtp {
             uvgrtp::clock::hrc::hrc_t last_garbage_collection_;
 
             bool discard_until_key_frame_ = true;
+
+            /* set between begin_frame() and end_frame() */
+            bool frame_open_ = false;
         };
     }
 }
@@ -6,20 +6,59 @@
 #include "uvgrtp/socket.hh"
 #include "uvgrtp/debug.hh"
 
-#include <map>
+#include <algorithm>
+#include <cstring>
 #include <unordered_map>
 
 
+constexpr int GARBAGE_COLLECTION_INTERVAL_MS = 100;
 
-#define INVALID_SEQ 0xffffffff
+/* How many completed or dropped frames are remembered for detecting late fragments */
+constexpr size_t MAX_FINISHED_FRAMES = 64;
+
+/* Flags stored with the timestamp of a received packet in media_frame_info_t::received */
+constexpr uint64_t SLOT_RECEIVED  = 1ULL << 32;
+constexpr uint64_t SLOT_FRAME_END = 1ULL << 33;
+
+/* Return the frames in "minfo->ready" from the packet handler */
+static rtp_error_t return_ready(uvgrtp::formats::media_frame_info_t *minfo, uvgrtp::frame::rtp_frame **out)
+{
+    *out = nullptr;
+
+    if (minfo->ready.empty())
+        return RTP_OK;
+
+    if (minfo->ready.size() > 1)
+        return RTP_MULTIPLE_PKTS_READY;
+
+    *out = minfo->ready.front();
+    minfo->ready.pop_front();
+    return RTP_PKT_READY;
+}
 
 uvgrtp::formats::media::media(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp_ctx, int flags):
     socket_(socket), rtp_ctx_(rtp_ctx), flags_(flags), fqueue_(new uvgrtp::frame_queue(socket, rtp_ctx, flags)), minfo_()
-{}
+{
+    minfo_.rtp_ctx = rtp_ctx;
+    minfo_.last_gc = uvgrtp::clock::hrc::now();
+
+    if (flags_ & RCE_FRAGMENT_GENERIC) {
+        minfo_.fragments.resize(UINT16_MAX + 1, nullptr);
+        minfo_.received.resize(UINT16_MAX + 1, 0);
+    }
+}
 
 uvgrtp::formats::media::~media()
 {
     fqueue_ = nullptr;
+
+    for (auto& fragment : minfo_.fragments) {
+        if (fragment)
+            (void)uvgrtp::frame::dealloc_frame(fragment);
+    }
+
+    for (auto& frame : minfo_.ready)
+        (void)uvgrtp::frame::dealloc_frame(frame);
 }
 
 rtp_error_t uvgrtp::formats::media::push_frame(uint8_t *data, size_t data_len, int flags)
@@ -38,6 +77,28 @@ rtp_error_t uvgrtp::formats::media::push_frame(std::unique_ptr<uint8_t[]> data,
     return push_media_frame(data.get(), data_len, flags);
 }
 
+rtp_error_t uvgrtp::formats::media::begin_frame()
+{
+    LOG_ERROR("Incremental sending is not supported by this format");
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::push_nal(uint8_t *data, size_t data_len, int flags)
+{
+    (void)data;
+    (void)data_len;
+    (void)flags;
+
+    LOG_ERROR("Incremental sending is not supported by this format");
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::end_frame()
+{
+    LOG_ERROR("Incremental sending is not supported by this format");
+    return RTP_NOT_SUPPORTED;
+}
+
 rtp_error_t uvgrtp::formats::media::push_media_frame(uint8_t *data, size_t data_len, int flags)
 {
     (void)flags;
@@ -94,73 +155,254 @@ uvgrtp::formats::media_frame_info_t *uvgrtp::formats::media::get_media_frame_inf
     return &minfo_;
 }
 
+rtp_error_t uvgrtp::formats::media::frame_getter(void *arg, uvgrtp::frame::rtp_frame **frame)
+{
+    auto minfo = (uvgrtp::formats::media_frame_info_t *)arg;
+
+    if (minfo->ready.empty())
+        return RTP_NOT_FOUND;
+
+    *frame = minfo->ready.front();
+    minfo->ready.pop_front();
+    return RTP_PKT_READY;
+}
+
 rtp_error_t uvgrtp::formats::media::packet_handler(void *arg, int flags, uvgrtp::frame::rtp_frame **out)
 {
     auto minfo   = (uvgrtp::formats::media_frame_info_t *)arg;
     auto frame   = *out;
     uint32_t ts  = frame->header.timestamp;
-    uint32_t seq = frame->header.seq;
-    size_t recv  = 0;
+    uint16_t seq = frame->header.seq;
 
     /* If fragmentation of generic frame has not been enabled, we can just return the frame
      * in "out" because RTP packet handler has done all the necessasry stuff for small RTP packets */
-    if (!(flags & RCE_FRAGMENT_GENERIC))
+    if (!(flags & RCE_FRAGMENT_GENERIC) || minfo->fragments.empty())
         return RTP_PKT_READY;
 
-    if (minfo->frames.find(ts) != minfo->frames.end()) {
-        minfo->frames[ts].npkts++;
-        minfo->frames[ts].size += frame->payload_len;
-
-        if (seq < minfo->frames[ts].s_seq)
-            minfo->frames[ts].fragments[seq + 0x10000] = frame;
-        else
-            minfo->frames[ts].fragments[seq] = frame;
-
-        *out = nullptr;
-
-        if (frame->header.marker)
-            minfo->frames[ts].e_seq = seq;
-
-        if (minfo->frames[ts].e_seq != INVALID_SEQ && minfo->frames[ts].s_seq != INVALID_SEQ) {
-            if (minfo->frames[ts].s_seq > minfo->frames[ts].e_seq)
-                recv = 0xffff - minfo->frames[ts].s_seq + minfo->frames[ts].e_seq + 2;
-            else
-                recv = minfo->frames[ts].e_seq - minfo->frames[ts].s_seq + 1;
-
-            if (recv == minfo->frames[ts].npkts) {
-                auto retframe = uvgrtp::frame::alloc_rtp_frame(minfo->frames[ts].size);
-                size_t ptr    = 0;
-
-                std::memcpy(&retframe->header, &frame->header, sizeof(frame->header));
-
-                for (auto& frag : minfo->frames[ts].fragments) {
-                    std::memcpy(
-                        retframe->payload + ptr,
-                        frag.second->payload,
-                        frag.second->payload_len
-                    );
-                    ptr += frag.second->payload_len;
-                    (void)uvgrtp::frame::dealloc_frame(frag.second);
-                }
-
-                minfo->frames.erase(ts);
-                (void)uvgrtp::frame::dealloc_frame(*out);
-                *out = retframe;
-                return RTP_PKT_READY;
+    garbage_collect_lost_frames(minfo, minfo->rtp_ctx->get_pkt_max_delay());
+
+    /* forget the packet received half of the sequence number space ago */
+    minfo->received[(uint16_t)(seq + 0x8000)] = 0;
+    minfo->received[seq] = SLOT_RECEIVED | ts;
+
+    bool first = !minfo->started;
+    minfo->started = true;
+
+    auto it = minfo->frames.find(ts);
+
+    if (it == minfo->frames.end()) {
+        for (auto& finished : minfo->finished) {
+            if (finished.ts == ts && (uint16_t)(seq - finished.s_seq) < finished.npkts) {
+                LOG_DEBUG("Fragment of a finished frame was received! Timestamp: %u", ts);
+                minfo->stats.late_fragments++;
+                (void)uvgrtp::frame::dealloc_frame(frame);
+                *out = nullptr;
+                return RTP_GENERIC_ERROR;
             }
         }
-    } else {
-        if (frame->header.marker) {
-            minfo->frames[ts].npkts          = 1;
-            minfo->frames[ts].s_seq          = seq;
-            minfo->frames[ts].e_seq          = INVALID_SEQ;
-            minfo->frames[ts].fragments[seq] = frame;
-            minfo->frames[ts].size           = frame->payload_len;
-            *out                             = nullptr;
-        } else {
-            return RTP_PKT_READY;
+
+        /* Only the first and the last fragment have the marker bit set. An unmarked packet that
+         * doesn't belong to an active frame is either a complete frame or a fragment that arrived
+         * before the first one. If its neighbours don't tell which, it waits for them like a fragment */
+        if (!frame->header.marker && (first || is_complete_packet(minfo, seq, ts))) {
+            minfo->received[seq] |= SLOT_FRAME_END;
+
+            release_packet(minfo, (uint16_t)(seq - 1), ts);
+            minfo->ready.push_back(frame);
+            release_packet(minfo, (uint16_t)(seq + 1), ts);
+
+            return return_ready(minfo, out);
         }
+
+        it = minfo->frames.emplace(ts, media_info_t()).first;
+        it->second.sframe_time = uvgrtp::clock::hrc::now();
+        it->second.base        = seq;
+    }
+
+    media_info_t& info = it->second;
+    uvgrtp::frame::rtp_frame *prev = minfo->fragments[seq];
+
+    if (prev) {
+        if (prev->header.timestamp == ts) {
+            LOG_DEBUG("Detected duplicate fragment, dropping! Seq: %u", seq);
+            minfo->stats.duplicate_fragments++;
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            *out = nullptr;
+            return RTP_GENERIC_ERROR;
+        }
+
+        /* The window has wrapped around and the slot still holds a fragment of an
+         * old frame, the old frame cannot be completed anymore */
+        drop_frame(minfo, prev->header.timestamp);
+    }
+
+    minfo->fragments[seq] = frame;
+    *out = nullptr;
+
+    if (frame->header.marker && info.nmarked < 2)
+        info.marked[info.nmarked++] = seq;
+
+    int32_t off = (int16_t)(uint16_t)(seq - info.base);
+
+    info.min_off = std::min(info.min_off, off);
+    info.max_off = std::max(info.max_off, off);
+    info.npkts++;
+    info.size += frame->payload_len;
+
+    /* a packet waiting next to this fragment is not a part of this frame */
+    release_packet(minfo, (uint16_t)(seq - 1), ts);
+
+    if (info.nmarked < 2) {
+        release_packet(minfo, (uint16_t)(seq + 1), ts);
+        return return_ready(minfo, out);
+    }
+
+    /* The start of the frame is the marked fragment from which the other one is
+     * reached by moving forward in the sequence number space */
+    uint16_t s_seq = info.marked[0];
+    uint16_t e_seq = info.marked[1];
+
+    if ((uint16_t)(e_seq - s_seq) >= 0x8000)
+        std::swap(s_seq, e_seq);
+
+    size_t expected = (size_t)(uint16_t)(e_seq - s_seq) + 1;
+
+    if (info.npkts < expected) {
+        release_packet(minfo, (uint16_t)(seq + 1), ts);
+        return return_ready(minfo, out);
+    }
+
+    minfo->ready.push_back(reconstruct_frame(minfo, ts, s_seq, expected));
+    minfo->received[e_seq] |= SLOT_FRAME_END;
+
+    release_packet(minfo, (uint16_t)(seq + 1), ts);
+    release_packet(minfo, (uint16_t)(e_seq + 1), ts);
+
+    return return_ready(minfo, out);
+}
+
+bool uvgrtp::formats::media::is_complete_packet(media_frame_info_t *minfo, uint16_t seq, uint32_t ts)
+{
+    for (uint64_t neighbour : { minfo->received[(uint16_t)(seq - 1)], minfo->received[(uint16_t)(seq + 1)] }) {
+        if ((neighbour & SLOT_RECEIVED) && ((uint32_t)neighbour != ts || (neighbour & SLOT_FRAME_END)))
+            return true;
+    }
+
+    return false;
+}
+
+void uvgrtp::formats::media::release_packet(media_frame_info_t *minfo, uint16_t seq, uint32_t ts)
+{
+    auto packet = minfo->fragments[seq];
+
+    if (!packet || packet->header.timestamp == ts)
+        return;
+
+    auto it = minfo->frames.find(packet->header.timestamp);
+
+    if (it == minfo->frames.end() || it->second.nmarked || it->second.npkts != 1)
+        return;
+
+    minfo->fragments[seq] = nullptr;
+    minfo->frames.erase(it);
+    minfo->received[seq] |= SLOT_FRAME_END;
+    minfo->ready.push_back(packet);
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::formats::media::reconstruct_frame(media_frame_info_t *minfo, uint32_t ts,
+    uint16_t s_seq, size_t npkts)
+{
+    auto retframe = uvgrtp::frame::alloc_rtp_frame(minfo->frames[ts].size);
+    size_t ptr    = 0;
+
+    for (size_t i = 0; i < npkts; ++i) {
+        uint16_t seq  = (uint16_t)(s_seq + i);
+        auto fragment = minfo->fragments[seq];
+
+        /* the header of the last fragment is used for the complete frame */
+        if (i == npkts - 1)
+            std::memcpy(&retframe->header, &fragment->header, sizeof(fragment->header));
+
+        std::memcpy(retframe->payload + ptr, fragment->payload, fragment->payload_len);
+        ptr += fragment->payload_len;
+
+        (void)uvgrtp::frame::dealloc_frame(fragment);
+        minfo->fragments[seq] = nullptr;
+    }
+
+    minfo->stats.completed_frames++;
+    finish_frame(minfo, ts, s_seq, npkts);
+
+    return retframe;
+}
+
+void uvgrtp::formats::media::drop_frame(media_frame_info_t *minfo, uint32_t ts)
+{
+    auto it = minfo->frames.find(ts);
+
+    if (it == minfo->frames.end())
+        return;
+
+    media_info_t& info = it->second;
+    size_t removed     = 0;
+
+    /* only the sequence number range of the received fragments is scanned */
+    for (int32_t off = info.min_off; off <= info.max_off; ++off) {
+        uint16_t seq = (uint16_t)(info.base + off);
+
+        if (minfo->fragments[seq] && minfo->fragments[seq]->header.timestamp == ts) {
+            (void)uvgrtp::frame::dealloc_frame(minfo->fragments[seq]);
+            minfo->fragments[seq] = nullptr;
+            ++removed;
+        }
+    }
+
+    /* The ends of the frame that have not been received are outside the received range */
+    size_t expected = (size_t)(info.max_off - info.min_off + 1) + (2 - info.nmarked);
+    minfo->stats.lost_fragments += expected - removed;
+
+    minfo->stats.dropped_frames++;
+    finish_frame(minfo, ts, (uint16_t)(info.base + info.min_off), (size_t)(info.max_off - info.min_off + 1));
+}
+
+void uvgrtp::formats::media::finish_frame(media_frame_info_t *minfo, uint32_t ts, uint16_t s_seq, size_t npkts)
+{
+    media_finished_t finished;
+
+    finished.ts    = ts;
+    finished.s_seq = s_seq;
+    finished.npkts = npkts;
+
+    minfo->frames.erase(ts);
+    minfo->finished.push_back(finished);
+
+    if (minfo->finished.size() > MAX_FINISHED_FRAMES)
+        minfo->finished.pop_front();
+}
+
+void uvgrtp::formats::media::garbage_collect_lost_frames(media_frame_info_t *minfo, size_t timeout)
+{
+    if (uvgrtp::clock::hrc::diff_now(minfo->last_gc) < GARBAGE_COLLECTION_INTERVAL_MS)
+        return;
+
+    std::vector<uint32_t> to_remove;
+
+    for (auto& gc_frame : minfo->frames) {
+        if (uvgrtp::clock::hrc::diff_now(gc_frame.second.sframe_time) > timeout)
+            to_remove.push_back(gc_frame.first);
+    }
+
+    for (auto& old_frame : to_remove) {
+        LOG_WARN("Dropping a generic frame that has not been completed. Timestamp: %u", old_frame);
+        drop_frame(minfo, old_frame);
+    }
+
+    if (!to_remove.empty()) {
+        LOG_INFO("Generic frames: %llu completed, %llu dropped, %llu lost, %llu late and %llu duplicate fragments",
+            (unsigned long long)minfo->stats.completed_frames, (unsigned long long)minfo->stats.dropped_frames,
+            (unsigned long long)minfo->stats.lost_fragments, (unsigned long long)minfo->stats.late_fragments,
+            (unsigned long long)minfo->stats.duplicate_fragments);
     }
 
-    return RTP_OK;
+    minfo->last_gc = uvgrtp::clock::hrc::now();
 }
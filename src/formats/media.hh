@@ -1,11 +1,13 @@
 #pragma once
 
 #include "uvgrtp/util.hh"
+#include "uvgrtp/clock.hh"
 
-#include <map>
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
 namespace uvgrtp {
 
@@ -21,17 +23,80 @@ namespace uvgrtp {
 
         #define INVALID_TS            0xffffffff
 
+        /* Reassembly state of one fragmented generic frame.
+         *
+         * The first and the last fragment of a frame have the marker bit set and the fragments
+         * between them have consecutive sequence numbers. Which marked fragment is which is
+         * resolved from their sequence numbers so that reordering and sequence number
+         * wraparound are handled correctly */
         typedef struct media_info {
-            uint32_t s_seq = 0;
-            uint32_t e_seq = 0;
+            /* clock reading when the first fragment is received */
+            uvgrtp::clock::hrc::hrc_t sframe_time;
+
+            /* sequence number of the first received fragment */
+            uint16_t base = 0;
+
+            /* sequence numbers of the fragments with marker bit set */
+            uint16_t marked[2] = { 0, 0 };
+            size_t nmarked = 0;
+
+            /* range of the received fragments relative to "base" */
+            int32_t min_off = 0;
+            int32_t max_off = 0;
+
             size_t npkts = 0;
             size_t size = 0;
-            std::map<uint32_t, uvgrtp::frame::rtp_frame *> fragments;
         } media_info_t;
 
+        /* Sequence number range of a completed or dropped frame.
+         * Timestamps alone don't identify generic frames as consecutive frames may share one */
+        typedef struct media_finished {
+            uint32_t ts = 0;
+            uint16_t s_seq = 0;
+            size_t npkts = 0;
+        } media_finished_t;
+
+        /* Counters of the generic frame reassembly, read by the application
+         * with media_stream::get_reassembly_statistics() */
+        typedef struct media_frame_stats {
+            std::atomic<uint64_t> completed_frames{0};
+            std::atomic<uint64_t> dropped_frames{0};
+
+            /* fragments received after their frame was completed or dropped */
+            std::atomic<uint64_t> late_fragments{0};
+
+            /* fragments that had not been received when their frame was dropped.
+             * If the ends of the frame were never received, only the fragments known to be missing are counted */
+            std::atomic<uint64_t> lost_fragments{0};
+
+            std::atomic<uint64_t> duplicate_fragments{0};
+        } media_frame_stats_t;
+
         typedef struct media_frame_info {
-            std::unordered_map<uint32_t, media_info> frames;
-            std::unordered_set<uint32_t> dropped;
+            std::unordered_map<uint32_t, media_info_t> frames;
+
+            /* Received fragments indexed by their sequence number.
+             * Allocated only if RCE_FRAGMENT_GENERIC has been given */
+            std::vector<uvgrtp::frame::rtp_frame *> fragments;
+
+            /* Recently completed or dropped frames, used to detect late fragments */
+            std::deque<media_finished_t> finished;
+
+            /* Timestamp of the packet received with each sequence number together with the
+             * SLOT_RECEIVED and SLOT_FRAME_END flags. An unmarked packet that doesn't belong
+             * to an active frame is a complete frame if its neighbours tell so */
+            std::vector<uint64_t> received;
+            bool started = false;
+
+            /* Frames that are ready to be returned by frame_getter() */
+            std::deque<uvgrtp::frame::rtp_frame *> ready;
+
+            uvgrtp::clock::hrc::hrc_t last_gc;
+
+            /* How long the fragments of a frame are waited */
+            std::shared_ptr<uvgrtp::rtp> rtp_ctx;
+
+            media_frame_stats_t stats;
         } media_frame_info_t;
 
         class media {
@@ -47,6 +112,15 @@ namespace uvgrtp {
                 rtp_error_t push_frame(uint8_t *data, size_t data_len, int flags);
                 rtp_error_t push_frame(std::unique_ptr<uint8_t[]> data, size_t data_len, int flags);
 
+                /* Incremental sending of a frame, see uvgrtp::media_stream::begin_frame()
+                 *
+                 * The default implementation does not support it, media that does should override these
+                 *
+                 * Return RTP_NOT_SUPPORTED */
+                virtual rtp_error_t begin_frame();
+                virtual rtp_error_t push_nal(uint8_t *data, size_t data_len, int flags);
+                virtual rtp_error_t end_frame();
+
                 /* Media-specific packet handler. The default handler, depending on what "flags_" contains,
                  * may only return the received RTP packet or it may merge multiple packets together before
                  * returning a complete frame to the user.
@@ -59,6 +133,12 @@ namespace uvgrtp {
                  * Return RTP_GENERIC_ERROR if the packet was corrupted in some way */
                 static rtp_error_t packet_handler(void *arg, int flags, frame::rtp_frame **frame);
 
+                /* Return the next frame completed by packet_handler() when it returned RTP_MULTIPLE_PKTS_READY
+                 *
+                 * Return RTP_PKT_READY if "frame" was set
+                 * Return RTP_NOT_FOUND if there are no more frames */
+                static rtp_error_t frame_getter(void *arg, frame::rtp_frame **frame);
+
                 /* Return pointer to the internal frame info structure which is relayed to packet handler */
                 media_frame_info_t *get_media_frame_info();
 
@@ -71,6 +151,29 @@ namespace uvgrtp {
                 std::unique_ptr<uvgrtp::frame_queue> fqueue_;
 
             private:
+                /* Remove all fragments of frame "ts" from the reassembly window
+                 * and remember it so that its late fragments can be discarded */
+                static void drop_frame(media_frame_info_t *minfo, uint32_t ts);
+                static void finish_frame(media_frame_info_t *minfo, uint32_t ts, uint16_t s_seq, size_t npkts);
+
+                /* Drop the frames that have not been completed within "timeout" milliseconds */
+                static void garbage_collect_lost_frames(media_frame_info_t *minfo, size_t timeout);
+
+                /* Return true if the unmarked packet "seq" with timestamp "ts" that doesn't belong to
+                 * an active frame is a complete frame: a fragment in the middle of a frame is surrounded
+                 * by fragments with the same timestamp */
+                static bool is_complete_packet(media_frame_info_t *minfo, uint16_t seq, uint32_t ts);
+
+                /* If an unmarked packet waiting at "seq" for its neighbours is the only packet of its frame
+                 * and its timestamp differs from "ts", it is a complete frame. Move it to "ready" */
+                static void release_packet(media_frame_info_t *minfo, uint16_t seq, uint32_t ts);
+
+                /* Copy the fragments of a completed frame to a new frame
+                 *
+                 * Return pointer to the new frame */
+                static uvgrtp::frame::rtp_frame *reconstruct_frame(media_frame_info_t *minfo, uint32_t ts,
+                    uint16_t s_seq, size_t npkts);
+
                 media_frame_info_t minfo_;
         };
     }
@@ -57,7 +57,7 @@ rtp_error_t uvgrtp::frame::dealloc_frame(uvgrtp::frame::rtp_frame *frame)
     if (frame->csrc)
         delete[] frame->csrc;
 
-    if (frame->ext) {
+    if (frame->ext && frame->ext != &frame->ext_inline) {
         delete[] frame->ext->data;
         delete frame->ext;
     }
@@ -74,6 +74,121 @@ rtp_error_t uvgrtp::frame::dealloc_frame(uvgrtp::frame::rtp_frame *frame)
     return RTP_OK;
 }
 
+const uvgrtp::frame::ext_element *uvgrtp::frame::get_ext_element(const uvgrtp::frame::rtp_frame *frame, uint8_t id)
+{
+    if (!frame)
+        return nullptr;
+
+    for (size_t i = 0; i < frame->ext_count; ++i) {
+        if (frame->ext_elements[i].id == id)
+            return &frame->ext_elements[i];
+    }
+
+    return nullptr;
+}
+
+uvgrtp::frame::rtcp_sender_info uvgrtp::frame::get_sender_info(const uvgrtp::frame::rtcp_report_view& view)
+{
+    uvgrtp::frame::rtcp_sender_info info;
+
+    if (view.sender_info)
+    {
+        info.ntp_msw  = ntohl(*(uint32_t *)&view.sender_info[0]);
+        info.ntp_lsw  = ntohl(*(uint32_t *)&view.sender_info[4]);
+        info.rtp_ts   = ntohl(*(uint32_t *)&view.sender_info[8]);
+        info.pkt_cnt  = ntohl(*(uint32_t *)&view.sender_info[12]);
+        info.byte_cnt = ntohl(*(uint32_t *)&view.sender_info[16]);
+    }
+
+    return info;
+}
+
+uvgrtp::frame::rtcp_report_block uvgrtp::frame::get_report_block(const uvgrtp::frame::rtcp_report_view& view, size_t index)
+{
+    /* each report block is 24 bytes */
+    const uint8_t *block = view.report_blocks + index * 24;
+    uvgrtp::frame::rtcp_report_block report;
+
+    report.ssrc     = ntohl(*(uint32_t *)&block[0]);
+    report.fraction = ntohl(*(uint32_t *)&block[4]) >> 24;
+    report.lost     = ntohl(*(uint32_t *)&block[4]) & 0xffffff;
+    report.last_seq = ntohl(*(uint32_t *)&block[8]);
+    report.jitter   = ntohl(*(uint32_t *)&block[12]);
+    report.lsr      = ntohl(*(uint32_t *)&block[16]);
+    report.dlsr     = ntohl(*(uint32_t *)&block[20]);
+
+    return report;
+}
+
+std::vector<bool> uvgrtp::frame::get_rle_packets(const uvgrtp::frame::rtcp_xr_rle_block& block)
+{
+    size_t packets = (uint16_t)(block.end_seq - block.begin_seq);
+    std::vector<bool> values;
+
+    values.reserve(packets);
+
+    for (auto& chunk : block.chunks)
+    {
+        /* a null chunk only pads the block */
+        if (chunk == 0 || values.size() >= packets)
+        {
+            break;
+        }
+
+        if (chunk & 0x8000)
+        {
+            /* bit vector chunk, the most significant bit is the first packet */
+            for (int bit = 14; bit >= 0 && values.size() < packets; --bit)
+            {
+                values.push_back((chunk >> bit) & 0x1);
+            }
+        }
+        else
+        {
+            /* run length chunk */
+            bool value = (chunk >> 14) & 0x1;
+
+            for (size_t i = 0; i < (size_t)(chunk & 0x3fff) && values.size() < packets; ++i)
+            {
+                values.push_back(value);
+            }
+        }
+    }
+
+    return values;
+}
+
+std::vector<uint16_t> uvgrtp::frame::get_nack_packets(const uvgrtp::frame::rtcp_fb_packet& packet)
+{
+    std::vector<uint16_t> lost;
+
+    if (packet.header.pkt_type != uvgrtp::frame::RTCP_FT_RTPFB ||
+        packet.header.count != uvgrtp::frame::RTCP_RTPFB_NACK)
+    {
+        return lost;
+    }
+
+    /* each FCI entry is the PID of a lost packet followed by a bitmask
+     * of the losses among the 16 packets that follow it */
+    for (size_t i = 0; i + 4 <= packet.fci.size(); i += 4)
+    {
+        uint16_t pid = ntohs(*(uint16_t *)&packet.fci[i]);
+        uint16_t blp = ntohs(*(uint16_t *)&packet.fci[i + 2]);
+
+        lost.push_back(pid);
+
+        for (int bit = 0; bit < 16; ++bit)
+        {
+            if (blp & (1 << bit))
+            {
+                lost.push_back((uint16_t)(pid + bit + 1));
+            }
+        }
+    }
+
+    return lost;
+}
+
 uvgrtp::frame::zrtp_frame *uvgrtp::frame::alloc_zrtp_frame(size_t size)
 {
     if (size == 0) {
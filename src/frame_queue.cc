@@ -76,7 +76,6 @@ rtp_error_t uvgrtp::frame_queue::init_transaction()
         active_->headers     = nullptr;
         active_->chunks      = nullptr;
 #endif
-        active_->rtp_headers = new uvgrtp::frame::rtp_header[max_mcount_];
 
         switch (rtp_->get_payload()) {
             case RTP_FORMAT_H264:
@@ -104,21 +103,35 @@ rtp_error_t uvgrtp::frame_queue::init_transaction()
     active_->hdr_ptr     = 0;
     active_->rtphdr_ptr  = 0;
     active_->rtpauth_ptr = 0;
+    active_->pkts_sent   = 0;
+    active_->pkt_held    = false;
     active_->fqueue      = this;
 
     active_->data_raw     = nullptr;
     active_->data_smart   = nullptr;
     active_->dealloc_hook = dealloc_hook_;
 
-    if (flags_ & RCE_SRTP_AUTHENTICATE_RTP)
-        active_->rtp_auth_tags = new uint8_t[10 * max_mcount_];
-    else
-        active_->rtp_auth_tags = nullptr;
+    /* a reused transaction already has the buffer */
+    if (uvgrtp::base_srtp::get_rtp_trailer_length(flags_) && !active_->rtp_auth_tags)
+        active_->rtp_auth_tags = new uint8_t[uvgrtp::base_srtp::get_rtp_trailer_length(flags_) * max_mcount_];
 
     active_->out_addr = socket_->get_out_address();
     rtp_->fill_header((uint8_t *)&active_->rtp_common);
     active_->buffers.clear();
 
+    /* Header extensions are serialized once per transaction and copied to each packet */
+    active_->rtp_ext_len = rtp_->fill_extensions(active_->rtp_ext);
+    active_->rtphdr_size = uvgrtp::frame::HEADER_SIZE_RTP + active_->rtp_ext_len;
+
+    if (active_->rtp_ext_len)
+        ((uint8_t *)&active_->rtp_common)[0] |= (1 << 4);
+
+    if (active_->rtphdr_size > active_->rtphdr_alloc_size) {
+        delete[] active_->rtp_headers;
+        active_->rtp_headers       = new uint8_t[active_->rtphdr_size * max_mcount_];
+        active_->rtphdr_alloc_size = active_->rtphdr_size;
+    }
+
     return RTP_OK;
 }
 
@@ -171,10 +184,16 @@ rtp_error_t uvgrtp::frame_queue::destroy_transaction(uvgrtp::transaction_t *t)
     if (t->rtp_auth_tags)
         delete[] t->rtp_auth_tags;
 
-    t->headers       = nullptr;
-    t->chunks        = nullptr;
-    t->rtp_headers   = nullptr;
-    t->rtp_auth_tags = nullptr;
+    if (t->held_pkt)
+        delete[] t->held_pkt;
+
+    t->headers           = nullptr;
+    t->chunks            = nullptr;
+    t->rtp_headers       = nullptr;
+    t->rtphdr_size       = 0;
+    t->rtphdr_alloc_size = 0;
+    t->rtp_auth_tags     = nullptr;
+    t->held_pkt          = nullptr;
 
     if (t->media_headers)
     {
@@ -227,8 +246,11 @@ rtp_error_t uvgrtp::frame_queue::deinit_transaction(uint32_t key)
     if (active_ && active_->key == key) {
         /* free all temporary buffers */
         if ((flags_ & (RCE_SRTP | RCE_SRTP_INPLACE_ENCRYPTION | RCE_SRTP_NULL_CIPHER)) == RCE_SRTP) {
+            /* the MKI and authentication tag are stored in "rtp_auth_tags" */
+            size_t trailer = uvgrtp::base_srtp::get_rtp_trailer_length(flags_) ? 1 : 0;
+
             for (auto& packet : active_->packets) {
-                for (size_t i = 1; i < packet.size(); ++i) {
+                for (size_t i = 1; i < packet.size() - trailer; ++i) {
                     delete[] packet[i].second;
                 }
             }
@@ -270,6 +292,7 @@ rtp_error_t uvgrtp::frame_queue::deinit_transaction(uint32_t key)
         delete[] transaction_it->second->headers;
         delete[] transaction_it->second->chunks;
         delete[] transaction_it->second->rtp_headers;
+        delete[] transaction_it->second->held_pkt;
         delete   transaction_it->second;
     } else {
         free_.push_back(transaction_it->second);
@@ -305,12 +328,12 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(uint8_t *message, size_t messag
     update_rtp_header();
 
     if (set_marker)
-        ((uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr])[1] |= (1 << 7);
+        get_rtp_header(active_->rtphdr_ptr)[1] |= (1 << 7);
 
     /* Push RTP header first and then push all payload buffers */
     tmp.push_back({
-        sizeof(active_->rtp_headers[active_->rtphdr_ptr]),
-        (uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr++]
+        active_->rtphdr_size,
+        get_rtp_header(active_->rtphdr_ptr++)
     });
 
     /* If SRTP with proper encryption has been enabled but
@@ -346,8 +369,8 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(std::vector<std::pair<size_t, u
 
     /* Push RTP header first and then push all payload buffers */
     tmp.push_back({
-        sizeof(active_->rtp_headers[active_->rtphdr_ptr]),
-        (uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr++]
+        active_->rtphdr_size,
+        get_rtp_header(active_->rtphdr_ptr++)
     });
 
     /* If SRTP with proper encryption is used and there are more than one buffer,
@@ -380,21 +403,35 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(std::vector<std::pair<size_t, u
 
 rtp_error_t uvgrtp::frame_queue::flush_queue()
 {
-    if (active_->packets.empty()) {
+    return flush_queue(active_ && active_->packets.size() > 1);
+}
+
+rtp_error_t uvgrtp::frame_queue::flush_queue(bool set_marker)
+{
+    if (active_->packets.size() <= active_->pkts_sent) {
         LOG_ERROR("Cannot send an empty packet!");
         (void)deinit_transaction();
         return RTP_INVALID_VALUE;
     }
 
     /* set the marker bit of the last packet to 1 */
-    if (active_->packets.size() > 1)
-        ((uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr - 1])[1] |= (1 << 7);
+    if (set_marker)
+        get_rtp_header(active_->rtphdr_ptr - 1)[1] |= (1 << 7);
 
     transaction_mtx_.lock();
     queued_.insert(std::make_pair(active_->key, active_));
     transaction_mtx_.unlock();
 
-    if (socket_->sendto(active_->packets, 0) != RTP_OK) {
+    rtp_error_t ret = RTP_OK;
+
+    if (active_->pkts_sent) {
+        uvgrtp::pkt_vec remaining(active_->packets.begin() + active_->pkts_sent, active_->packets.end());
+        ret = socket_->sendto(remaining, 0);
+    } else {
+        ret = socket_->sendto(active_->packets, 0);
+    }
+
+    if (ret != RTP_OK) {
         LOG_ERROR("Failed to flush the message queue: %s", strerror(errno));
         (void)deinit_transaction();
         return RTP_SEND_ERROR;
@@ -404,10 +441,50 @@ rtp_error_t uvgrtp::frame_queue::flush_queue()
     return deinit_transaction();
 }
 
+rtp_error_t uvgrtp::frame_queue::flush_queue_partial()
+{
+    if (!active_) {
+        LOG_ERROR("No active transaction");
+        return RTP_INVALID_VALUE;
+    }
+
+    size_t npkts = active_->packets.size();
+
+    /* nothing has been enqueued since the last call */
+    if (npkts == 0 || (active_->pkt_held && npkts == active_->pkts_sent + 1))
+        return RTP_OK;
+
+    if (npkts - 1 > active_->pkts_sent) {
+        uvgrtp::pkt_vec ready(active_->packets.begin() + active_->pkts_sent, active_->packets.end() - 1);
+
+        if (socket_->sendto(ready, 0) != RTP_OK) {
+            LOG_ERROR("Failed to flush the message queue: %s", strerror(errno));
+            return RTP_SEND_ERROR;
+        }
+        active_->pkts_sent = npkts - 1;
+    }
+
+    hold_packet(active_->packets.back());
+    active_->pkt_held = true;
+
+    return RTP_OK;
+}
+
 void uvgrtp::frame_queue::update_rtp_header()
 {
-    memcpy(&active_->rtp_headers[active_->rtphdr_ptr], &active_->rtp_common, sizeof(active_->rtp_common));
-    rtp_->update_sequence((uint8_t *)(&active_->rtp_headers[active_->rtphdr_ptr]));
+    uint8_t *header = get_rtp_header(active_->rtphdr_ptr);
+
+    memcpy(header, &active_->rtp_common, sizeof(active_->rtp_common));
+
+    if (active_->rtp_ext_len)
+        memcpy(header + sizeof(active_->rtp_common), active_->rtp_ext, active_->rtp_ext_len);
+
+    rtp_->update_sequence(header);
+}
+
+uint8_t *uvgrtp::frame_queue::get_rtp_header(size_t index)
+{
+    return active_->rtp_headers + index * active_->rtphdr_size;
 }
 
 uvgrtp::buf_vec* uvgrtp::frame_queue::get_buffer_vector()
@@ -447,10 +524,12 @@ void uvgrtp::frame_queue::install_dealloc_hook(void (*dealloc_hook)(void *))
 
 void uvgrtp::frame_queue::enqueue_finalize(uvgrtp::buf_vec& tmp)
 {
-    if (flags_ & RCE_SRTP_AUTHENTICATE_RTP) {
+    if (uvgrtp::base_srtp::get_rtp_trailer_length(flags_)) {
+        size_t trailer_len = uvgrtp::base_srtp::get_rtp_trailer_length(flags_);
+
         tmp.push_back({
-            UVG_AUTH_TAG_LENGTH,
-            (uint8_t*)&active_->rtp_auth_tags[10 * active_->rtpauth_ptr++]
+            trailer_len,
+            (uint8_t*)&active_->rtp_auth_tags[trailer_len * active_->rtpauth_ptr++]
             });
     }
 
@@ -458,3 +537,36 @@ void uvgrtp::frame_queue::enqueue_finalize(uvgrtp::buf_vec& tmp)
     rtp_->inc_sequence();
     rtp_->inc_sent_pkts();
 }
+
+void uvgrtp::frame_queue::hold_packet(uvgrtp::buf_vec& packet)
+{
+    /* SRTP has already copied the payload to a buffer owned by the transaction */
+    if ((flags_ & (RCE_SRTP | RCE_SRTP_INPLACE_ENCRYPTION | RCE_SRTP_NULL_CIPHER)) == RCE_SRTP)
+        return;
+
+    size_t trailer  = uvgrtp::base_srtp::get_rtp_trailer_length(flags_) ? 1 : 0;
+    size_t total    = 0;
+
+    for (size_t i = 1; i < packet.size() - trailer; ++i)
+        total += packet[i].first;
+
+    if (total > active_->held_pkt_size) {
+        delete[] active_->held_pkt;
+        active_->held_pkt      = new uint8_t[total];
+        active_->held_pkt_size = total;
+    }
+
+    uint8_t *ptr = active_->held_pkt;
+
+    for (size_t i = 1; i < packet.size() - trailer; ++i) {
+        memcpy(ptr, packet[i].second, packet[i].first);
+        ptr += packet[i].first;
+    }
+
+    uvgrtp::buf_vec held = { packet[0], { total, active_->held_pkt } };
+
+    if (trailer)
+        held.push_back(packet.back());
+
+    packet = held;
+}
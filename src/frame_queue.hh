@@ -50,7 +50,17 @@ namespace uvgrtp {
          * Keeping a separate common RTP header and then just copying this is cleaner than initializing
          * RTP header for each packet */
         uvgrtp::frame::rtp_header rtp_common;
-        uvgrtp::frame::rtp_header *rtp_headers = nullptr;
+
+        /* Header extension block shared by all packets of the transaction, if any */
+        uint8_t rtp_ext[2 * sizeof(uint16_t) + uvgrtp::frame::RTP_EXT_MAX_DATA_SIZE];
+        size_t rtp_ext_len = 0;
+
+        /* RTP headers of the packets. Each header occupies "rtphdr_size" bytes
+         * (12-byte RTP header followed by the extension block) and the area is
+         * reallocated only if the transaction is reused with a larger extension block */
+        uint8_t *rtp_headers = nullptr;
+        size_t rtphdr_size = 0;
+        size_t rtphdr_alloc_size = 0;
 
 #ifndef _WIN32
         struct mmsghdr *headers = nullptr;
@@ -67,9 +77,17 @@ namespace uvgrtp {
          * See src/formats/hevc.hh for example */
         void *media_headers = nullptr;
 
-        /* Pointer to RTP authentication (if enabled) */
+        /* MKIs and RTP authentication tags (if enabled) of the packets */
         uint8_t *rtp_auth_tags = nullptr;
 
+        /* When a frame is sent incrementally (see flush_queue_partial()), "pkts_sent" tells
+         * how many packets of the transaction have already been sent and "held_pkt" stores the
+         * payload of the last packet which is held back until the marker bit is known */
+        size_t pkts_sent = 0;
+        bool pkt_held = false;
+        uint8_t *held_pkt = nullptr;
+        size_t held_pkt_size = 0;
+
         size_t chunk_ptr = 0;
         size_t hdr_ptr = 0;
         size_t rtphdr_ptr = 0;
@@ -133,11 +151,27 @@ namespace uvgrtp {
             rtp_error_t enqueue_message(buf_vec& buffers);
 
             /* Flush the message queue
+             *
+             * If "set_marker" is given, it determines whether the marker bit of the last packet
+             * is set. Otherwise the marker bit is set only if the transaction contains more than one packet
              *
              * Return RTP_OK on success
              * Return RTP_INVALID_VALUE if "sender" is nullptr or message buffer is empty
              * return RTP_SEND_ERROR if send fails */
             rtp_error_t flush_queue();
+            rtp_error_t flush_queue(bool set_marker);
+
+            /* Send all but the last enqueued packet of the active transaction and keep the transaction open
+             *
+             * The last packet is held back so that its marker bit can still be set by flush_queue().
+             * Its payload is copied to the transaction so the caller may release the memory it
+             * enqueued as soon as this function returns. If flush_queue_partial() has been called,
+             * flush_queue() sends only the packets that have not been sent yet
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if there is no active transaction
+             * Return RTP_SEND_ERROR if send fails */
+            rtp_error_t flush_queue_partial();
 
             /* Media may have extra headers (f.ex. NAL and FU headers for HEVC).
              * These headers must be valid until the message is sent (ie. they cannot be saved to
@@ -156,6 +190,9 @@ namespace uvgrtp {
             /* Update the active task's current packet's sequence number */
             void update_rtp_header();
 
+            /* Return pointer to the RTP header of "index"th packet of active transaction */
+            uint8_t *get_rtp_header(size_t index);
+
             /* Because frame queue supports both raw and smart pointers and the smart pointer ownership
              * is transferred to active transaction, the code that created the transaction must query
              * the data pointer from frame queue explicitly
@@ -180,6 +217,9 @@ namespace uvgrtp {
 
             void enqueue_finalize(uvgrtp::buf_vec& tmp);
 
+            /* Copy the payload of "packet" to the held packet buffer of the active transaction */
+            void hold_packet(uvgrtp::buf_vec& packet);
+
             /* Both the application and SCD access "free_" and "queued_" structures so the
              * access must be protected by a mutex
              *
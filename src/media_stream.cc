@@ -16,19 +16,25 @@
 #include "srtp/srtp.hh"
 #include "formats/media.hh"
 
+#include <chrono>
 #include <cstring>
 #include <errno.h>
 
 uvgrtp::media_stream::media_stream(std::string cname, std::string addr, 
-    int src_port, int dst_port, rtp_format_t fmt, int flags):
+    int src_port, int dst_port, rtp_format_t fmt, int flags,
+    std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler):
     srtp_(nullptr),
     srtcp_(nullptr),
     socket_(nullptr),
     rtp_(nullptr),
     rtcp_(nullptr),
+    rtcp_scheduler_(rtcp_scheduler),
     ctx_config_(),
     media_config_(nullptr),
     initialized_(false),
+    zrtp_status_(RTP_NOT_SUPPORTED),
+    zrtp_hook_arg_(nullptr),
+    zrtp_hook_(nullptr),
     rtp_handler_key_(0),
     reception_flow_(nullptr),
     media_(nullptr),
@@ -49,15 +55,20 @@ uvgrtp::media_stream::media_stream(std::string cname, std::string addr,
 uvgrtp::media_stream::media_stream(std::string cname,
     std::string remote_addr, std::string local_addr,
     int src_port, int dst_port,
-    rtp_format_t fmt, int flags
+    rtp_format_t fmt, int flags,
+    std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler
 ):
-    media_stream(cname, remote_addr, src_port, dst_port, fmt, flags)
+    media_stream(cname, remote_addr, src_port, dst_port, fmt, flags, rtcp_scheduler)
 {
     laddr_ = local_addr;
 }
 
 uvgrtp::media_stream::~media_stream()
 {
+    /* the handshake cannot be interrupted, wait until it finishes or times out */
+    if (zrtp_thread_.joinable())
+        zrtp_thread_.join();
+
     if (reception_flow_)
     {
         reception_flow_->stop();
@@ -176,7 +187,7 @@ rtp_error_t uvgrtp::media_stream::create_media(rtp_format_t fmt)
                 rtp_handler_key_,
                 media_->get_media_frame_info(),
                 media_->packet_handler,
-                nullptr
+                media_->frame_getter
             );
             return RTP_OK;
 
@@ -247,8 +258,6 @@ rtp_error_t uvgrtp::media_stream::init()
 
 rtp_error_t uvgrtp::media_stream::init(std::shared_ptr<uvgrtp::zrtp> zrtp)
 {
-    rtp_error_t ret = RTP_OK;
-
     if (init_connection() != RTP_OK) {
         log_platform_error("Failed to initialize the underlying socket");
         return RTP_GENERIC_ERROR;
@@ -258,23 +267,71 @@ rtp_error_t uvgrtp::media_stream::init(std::shared_ptr<uvgrtp::zrtp> zrtp)
 
     rtp_ = std::shared_ptr<uvgrtp::rtp> (new uvgrtp::rtp(fmt_));
 
-    if ((ret = zrtp->init(rtp_->get_ssrc(), socket_, addr_out_)) != RTP_OK) {
+    /* The place in the queue is reserved here so that the streams of a session
+     * are keyed in the order in which they were created */
+    uint64_t ticket = zrtp->take_ticket();
+    zrtp_status_    = RTP_NOT_READY;
+
+    if (!(ctx_config_.flags & RCE_ZRTP_ASYNC))
+        return negotiate_zrtp(zrtp, ticket);
+
+    zrtp_thread_ = std::thread(&uvgrtp::media_stream::negotiate_zrtp, this, zrtp, ticket);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::negotiate_zrtp(std::shared_ptr<uvgrtp::zrtp> zrtp, uint64_t ticket)
+{
+    zrtp->wait_turn(ticket);
+    rtp_error_t ret = init_zrtp_keys(zrtp);
+    zrtp->end_turn();
+
+    void *arg = nullptr;
+    void (*hook)(void *, rtp_error_t) = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(zrtp_mtx_);
+        zrtp_status_ = ret;
+        arg          = zrtp_hook_arg_;
+        hook         = zrtp_hook_;
+    }
+    zrtp_cv_.notify_all();
+
+    if (hook)
+        hook(arg, ret);
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::init_zrtp_keys(std::shared_ptr<uvgrtp::zrtp> zrtp)
+{
+    rtp_error_t ret = RTP_OK;
+
+    /* Once the session has been keyed with Diffie-Hellman Mode, the stream
+     * performs its Multistream Mode handshake without blocking the other streams */
+    if (auto stream_zrtp = zrtp->multistream())
+        zrtp = stream_zrtp;
+
+    if ((ret = zrtp->init(rtp_->get_ssrc(), socket_, addr_out_, ctx_config_.flags)) != RTP_OK) {
         LOG_WARN("Failed to initialize ZRTP for media stream!");
         return free_resources(ret);
     }
 
-    srtp_ = std::shared_ptr<uvgrtp::srtp>(new uvgrtp::srtp(ctx_config_.flags));
-    if ((ret = init_srtp_with_zrtp(ctx_config_.flags, SRTP, srtp_, zrtp)) != RTP_OK)
-      return free_resources(ret);
+    /* Fall back to AES-CM and HMAC-SHA1 if remote does not support AES-GCM */
+    if ((ctx_config_.flags & RCE_SRTP_AES_GCM) && !zrtp->aead_negotiated()) {
+        LOG_INFO("Remote does not support AES-GCM, using AES-CM and HMAC-SHA1 instead");
+        ctx_config_.flags &= ~RCE_SRTP_AES_GCM;
+    }
 
+    srtp_  = std::shared_ptr<uvgrtp::srtp>(new uvgrtp::srtp(ctx_config_.flags));
     srtcp_ = std::shared_ptr<uvgrtp::srtcp> (new uvgrtp::srtcp());
-    if ((ret = init_srtp_with_zrtp(ctx_config_.flags, SRTCP, srtcp_, zrtp)) != RTP_OK)
+
+    if ((ret = init_srtp_with_zrtp(ctx_config_.flags, zrtp)) != RTP_OK)
       return free_resources(ret);
 
     rtcp_ = std::shared_ptr<uvgrtp::rtcp> (new uvgrtp::rtcp(rtp_, cname_, srtcp_, ctx_config_.flags));
 
     socket_->install_handler(rtcp_.get(), rtcp_->send_packet_handler_vec);
-    socket_->install_handler(srtp_.get(), srtp_->send_packet_handler);
+    socket_->install_handler(srtp_.get(), srtp_->send_packet_handler, srtp_->send_batch_handler);
 
     rtp_handler_key_  = reception_flow_->install_handler(rtp_->packet_handler);
     zrtp_handler_key_ = reception_flow_->install_handler(zrtp->packet_handler);
@@ -285,7 +342,49 @@ rtp_error_t uvgrtp::media_stream::init(std::shared_ptr<uvgrtp::zrtp> zrtp)
     return start_components();
 }
 
+rtp_error_t uvgrtp::media_stream::install_zrtp_hook(void *arg, void (*hook)(void *, rtp_error_t))
+{
+    if (!hook)
+        return RTP_INVALID_VALUE;
+
+    rtp_error_t status = RTP_OK;
+
+    {
+        std::lock_guard<std::mutex> lock(zrtp_mtx_);
+
+        if (zrtp_status_ == RTP_NOT_SUPPORTED)
+            return RTP_NOT_SUPPORTED;
+
+        if (zrtp_status_ == RTP_NOT_READY) {
+            zrtp_hook_arg_ = arg;
+            zrtp_hook_     = hook;
+            return RTP_OK;
+        }
+
+        status = zrtp_status_;
+    }
+
+    hook(arg, status);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::wait_for_zrtp(size_t timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(zrtp_mtx_);
+
+    if (!zrtp_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                           [this] { return zrtp_status_ != RTP_NOT_READY; }))
+        return RTP_TIMEOUT;
+
+    return zrtp_status_;
+}
+
 rtp_error_t uvgrtp::media_stream::add_srtp_ctx(uint8_t *key, uint8_t *salt)
+{
+    return add_srtp_ctx(key, salt, 0);
+}
+
+rtp_error_t uvgrtp::media_stream::add_srtp_ctx(uint8_t *key, uint8_t *salt, uint32_t mki)
 {
     if (!key || !salt)
         return RTP_INVALID_VALUE;
@@ -308,14 +407,14 @@ rtp_error_t uvgrtp::media_stream::add_srtp_ctx(uint8_t *key, uint8_t *salt)
     srtp_ = std::shared_ptr<uvgrtp::srtp> (new uvgrtp::srtp(ctx_config_.flags));
 
     // why are they local and remote key/salt the same?
-    if ((ret = srtp_->init(SRTP, ctx_config_.flags, key, key, salt, salt)) != RTP_OK) {
+    if ((ret = srtp_->init(SRTP, ctx_config_.flags, key, key, salt, salt, mki)) != RTP_OK) {
         LOG_WARN("Failed to initialize SRTP for media stream!");
         return free_resources(ret);
     }
 
     srtcp_ = std::shared_ptr<uvgrtp::srtcp> (new uvgrtp::srtcp());
 
-    if ((ret = srtcp_->init(SRTCP, ctx_config_.flags, key, key, salt, salt)) != RTP_OK) {
+    if ((ret = srtcp_->init(SRTCP, ctx_config_.flags, key, key, salt, salt, mki)) != RTP_OK) {
         LOG_WARN("Failed to initialize SRTCP for media stream!");
         return free_resources(ret);
     }
@@ -323,7 +422,7 @@ rtp_error_t uvgrtp::media_stream::add_srtp_ctx(uint8_t *key, uint8_t *salt)
     rtcp_ = std::shared_ptr<uvgrtp::rtcp> (new uvgrtp::rtcp(rtp_, cname_, srtcp_, ctx_config_.flags));
 
     socket_->install_handler(rtcp_.get(), rtcp_->send_packet_handler_vec);
-    socket_->install_handler(srtp_.get(), srtp_->send_packet_handler);
+    socket_->install_handler(srtp_.get(), srtp_->send_packet_handler, srtp_->send_batch_handler);
 
     rtp_handler_key_ = reception_flow_->install_handler(rtp_->packet_handler);
 
@@ -333,6 +432,31 @@ rtp_error_t uvgrtp::media_stream::add_srtp_ctx(uint8_t *key, uint8_t *salt)
     return start_components();
 }
 
+rtp_error_t uvgrtp::media_stream::add_srtp_key(uint8_t *key, uint8_t *salt, uint32_t mki, uint64_t from_index)
+{
+    if (!key || !salt)
+        return RTP_INVALID_VALUE;
+
+    if (!(flags_ & RCE_SRTP_KMNGMNT_USER))
+        return RTP_NOT_SUPPORTED;
+
+    if (!initialized_ || !srtp_ || !srtcp_)
+        return RTP_NOT_INITIALIZED;
+
+    rtp_error_t ret = RTP_OK;
+
+    if ((ret = srtp_->add_master_key(key, key, salt, salt, mki, from_index)) != RTP_OK) {
+        LOG_ERROR("Failed to add SRTP master key");
+        return ret;
+    }
+
+    /* SRTCP packets have an index of their own so the key is taken into use right away */
+    if ((ret = srtcp_->add_master_key(key, key, salt, salt, mki, 0)) != RTP_OK)
+        LOG_ERROR("Failed to add SRTCP master key");
+
+    return ret;
+}
+
 rtp_error_t uvgrtp::media_stream::start_components()
 {
     if (create_media(fmt_) != RTP_OK)
@@ -346,11 +470,11 @@ rtp_error_t uvgrtp::media_stream::start_components()
     if (ctx_config_.flags & RCE_RTCP) {
         rtcp_->add_participant(addr_, src_port_ + 1, dst_port_ + 1, rtp_->get_clock_rate());
         rtcp_->set_session_bandwidth(get_default_bandwidth_kbps(fmt_));
-        rtcp_->start();
+        rtcp_->start(rtcp_scheduler_);
     }
 
-    if (ctx_config_.flags & RCE_SRTP_AUTHENTICATE_RTP)
-        rtp_->set_payload_size(MAX_PAYLOAD - UVG_AUTH_TAG_LENGTH);
+    if (uvgrtp::base_srtp::get_rtp_trailer_length(ctx_config_.flags))
+        rtp_->set_payload_size(MAX_PAYLOAD - uvgrtp::base_srtp::get_rtp_trailer_length(ctx_config_.flags));
 
     initialized_ = true;
     return reception_flow_->start(socket_, ctx_config_.flags);
@@ -420,6 +544,56 @@ rtp_error_t uvgrtp::media_stream::push_frame(std::unique_ptr<uint8_t[]> data, si
     return ret;
 }
 
+rtp_error_t uvgrtp::media_stream::begin_frame()
+{
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    return media_->begin_frame();
+}
+
+rtp_error_t uvgrtp::media_stream::begin_frame(uint32_t ts)
+{
+    rtp_error_t ret = RTP_GENERIC_ERROR;
+
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    /* the timestamp is copied to the transaction of the access unit */
+    rtp_->set_timestamp(ts);
+    ret = media_->begin_frame();
+    rtp_->set_timestamp(INVALID_TS);
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::push_nal(uint8_t *data, size_t data_len, int flags)
+{
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE)
+        holepuncher_->notify();
+
+    return media_->push_nal(data, data_len, flags);
+}
+
+rtp_error_t uvgrtp::media_stream::end_frame()
+{
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    return media_->end_frame();
+}
+
 uvgrtp::frame::rtp_frame *uvgrtp::media_stream::pull_frame()
 {
     if (!initialized_) {
@@ -551,8 +725,7 @@ rtp_error_t uvgrtp::media_stream::configure_ctx(int flag, ssize_t value)
             ssize_t hdr      = ETH_HDR_SIZE + IPV4_HDR_SIZE + UDP_HDR_SIZE + RTP_HDR_SIZE;
             ssize_t max_size = 0xffff - IPV4_HDR_SIZE - UDP_HDR_SIZE;
 
-            if (ctx_config_.flags & RCE_SRTP_AUTHENTICATE_RTP)
-                hdr += UVG_AUTH_TAG_LENGTH;
+            hdr += (ssize_t)uvgrtp::base_srtp::get_rtp_trailer_length(ctx_config_.flags);
 
             if (value <= hdr)
                 return RTP_INVALID_VALUE;
@@ -565,12 +738,44 @@ rtp_error_t uvgrtp::media_stream::configure_ctx(int flag, ssize_t value)
                 return RTP_INVALID_VALUE;
             }
 
-            rtp_->set_payload_size(value - hdr);
+            if ((ret = rtp_->set_payload_size(value - hdr)) != RTP_OK)
+                return ret;
+
             rtcp_->set_mtu_size(value - (ETH_HDR_SIZE + IPV4_HDR_SIZE + UDP_HDR_SIZE));
 
         }
         break;
 
+        case RCC_SRTP_REPLAY_WINDOW: {
+            if (value <= 0 || !srtp_ || !srtcp_)
+                return RTP_INVALID_VALUE;
+
+            if ((ret = srtp_->set_replay_window_size((size_t)value)) != RTP_OK)
+                return ret;
+
+            ret = srtcp_->set_replay_window_size((size_t)value);
+        }
+        break;
+
+        case RCC_SRTP_CRYPTO_THREADS: {
+            if (value < 0 || !srtp_)
+                return RTP_INVALID_VALUE;
+
+            ret = srtp_->set_crypto_threads((size_t)value);
+        }
+        break;
+
+        case RCC_SRTP_KEY_DERIVATION_RATE: {
+            if (value < 0 || !srtp_ || !srtcp_)
+                return RTP_INVALID_VALUE;
+
+            if ((ret = srtp_->set_key_derivation_rate((uint64_t)value)) != RTP_OK)
+                return ret;
+
+            ret = srtcp_->set_key_derivation_rate((uint64_t)value);
+        }
+        break;
+
         default:
             return RTP_INVALID_VALUE;
     }
@@ -585,6 +790,10 @@ uint32_t uvgrtp::media_stream::get_key() const
 
 uvgrtp::rtcp *uvgrtp::media_stream::get_rtcp()
 {
+    /* with RCE_ZRTP_ASYNC, RTCP is created once the handshake has finished */
+    if (!initialized_)
+        return nullptr;
+
     return rtcp_.get();
 }
 
@@ -598,10 +807,67 @@ uint32_t uvgrtp::media_stream::get_ssrc() const
     return rtp_->get_ssrc();
 }
 
-rtp_error_t uvgrtp::media_stream::init_srtp_with_zrtp(int flags, int type, std::shared_ptr<uvgrtp::base_srtp> srtp,
-    std::shared_ptr<uvgrtp::zrtp> zrtp)
+uvgrtp::reassembly_statistics uvgrtp::media_stream::get_reassembly_statistics() const
 {
-    size_t key_size = srtp->get_key_size(flags);
+    uvgrtp::reassembly_statistics statistics;
+
+    if (!initialized_ || !media_)
+        return statistics;
+
+    auto& stats = media_->get_media_frame_info()->stats;
+
+    statistics.completed_frames    = stats.completed_frames;
+    statistics.dropped_frames      = stats.dropped_frames;
+    statistics.late_fragments      = stats.late_fragments;
+    statistics.lost_fragments      = stats.lost_fragments;
+    statistics.duplicate_fragments = stats.duplicate_fragments;
+
+    return statistics;
+}
+
+rtp_error_t uvgrtp::media_stream::register_header_extension(uint8_t id, std::string uri)
+{
+    if (!initialized_ || rtp_ == nullptr) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    return rtp_->register_extension(id, uri);
+}
+
+uint8_t uvgrtp::media_stream::get_header_extension_id(std::string uri)
+{
+    if (!initialized_ || rtp_ == nullptr) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return 0;
+    }
+
+    return rtp_->get_extension_id(uri);
+}
+
+rtp_error_t uvgrtp::media_stream::set_header_extension(uint8_t id, uint8_t *data, size_t len)
+{
+    if (!initialized_ || rtp_ == nullptr) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    return rtp_->set_extension(id, data, len);
+}
+
+rtp_error_t uvgrtp::media_stream::clear_header_extension(uint8_t id)
+{
+    if (!initialized_ || rtp_ == nullptr) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    return rtp_->clear_extension(id);
+}
+
+rtp_error_t uvgrtp::media_stream::init_srtp_with_zrtp(int flags, std::shared_ptr<uvgrtp::zrtp> zrtp)
+{
+    size_t key_size = srtp_->get_key_size(flags);
 
     uint8_t* local_key = new uint8_t[key_size];
     uint8_t* remote_key = new uint8_t[key_size];
@@ -615,12 +881,20 @@ rtp_error_t uvgrtp::media_stream::init_srtp_with_zrtp(int flags, int type, std::
         remote_salt, UVG_SALT_LENGTH * 8
      );
 
+    /* SRTP and SRTCP use the same master keys so they are derived only once */
     if (ret == RTP_OK)
     {
-        ret = srtp->init(type, flags, local_key, remote_key,
-                        local_salt, remote_salt);
+        ret = srtp_->init(SRTP, flags, local_key, remote_key,
+                          local_salt, remote_salt);
     }
-    else
+
+    if (ret == RTP_OK)
+    {
+        ret = srtcp_->init(SRTCP, flags, local_key, remote_key,
+                           local_salt, remote_salt);
+    }
+
+    if (ret != RTP_OK)
     {
         LOG_WARN("Failed to initialize SRTP for media stream!");
     }
@@ -62,7 +62,7 @@ void uvgrtp::reception_flow::create_ring_buffer()
 
     for (int i = 0; i < elements; ++i)
     {
-        ring_buffer_.push_back({ new uint8_t[RECV_BUFFER_SIZE] , 0 });
+        ring_buffer_.push_back({ new uint8_t[RECV_BUFFER_SIZE] , 0, {} });
     }
 }
 
@@ -273,6 +273,10 @@ void uvgrtp::reception_flow::call_aux_handlers(uint32_t key, int flags, uvgrtp::
             case RTP_GENERIC_ERROR:
                 // too many prints with this in case of minor errors
                 //LOG_DEBUG("Error in auxiliary handling of received packet!");
+
+                /* the handler rejected and released the packet, e.g., SRTP authentication failed */
+                if (!*frame)
+                    return;
                 break;
 
             default:
@@ -383,7 +387,7 @@ void uvgrtp::reception_flow::receiver(std::shared_ptr<uvgrtp::socket> socket, in
                     ring_mutex_.lock();
                     for (unsigned int i = 0; i < increase; ++i)
                     {
-                        ring_buffer_.insert(ring_buffer_.begin() + next_write_index, { new uint8_t[RECV_BUFFER_SIZE] , 0 });
+                        ring_buffer_.insert(ring_buffer_.begin() + next_write_index, { new uint8_t[RECV_BUFFER_SIZE] , 0, {} });
                     }
                     ring_read_index_ += increase; // move read ahead because of the new empty indexes
 
@@ -393,7 +397,7 @@ void uvgrtp::reception_flow::receiver(std::shared_ptr<uvgrtp::socket> socket, in
                 rtp_error_t ret = RTP_OK;
                 // get the potential packet
                 ret = socket->recvfrom(ring_buffer_[next_write_index].data, RECV_BUFFER_SIZE,
-                    MSG_DONTWAIT, &ring_buffer_[next_write_index].read);
+                    MSG_DONTWAIT, &ring_buffer_[next_write_index].from, &ring_buffer_[next_write_index].read);
 
                 if (ret == RTP_INTERRUPTED)
                 {
@@ -442,6 +446,10 @@ void uvgrtp::reception_flow::process_packet(int flags)
 
         ring_mutex_.lock();
 
+        // the clock is read once for the whole batch, RTCP uses this as the arrival time of the packets
+        uint64_t arrival = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+
         // process all available reads in one go
         while (ring_read_index_ != last_ring_write_index_)
         {
@@ -469,6 +477,8 @@ void uvgrtp::reception_flow::process_packet(int flags)
                     /* packet was handled by the primary handler
                      * and should be dispatched to the auxiliary handler(s) */
                 case RTP_PKT_MODIFIED:
+                    frame->arrival  = arrival;
+                    frame->src_addr = ring_buffer_[ring_read_index_].from;
                     this->call_aux_handlers(handler.first, flags, &frame);
                     break;
 
@@ -2,6 +2,12 @@
 
 #include "uvgrtp/util.hh"
 
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#endif
+
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -187,6 +193,7 @@ namespace uvgrtp {
             {
                 uint8_t* data;
                 int read;
+                sockaddr_in from; /* the source transport address of the packet */
             };
 
             std::vector<Buffer> ring_buffer_;
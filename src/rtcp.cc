@@ -1,7 +1,10 @@
 #include "uvgrtp/rtcp.hh"
 
 #include "hostname.hh"
-#include "poll.hh"
+#include "random.hh"
+#include "rtcp_scheduler.hh"
+#include "rtcp_dispatcher.hh"
+#include "rtcp_xr.hh"
 #include "rtp.hh"
 #include "srtp/srtcp.hh"
 #include "rtcp_packets.hh"
@@ -15,6 +18,8 @@
 #endif
 
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -28,17 +33,82 @@ const uint32_t MAX_DROPOUT    = 3000;
 const uint32_t MAX_MISORDER   = 100;
 const uint32_t DEFAULT_RTCP_INTERVAL_MS = 5000;
 
-constexpr int ESTIMATED_MAX_RECEPTION_TIME_MS = 10;
+/* Number of received packets that can wait for their hooks with RCE_RTCP_ASYNC_HOOKS */
+const size_t HOOK_QUEUE_SIZE = 256;
 
-const uint32_t MAX_SUPPORTED_PARTICIPANTS = 31;
+/* The lost packets of one Generic NACK, longer lists are split to several NACKs */
+constexpr size_t MAX_NACK_ENTRIES = 64;
+
+/* An address that has sent our SSRC is remembered for about ten report intervals (RFC 3550 section 8.2) */
+constexpr uint64_t CONFLICT_TIMEOUT_MS = 10 * DEFAULT_RTCP_INTERVAL_MS;
+
+/* RFC 3550 appendix A.7 */
+constexpr double RTCP_SENDER_BW_FRACTION = 0.25;
+constexpr double RTCP_RCVR_BW_FRACTION   = 1 - RTCP_SENDER_BW_FRACTION;
+constexpr double COMPENSATION            = 2.71828 - 1.5;
+
+/* The report count field of SR and RR packets is 5 bits */
+constexpr size_t MAX_REPORT_BLOCKS = 31;
+
+/* Members that have not been heard from in this many deterministic
+ * intervals are removed from the session (RFC 3550 section 6.3.5) */
+constexpr uint64_t MEMBER_TIMEOUT_INTERVALS = 5;
+
+/* Gain of the smoothed analytics, the same as for the smoothed RTT of TCP (RFC 6298) */
+constexpr double ANALYTICS_GAIN = 0.125;
+
+/* Return the size of the SR or RR packet carrying "reports" report blocks, including
+ * the additional RR packets needed for the blocks that do not fit in the first one */
+static size_t report_packets_size(bool sr_packet, size_t reports)
+{
+    size_t blocks = std::min(reports, MAX_REPORT_BLOCKS);
+    size_t size   = sr_packet ? uvgrtp::get_sr_packet_size((uint16_t)blocks) : uvgrtp::get_rr_packet_size((uint16_t)blocks);
+
+    for (reports -= blocks; reports > 0; reports -= blocks)
+    {
+        blocks = std::min(reports, MAX_REPORT_BLOCKS);
+        size  += uvgrtp::get_rr_packet_size((uint16_t)blocks);
+    }
+
+    return size;
+}
+
+/* Return the monotonic arrival time of "frame" in microseconds
+ *
+ * The reception flow sets it once for each batch of packets it processes and
+ * the clock is only read here if the frame did not come through it */
+static uint64_t arrival_time(const uvgrtp::frame::rtp_frame *frame)
+{
+    if (frame->arrival)
+    {
+        return frame->arrival;
+    }
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Return the arrival time "arrival" of a packet from "p" expressed as an RTP timestamp of the source */
+static uint32_t arrival_rtp_time(const uvgrtp::rtcp_participant *p, uint64_t arrival)
+{
+    uint64_t elapsed_us = arrival - p->stats.initial_arrival;
+
+    return p->stats.initial_rtp + (uint32_t)(elapsed_us * p->stats.clock_rate / 1000000);
+}
 
 uvgrtp::rtcp::rtcp(std::shared_ptr<uvgrtp::rtp> rtp, std::string cname, int flags):
     flags_(flags), our_role_(RECEIVER),
     tp_(0), tc_(0), tn_(0), pmembers_(0),
     members_(0), senders_(0), rtcp_bandwidth_(0),
     we_sent_(false), avg_rtcp_pkt_pize_(0), rtcp_pkt_count_(0),
-    rtcp_pkt_sent_count_(0), initial_(true), ssrc_(rtp->get_ssrc()), 
-    num_receivers_(0),
+    rtcp_pkt_sent_count_(0), initial_(true), rtp_(rtp), ssrc_(rtp->get_ssrc()),
+    collisions_(0),
+    loops_(0),
+    next_report_ssrc_(0),
+    participants_generation_(0),
+    cached_sender_(nullptr),
+    cached_ssrc_(0),
+    cached_generation_(0),
     sender_hook_(nullptr),
     receiver_hook_(nullptr),
     sdes_hook_(nullptr),
@@ -51,18 +121,35 @@ uvgrtp::rtcp::rtcp(std::shared_ptr<uvgrtp::rtp> rtp, std::string cname, int flag
     sdes_hook_u_(nullptr),
     app_hook_f_(nullptr),
     app_hook_u_(nullptr),
+    xr_hook_(nullptr),
+    xr_hook_f_(nullptr),
+    xr_hook_u_(nullptr),
+    fb_hook_(nullptr),
+    fb_hook_f_(nullptr),
+    fb_hook_u_(nullptr),
     active_(false),
     interval_ms_(DEFAULT_RTCP_INTERVAL_MS),
     ourItems_(),
     bye_ssrcs_(false),
-    mtu_size_(MAX_PAYLOAD)
+    allow_early_(true),
+    early_report_(0),
+    last_regular_(0),
+    trr_interval_ms_(0),
+    mtu_size_(MAX_PAYLOAD),
+    report_buffer_(nullptr),
+    report_buffer_size_(0),
+    xr_buffer_(nullptr),
+    early_buffer_(nullptr),
+    analytics_index_(std::make_shared<const analytics_index>())
 {
     clock_rate_   = rtp->get_clock_rate();
 
     clock_start_  = 0;
     rtp_ts_start_ = 0;
 
-    report_generator_   = nullptr;
+    sync_ntp_     = 0;
+    sync_rtp_     = 0;
+    last_sent_ts_ = 0;
 
     srtcp_        = nullptr;
 
@@ -121,22 +208,76 @@ void uvgrtp::rtcp::free_participant(rtcp_participant* participant)
     {
         delete participant->app_frame;
     }
+    if (participant->xr_frame)
+    {
+        delete participant->xr_frame;
+    }
+    if (participant->fb_frame)
+    {
+        delete participant->fb_frame;
+    }
 
     delete participant;
 }
 
-rtp_error_t uvgrtp::rtcp::start()
+rtp_error_t uvgrtp::rtcp::start(std::shared_ptr<uvgrtp::rtcp_scheduler> scheduler)
 {
     if (sockets_.empty())
     {
-        LOG_ERROR("Cannot start RTCP Runner because no connections have been initialized");
+        LOG_ERROR("Cannot start RTCP because no connections have been initialized");
         return RTP_INVALID_VALUE;
     }
-    active_ = true;
 
-    report_generator_.reset(new std::thread(rtcp_runner, this, interval_ms_));
+    scheduler_ = scheduler ? scheduler : std::make_shared<uvgrtp::rtcp_scheduler>();
 
-    return RTP_OK;
+    /* The size of our first report is the best guess for the average
+     * before any RTCP packets have been sent or received */
+    avg_rtcp_pkt_pize_ = get_rr_packet_size(0) + get_sdes_packet_size(ourItems_)
+        + uvgrtp::base_srtp::get_rtcp_trailer_length(srtcp_ ? flags_ : 0) + UDP_HDR_SIZE + IPV4_HDR_SIZE;
+
+    /* Reports are written to the same buffer, it is grown only if an APP or BYE packet makes
+     * the report larger than the MTU */
+    report_buffer_size_ = mtu_size_ + uvgrtp::base_srtp::get_rtcp_trailer_length(srtcp_ ? flags_ : 0);
+    report_buffer_.reset(new uint8_t[report_buffer_size_]);
+
+    if (flags_ & RCE_RTCP_XR)
+    {
+        xr_buffer_.reset(new uint8_t[mtu_size_]);
+    }
+
+    if (flags_ & RCE_RTCP_FEEDBACK)
+    {
+        early_buffer_.reset(new uint8_t[report_buffer_size_]);
+    }
+
+    allow_early_   = true;
+    early_report_  = 0;
+    last_regular_  = 0;
+
+    if (flags_ & RCE_RTCP_ASYNC_HOOKS)
+    {
+        dispatcher_.reset(new uvgrtp::rtcp_dispatcher(HOOK_QUEUE_SIZE,
+            [this](uvgrtp::rtcp_hook_event& event) { deliver_hook_event(event); },
+            &uvgrtp::rtcp::free_hook_event));
+    }
+
+    initial_  = true;
+    pmembers_ = 1;
+    members_  = 1;
+    tp_       = uvgrtp::rtcp_scheduler::now();
+    tn_       = tp_ + rtcp_interval();
+    active_   = true;
+
+    LOG_INFO("RTCP instance created! First report in %llu ms", (unsigned long long)(tn_ - tp_));
+
+    rtp_error_t ret = scheduler_->add(this, sockets_, tn_);
+
+    if (ret != RTP_OK)
+    {
+        active_ = false;
+    }
+
+    return ret;
 }
 
 rtp_error_t uvgrtp::rtcp::stop()
@@ -152,6 +293,7 @@ rtp_error_t uvgrtp::rtcp::stop()
             free_participant(participant.second);
         }
         participants_.clear();
+        std::atomic_store(&analytics_index_, std::make_shared<const analytics_index>());
 
         for (auto& participant : initial_participants_)
         {
@@ -159,15 +301,25 @@ rtp_error_t uvgrtp::rtcp::stop()
         }
         initial_participants_.clear();
 
+        for (auto& participant : retired_participants_)
+        {
+            free_participant(participant);
+        }
+        retired_participants_.clear();
+        cached_sender_ = nullptr;
+
         return RTP_OK;
     }
 
     active_ = false;
 
-    if (report_generator_ && report_generator_->joinable())
+    LOG_DEBUG("Removing RTCP from the scheduler");
+    scheduler_->remove(this);
+
+    /* no more packets are received so the hooks still waiting are not called */
+    if (dispatcher_)
     {
-        LOG_DEBUG("Waiting for RTCP loop to exit");
-        report_generator_->join();
+        dispatcher_->stop();
     }
 
     /* when the member count is less than 50,
@@ -186,67 +338,206 @@ rtp_error_t uvgrtp::rtcp::stop()
     return uvgrtp::rtcp::send_bye_packet({ ssrc_ });
 }
 
-void uvgrtp::rtcp::rtcp_runner(rtcp* rtcp, int interval)
+double uvgrtp::rtcp::deterministic_interval()
+{
+    double rtcp_min_time = interval_ms_;
+    double rtcp_bw       = (double)rtcp_bandwidth_;
+
+    /* the participants and ourselves */
+    packet_mutex_.lock();
+    members_        = participants_.size() + 1;
+    size_t senders  = std::min(senders_, members_ - 1) + (we_sent_ ? 1 : 0);
+    double avg_size = (double)avg_rtcp_pkt_pize_;
+    packet_mutex_.unlock();
+
+    size_t n = members_;
+
+    /* the first report may be sent after half the minimum interval */
+    if (initial_)
+    {
+        rtcp_min_time /= 2;
+    }
+
+    /* If there are active senders, give them at least a minimum share of the RTCP bandwidth */
+    if (senders <= members_ * RTCP_SENDER_BW_FRACTION)
+    {
+        if (we_sent_)
+        {
+            rtcp_bw *= RTCP_SENDER_BW_FRACTION;
+            n = senders;
+        }
+        else
+        {
+            rtcp_bw *= RTCP_RCVR_BW_FRACTION;
+            n -= senders;
+        }
+    }
+
+    double t = rtcp_bw > 0 ? avg_size * n / rtcp_bw * 1000 : 0;
+
+    if (t < rtcp_min_time)
+    {
+        t = rtcp_min_time;
+    }
+
+    return t;
+}
+
+uint64_t uvgrtp::rtcp::rtcp_interval()
+{
+    double t = deterministic_interval();
+
+    /* randomize the interval to [0.5, 1.5] times the calculated interval
+     * so that the reports of the participants do not synchronize */
+    t = t * ((double)uvgrtp::random::generate_32() / UINT32_MAX + 0.5);
+    t = t / COMPENSATION;
+
+    return (uint64_t)t;
+}
+
+void uvgrtp::rtcp::timeout_members(uint64_t now)
 {
-    LOG_INFO("RTCP instance created! RTCP interval: %i ms", interval);
+    bool initial = initial_;
 
-    // RFC 3550 says to wait half interval before sending first report
-    int initial_sleep_ms = interval / 2;
-    LOG_DEBUG("Sleeping for %i ms before sending first RTCP report", initial_sleep_ms);
-    std::this_thread::sleep_for(std::chrono::milliseconds(initial_sleep_ms));
+    /* the timeouts are calculated as if the first report had already been sent */
+    initial_ = false;
+    uint64_t td = (uint64_t)deterministic_interval();
+    initial_ = initial;
 
-    uint8_t buffer[MAX_PACKET];
+    std::vector<uint32_t> timed_out;
+    size_t senders = 0;
 
-    uvgrtp::clock::hrc::hrc_t start = uvgrtp::clock::hrc::now();
+    std::lock_guard<std::mutex> lock(packet_mutex_);
 
-    int i = 0;
-    while (rtcp->is_active())
+    for (auto& participant : participants_)
     {
-        long int next_sendslot = i * interval;
-        long int run_time = uvgrtp::clock::hrc::diff_now(start);
-        long int diff_ms = next_sendslot - run_time;
+        auto p = participant.second;
 
-        rtp_error_t ret = RTP_OK;
-        if (diff_ms <= 0)
+        if (p->last_rtp && p->last_rtp + 2 * td >= now)
         {
-            ++i;
+            ++senders;
+        }
 
-            LOG_DEBUG("Sending RTCP report number %i at time slot %i ms", i, next_sendslot);
+        /* the participants given by the application are the destinations of our
+         * reports so they stay members even if they are silent */
+        if (p->socket)
+        {
+            continue;
+        }
 
-            if ((ret = rtcp->generate_report()) != RTP_OK && ret != RTP_NOT_READY)
-            {
-                LOG_ERROR("Failed to send RTCP status report!");
-            }
-        } else if (diff_ms > ESTIMATED_MAX_RECEPTION_TIME_MS) { // try receiving if we have time
-            // Receive RTCP reports until time to send report
-            int nread = 0;
+        if (std::max(p->last_active, p->last_rtp) + MEMBER_TIMEOUT_INTERVALS * td < now)
+        {
+            timed_out.push_back(participant.first);
+        }
+    }
 
-            int poll_timout = diff_ms - ESTIMATED_MAX_RECEPTION_TIME_MS;
+    for (auto& ssrc : timed_out)
+    {
+        LOG_DEBUG("Participant %lu timed out", ssrc);
+        retire_participant(ssrc);
+    }
 
-            // using max poll we make sure that exiting uvgRTP doesn't take several seconds
-            int max_poll_timeout_ms = 100;
-            if (poll_timout > max_poll_timeout_ms)
-            {
-                poll_timout = max_poll_timeout_ms;
-            }
+    /* the session shrunk the same way as with BYE packets (RFC 3550 section 6.3.5) */
+    if (!timed_out.empty())
+    {
+        reverse_reconsideration(now);
+    }
 
-            ret = uvgrtp::poll::poll(rtcp->get_sockets(), buffer, MAX_PACKET, poll_timout, &nread);
+    senders_ = senders;
+}
 
-            if (ret == RTP_OK && nread > 0)
-            {
-                (void)rtcp->handle_incoming_packet(buffer, (size_t)nread);
-            } else if (ret == RTP_INTERRUPTED) {
-                /* do nothing */
-            } else {
-                LOG_ERROR("poll failed, %d", ret);
-                break; // TODO the sockets should be manages so that this is not needed
-            }
-        } else { // sleep until it is time to send the report
-            std::this_thread::sleep_for(std::chrono::milliseconds(diff_ms));
+void uvgrtp::rtcp::reverse_reconsideration(uint64_t now)
+{
+    size_t members = participants_.size() + 1;
+
+    if (members >= pmembers_)
+    {
+        return;
+    }
+
+    if (tn_ > now)
+    {
+        tn_ = now + (tn_ - now) * members / pmembers_;
+    }
+
+    if (tp_ < now)
+    {
+        tp_ = now - (now - tp_) * members / pmembers_;
+    }
+
+    pmembers_ = members;
+    members_  = members;
+}
+
+uint64_t uvgrtp::rtcp::report_timer_expired(uint64_t now)
+{
+    /* A dithered early packet with feedback (RFC 4585 section 3.5.2) is due before the regular report */
+    uint64_t early = early_report_;
+
+    if (early != 0 && early <= now)
+    {
+        packet_mutex_.lock();
+        rtp_error_t ret = send_early_report();
+        packet_mutex_.unlock();
+
+        if (ret != RTP_OK)
+        {
+            LOG_ERROR("Failed to send early RTCP packet!");
+        }
+    }
+
+    /* Timer reconsideration: the interval is calculated again with the current state of
+     * the session and the report is postponed if the new transmission time is still ahead.
+     * After an early packet the regular report waits for twice the interval (RFC 4585 section 3.5.3) */
+    uint64_t t = rtcp_interval();
+
+    tc_ = now;
+    tn_ = tp_ + (allow_early_ ? t : 2 * t);
+
+    uint64_t next = tn_;
+
+    if (next > tc_)
+    {
+        early = early_report_;
+        return early != 0 ? std::min(next, early) : next;
+    }
+
+    /* A regular report without feedback is not sent sooner than T_rr_interval after the previous one */
+    packet_mutex_.lock();
+    bool suppress = trr_interval_ms_ != 0 && !initial_ && tc_ - last_regular_ < trr_interval_ms_ &&
+        fb_packets_.empty();
+    packet_mutex_.unlock();
+
+    if (!suppress)
+    {
+        rtp_error_t ret = generate_report();
+
+        if (ret != RTP_OK && ret != RTP_NOT_READY)
+        {
+            LOG_ERROR("Failed to send RTCP status report!");
         }
+
+        last_regular_ = tc_;
     }
 
-    LOG_DEBUG("Exited RTCP loop");
+    timeout_members(tc_);
+
+    we_sent_     = our_role_ == SENDER;
+    tp_          = tc_;
+    initial_     = false;
+    tn_          = tc_ + rtcp_interval();
+    pmembers_    = members_;
+    allow_early_ = true;
+
+    return tn_;
+}
+
+uint64_t uvgrtp::rtcp::next_report() const
+{
+    uint64_t next  = tn_;
+    uint64_t early = early_report_;
+
+    return early != 0 ? std::min(next, early) : next;
 }
 
 rtp_error_t uvgrtp::rtcp::set_sdes_items(const std::vector<uvgrtp::frame::rtcp_sdes_item>& items)
@@ -354,19 +645,16 @@ rtp_error_t uvgrtp::rtcp::add_participant(std::string dst_addr, uint16_t dst_por
     p->stats.clock_rate = clock_rate;
 
     initial_participants_.push_back(p);
-    sockets_.push_back(*p->socket);
+    sockets_.push_back(p->socket);
 
     return RTP_OK;
 }
 
 rtp_error_t uvgrtp::rtcp::add_participant(uint32_t ssrc)
 {
-    if (num_receivers_ == MAX_SUPPORTED_PARTICIPANTS)
-    {
-        LOG_ERROR("Maximum number of RTCP participants reached.");
-        // TODO: Support more participants by sending multiple messages at the same time
-        return RTP_GENERIC_ERROR;
-    }
+    /* The RTP packet processing thread adds participants while the RTCP thread may be
+     * generating a report so participants_ is only modified with packet_mutex_ held */
+    std::lock_guard<std::mutex> lock(packet_mutex_);
 
     /* RTCP is not in use for this media stream,
      * create a "fake" participant that is only used for storing statistics information */
@@ -378,12 +666,32 @@ rtp_error_t uvgrtp::rtcp::add_participant(uint32_t ssrc)
         participants_[ssrc] = initial_participants_.back();
         initial_participants_.pop_back();
     }
-    num_receivers_++;
 
+    participants_[ssrc]->last_active = uvgrtp::rtcp_scheduler::now();
     participants_[ssrc]->rr_frame    = nullptr;
     participants_[ssrc]->sr_frame    = nullptr;
     participants_[ssrc]->sdes_frame  = nullptr;
     participants_[ssrc]->app_frame   = nullptr;
+    participants_[ssrc]->analytics   = std::make_shared<shared_analytics>();
+    participants_[ssrc]->analytics->current.ssrc = ssrc;
+    participants_[ssrc]->xr_frame    = nullptr;
+    participants_[ssrc]->history     = (flags_ & RCE_RTCP_XR) ? std::make_shared<receive_history>() : nullptr;
+
+    publish_analytics_index();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::install_report_view_hook(std::function<void(const uvgrtp::frame::rtcp_report_view&)> report_handler)
+{
+    if (!report_handler)
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    report_view_mutex_.lock();
+    report_view_hook_ = report_handler;
+    report_view_mutex_.unlock();
 
     return RTP_OK;
 }
@@ -413,6 +721,22 @@ rtp_error_t uvgrtp::rtcp::remove_all_hooks()
     app_hook_f_ = nullptr;
     app_hook_u_ = nullptr;
     app_mutex_.unlock();
+
+    xr_mutex_.lock();
+    xr_hook_   = nullptr;
+    xr_hook_f_ = nullptr;
+    xr_hook_u_ = nullptr;
+    xr_mutex_.unlock();
+
+    fb_mutex_.lock();
+    fb_hook_   = nullptr;
+    fb_hook_f_ = nullptr;
+    fb_hook_u_ = nullptr;
+    fb_mutex_.unlock();
+
+    report_view_mutex_.lock();
+    report_view_hook_ = nullptr;
+    report_view_mutex_.unlock();
     return RTP_OK;
 }
 
@@ -608,6 +932,102 @@ rtp_error_t uvgrtp::rtcp::install_app_hook(std::function<void(std::unique_ptr<uv
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::rtcp::install_xr_hook(void (*hook)(uvgrtp::frame::rtcp_xr_packet*))
+{
+    if (!hook)
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    xr_mutex_.lock();
+    xr_hook_   = hook;
+    xr_hook_f_ = nullptr;
+    xr_hook_u_ = nullptr;
+    xr_mutex_.unlock();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::install_xr_hook(std::function<void(std::shared_ptr<uvgrtp::frame::rtcp_xr_packet>)> xr_handler)
+{
+    if (!xr_handler)
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    xr_mutex_.lock();
+    xr_hook_   = nullptr;
+    xr_hook_f_ = xr_handler;
+    xr_hook_u_ = nullptr;
+    xr_mutex_.unlock();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::install_xr_hook(std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_xr_packet>)> xr_handler)
+{
+    if (!xr_handler)
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    xr_mutex_.lock();
+    xr_hook_   = nullptr;
+    xr_hook_f_ = nullptr;
+    xr_hook_u_ = xr_handler;
+    xr_mutex_.unlock();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::install_fb_hook(void (*hook)(uvgrtp::frame::rtcp_fb_packet*))
+{
+    if (!hook)
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    fb_mutex_.lock();
+    fb_hook_   = hook;
+    fb_hook_f_ = nullptr;
+    fb_hook_u_ = nullptr;
+    fb_mutex_.unlock();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::install_fb_hook(std::function<void(std::shared_ptr<uvgrtp::frame::rtcp_fb_packet>)> fb_handler)
+{
+    if (!fb_handler)
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    fb_mutex_.lock();
+    fb_hook_   = nullptr;
+    fb_hook_f_ = fb_handler;
+    fb_hook_u_ = nullptr;
+    fb_mutex_.unlock();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::install_fb_hook(std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_fb_packet>)> fb_handler)
+{
+    if (!fb_handler)
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    fb_mutex_.lock();
+    fb_hook_   = nullptr;
+    fb_hook_f_ = nullptr;
+    fb_hook_u_ = fb_handler;
+    fb_mutex_.unlock();
+
+    return RTP_OK;
+}
+
 uvgrtp::frame::rtcp_sender_report* uvgrtp::rtcp::get_sender_packet(uint32_t ssrc)
 {
     if (participants_.find(ssrc) == participants_.end())
@@ -668,7 +1088,37 @@ uvgrtp::frame::rtcp_app_packet* uvgrtp::rtcp::get_app_packet(uint32_t ssrc)
     return frame;
 }
 
-std::vector<uvgrtp::socket>& uvgrtp::rtcp::get_sockets()
+uvgrtp::frame::rtcp_xr_packet* uvgrtp::rtcp::get_xr_packet(uint32_t ssrc)
+{
+    if (participants_.find(ssrc) == participants_.end())
+    {
+        return nullptr;
+    }
+
+    xr_mutex_.lock();
+    auto frame = participants_[ssrc]->xr_frame;
+    participants_[ssrc]->xr_frame = nullptr;
+    xr_mutex_.unlock();
+
+    return frame;
+}
+
+uvgrtp::frame::rtcp_fb_packet* uvgrtp::rtcp::get_fb_packet(uint32_t ssrc)
+{
+    if (participants_.find(ssrc) == participants_.end())
+    {
+        return nullptr;
+    }
+
+    fb_mutex_.lock();
+    auto frame = participants_[ssrc]->fb_frame;
+    participants_[ssrc]->fb_frame = nullptr;
+    fb_mutex_.unlock();
+
+    return frame;
+}
+
+std::vector<std::shared_ptr<uvgrtp::socket>>& uvgrtp::rtcp::get_sockets()
 {
     return sockets_;
 }
@@ -689,7 +1139,9 @@ void uvgrtp::rtcp::update_rtcp_bandwidth(size_t pkt_size)
 {
     rtcp_pkt_count_    += 1;
     rtcp_byte_count_   += pkt_size + UDP_HDR_SIZE + IPV4_HDR_SIZE;
-    avg_rtcp_pkt_pize_  = rtcp_byte_count_ / rtcp_pkt_count_;
+
+    /* RFC 3550 section 6.3.3 */
+    avg_rtcp_pkt_pize_  = (pkt_size + UDP_HDR_SIZE + IPV4_HDR_SIZE + 15 * avg_rtcp_pkt_pize_) / 16;
 }
 
 
@@ -707,12 +1159,10 @@ void uvgrtp::rtcp::zero_stats(uvgrtp::receiver_statistics *stats)
     stats->dropped_pkts   = 0;
     stats->received_bytes = 0;
 
-    stats->received_rtp_packet = false;
-
     stats->jitter  = 0;
     stats->transit = 0;
 
-    stats->initial_ntp = 0;
+    stats->initial_arrival = 0;
     stats->initial_rtp = 0;
     stats->clock_rate  = 0;
     stats->lsr         = 0;
@@ -748,44 +1198,99 @@ void uvgrtp::rtcp::sender_update_stats(const uvgrtp::frame::rtp_frame *frame)
         return;
     }
 
+    record_sent_timestamp(frame->header.timestamp);
+
     our_stats.sent_pkts  += 1;
     our_stats.sent_bytes += (uint32_t)frame->payload_len;
     our_stats.sent_rtp_packet = true;
 }
 
-rtp_error_t uvgrtp::rtcp::init_new_participant(const uvgrtp::frame::rtp_frame *frame)
+void uvgrtp::rtcp::record_sent_timestamp(uint32_t rtp_ts)
 {
-    rtp_error_t ret;
-
-    if ((ret = uvgrtp::rtcp::add_participant(frame->header.ssrc)) != RTP_OK)
-    {
-        return ret;
-    }
+    /* All packets of a frame have the same timestamp, the first one is sent closest to the capture.
+     * The bit above the timestamp tells that a packet has been sent */
+    uint64_t sent_ts = (1ULL << 32) | rtp_ts;
 
-    if ((ret = uvgrtp::rtcp::init_participant_seq(frame->header.ssrc, frame->header.seq)) != RTP_OK)
+    if (last_sent_ts_.exchange(sent_ts, std::memory_order_relaxed) == sent_ts)
     {
-        return ret;
+        return;
     }
 
-    /* Set the probation to MIN_SEQUENTIAL (2)
-     *
-     * What this means is that we must receive at least two packets from SSRC
-     * with sequential RTP sequence numbers for this peer to be considered valid */
-    participants_[frame->header.ssrc]->probation = MIN_SEQUENTIAL;
-
-    /* This is the first RTP frame from remote to frame->header.timestamp represents t = 0
-     * Save the timestamp and current NTP timestamp so we can do jitter calculations later on */
-    participants_[frame->header.ssrc]->stats.initial_rtp = frame->header.timestamp;
-    participants_[frame->header.ssrc]->stats.initial_ntp = uvgrtp::clock::ntp::now();
-
-    senders_++;
+    uint64_t ntp_ts = uvgrtp::clock::ntp::now();
 
-    return ret;
+    std::lock_guard<std::mutex> lock(sync_mutex_);
+    sync_ntp_ = ntp_ts;
+    sync_rtp_ = rtp_ts;
 }
 
-rtp_error_t uvgrtp::rtcp::update_sender_stats(size_t pkt_size)
+uint32_t uvgrtp::rtcp::sender_rtp_timestamp(uint64_t ntp_ts)
 {
-    if (our_role_ == RECEIVER)
+    uint64_t ref_ntp = 0;
+    uint32_t ref_rtp = 0;
+
+    /* The application that timestamps the stream itself gives the mapping with set_ts_info() */
+    if (clock_start_ != 0)
+    {
+        ref_ntp = clock_start_;
+        ref_rtp = rtp_ts_start_;
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(sync_mutex_);
+        ref_ntp = sync_ntp_;
+        ref_rtp = sync_rtp_;
+    }
+
+    if (ref_ntp == 0)
+    {
+        return 0;
+    }
+
+    /* the difference of the NTP timestamps is in 1/2^32 seconds */
+    double seconds = (double)(int64_t)(ntp_ts - ref_ntp) / 4294967296.0;
+
+    return ref_rtp + (uint32_t)(int64_t)std::llround(seconds * clock_rate_);
+}
+
+rtp_error_t uvgrtp::rtcp::init_new_participant(const uvgrtp::frame::rtp_frame *frame)
+{
+    rtp_error_t ret;
+
+    if ((ret = uvgrtp::rtcp::add_participant(frame->header.ssrc)) != RTP_OK)
+    {
+        return ret;
+    }
+
+    if ((ret = uvgrtp::rtcp::init_participant_seq(frame->header.ssrc, frame->header.seq)) != RTP_OK)
+    {
+        return ret;
+    }
+
+    auto p = find_sender(frame->header.ssrc);
+
+    /* Set the probation to MIN_SEQUENTIAL (2)
+     *
+     * What this means is that we must receive at least two packets from SSRC
+     * with sequential RTP sequence numbers for this peer to be considered valid */
+    p->probation = MIN_SEQUENTIAL;
+
+    /* This is the first RTP frame from remote to frame->header.timestamp represents t = 0
+     * Save the timestamp and arrival time so we can do jitter calculations later on */
+    p->stats.initial_rtp     = frame->header.timestamp;
+    p->stats.initial_arrival = arrival_time(frame);
+
+    packet_mutex_.lock();
+    senders_++;
+    packet_mutex_.unlock();
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::rtcp::update_sender_stats(size_t pkt_size, uint32_t rtp_ts)
+{
+    record_sent_timestamp(rtp_ts);
+
+    if (our_role_ == RECEIVER)
     {
         our_role_ = SENDER;
     }
@@ -804,27 +1309,30 @@ rtp_error_t uvgrtp::rtcp::update_sender_stats(size_t pkt_size)
 
 rtp_error_t uvgrtp::rtcp::init_participant_seq(uint32_t ssrc, uint16_t base_seq)
 {
-    if (participants_.find(ssrc) == participants_.end())
+    auto p = find_sender(ssrc);
+
+    if (!p)
     {
         return RTP_NOT_FOUND;
     }
 
-    participants_[ssrc]->stats.base_seq = base_seq;
-    participants_[ssrc]->stats.max_seq  = base_seq;
-    participants_[ssrc]->stats.bad_seq  = (RTP_SEQ_MOD + 1)%UINT32_MAX;
+    p->stats.base_seq = base_seq;
+    p->stats.max_seq  = base_seq;
+    p->stats.bad_seq  = (RTP_SEQ_MOD + 1)%UINT32_MAX;
 
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::rtcp::update_participant_seq(uint32_t ssrc, uint16_t seq)
+rtp_error_t uvgrtp::rtcp::update_participant_seq(uint32_t ssrc, uint16_t seq, uint64_t arrival)
 {
-    if (participants_.find(ssrc) == participants_.end())
+    auto p = find_sender(ssrc);
+
+    if (!p)
     {
         LOG_ERROR("Did not find participant SSRC when updating seq");
         return RTP_GENERIC_ERROR;
     }
 
-    auto p = participants_[ssrc];
     uint16_t udelta = seq - p->stats.max_seq;
 
     /* Source is not valid until MIN_SEQUENTIAL packets with
@@ -839,6 +1347,12 @@ rtp_error_t uvgrtp::rtcp::update_participant_seq(uint32_t ssrc, uint16_t seq)
            if (!p->probation)
            {
                uvgrtp::rtcp::init_participant_seq(ssrc, seq);
+
+               /* the receive history starts from the first valid packet */
+               if (p->history)
+               {
+                   p->history->record((uint32_t)p->stats.cycles << 16 | seq, arrival_rtp_time(p, arrival));
+               }
                return RTP_OK;
            }
        } else {
@@ -872,6 +1386,13 @@ rtp_error_t uvgrtp::rtcp::update_participant_seq(uint32_t ssrc, uint16_t seq)
        /* duplicate or reordered packet */
     }
 
+    if (p->history)
+    {
+        /* the extended sequence number of a reordered packet is counted back from the highest one */
+        uint32_t extended_max = (uint32_t)p->stats.cycles << 16 | p->stats.max_seq;
+        p->history->record(extended_max - (uint16_t)(p->stats.max_seq - seq), arrival_rtp_time(p, arrival));
+    }
+
     return RTP_OK;
 }
 
@@ -884,6 +1405,15 @@ rtp_error_t uvgrtp::rtcp::reset_rtcp_state(uint32_t ssrc)
 
     zero_stats(&our_stats);
 
+    ssrc_ = ssrc;
+    rtp_->set_ssrc(ssrc);
+
+    /* the feedback waiting to be sent is sent from the new SSRC */
+    for (auto& fb_packet : fb_packets_)
+    {
+        *(uint32_t*)&fb_packet[RTCP_HEADER_SIZE] = htonl(ssrc);
+    }
+
     return RTP_OK;
 }
 
@@ -905,11 +1435,186 @@ bool uvgrtp::rtcp::collision_detected(uint32_t ssrc, const sockaddr_in& src_addr
     return false;
 }
 
+bool uvgrtp::rtcp::resolve_own_ssrc_conflict(const sockaddr_in *src_addr)
+{
+    /* without the address a loop can not be told from a collision, so the packet is only dropped */
+    if (!src_addr)
+    {
+        ++loops_;
+        return true;
+    }
+
+    uint64_t address = ((uint64_t)ntohl(src_addr->sin_addr.s_addr) << 16) | ntohs(src_addr->sin_port);
+    uint64_t now     = uvgrtp::rtcp_scheduler::now();
+
+    std::lock_guard<std::mutex> lock(packet_mutex_);
+
+    for (auto it = conflicting_addresses_.begin(); it != conflicting_addresses_.end();)
+    {
+        if (it->second + CONFLICT_TIMEOUT_MS < now)
+        {
+            it = conflicting_addresses_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    auto conflict = conflicting_addresses_.find(address);
+
+    if (conflict != conflicting_addresses_.end())
+    {
+        conflict->second = now;
+        ++loops_;
+        return true;
+    }
+
+    conflicting_addresses_[address] = now;
+
+    uint32_t old_ssrc = ssrc_;
+    LOG_WARN("Our SSRC %lu collided with another participant, choosing a new one", old_ssrc);
+
+    /* Leave the session with the old SSRC. The participant that sent the packet keeps it */
+    std::vector<uint32_t> bye_ssrcs = { old_ssrc };
+    size_t bye_size = get_rr_packet_size(0) + get_sdes_packet_size(ourItems_) + get_bye_packet_size(bye_ssrcs);
+    std::unique_ptr<uint8_t[]> frame(new uint8_t[bye_size + uvgrtp::base_srtp::get_rtcp_trailer_length(srtcp_ ? flags_ : 0)]);
+    int write_ptr = 0;
+
+    if (!construct_rtcp_header(frame.get(), write_ptr, get_rr_packet_size(0), 0, uvgrtp::frame::RTCP_FT_RR) ||
+        !construct_ssrc(frame.get(), write_ptr, old_ssrc) ||
+        !construct_rtcp_header(frame.get(), write_ptr, get_sdes_packet_size(ourItems_), 1, uvgrtp::frame::RTCP_FT_SDES) ||
+        !construct_sdes_chunk(frame.get(), write_ptr, old_ssrc, ourItems_) ||
+        !construct_rtcp_header(frame.get(), write_ptr, get_bye_packet_size(bye_ssrcs), 1, uvgrtp::frame::RTCP_FT_BYE) ||
+        !construct_bye_packet(frame.get(), write_ptr, bye_ssrcs))
+    {
+        LOG_ERROR("Failed to construct BYE for our old SSRC");
+    }
+    else
+    {
+        rtcp_pkt_sent_count_++;
+        (void)send_rtcp_packet_to_participants(frame.get(), bye_size, true);
+
+        /* the participants we have not heard from yet do not get reports but they still need the BYE */
+        for (auto& participant : initial_participants_)
+        {
+            if (participant->socket)
+            {
+                (void)participant->socket->sendto(participant->address, frame.get(), bye_size, 0);
+            }
+        }
+    }
+
+    uint32_t new_ssrc = 0;
+
+    do {
+        new_ssrc = uvgrtp::random::generate_32();
+    } while (new_ssrc == old_ssrc || reset_rtcp_state(new_ssrc) != RTP_OK);
+
+    LOG_INFO("Our new SSRC is %lu", new_ssrc);
+    ++collisions_;
+
+    return false;
+}
+
+uvgrtp::rtcp_participant *uvgrtp::rtcp::find_sender(uint32_t ssrc)
+{
+    uint32_t generation = participants_generation_.load(std::memory_order_acquire);
+
+    if (cached_sender_ && cached_ssrc_ == ssrc && cached_generation_ == generation)
+    {
+        return cached_sender_;
+    }
+
+    std::lock_guard<std::mutex> lock(packet_mutex_);
+
+    /* This thread no longer holds any of the removed participants so they can be freed */
+    if (cached_generation_ != participants_generation_.load(std::memory_order_acquire))
+    {
+        for (auto& participant : retired_participants_)
+        {
+            free_participant(participant);
+        }
+        retired_participants_.clear();
+        cached_generation_ = participants_generation_.load(std::memory_order_acquire);
+    }
+
+    auto it = participants_.find(ssrc);
+
+    cached_sender_ = (it != participants_.end()) ? it->second : nullptr;
+    cached_ssrc_   = ssrc;
+
+    return cached_sender_;
+}
+
+void uvgrtp::rtcp::retire_participant(uint32_t ssrc)
+{
+    auto it = participants_.find(ssrc);
+
+    if (it == participants_.end())
+    {
+        return;
+    }
+
+    it->second->socket = nullptr;
+    retired_participants_.push_back(it->second);
+    participants_.erase(it);
+
+    participants_generation_.fetch_add(1, std::memory_order_release);
+    publish_analytics_index();
+}
+
+void uvgrtp::rtcp::publish_statistics(rtcp_participant *p)
+{
+    auto& shared = p->published;
+    uint32_t sequence = shared.sequence.load(std::memory_order_relaxed);
+
+    shared.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    shared.received_pkts.store(p->stats.received_pkts,   std::memory_order_relaxed);
+    shared.dropped_pkts.store(p->stats.dropped_pkts,     std::memory_order_relaxed);
+    shared.received_bytes.store(p->stats.received_bytes, std::memory_order_relaxed);
+    shared.jitter.store(p->stats.jitter,                 std::memory_order_relaxed);
+    shared.max_seq.store(p->stats.max_seq,               std::memory_order_relaxed);
+    shared.cycles.store(p->stats.cycles,                 std::memory_order_relaxed);
+
+    shared.sequence.store(sequence + 2, std::memory_order_release);
+    shared.received_rtp_packet.store(true, std::memory_order_release);
+}
+
+uvgrtp::statistics_snapshot uvgrtp::rtcp::read_statistics(const rtcp_participant *p)
+{
+    const auto& shared = p->published;
+    statistics_snapshot snapshot;
+    uint32_t before = 0;
+    uint32_t after  = 0;
+
+    do {
+        before = shared.sequence.load(std::memory_order_acquire);
+
+        snapshot.received_pkts  = shared.received_pkts.load(std::memory_order_relaxed);
+        snapshot.dropped_pkts   = shared.dropped_pkts.load(std::memory_order_relaxed);
+        snapshot.received_bytes = shared.received_bytes.load(std::memory_order_relaxed);
+        snapshot.jitter         = shared.jitter.load(std::memory_order_relaxed);
+        snapshot.max_seq        = (uint16_t)shared.max_seq.load(std::memory_order_relaxed);
+        snapshot.cycles         = (uint16_t)shared.cycles.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = shared.sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    return snapshot;
+}
+
 void uvgrtp::rtcp::update_session_statistics(const uvgrtp::frame::rtp_frame *frame)
 {
-    auto p = participants_[frame->header.ssrc];
+    auto p = find_sender(frame->header.ssrc);
 
-    p->stats.received_rtp_packet = true;
+    if (!p)
+    {
+        return;
+    }
 
     p->stats.received_pkts  += 1;
     p->stats.received_bytes += (uint32_t)frame->payload_len;
@@ -922,17 +1627,20 @@ void uvgrtp::rtcp::update_session_statistics(const uvgrtp::frame::rtp_frame *fra
     p->stats.dropped_pkts = dropped >= 0 ? dropped : 0;
 
     // the arrival time expressed as an RTP timestamp
-    uint32_t arrival =
-        p->stats.initial_rtp +
-        + (uint32_t)uvgrtp::clock::ntp::diff_now(p->stats.initial_ntp)*(p->stats.clock_rate / 1000);
+    uint32_t arrival = arrival_rtp_time(p, arrival_time(frame));
 
     // calculate interarrival jitter. See RFC 3550 A.8
     uint32_t transit = arrival - frame->header.timestamp; // A.8: int transit = arrival - r->ts
-    uint32_t trans_difference = std::abs((int)(transit - p->stats.transit));
+    int32_t d        = (int32_t)(transit - p->stats.transit);
 
-    // update statistics
+    // update statistics, the first packet has no previous transit time to compare to
+    if (p->stats.received_pkts > 1)
+    {
+        p->stats.jitter += (uint32_t)std::abs(d) - ((p->stats.jitter + 8) >> 4);
+    }
     p->stats.transit = transit;
-    p->stats.jitter += (1.f / 16.f) * ((double)trans_difference - p->stats.jitter);
+
+    publish_statistics(p);
 }
 
 /* RTCP packet handler is responsible for doing two things:
@@ -956,7 +1664,16 @@ rtp_error_t uvgrtp::rtcp::recv_packet_handler(void *arg, int flags, frame::rtp_f
     if (auto payload_type = frame->header.payload;
         72 <= payload_type && payload_type <= 76)
     {
-        return rtcp->handle_incoming_packet(frame->dgram, frame->dgram_size);
+        return rtcp->handle_incoming_packet(frame->dgram, frame->dgram_size, &frame->src_addr);
+    }
+
+    /* A packet with our own SSRC is either a collision or a loop (RFC 3550 section 8.2) */
+    if (frame->header.ssrc == rtcp->ssrc_.load(std::memory_order_relaxed) &&
+        rtcp->resolve_own_ssrc_conflict(&frame->src_addr))
+    {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        *out = nullptr;
+        return RTP_GENERIC_ERROR;
     }
 
     /* If this is the first packet from remote, move the participant from initial_participants_
@@ -966,14 +1683,15 @@ rtp_error_t uvgrtp::rtcp::recv_packet_handler(void *arg, int flags, frame::rtp_f
      * Otherwise update and monitor the received sequence numbers to determine whether something
      * has gone awry with the sender's sequence number calculations/delivery of packets */
     rtp_error_t ret = RTP_OK;
-    if (!rtcp->is_participant(frame->header.ssrc))
+    if (!rtcp->find_sender(frame->header.ssrc))
     {
         if ((rtcp->init_new_participant(frame)) != RTP_OK)
         {
             LOG_ERROR("Failed to initiate new participant");
             return RTP_GENERIC_ERROR;
         }
-    } else if ((ret = rtcp->update_participant_seq(frame->header.ssrc, frame->header.seq)) != RTP_OK) {
+    } else if ((ret = rtcp->update_participant_seq(frame->header.ssrc, frame->header.seq,
+        arrival_time(frame))) != RTP_OK) {
         if (ret == RTP_NOT_READY) {
             return RTP_OK;
         }
@@ -993,19 +1711,27 @@ rtp_error_t uvgrtp::rtcp::recv_packet_handler(void *arg, int flags, frame::rtp_f
 
 rtp_error_t uvgrtp::rtcp::send_packet_handler_vec(void *arg, uvgrtp::buf_vec& buffers)
 {
-    ssize_t pkt_size = -uvgrtp::frame::HEADER_SIZE_RTP;
+    if (buffers.empty())
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    /* the first buffer is the RTP header, including possible header extensions */
+    ssize_t pkt_size = -(ssize_t)buffers.at(0).first;
 
     for (auto& buffer : buffers)
     {
         pkt_size += buffer.first;
     }
 
-    if (pkt_size < 0)
+    if (pkt_size < 0 || buffers.at(0).first < RTP_HDR_SIZE)
     {
         return RTP_INVALID_VALUE;
     }
 
-    return ((uvgrtp::rtcp *)arg)->update_sender_stats(pkt_size);
+    uint32_t rtp_ts = ntohl(*(uint32_t*)&buffers.at(0).second[4]);
+
+    return ((uvgrtp::rtcp *)arg)->update_sender_stats(pkt_size, rtp_ts);
 }
 
 size_t uvgrtp::rtcp::rtcp_length_in_bytes(uint16_t length)
@@ -1014,7 +1740,7 @@ size_t uvgrtp::rtcp::rtcp_length_in_bytes(uint16_t length)
     return uint32_t(length + 1) * sizeof(uint32_t);
 }
 
-rtp_error_t uvgrtp::rtcp::handle_incoming_packet(uint8_t *buffer, size_t size)
+rtp_error_t uvgrtp::rtcp::handle_incoming_packet(uint8_t *buffer, size_t size, const sockaddr_in *src_addr)
 {
     if (!buffer || !size)
     {
@@ -1028,7 +1754,12 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(uint8_t *buffer, size_t size)
 
     int packets = 0;
 
+    /* whether the latest packet is a feedback message, which may also come alone (RFC 5506) */
+    bool feedback = false;
+
+    packet_mutex_.lock();
     update_rtcp_bandwidth(size);
+    packet_mutex_.unlock();
 
     rtp_error_t ret = RTP_OK;
 
@@ -1045,6 +1776,24 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(uint8_t *buffer, size_t size)
             return ret;
         }
     }
+    else if (srtcp_)
+    {
+        LOG_ERROR("RTCP packet is too small to be an SRTCP packet");
+        return RTP_INVALID_VALUE;
+    }
+
+    /* A packet with our own SSRC is either a collision or a loop (RFC 3550 section 8.2) */
+    if (sender_ssrc == ssrc_.load(std::memory_order_relaxed) && resolve_own_ssrc_conflict(src_addr))
+    {
+        LOG_DEBUG("Dropping a looped RTCP packet");
+        return RTP_OK;
+    }
+
+    // the SRTCP fields after the last packet have now been handled
+    if (srtcp_)
+    {
+        remaining_size -= uvgrtp::base_srtp::get_rtcp_trailer_length(flags_);
+    }
 
     // this handles each separate rtcp packet in a compound packet
     while (remaining_size > 0)
@@ -1088,7 +1837,7 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(uint8_t *buffer, size_t size)
             return RTP_INVALID_VALUE;
         }
 
-        if (header.pkt_type > uvgrtp::frame::RTCP_FT_APP ||
+        if (header.pkt_type > uvgrtp::frame::RTCP_FT_XR ||
             header.pkt_type < uvgrtp::frame::RTCP_FT_SR)
         {
             LOG_ERROR("Invalid packet type (%u)!", header.pkt_type);
@@ -1097,6 +1846,8 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(uint8_t *buffer, size_t size)
 
         rtp_error_t ret = RTP_INVALID_VALUE;
 
+        feedback = header.pkt_type == uvgrtp::frame::RTCP_FT_RTPFB || header.pkt_type == uvgrtp::frame::RTCP_FT_PSFB;
+
         switch (header.pkt_type)
         {
             case uvgrtp::frame::RTCP_FT_SR:
@@ -1119,6 +1870,15 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(uint8_t *buffer, size_t size)
                 ret = handle_app_packet(buffer, read_ptr, packet_end, header);
                 break;
 
+            case uvgrtp::frame::RTCP_FT_XR:
+                ret = handle_xr_packet(buffer, read_ptr, packet_end, header);
+                break;
+
+            case uvgrtp::frame::RTCP_FT_RTPFB:
+            case uvgrtp::frame::RTCP_FT_PSFB:
+                ret = handle_fb_packet(buffer, read_ptr, packet_end, header);
+                break;
+
             default:
                 LOG_WARN("Unknown packet received, type %d", header.pkt_type);
                 break;
@@ -1134,10 +1894,24 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(uint8_t *buffer, size_t size)
         remaining_size -= size_of_rtcp_packet;
     }
 
+    /* The sender is still a member of the session, see RFC 3550 section 6.3.5 */
+    packet_mutex_.lock();
+    auto sender = participants_.find(sender_ssrc);
+
+    if (sender != participants_.end())
+    {
+        sender->second->last_active = uvgrtp::rtcp_scheduler::now();
+    }
+    packet_mutex_.unlock();
+
     if (packets > 1)
     {
         LOG_DEBUG("Received a compound RTCP frame with %i packets and size: %li", packets, size);
     }
+    else if (feedback)
+    {
+        LOG_DEBUG("Received a reduced-size RTCP packet with size: %li", size);
+    }
     else
     {
         LOG_WARN("Received RTCP packet was not a compound packet!");
@@ -1169,20 +1943,14 @@ void uvgrtp::rtcp::read_rtcp_header(const uint8_t* buffer, size_t& read_ptr, uvg
 void uvgrtp::rtcp::read_reports(const uint8_t* buffer, size_t& read_ptr, size_t packet_end, uint8_t count,
     std::vector<uvgrtp::frame::rtcp_report_block>& reports)
 {
+    uvgrtp::frame::rtcp_report_view view;
+
     for (int i = 0; i < count; ++i)
     {
         if (packet_end >= read_ptr + REPORT_BLOCK_SIZE)
         {
-            uvgrtp::frame::rtcp_report_block report;
-            report.ssrc = ntohl(*(uint32_t*)& buffer[read_ptr + 0]);
-            report.fraction = (ntohl(*(uint32_t*)& buffer[read_ptr + 4])) >> 24;
-            report.lost = (ntohl(*(int32_t*)& buffer[read_ptr + 4])) & 0xfffffd;
-            report.last_seq = ntohl(*(uint32_t*)& buffer[read_ptr + 8]);
-            report.jitter = ntohl(*(uint32_t*)& buffer[read_ptr + 12]);
-            report.lsr = ntohl(*(uint32_t*)& buffer[read_ptr + 16]);
-            report.dlsr = ntohl(*(uint32_t*)& buffer[read_ptr + 20]);
-
-            reports.push_back(report);
+            view.report_blocks = &buffer[read_ptr];
+            reports.push_back(uvgrtp::frame::get_report_block(view, 0));
             read_ptr += REPORT_BLOCK_SIZE;
         }
         else {
@@ -1192,104 +1960,556 @@ void uvgrtp::rtcp::read_reports(const uint8_t* buffer, size_t& read_ptr, size_t
     }
 }
 
-void uvgrtp::rtcp::read_ssrc(const uint8_t* buffer, size_t& read_ptr, uint32_t& out_ssrc)
+uvgrtp::frame::rtcp_report_view uvgrtp::rtcp::make_report_view(const uint8_t* buffer, size_t packet_start,
+    size_t packet_end, const uvgrtp::frame::rtcp_header& header, uint32_t ssrc, bool sender_report) const
 {
-    out_ssrc = ntohl(*(uint32_t*)& buffer[read_ptr]);
-    read_ptr += SSRC_CSRC_SIZE;
-}
+    uvgrtp::frame::rtcp_report_view view;
+    view.header = header;
+    view.ssrc   = ssrc;
 
-rtp_error_t uvgrtp::rtcp::handle_receiver_report_packet(uint8_t* buffer, size_t& read_ptr, size_t packet_end,
-    uvgrtp::frame::rtcp_header& header)
-{
-    auto frame = new uvgrtp::frame::rtcp_receiver_report;
-    frame->header = header;
-    read_ssrc(buffer, read_ptr, frame->ssrc);
+    size_t blocks_start = packet_start + RTCP_HEADER_SIZE + SSRC_CSRC_SIZE;
 
-    /* Receiver Reports are sent from participant that don't send RTP packets
-     * This means that the sender of this report is not in the participants_ map
-     * but rather in the initial_participants_ vector
-     *
-     * Check if that's the case and if so, move the entry from initial_participants_ to participants_ */
-    if (!is_participant(frame->ssrc))
+    if (sender_report)
     {
-        LOG_INFO("Got an RR from a previously unknown participant SSRC %lu", frame->ssrc);
-        add_participant(frame->ssrc);
+        view.sender_info = &buffer[blocks_start];
+        blocks_start    += SENDER_INFO_SIZE;
     }
 
-    if (!frame->header.count)
+    /* only the report blocks that are within the packet are included in the view */
+    size_t blocks = (packet_end - blocks_start) / REPORT_BLOCK_SIZE;
+
+    if (view.header.count > blocks)
     {
-        LOG_ERROR("RR cannot have 0 report blocks!");
-        return RTP_INVALID_VALUE;
+        LOG_WARN("Received rtcp packet is smaller than the indicated number of reports!");
+        view.header.count = (uint8_t)blocks;
     }
 
-    read_reports(buffer, read_ptr, packet_end, frame->header.count, frame->report_blocks);
+    view.report_blocks = &buffer[blocks_start];
 
-    rr_mutex_.lock();
-    if (receiver_hook_) {
-        receiver_hook_(frame);
-    }
-    else if (rr_hook_f_) {
-        rr_hook_f_(std::shared_ptr<uvgrtp::frame::rtcp_receiver_report>(frame));
-    }
-    else if (rr_hook_u_) {
-        rr_hook_u_(std::unique_ptr<uvgrtp::frame::rtcp_receiver_report>(frame));
-    }
-    else {
-        /* Deallocate previous frame from the buffer if it exists, it's going to get overwritten */
-        if (participants_[frame->ssrc]->rr_frame)
-        {
-            delete participants_[frame->ssrc]->rr_frame;
-        }
+    return view;
+}
 
-        participants_[frame->ssrc]->rr_frame = frame;
+bool uvgrtp::rtcp::call_report_view_hook(const uvgrtp::frame::rtcp_report_view& view)
+{
+    std::lock_guard<std::mutex> lock(report_view_mutex_);
+
+    if (!report_view_hook_)
+    {
+        return false;
     }
-    rr_mutex_.unlock();
 
-    return RTP_OK;
+    report_view_hook_(view);
+
+    return true;
 }
 
-rtp_error_t uvgrtp::rtcp::handle_sender_report_packet(uint8_t* buffer, size_t& read_ptr, size_t packet_end,
-    uvgrtp::frame::rtcp_header& header)
+void uvgrtp::rtcp::update_analytics(uint32_t ssrc, const uvgrtp::frame::rtcp_report_view& view)
 {
-    auto frame = new uvgrtp::frame::rtcp_sender_report;
-    frame->header = header;
-    read_ssrc(buffer, read_ptr, frame->ssrc);
-    if (!is_participant(frame->ssrc))
+    std::shared_ptr<shared_analytics> shared;
+    uint32_t participant_clock_rate = 0;
+
+    /* The RTP packet processing thread may be adding participants */
+    packet_mutex_.lock();
+    auto it = participants_.find(ssrc);
+
+    if (it != participants_.end())
     {
-        LOG_INFO("Got an SR from a previously unknown participant SSRC %lu", frame->ssrc);
-        add_participant(frame->ssrc);
+        shared                 = it->second->analytics;
+        participant_clock_rate = it->second->stats.clock_rate;
     }
+    packet_mutex_.unlock();
 
-    participants_[frame->ssrc]->stats.sr_ts = uvgrtp::clock::hrc::now();
+    if (!shared)
+    {
+        return;
+    }
 
-    frame->sender_info.ntp_msw = ntohl(*(uint32_t*)& buffer[read_ptr]);
-    frame->sender_info.ntp_lsw = ntohl(*(uint32_t*)& buffer[read_ptr + 4]);
-    frame->sender_info.rtp_ts = ntohl(*(uint32_t*)& buffer[read_ptr + 8]);
-    frame->sender_info.pkt_cnt = ntohl(*(uint32_t*)& buffer[read_ptr + 12]);
-    frame->sender_info.byte_cnt = ntohl(*(uint32_t*)& buffer[read_ptr + 16]);
-    read_ptr += SENDER_INFO_SIZE;
+    /* This thread is the only writer of the analytics so they are updated without the lock */
+    auto& analytics = *shared;
+    auto& current   = analytics.current;
 
-    participants_[frame->ssrc]->stats.lsr =
-        ((frame->sender_info.ntp_msw & 0xffff) << 16) |
-        (frame->sender_info.ntp_lsw >> 16);
+    uint64_t sync_ntp        = 0;
+    uint32_t sync_rtp        = 0;
+    uint32_t sync_clock_rate = 0;
 
-    read_reports(buffer, read_ptr, packet_end, frame->header.count, frame->report_blocks);
+    /* the middle 32 bits of the NTP timestamp, the same units as LSR and DLSR */
+    uint32_t arrival = (uint32_t)(uvgrtp::clock::ntp::now() >> 16);
 
-    sr_mutex_.lock();
-    if (sender_hook_) {
-        sender_hook_(frame);
-    }
-    else if (sr_hook_f_) {
-        sr_hook_f_(std::shared_ptr<uvgrtp::frame::rtcp_sender_report>(frame));
-    }
-    else if (sr_hook_u_) {
-        sr_hook_u_(std::unique_ptr<uvgrtp::frame::rtcp_sender_report>(frame));
-    }
-    else {
-        /* Deallocate previous frame from the buffer if it exists, it's going to get overwritten */
-        if (participants_[frame->ssrc]->sr_frame)
+    if (view.sender_info)
+    {
+        uvgrtp::frame::rtcp_sender_info info = uvgrtp::frame::get_sender_info(view);
+        uint64_t ntp = ((uint64_t)info.ntp_msw << 32) | info.ntp_lsw;
+
+        if (analytics.sr_ntp && ntp > analytics.sr_ntp)
         {
-            delete participants_[frame->ssrc]->sr_frame;
+            double seconds = (double)(ntp - analytics.sr_ntp) / 4294967296.0;
+            current.bitrate_kbps = (uint32_t)(info.byte_cnt - analytics.sr_octets) * 8 / seconds / 1000;
+        }
+
+        analytics.sr_ntp    = ntp;
+        analytics.sr_octets = info.byte_cnt;
+
+        /* the clock rate of a participant learned from its packets is not known, its stream has the format of ours */
+        uint32_t clock_rate = participant_clock_rate ? participant_clock_rate : clock_rate_;
+
+        sync_ntp        = ntp;
+        sync_rtp        = info.rtp_ts;
+        sync_clock_rate = clock_rate;
+    }
+
+    for (size_t i = 0; i < view.header.count; ++i)
+    {
+        uvgrtp::frame::rtcp_report_block block = uvgrtp::frame::get_report_block(view, i);
+
+        if (block.ssrc != ssrc_)
+        {
+            continue;
+        }
+
+        double fraction_lost = block.fraction / 256.0;
+
+        current.smoothed_fraction_lost = (current.reports == 0) ? fraction_lost :
+            current.smoothed_fraction_lost + ANALYTICS_GAIN * (fraction_lost - current.smoothed_fraction_lost);
+        current.fraction_lost = fraction_lost;
+        ++current.reports;
+
+        /* the cumulative number of packets lost is a signed 24-bit value */
+        current.cumulative_lost = (block.lost & 0x800000) ? block.lost - 0x1000000 : block.lost;
+        current.highest_seq     = block.last_seq;
+        current.jitter_ms       = clock_rate_ ? (double)block.jitter * 1000 / clock_rate_ : 0.0;
+
+        /* LSR is zero until the participant has received an SR from us (RFC 3550 section 6.4.1) */
+        if (block.lsr)
+        {
+            int32_t rtt = (int32_t)(arrival - block.lsr - block.dlsr);
+
+            /* the clocks are not synchronized so a negative RTT is taken as zero */
+            double rtt_ms = (rtt > 0) ? (double)rtt * 1000 / 65536 : 0.0;
+
+            current.smoothed_rtt_ms = (current.smoothed_rtt_ms < 0) ? rtt_ms :
+                current.smoothed_rtt_ms + ANALYTICS_GAIN * (rtt_ms - current.smoothed_rtt_ms);
+            current.rtt_ms = rtt_ms;
+        }
+    }
+
+    uint32_t sequence = analytics.sequence.load(std::memory_order_relaxed);
+
+    analytics.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    analytics.reports.store(current.reports,                               std::memory_order_relaxed);
+    analytics.rtt_ms.store(current.rtt_ms,                                 std::memory_order_relaxed);
+    analytics.smoothed_rtt_ms.store(current.smoothed_rtt_ms,               std::memory_order_relaxed);
+    analytics.fraction_lost.store(current.fraction_lost,                   std::memory_order_relaxed);
+    analytics.smoothed_fraction_lost.store(current.smoothed_fraction_lost, std::memory_order_relaxed);
+    analytics.cumulative_lost.store(current.cumulative_lost,               std::memory_order_relaxed);
+    analytics.highest_seq.store(current.highest_seq,                       std::memory_order_relaxed);
+    analytics.jitter_ms.store(current.jitter_ms,                           std::memory_order_relaxed);
+    analytics.bitrate_kbps.store(current.bitrate_kbps,                     std::memory_order_relaxed);
+
+    if (sync_ntp != 0)
+    {
+        analytics.sync_ntp.store(sync_ntp,               std::memory_order_relaxed);
+        analytics.sync_rtp.store(sync_rtp,               std::memory_order_relaxed);
+        analytics.sync_clock_rate.store(sync_clock_rate, std::memory_order_relaxed);
+    }
+
+    analytics.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+uvgrtp::rtcp_analytics uvgrtp::rtcp::read_analytics(const shared_analytics& analytics)
+{
+    rtcp_analytics snapshot;
+    uint32_t before = 0;
+    uint32_t after  = 0;
+
+    snapshot.ssrc = analytics.current.ssrc;
+
+    do {
+        before = analytics.sequence.load(std::memory_order_acquire);
+
+        snapshot.reports                = analytics.reports.load(std::memory_order_relaxed);
+        snapshot.rtt_ms                 = analytics.rtt_ms.load(std::memory_order_relaxed);
+        snapshot.smoothed_rtt_ms        = analytics.smoothed_rtt_ms.load(std::memory_order_relaxed);
+        snapshot.fraction_lost          = analytics.fraction_lost.load(std::memory_order_relaxed);
+        snapshot.smoothed_fraction_lost = analytics.smoothed_fraction_lost.load(std::memory_order_relaxed);
+        snapshot.cumulative_lost        = analytics.cumulative_lost.load(std::memory_order_relaxed);
+        snapshot.highest_seq            = analytics.highest_seq.load(std::memory_order_relaxed);
+        snapshot.jitter_ms              = analytics.jitter_ms.load(std::memory_order_relaxed);
+        snapshot.bitrate_kbps           = analytics.bitrate_kbps.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = analytics.sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    return snapshot;
+}
+
+void uvgrtp::rtcp::publish_analytics_index()
+{
+    auto index = std::make_shared<analytics_index>();
+
+    for (auto& participant : participants_)
+    {
+        (*index)[participant.first] = participant.second->analytics;
+    }
+
+    std::atomic_store(&analytics_index_, std::shared_ptr<const analytics_index>(index));
+}
+
+rtp_error_t uvgrtp::rtcp::get_analytics(uint32_t ssrc, uvgrtp::rtcp_analytics& analytics) const
+{
+    auto index = std::atomic_load(&analytics_index_);
+    auto it    = index->find(ssrc);
+
+    if (it == index->end())
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    analytics = read_analytics(*it->second);
+
+    return RTP_OK;
+}
+
+std::vector<uvgrtp::rtcp_analytics> uvgrtp::rtcp::get_analytics() const
+{
+    auto index = std::atomic_load(&analytics_index_);
+    std::vector<uvgrtp::rtcp_analytics> analytics;
+
+    for (auto& participant : *index)
+    {
+        analytics.push_back(read_analytics(*participant.second));
+    }
+
+    return analytics;
+}
+
+rtp_error_t uvgrtp::rtcp::get_sender_ntp(uint32_t ssrc, uint32_t rtp_ts, uint64_t& ntp_ts) const
+{
+    auto index = std::atomic_load(&analytics_index_);
+    auto it    = index->find(ssrc);
+
+    if (it == index->end())
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    const shared_analytics& analytics = *it->second;
+    uint64_t sync_ntp   = 0;
+    uint32_t sync_rtp   = 0;
+    uint32_t clock_rate = 0;
+    uint32_t before     = 0;
+    uint32_t after      = 0;
+
+    do {
+        before = analytics.sequence.load(std::memory_order_acquire);
+
+        sync_ntp   = analytics.sync_ntp.load(std::memory_order_relaxed);
+        sync_rtp   = analytics.sync_rtp.load(std::memory_order_relaxed);
+        clock_rate = analytics.sync_clock_rate.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = analytics.sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    if (sync_ntp == 0 || clock_rate == 0)
+    {
+        return RTP_NOT_READY;
+    }
+
+    /* the timestamp may be before or after the one of the SR and the difference wraps around */
+    double seconds = (double)(int32_t)(rtp_ts - sync_rtp) / clock_rate;
+
+    ntp_ts = sync_ntp + (uint64_t)(int64_t)std::llround(seconds * 4294967296.0);
+
+    return RTP_OK;
+}
+
+uvgrtp::rtcp_conflict_statistics uvgrtp::rtcp::get_conflict_statistics() const
+{
+    uvgrtp::rtcp_conflict_statistics statistics;
+
+    statistics.collisions = collisions_;
+    statistics.loops      = loops_;
+
+    return statistics;
+}
+
+uvgrtp::rtcp_hook_statistics uvgrtp::rtcp::get_hook_statistics() const
+{
+    uvgrtp::rtcp_hook_statistics statistics;
+
+    if (dispatcher_)
+    {
+        statistics.delivered = dispatcher_->delivered();
+        statistics.dropped   = dispatcher_->dropped();
+        statistics.coalesced = dispatcher_->coalesced();
+    }
+
+    return statistics;
+}
+
+/* Call the hook installed for "frame" and return false if there is none. The hook is
+ * copied so that the packet thread is not kept waiting for "mutex" while the hook runs */
+template <typename T>
+static bool call_hook(std::mutex& mutex, void (*const& hook)(T*),
+    const std::function<void(std::shared_ptr<T>)>& hook_f,
+    const std::function<void(std::unique_ptr<T>)>& hook_u, T* frame)
+{
+    mutex.lock();
+    auto hook_copy   = hook;
+    auto hook_f_copy = hook_f;
+    auto hook_u_copy = hook_u;
+    mutex.unlock();
+
+    if (hook_copy) {
+        hook_copy(frame);
+    } else if (hook_f_copy) {
+        hook_f_copy(std::shared_ptr<T>(frame));
+    } else if (hook_u_copy) {
+        hook_u_copy(std::unique_ptr<T>(frame));
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+void uvgrtp::rtcp::deliver_hook_event(uvgrtp::rtcp_hook_event& event)
+{
+    bool delivered = false;
+
+    switch (event.type)
+    {
+        case uvgrtp::frame::RTCP_FT_SR:
+            delivered = call_hook(sr_mutex_, sender_hook_, sr_hook_f_, sr_hook_u_,
+                (uvgrtp::frame::rtcp_sender_report*)event.frame);
+            break;
+
+        case uvgrtp::frame::RTCP_FT_RR:
+            delivered = call_hook(rr_mutex_, receiver_hook_, rr_hook_f_, rr_hook_u_,
+                (uvgrtp::frame::rtcp_receiver_report*)event.frame);
+            break;
+
+        case uvgrtp::frame::RTCP_FT_SDES:
+            delivered = call_hook(sdes_mutex_, sdes_hook_, sdes_hook_f_, sdes_hook_u_,
+                (uvgrtp::frame::rtcp_sdes_packet*)event.frame);
+            break;
+
+        case uvgrtp::frame::RTCP_FT_APP:
+            delivered = call_hook(app_mutex_, app_hook_, app_hook_f_, app_hook_u_,
+                (uvgrtp::frame::rtcp_app_packet*)event.frame);
+            break;
+
+        case uvgrtp::frame::RTCP_FT_XR:
+            delivered = call_hook(xr_mutex_, xr_hook_, xr_hook_f_, xr_hook_u_,
+                (uvgrtp::frame::rtcp_xr_packet*)event.frame);
+            break;
+
+        case uvgrtp::frame::RTCP_FT_RTPFB:
+        case uvgrtp::frame::RTCP_FT_PSFB:
+            delivered = call_hook(fb_mutex_, fb_hook_, fb_hook_f_, fb_hook_u_,
+                (uvgrtp::frame::rtcp_fb_packet*)event.frame);
+            break;
+
+        default:
+            break;
+    }
+
+    /* the hook was removed while the packet was queued */
+    if (!delivered)
+    {
+        free_hook_event(event);
+    }
+}
+
+void uvgrtp::rtcp::free_hook_event(uvgrtp::rtcp_hook_event& event)
+{
+    switch (event.type)
+    {
+        case uvgrtp::frame::RTCP_FT_SR:
+            delete (uvgrtp::frame::rtcp_sender_report*)event.frame;
+            break;
+
+        case uvgrtp::frame::RTCP_FT_RR:
+            delete (uvgrtp::frame::rtcp_receiver_report*)event.frame;
+            break;
+
+        case uvgrtp::frame::RTCP_FT_SDES:
+        {
+            auto frame = (uvgrtp::frame::rtcp_sdes_packet*)event.frame;
+            for (auto& chunk : frame->chunks)
+            {
+                for (auto& item : chunk.items)
+                {
+                    delete[](uint8_t*)item.data;
+                }
+            }
+            delete frame;
+            break;
+        }
+
+        case uvgrtp::frame::RTCP_FT_APP:
+        {
+            auto frame = (uvgrtp::frame::rtcp_app_packet*)event.frame;
+            delete[] frame->payload;
+            delete frame;
+            break;
+        }
+
+        case uvgrtp::frame::RTCP_FT_XR:
+            delete (uvgrtp::frame::rtcp_xr_packet*)event.frame;
+            break;
+
+        case uvgrtp::frame::RTCP_FT_RTPFB:
+        case uvgrtp::frame::RTCP_FT_PSFB:
+            delete (uvgrtp::frame::rtcp_fb_packet*)event.frame;
+            break;
+
+        default:
+            break;
+    }
+
+    event.frame = nullptr;
+}
+
+void uvgrtp::rtcp::read_ssrc(const uint8_t* buffer, size_t& read_ptr, uint32_t& out_ssrc)
+{
+    out_ssrc = ntohl(*(uint32_t*)& buffer[read_ptr]);
+    read_ptr += SSRC_CSRC_SIZE;
+}
+
+rtp_error_t uvgrtp::rtcp::handle_receiver_report_packet(uint8_t* buffer, size_t& read_ptr, size_t packet_end,
+    uvgrtp::frame::rtcp_header& header)
+{
+    size_t packet_start = read_ptr - RTCP_HEADER_SIZE;
+
+    if (packet_end < read_ptr + SSRC_CSRC_SIZE)
+    {
+        LOG_ERROR("RR is too small to contain the SSRC");
+        return RTP_INVALID_VALUE;
+    }
+
+    uint32_t ssrc = 0;
+    read_ssrc(buffer, read_ptr, ssrc);
+
+    /* Receiver Reports are sent from participant that don't send RTP packets
+     * This means that the sender of this report is not in the participants_ map
+     * but rather in the initial_participants_ vector
+     *
+     * Check if that's the case and if so, move the entry from initial_participants_ to participants_ */
+    if (!is_participant(ssrc))
+    {
+        LOG_INFO("Got an RR from a previously unknown participant SSRC %lu", ssrc);
+        add_participant(ssrc);
+    }
+
+    uvgrtp::frame::rtcp_report_view view = make_report_view(buffer, packet_start, packet_end, header, ssrc, false);
+    update_analytics(ssrc, view);
+
+    if (call_report_view_hook(view))
+    {
+        return RTP_OK;
+    }
+
+    auto frame = new uvgrtp::frame::rtcp_receiver_report;
+    frame->header = header;
+    frame->ssrc   = ssrc;
+
+    /* Receivers that have not received RTP packets send empty RRs */
+    read_reports(buffer, read_ptr, packet_end, frame->header.count, frame->report_blocks);
+
+    rr_mutex_.lock();
+    if (dispatcher_ && (receiver_hook_ || rr_hook_f_ || rr_hook_u_)) {
+        dispatcher_->push({ uvgrtp::frame::RTCP_FT_RR, ssrc, frame });
+    }
+    else if (receiver_hook_) {
+        receiver_hook_(frame);
+    }
+    else if (rr_hook_f_) {
+        rr_hook_f_(std::shared_ptr<uvgrtp::frame::rtcp_receiver_report>(frame));
+    }
+    else if (rr_hook_u_) {
+        rr_hook_u_(std::unique_ptr<uvgrtp::frame::rtcp_receiver_report>(frame));
+    }
+    else {
+        /* Deallocate previous frame from the buffer if it exists, it's going to get overwritten */
+        if (participants_[frame->ssrc]->rr_frame)
+        {
+            delete participants_[frame->ssrc]->rr_frame;
+        }
+
+        participants_[frame->ssrc]->rr_frame = frame;
+    }
+    rr_mutex_.unlock();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::handle_sender_report_packet(uint8_t* buffer, size_t& read_ptr, size_t packet_end,
+    uvgrtp::frame::rtcp_header& header)
+{
+    size_t packet_start = read_ptr - RTCP_HEADER_SIZE;
+
+    if (packet_end < read_ptr + SSRC_CSRC_SIZE + SENDER_INFO_SIZE)
+    {
+        LOG_ERROR("SR is too small to contain the sender info");
+        return RTP_INVALID_VALUE;
+    }
+
+    uint32_t ssrc = 0;
+    read_ssrc(buffer, read_ptr, ssrc);
+    if (!is_participant(ssrc))
+    {
+        LOG_INFO("Got an SR from a previously unknown participant SSRC %lu", ssrc);
+        add_participant(ssrc);
+    }
+
+    participants_[ssrc]->stats.sr_ts = uvgrtp::clock::hrc::now();
+    participants_[ssrc]->stats.lsr =
+        ((ntohl(*(uint32_t*)& buffer[read_ptr]) & 0xffff) << 16) |
+        (ntohl(*(uint32_t*)& buffer[read_ptr + 4]) >> 16);
+
+    uvgrtp::frame::rtcp_report_view view = make_report_view(buffer, packet_start, packet_end, header, ssrc, true);
+    update_analytics(ssrc, view);
+
+    if (call_report_view_hook(view))
+    {
+        return RTP_OK;
+    }
+
+    auto frame = new uvgrtp::frame::rtcp_sender_report;
+    frame->header = header;
+    frame->ssrc   = ssrc;
+
+    frame->sender_info.ntp_msw = ntohl(*(uint32_t*)& buffer[read_ptr]);
+    frame->sender_info.ntp_lsw = ntohl(*(uint32_t*)& buffer[read_ptr + 4]);
+    frame->sender_info.rtp_ts = ntohl(*(uint32_t*)& buffer[read_ptr + 8]);
+    frame->sender_info.pkt_cnt = ntohl(*(uint32_t*)& buffer[read_ptr + 12]);
+    frame->sender_info.byte_cnt = ntohl(*(uint32_t*)& buffer[read_ptr + 16]);
+    read_ptr += SENDER_INFO_SIZE;
+
+    read_reports(buffer, read_ptr, packet_end, frame->header.count, frame->report_blocks);
+
+    sr_mutex_.lock();
+    if (dispatcher_ && (sender_hook_ || sr_hook_f_ || sr_hook_u_)) {
+        dispatcher_->push({ uvgrtp::frame::RTCP_FT_SR, ssrc, frame });
+    }
+    else if (sender_hook_) {
+        sender_hook_(frame);
+    }
+    else if (sr_hook_f_) {
+        sr_hook_f_(std::shared_ptr<uvgrtp::frame::rtcp_sender_report>(frame));
+    }
+    else if (sr_hook_u_) {
+        sr_hook_u_(std::unique_ptr<uvgrtp::frame::rtcp_sender_report>(frame));
+    }
+    else {
+        /* Deallocate previous frame from the buffer if it exists, it's going to get overwritten */
+        if (participants_[frame->ssrc]->sr_frame)
+        {
+            delete participants_[frame->ssrc]->sr_frame;
         }
 
         participants_[frame->ssrc]->sr_frame = frame;
@@ -1349,7 +2569,9 @@ rtp_error_t uvgrtp::rtcp::handle_sdes_packet(uint8_t* packet, size_t& read_ptr,
     }
 
     sdes_mutex_.lock();
-    if (sdes_hook_) {
+    if (dispatcher_ && (sdes_hook_ || sdes_hook_f_ || sdes_hook_u_)) {
+        dispatcher_->push({ uvgrtp::frame::RTCP_FT_SDES, sender_ssrc, frame });
+    } else if (sdes_hook_) {
         sdes_hook_(frame);
     } else if (sdes_hook_f_) {
         sdes_hook_f_(std::shared_ptr<uvgrtp::frame::rtcp_sdes_packet>(frame));
@@ -1383,9 +2605,10 @@ rtp_error_t uvgrtp::rtcp::handle_sdes_packet(uint8_t* packet, size_t& read_ptr,
 rtp_error_t uvgrtp::rtcp::handle_bye_packet(uint8_t* packet, size_t& read_ptr, 
     size_t packet_end, uvgrtp::frame::rtcp_header& header)
 {
-    for (size_t i = 0; i < packet_end; i += sizeof(uint32_t))
+    /* the BYE packet lists "count" sources and may be followed by a reason */
+    for (size_t i = 0; i < header.count && read_ptr + SSRC_CSRC_SIZE <= packet_end; ++i)
     {
-        uint32_t ssrc = 0; 
+        uint32_t ssrc = 0;
         read_ssrc(packet, read_ptr, ssrc);
 
         if (!is_participant(ssrc))
@@ -1395,9 +2618,10 @@ rtp_error_t uvgrtp::rtcp::handle_bye_packet(uint8_t* packet, size_t& read_ptr,
         }
 
         LOG_DEBUG("Destroying participant with BYE");
-        participants_[ssrc]->socket = nullptr;
-        delete participants_[ssrc];
-        participants_.erase(ssrc);
+        packet_mutex_.lock();
+        retire_participant(ssrc);
+        reverse_reconsideration(uvgrtp::rtcp_scheduler::now());
+        packet_mutex_.unlock();
     }
 
     // TODO: Give BYE packet to user and read optional reason for BYE
@@ -1430,7 +2654,9 @@ rtp_error_t uvgrtp::rtcp::handle_app_packet(uint8_t* packet, size_t& read_ptr,
     memcpy(frame->payload, &packet[read_ptr], application_data_size);
 
     app_mutex_.lock();
-    if (app_hook_) {
+    if (dispatcher_ && (app_hook_ || app_hook_f_ || app_hook_u_)) {
+        dispatcher_->push({ uvgrtp::frame::RTCP_FT_APP, frame->ssrc, frame });
+    } else if (app_hook_) {
         app_hook_(frame);
     } else if (app_hook_f_) {
         app_hook_f_(std::shared_ptr<uvgrtp::frame::rtcp_app_packet>(frame));
@@ -1438,15 +2664,180 @@ rtp_error_t uvgrtp::rtcp::handle_app_packet(uint8_t* packet, size_t& read_ptr,
         app_hook_u_(std::unique_ptr<uvgrtp::frame::rtcp_app_packet>(frame));
     } else {
 
-        if (participants_[frame->ssrc]->app_frame)
+        if (participants_[frame->ssrc]->app_frame)
+        {
+            delete[] participants_[frame->ssrc]->app_frame->payload;
+            delete   participants_[frame->ssrc]->app_frame;
+        }
+
+        participants_[frame->ssrc]->app_frame = frame;
+    }
+    app_mutex_.unlock();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::handle_xr_packet(uint8_t* packet, size_t& read_ptr,
+    size_t packet_end, uvgrtp::frame::rtcp_header& header)
+{
+    if (packet_end < read_ptr + SSRC_CSRC_SIZE)
+    {
+        LOG_ERROR("XR is too small to contain the SSRC");
+        return RTP_INVALID_VALUE;
+    }
+
+    auto frame = new uvgrtp::frame::rtcp_xr_packet;
+    frame->header = header;
+    read_ssrc(packet, read_ptr, frame->ssrc);
+
+    if (!is_participant(frame->ssrc))
+    {
+        LOG_INFO("Got an XR from a previously unknown participant SSRC %lu", frame->ssrc);
+        add_participant(frame->ssrc);
+    }
+
+    // the report blocks, the blocks of unknown types are skipped
+    while (read_ptr + XR_BLOCK_HEADER_SIZE <= packet_end)
+    {
+        uint8_t block_type = packet[read_ptr];
+        uint8_t thinning   = packet[read_ptr + 1] & 0x0f;
+        size_t block_end   = read_ptr + rtcp_length_in_bytes(ntohs(*(uint16_t*)&packet[read_ptr + 2]));
+
+        if (block_end > packet_end)
+        {
+            LOG_WARN("XR block of type %u does not fit in the packet", block_type);
+            break;
+        }
+
+        if ((block_type == uvgrtp::frame::RTCP_XR_LOSS_RLE || block_type == uvgrtp::frame::RTCP_XR_DUPLICATE_RLE ||
+             block_type == uvgrtp::frame::RTCP_XR_RECEIPT_TIMES) && block_end >= read_ptr + XR_RLE_HEADER_SIZE)
+        {
+            uint32_t ssrc      = ntohl(*(uint32_t*)&packet[read_ptr + 4]);
+            uint16_t begin_seq = ntohs(*(uint16_t*)&packet[read_ptr + 8]);
+            uint16_t end_seq   = ntohs(*(uint16_t*)&packet[read_ptr + 10]);
+
+            if (block_type == uvgrtp::frame::RTCP_XR_RECEIPT_TIMES)
+            {
+                frame->receipt_times.push_back({ thinning, ssrc, begin_seq, end_seq, {} });
+
+                for (size_t ptr = read_ptr + XR_RLE_HEADER_SIZE; ptr + sizeof(uint32_t) <= block_end; ptr += sizeof(uint32_t))
+                {
+                    frame->receipt_times.back().receipt_times.push_back(ntohl(*(uint32_t*)&packet[ptr]));
+                }
+            }
+            else
+            {
+                auto& blocks = (block_type == uvgrtp::frame::RTCP_XR_LOSS_RLE) ? frame->loss_rle : frame->duplicate_rle;
+                blocks.push_back({ thinning, ssrc, begin_seq, end_seq, {} });
+
+                for (size_t ptr = read_ptr + XR_RLE_HEADER_SIZE; ptr + sizeof(uint16_t) <= block_end; ptr += sizeof(uint16_t))
+                {
+                    blocks.back().chunks.push_back(ntohs(*(uint16_t*)&packet[ptr]));
+                }
+            }
+        }
+        else if (block_type == uvgrtp::frame::RTCP_XR_VOIP_METRICS && block_end >= read_ptr + XR_VOIP_METRICS_SIZE)
+        {
+            const uint8_t* block = &packet[read_ptr];
+            uvgrtp::frame::rtcp_xr_voip_metrics_block metrics;
+
+            metrics.ssrc             = ntohl(*(uint32_t*)&block[4]);
+            metrics.loss_rate        = block[8];
+            metrics.discard_rate     = block[9];
+            metrics.burst_density    = block[10];
+            metrics.gap_density      = block[11];
+            metrics.burst_duration   = ntohs(*(uint16_t*)&block[12]);
+            metrics.gap_duration     = ntohs(*(uint16_t*)&block[14]);
+            metrics.round_trip_delay = ntohs(*(uint16_t*)&block[16]);
+            metrics.end_system_delay = ntohs(*(uint16_t*)&block[18]);
+            metrics.signal_level     = block[20];
+            metrics.noise_level      = block[21];
+            metrics.rerl             = block[22];
+            metrics.gmin             = block[23];
+            metrics.r_factor         = block[24];
+            metrics.ext_r_factor     = block[25];
+            metrics.mos_lq           = block[26];
+            metrics.mos_cq           = block[27];
+            metrics.rx_config        = block[28];
+            metrics.jb_nominal       = ntohs(*(uint16_t*)&block[30]);
+            metrics.jb_maximum       = ntohs(*(uint16_t*)&block[32]);
+            metrics.jb_abs_max       = ntohs(*(uint16_t*)&block[34]);
+
+            frame->voip_metrics.push_back(metrics);
+        }
+        else
+        {
+            LOG_DEBUG("Skipping XR block of type %u", block_type);
+        }
+
+        read_ptr = block_end;
+    }
+
+    xr_mutex_.lock();
+    if (dispatcher_ && (xr_hook_ || xr_hook_f_ || xr_hook_u_)) {
+        dispatcher_->push({ uvgrtp::frame::RTCP_FT_XR, frame->ssrc, frame });
+    } else if (xr_hook_) {
+        xr_hook_(frame);
+    } else if (xr_hook_f_) {
+        xr_hook_f_(std::shared_ptr<uvgrtp::frame::rtcp_xr_packet>(frame));
+    } else if (xr_hook_u_) {
+        xr_hook_u_(std::unique_ptr<uvgrtp::frame::rtcp_xr_packet>(frame));
+    } else {
+        /* Deallocate previous frame from the buffer if it exists, it's going to get overwritten */
+        if (participants_[frame->ssrc]->xr_frame)
+        {
+            delete participants_[frame->ssrc]->xr_frame;
+        }
+
+        participants_[frame->ssrc]->xr_frame = frame;
+    }
+    xr_mutex_.unlock();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::handle_fb_packet(uint8_t* packet, size_t& read_ptr,
+    size_t packet_end, uvgrtp::frame::rtcp_header& header)
+{
+    if (packet_end < read_ptr + 2 * SSRC_CSRC_SIZE)
+    {
+        LOG_ERROR("Feedback message is too small to contain the SSRCs");
+        return RTP_INVALID_VALUE;
+    }
+
+    auto frame = new uvgrtp::frame::rtcp_fb_packet;
+    frame->header = header;
+    read_ssrc(packet, read_ptr, frame->sender_ssrc);
+    read_ssrc(packet, read_ptr, frame->media_ssrc);
+
+    if (!is_participant(frame->sender_ssrc))
+    {
+        LOG_INFO("Got a feedback message from a previously unknown participant SSRC %lu", frame->sender_ssrc);
+        add_participant(frame->sender_ssrc);
+    }
+
+    // the Feedback Control Information is parsed by the user, see get_nack_packets()
+    frame->fci.assign(&packet[read_ptr], &packet[packet_end]);
+
+    fb_mutex_.lock();
+    if (dispatcher_ && (fb_hook_ || fb_hook_f_ || fb_hook_u_)) {
+        dispatcher_->push({ header.pkt_type, frame->sender_ssrc, frame });
+    } else if (fb_hook_) {
+        fb_hook_(frame);
+    } else if (fb_hook_f_) {
+        fb_hook_f_(std::shared_ptr<uvgrtp::frame::rtcp_fb_packet>(frame));
+    } else if (fb_hook_u_) {
+        fb_hook_u_(std::unique_ptr<uvgrtp::frame::rtcp_fb_packet>(frame));
+    } else {
+        /* Deallocate previous frame from the buffer if it exists, it's going to get overwritten */
+        if (participants_[frame->sender_ssrc]->fb_frame)
         {
-            delete[] participants_[frame->ssrc]->app_frame->payload;
-            delete   participants_[frame->ssrc]->app_frame;
+            delete participants_[frame->sender_ssrc]->fb_frame;
         }
 
-        participants_[frame->ssrc]->app_frame = frame;
+        participants_[frame->sender_ssrc]->fb_frame = frame;
     }
-    app_mutex_.unlock();
+    fb_mutex_.unlock();
 
     return RTP_OK;
 }
@@ -1461,33 +2852,33 @@ rtp_error_t uvgrtp::rtcp::send_rtcp_packet_to_participants(uint8_t* frame, size_
 
     rtp_error_t ret = RTP_OK;
 
+    /* All participants share the SRTCP keys of the stream so the compound
+     * packet is protected once and the same datagram is sent to everyone */
     if (encrypt && srtcp_ && 
         (ret = srtcp_->handle_rtcp_encryption(flags_, rtcp_pkt_sent_count_, ssrc_, frame, frame_size)) != RTP_OK)
     {
         LOG_DEBUG("Encryption failed. Not sending packet");
-        delete[] frame;
         return ret;
     }
 
     for (auto& p : participants_)
     {
-        if (p.second->socket != nullptr)
+        /* Participants learned from their RTP packets do not have a socket of their own,
+         * they are only used for statistics and the reports reach them through the others */
+        if (p.second->socket == nullptr)
         {
-            if ((ret = p.second->socket->sendto(p.second->address, frame, frame_size, 0)) != RTP_OK)
-            {
-                LOG_ERROR("Sending rtcp packet with sendto() failed!");
-                break;
-            }
-
-            update_rtcp_bandwidth(frame_size);
+            continue;
         }
-        else
+
+        if ((ret = p.second->socket->sendto(p.second->address, frame, frame_size, 0)) != RTP_OK)
         {
-            LOG_ERROR("Tried to send RTCP packet when socket does not exist!");
+            LOG_ERROR("Sending rtcp packet with sendto() failed!");
+            break;
         }
+
+        update_rtcp_bandwidth(frame_size);
     }
 
-    delete[] frame;
     return ret;
 }
 
@@ -1513,12 +2904,12 @@ size_t uvgrtp::rtcp::size_of_compound_packet(uint16_t reports,
 
     if (sr_packet)
     {  
-        compound_packet_size = get_sr_packet_size(flags_, reports);
+        compound_packet_size = report_packets_size(true, reports);
         LOG_DEBUG("Sending SR. Compound packet size: %li", compound_packet_size);
     }
     else if (rr_packet)
     {
-        compound_packet_size = get_rr_packet_size(flags_, reports);
+        compound_packet_size = report_packets_size(false, reports);
         LOG_DEBUG("Sending RR. Compound packet size: %li", compound_packet_size);
     }
     else
@@ -1545,20 +2936,96 @@ size_t uvgrtp::rtcp::size_of_compound_packet(uint16_t reports,
         LOG_DEBUG("Sending BYE. Compound packet size: %li", compound_packet_size);
     }
 
+    /* SRTCP fields follow the last RTCP packet and are not part of its length */
+    if (srtcp_)
+    {
+        compound_packet_size += uvgrtp::base_srtp::get_rtcp_trailer_length(flags_);
+    }
+
     return compound_packet_size;
 }
 
+size_t uvgrtp::rtcp::construct_xr_packet(uint8_t* frame, size_t max_size)
+{
+    /* enough for the chunks of receive_history::MAX_RANGE packets */
+    constexpr size_t MAX_CHUNKS = 64;
+
+    const size_t header_size = RTCP_HEADER_SIZE + SSRC_CSRC_SIZE;
+
+    receive_history::range range;
+    uint16_t chunks[MAX_CHUNKS];
+    uint32_t times[receive_history::RECEIPT_TIMES];
+
+    int ptr = (int)header_size;
+
+    for (auto& source : report_sources_)
+    {
+        auto p = participants_[source.first];
+
+        /* the blocks about a source are only added if at least the VoIP metrics fit */
+        if (!p->history || (size_t)ptr + XR_VOIP_METRICS_SIZE > max_size || !p->history->take_range(range))
+        {
+            continue;
+        }
+
+        construct_xr_voip_metrics_block(frame, ptr, compute_voip_metrics(range, source.first,
+            p->stats.clock_rate, p->analytics->smoothed_rtt_ms.load(std::memory_order_relaxed)));
+
+        for (bool duplicates : { false, true })
+        {
+            size_t count = encode_rle_chunks(range, duplicates, chunks, MAX_CHUNKS);
+
+            if (count && (size_t)ptr + get_xr_rle_block_size(count) <= max_size)
+            {
+                construct_xr_rle_block(frame, ptr,
+                    duplicates ? uvgrtp::frame::RTCP_XR_DUPLICATE_RLE : uvgrtp::frame::RTCP_XR_LOSS_RLE,
+                    source.first, (uint16_t)range.begin, (uint16_t)range.end, chunks, count);
+            }
+        }
+
+        size_t count = 0;
+        for (uint32_t seq = range.receipt_begin; seq != range.end; ++seq)
+        {
+            if (range.is_received(seq))
+            {
+                times[count++] = range.receipt_time(seq);
+            }
+        }
+
+        if (count && (size_t)ptr + get_xr_receipt_times_block_size(count) <= max_size)
+        {
+            construct_xr_receipt_times_block(frame, ptr, source.first,
+                (uint16_t)range.receipt_begin, (uint16_t)range.end, times, count);
+        }
+    }
+
+    if ((size_t)ptr == header_size)
+    {
+        return 0;
+    }
+
+    int header_ptr = 0;
+    construct_rtcp_header(frame, header_ptr, ptr, 0, uvgrtp::frame::RTCP_FT_XR);
+    construct_ssrc(frame, header_ptr, ssrc_);
+
+    return ptr;
+}
+
 rtp_error_t uvgrtp::rtcp::generate_report()
 {
     std::lock_guard<std::mutex> lock(packet_mutex_);
     rtcp_pkt_sent_count_++;
 
-    uint16_t reports = 0;
+    uint64_t now = uvgrtp::rtcp_scheduler::now();
+
+    /* The sources we have received data from since the last report */
+    size_t active_sources = 0;
     for (auto& p : participants_)
     {
-        if (p.second->stats.received_rtp_packet)
+        if (p.second->published.received_rtp_packet.load(std::memory_order_relaxed))
         {
-            ++reports;
+            p.second->last_rtp = now;
+            ++active_sources;
         }
     }
 
@@ -1568,21 +3035,88 @@ rtp_error_t uvgrtp::rtcp::generate_report()
     size_t app_packets_size = size_of_ready_app_packets();
     bool bye_packet = !bye_ssrcs_.empty();
 
-    size_t compound_packet_size = size_of_compound_packet(reports, sr_packet, rr_packet, sdes_packet, app_packets_size, bye_packet);
+    size_t compound_packet_size = size_of_compound_packet(0, sr_packet, rr_packet, sdes_packet, app_packets_size, bye_packet);
     
     if (compound_packet_size == 0)
     {
         LOG_WARN("Failed to get compound packet size");
         return RTP_GENERIC_ERROR;
     }
-    else if (compound_packet_size > mtu_size_)
+
+    /* If the reports of all sources do not fit in the MTU, as many as fit are sent
+     * and the rest are sent in the following reports (see RFC 3550 section 6.4) */
+    size_t other_packets_size = compound_packet_size - report_packets_size(sr_packet, 0);
+    size_t reports            = 0;
+
+    /* The feedback waiting for this report is reserved before the report blocks,
+     * the messages that do not fit are sent in the next RTCP packet */
+    size_t fb_packets = 0;
+
+    for (auto& fb_packet : fb_packets_)
+    {
+        if (compound_packet_size + fb_packet.size() > mtu_size_)
+        {
+            break;
+        }
+
+        compound_packet_size += fb_packet.size();
+        other_packets_size   += fb_packet.size();
+        ++fb_packets;
+    }
+
+    while (reports < active_sources &&
+        other_packets_size + report_packets_size(sr_packet, reports + 1) <= mtu_size_)
+    {
+        ++reports;
+    }
+
+    if (reports < active_sources)
+    {
+        LOG_DEBUG("Reporting %zu of %zu sources in this report", reports, active_sources);
+    }
+
+    /* Take the statistics of the reported sources starting from where the previous report
+     * ended, the RTP packet processing thread keeps updating them in the meantime */
+    auto& sources = report_sources_;
+    sources.clear();
+
+    auto it = participants_.lower_bound(next_report_ssrc_);
+
+    for (size_t visited = 0; visited < participants_.size() && sources.size() < reports; ++visited, ++it)
+    {
+        if (it == participants_.end())
+        {
+            it = participants_.begin();
+        }
+
+        if (it->second->published.received_rtp_packet.exchange(false, std::memory_order_acquire))
+        {
+            sources.push_back({ it->first, read_statistics(it->second) });
+            next_report_ssrc_ = it->first + 1;
+        }
+    }
+
+    reports = sources.size();
+    compound_packet_size = other_packets_size + report_packets_size(sr_packet, reports);
+
+    /* The Extended Report about the reported sources gets the space left in the MTU */
+    size_t xr_packet_size = 0;
+
+    if (xr_buffer_ && compound_packet_size < mtu_size_)
+    {
+        xr_packet_size = construct_xr_packet(xr_buffer_.get(), mtu_size_ - compound_packet_size);
+        compound_packet_size += xr_packet_size;
+    }
+
+    if (compound_packet_size > report_buffer_size_)
     {
-        LOG_WARN("Generate RTCP packet is too large %lli/%lli, reports should be circled, but not implemented!", 
-            compound_packet_size, mtu_size_);
+        LOG_DEBUG("Growing the RTCP report buffer to %zu bytes", compound_packet_size);
+        report_buffer_size_ = compound_packet_size;
+        report_buffer_.reset(new uint8_t[report_buffer_size_]);
     }
 
-    uint8_t* frame = new uint8_t[compound_packet_size];
-    memset(frame, 0, compound_packet_size);
+    /* every byte of the report is written below so the buffer is not cleared */
+    uint8_t* frame = report_buffer_.get();
 
     // see https://datatracker.ietf.org/doc/html/rfc3550#section-6.4.1
 
@@ -1590,22 +3124,14 @@ rtp_error_t uvgrtp::rtcp::generate_report()
     if (sr_packet)
     {
         // sender reports have sender information in addition compared to receiver reports
-        size_t sender_report_size = get_sr_packet_size(flags_, reports);
-
-        /* TODO: The clock would be better to start with first sent RTP packet.
-         * In reality it should be provided by user which I think is implemented? */
-        if (clock_start_ == 0)
-        {
-          clock_start_ = uvgrtp::clock::ntp::now();
-        }
+        size_t sender_report_size = get_sr_packet_size((uint16_t)std::min(reports, MAX_REPORT_BLOCKS));
 
-        /* TODO: The RTP timestamp should be from an actual RTP packet and NTP timestamp should be the one
-           corresponding to it. */
+        /* the RTP timestamp of the same instant as the NTP timestamp (RFC 3550 section 6.4.1) */
         uint64_t ntp_ts = uvgrtp::clock::ntp::now();
-        uint64_t rtp_ts = rtp_ts_start_ + (uvgrtp::clock::ntp::diff(clock_start_, ntp_ts))
-            * float(clock_rate_ / 1000);
+        uint32_t rtp_ts = sender_rtp_timestamp(ntp_ts);
 
-        if (!construct_rtcp_header(frame, write_ptr, sender_report_size, reports, uvgrtp::frame::RTCP_FT_SR) ||
+        if (!construct_rtcp_header(frame, write_ptr, sender_report_size, (uint16_t)std::min(reports, MAX_REPORT_BLOCKS),
+            uvgrtp::frame::RTCP_FT_SR) ||
             !construct_ssrc(frame, write_ptr, ssrc_) ||
             !construct_sender_info(frame, write_ptr, ntp_ts, rtp_ts, our_stats.sent_pkts, our_stats.sent_bytes))
         {
@@ -1616,9 +3142,10 @@ rtp_error_t uvgrtp::rtcp::generate_report()
         our_stats.sent_rtp_packet = false;
 
     } else if (rr_packet) { // RECEIVER
-        size_t receiver_report_size = get_rr_packet_size(flags_, reports);
+        size_t receiver_report_size = get_rr_packet_size((uint16_t)std::min(reports, MAX_REPORT_BLOCKS));
 
-        if (!construct_rtcp_header(frame, write_ptr, receiver_report_size, reports, uvgrtp::frame::RTCP_FT_RR) ||
+        if (!construct_rtcp_header(frame, write_ptr, receiver_report_size, (uint16_t)std::min(reports, MAX_REPORT_BLOCKS),
+            uvgrtp::frame::RTCP_FT_RR) ||
             !construct_ssrc(frame, write_ptr, ssrc_))
         {
             LOG_ERROR("Failed to construct RR");
@@ -1632,75 +3159,73 @@ rtp_error_t uvgrtp::rtcp::generate_report()
     }
 
     // the report blocks for sender or receiver report. Both have same reports.
-    for (auto& p : participants_)
+    for (size_t i = 0; i < sources.size(); ++i)
     {
-        // only add report blocks if we have received data from them
-        if (p.second->stats.received_rtp_packet)
+        /* the blocks that do not fit in the first packet are sent in additional RRs */
+        if (i != 0 && i % MAX_REPORT_BLOCKS == 0)
         {
-            uint32_t dropped_packets = p.second->stats.dropped_pkts;
-            // TODO: This should be the number of packets lost compared to number of packets expected (see fraction lost in RFC 3550)
-            // see https://datatracker.ietf.org/doc/html/rfc3550#appendix-A.3
-            uint8_t fraction = dropped_packets ? p.second->stats.received_bytes / dropped_packets : 0;
+            uint16_t blocks = (uint16_t)std::min(sources.size() - i, MAX_REPORT_BLOCKS);
 
-            uint64_t diff = (u_long)uvgrtp::clock::hrc::diff_now(p.second->stats.sr_ts);
-            uint32_t dlrs = uvgrtp::clock::ms_to_jiffies(diff);
-
-            /* calculate delay of last SR only if SR has been received at least once */
-            if (p.second->stats.lsr == 0)
+            if (!construct_rtcp_header(frame, write_ptr, get_rr_packet_size(blocks), blocks, uvgrtp::frame::RTCP_FT_RR) ||
+                !construct_ssrc(frame, write_ptr, ssrc_))
             {
-                dlrs = 0;
+                LOG_ERROR("Failed to construct RR");
+                return RTP_GENERIC_ERROR;
             }
+        }
 
-            construct_report_block(frame, write_ptr, p.first, fraction, dropped_packets,
-                p.second->stats.cycles, p.second->stats.max_seq, p.second->stats.jitter, 
-                p.second->stats.lsr, dlrs);
+        auto& source = sources[i];
+        auto p = participants_[source.first];
+        auto& stats = source.second;
 
-            // we only send reports if there is something to report since last report
-            p.second->stats.received_rtp_packet = false;
+        uint32_t dropped_packets = stats.dropped_pkts;
+        // TODO: This should be the number of packets lost compared to number of packets expected (see fraction lost in RFC 3550)
+        // see https://datatracker.ietf.org/doc/html/rfc3550#appendix-A.3
+        uint8_t fraction = dropped_packets ? stats.received_bytes / dropped_packets : 0;
+
+        uint64_t diff = (u_long)uvgrtp::clock::hrc::diff_now(p->stats.sr_ts);
+        uint32_t dlrs = uvgrtp::clock::ms_to_jiffies(diff);
+
+        /* calculate delay of last SR only if SR has been received at least once */
+        if (p->stats.lsr == 0)
+        {
+            dlrs = 0;
         }
+
+        construct_report_block(frame, write_ptr, source.first, fraction, dropped_packets,
+            stats.cycles, stats.max_seq, stats.jitter >> 4, p->stats.lsr, dlrs);
     }
 
     if (sdes_packet)
     {
         // add the SDES packet after the SR/RR, mandatory, must contain CNAME
-        if (!construct_rtcp_header(frame, write_ptr, get_sdes_packet_size(ourItems_), num_receivers_,
+        if (!construct_rtcp_header(frame, write_ptr, get_sdes_packet_size(ourItems_), 1,
             uvgrtp::frame::RTCP_FT_SDES) ||
-            !construct_sdes_chunk(frame, write_ptr, { ssrc_, ourItems_ }))
+            !construct_sdes_chunk(frame, write_ptr, ssrc_, ourItems_))
         {
             LOG_ERROR("Failed to add SDES packet");
-            delete[] frame;
             return RTP_GENERIC_ERROR;
         }
     }
 
-    if (app_packets_size != 0)
+    if (xr_packet_size != 0)
     {
-        for (auto& app_name : app_packets_)
-        {
-            // we send one packet per APP name
-
-            // TODO: Should we also send one per subtype?
-            if (!app_name.second.empty())
-            {
-                // take the oldest APP packet and send it
-                rtcp_app_packet next_packet = app_name.second.front();
-                app_name.second.pop_front();
-
-                uint16_t secondField = (next_packet.subtype & 0x1f);
+        memcpy(&frame[write_ptr], xr_buffer_.get(), xr_packet_size);
+        write_ptr += (int)xr_packet_size;
+    }
 
-                size_t packet_size = get_app_packet_size(next_packet.payload_len);
+    /* the feedback waiting for this report goes after the Extended Report */
+    for (; fb_packets != 0; --fb_packets)
+    {
+        memcpy(&frame[write_ptr], fb_packets_.front().data(), fb_packets_.front().size());
+        write_ptr += (int)fb_packets_.front().size();
+        fb_packets_.pop_front();
+    }
+    early_report_ = 0;
 
-                if (!construct_rtcp_header(frame, write_ptr, packet_size, secondField,
-                    uvgrtp::frame::RTCP_FT_APP) ||
-                    !construct_ssrc(frame, write_ptr, ssrc_) ||
-                    !construct_app_packet(frame, write_ptr, next_packet.name, next_packet.payload, next_packet.payload_len))
-                {
-                    LOG_ERROR("Failed to construct APP packet");
-                    delete[] frame;
-                    return RTP_GENERIC_ERROR;
-                }
-            }
-        }
+    if (app_packets_size != 0 && !construct_app_packets(frame, write_ptr))
+    {
+        return RTP_GENERIC_ERROR;
     }
 
     // BYE is last if it is sent
@@ -1714,7 +3239,6 @@ rtp_error_t uvgrtp::rtcp::generate_report()
         {
             bye_ssrcs_.clear();
             LOG_ERROR("Failed to construct BYE");
-            delete[] frame;
             return RTP_GENERIC_ERROR;
         }
 
@@ -1728,6 +3252,37 @@ rtp_error_t uvgrtp::rtcp::generate_report()
     return send_rtcp_packet_to_participants(frame, compound_packet_size, true);
 }
 
+bool uvgrtp::rtcp::construct_app_packets(uint8_t* frame, int& ptr)
+{
+    for (auto& app_name : app_packets_)
+    {
+        // we send one packet per APP name
+
+        // TODO: Should we also send one per subtype?
+        if (!app_name.second.empty())
+        {
+            // take the oldest APP packet and send it
+            rtcp_app_packet next_packet = app_name.second.front();
+            app_name.second.pop_front();
+
+            uint16_t secondField = (next_packet.subtype & 0x1f);
+
+            size_t packet_size = get_app_packet_size(next_packet.payload_len);
+
+            if (!construct_rtcp_header(frame, ptr, packet_size, secondField,
+                uvgrtp::frame::RTCP_FT_APP) ||
+                !construct_ssrc(frame, ptr, ssrc_) ||
+                !construct_app_packet(frame, ptr, next_packet.name, next_packet.payload, next_packet.payload_len))
+            {
+                LOG_ERROR("Failed to construct APP packet");
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 rtp_error_t uvgrtp::rtcp::send_sdes_packet(const std::vector<uvgrtp::frame::rtcp_sdes_item>& items)
 {
     if (items.empty())
@@ -1771,18 +3326,239 @@ rtp_error_t uvgrtp::rtcp::send_app_packet(const char* name, uint8_t subtype,
     app_packets_[name].push_back(packet);
     packet_mutex_.unlock();
 
+    /* with RCE_RTCP_FEEDBACK, APP packets are also sent early */
+    if (flags_ & RCE_RTCP_FEEDBACK)
+    {
+        return queue_feedback({});
+    }
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::send_nack(uint32_t media_ssrc, const std::vector<uint16_t>& lost_packets)
+{
+    if (lost_packets.empty())
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    /* Each FCI entry has the sequence number of a lost packet (PID) and a bitmask of the
+     * losses among the 16 packets following it (BLP). The losses are expected in order */
+    std::vector<uint8_t> fci;
+    uint16_t pid = 0;
+
+    for (size_t i = 0; i < lost_packets.size(); ++i)
+    {
+        uint16_t distance = (uint16_t)(lost_packets[i] - pid);
+
+        if (i != 0 && distance == 0)
+        {
+            continue;
+        }
+
+        if (i != 0 && distance <= 16)
+        {
+            size_t blp = fci.size() - 2;
+            uint16_t mask = ntohs(*(uint16_t*)&fci[blp]) | (uint16_t)(1 << (distance - 1));
+            *(uint16_t*)&fci[blp] = htons(mask);
+            continue;
+        }
+
+        pid = lost_packets[i];
+        fci.resize(fci.size() + 4);
+        *(uint16_t*)&fci[fci.size() - 4] = htons(pid);
+        *(uint16_t*)&fci[fci.size() - 2] = 0;
+    }
+
+    /* long lists are split to several NACKs */
+    for (size_t offset = 0; offset < fci.size(); offset += MAX_NACK_ENTRIES * 4)
+    {
+        size_t len = std::min(fci.size() - offset, MAX_NACK_ENTRIES * 4);
+        rtp_error_t ret = send_fb_packet(uvgrtp::frame::RTCP_FT_RTPFB, uvgrtp::frame::RTCP_RTPFB_NACK,
+            media_ssrc, &fci[offset], len);
+
+        if (ret != RTP_OK)
+        {
+            return ret;
+        }
+    }
+
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::rtcp::send_pli(uint32_t media_ssrc)
+{
+    return send_fb_packet(uvgrtp::frame::RTCP_FT_PSFB, uvgrtp::frame::RTCP_PSFB_PLI, media_ssrc, nullptr, 0);
+}
+
+rtp_error_t uvgrtp::rtcp::send_fb_packet(uvgrtp::frame::RTCP_FRAME_TYPE type, uint8_t fmt, uint32_t media_ssrc,
+    const uint8_t* fci, size_t fci_len)
+{
+    if (type != uvgrtp::frame::RTCP_FT_RTPFB && type != uvgrtp::frame::RTCP_FT_PSFB)
+    {
+        LOG_ERROR("Invalid feedback packet type %u", type);
+        return RTP_INVALID_VALUE;
+    }
+
+    if (fmt == 0 || fmt > 31 || fci_len % 4 != 0 || (fci_len && !fci))
+    {
+        LOG_ERROR("Invalid feedback message type or FCI");
+        return RTP_INVALID_VALUE;
+    }
+
+    /* the message must fit in an early packet with a report and SDES */
+    if (get_fb_packet_size(fci_len) + get_rr_packet_size(0) + get_sdes_packet_size(ourItems_) > mtu_size_)
+    {
+        LOG_ERROR("Feedback message of %zu bytes does not fit in an RTCP packet", get_fb_packet_size(fci_len));
+        return RTP_INVALID_VALUE;
+    }
+
+    std::vector<uint8_t> packet(get_fb_packet_size(fci_len));
+    int ptr = 0;
+
+    if (!construct_fb_packet(packet.data(), ptr, type, fmt, ssrc_, media_ssrc, fci, fci_len))
+    {
+        LOG_ERROR("Failed to construct feedback packet");
+        return RTP_GENERIC_ERROR;
+    }
+
+    return queue_feedback(std::move(packet));
+}
+
+void uvgrtp::rtcp::set_trr_interval(uint32_t interval_ms)
+{
+    packet_mutex_.lock();
+    trr_interval_ms_ = interval_ms;
+    packet_mutex_.unlock();
+}
+
+rtp_error_t uvgrtp::rtcp::queue_feedback(std::vector<uint8_t> packet)
+{
+    rtp_error_t ret = RTP_OK;
+
+    packet_mutex_.lock();
+    if (!packet.empty())
+    {
+        fb_packets_.push_back(std::move(packet));
+    }
+    uint64_t early = request_early_report(ret);
+    packet_mutex_.unlock();
+
+    /* The scheduler is told only after packet_mutex_ is released. On the scheduler thread
+     * this is skipped and the scheduler reads the time from next_report() after the call */
+    if (early != 0)
+    {
+        scheduler_->reschedule(this, early);
+    }
+
+    return ret;
+}
+
+uint64_t uvgrtp::rtcp::request_early_report(rtp_error_t& ret)
+{
+    ret = RTP_OK;
+
+    if (!early_buffer_ || !active_ || !allow_early_ || early_report_ != 0)
+    {
+        return 0;
+    }
+
+    uint64_t now  = uvgrtp::rtcp_scheduler::now();
+    uint64_t tp   = tp_;
+    uint64_t tn   = tn_;
+    uint64_t t_rr = tn > tp ? tn - tp : 0;
+
+    /* T_dither_max is zero in point-to-point sessions and half the report interval
+     * in larger ones so that the members do not all send the same feedback at once */
+    uint64_t dither_max = participants_.size() + 1 > 2 ? t_rr / 2 : 0;
+    uint64_t te         = now + (uint64_t)((double)uvgrtp::random::generate_32() / UINT32_MAX * dither_max);
+
+    /* the feedback goes with the regular report if that is sent first */
+    if (te >= tn)
+    {
+        return 0;
+    }
+
+    if (dither_max == 0)
+    {
+        ret = send_early_report();
+        return 0;
+    }
+
+    early_report_ = te;
+
+    return te;
+}
+
+rtp_error_t uvgrtp::rtcp::send_early_report()
+{
+    early_report_ = 0;
+
+    size_t app_size    = size_of_ready_app_packets();
+    size_t prefix_size = get_rr_packet_size(0) + get_sdes_packet_size(ourItems_);
+
+    /* the APP packets that do not fit wait for the next regular report */
+    if (prefix_size + app_size > mtu_size_)
+    {
+        app_size = 0;
+    }
+
+    if (fb_packets_.empty() && app_size == 0)
+    {
+        return RTP_OK;
+    }
+
+    /* Reduced-size packets only carry feedback messages (RFC 5506 section 3) */
+    bool compound = !(flags_ & RCE_RTCP_REDUCED_SIZE) || app_size != 0;
+
+    allow_early_ = false;
+
+    uint8_t* frame = early_buffer_.get();
+    int write_ptr  = 0;
+
+    if (compound)
+    {
+        if (!construct_rtcp_header(frame, write_ptr, get_rr_packet_size(0), 0, uvgrtp::frame::RTCP_FT_RR) ||
+            !construct_ssrc(frame, write_ptr, ssrc_) ||
+            !construct_rtcp_header(frame, write_ptr, get_sdes_packet_size(ourItems_), 1, uvgrtp::frame::RTCP_FT_SDES) ||
+            !construct_sdes_chunk(frame, write_ptr, ssrc_, ourItems_))
+        {
+            LOG_ERROR("Failed to construct early RTCP packet");
+            return RTP_GENERIC_ERROR;
+        }
+    }
+
+    /* the feedback messages that do not fit are sent in the next RTCP packet */
+    while (!fb_packets_.empty() && write_ptr + fb_packets_.front().size() + app_size <= mtu_size_)
+    {
+        memcpy(&frame[write_ptr], fb_packets_.front().data(), fb_packets_.front().size());
+        write_ptr += (int)fb_packets_.front().size();
+        fb_packets_.pop_front();
+    }
+
+    if (app_size != 0 && !construct_app_packets(frame, write_ptr))
+    {
+        return RTP_GENERIC_ERROR;
+    }
+
+    rtcp_pkt_sent_count_++;
+
+    LOG_DEBUG("Sending early RTCP packet, size: %i", write_ptr);
+
+    return send_rtcp_packet_to_participants(frame, write_ptr, true);
+}
+
 void uvgrtp::rtcp::set_session_bandwidth(int kbps)
 {
     interval_ms_ = 1000*360 / kbps; // the reduced minimum (see section 6.2 in RFC 3550)
 
+    // 5% of the session bandwidth in octets per second
+    rtcp_bandwidth_ = (size_t)kbps * 1000 / 8 / 20;
+
     if (interval_ms_ > DEFAULT_RTCP_INTERVAL_MS)
     {
         interval_ms_ = DEFAULT_RTCP_INTERVAL_MS;
     }
-    // TODO: This should follow the algorithm specified in RFC 3550 appendix-A.7
 }
 
 
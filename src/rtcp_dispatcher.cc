@@ -0,0 +1,227 @@
+#include "rtcp_dispatcher.hh"
+
+#include "uvgrtp/frame.hh"
+
+static bool is_coalesced(uint8_t type)
+{
+    return type == uvgrtp::frame::RTCP_FT_SR || type == uvgrtp::frame::RTCP_FT_RR ||
+        type == uvgrtp::frame::RTCP_FT_SDES || type == uvgrtp::frame::RTCP_FT_XR;
+}
+
+uvgrtp::rtcp_dispatcher::rtcp_dispatcher(size_t capacity, std::function<void(rtcp_hook_event&)> deliver,
+    std::function<void(rtcp_hook_event&)> discard):
+    mask_(0),
+    enqueue_pos_(0),
+    dequeue_pos_(0),
+    deliver_(deliver),
+    discard_(discard),
+    delivered_(0),
+    dropped_(0),
+    coalesced_(0),
+    waiting_(false),
+    stop_(false)
+{
+    size_t cells = 2;
+    while (cells < capacity)
+    {
+        cells <<= 1;
+    }
+
+    mask_ = cells - 1;
+    cells_.reset(new cell[cells]);
+
+    for (size_t i = 0; i < cells; ++i)
+    {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    batch_.reserve(cells);
+    latest_.reserve(cells);
+
+    thread_ = std::thread(&uvgrtp::rtcp_dispatcher::dispatcher, this);
+}
+
+uvgrtp::rtcp_dispatcher::~rtcp_dispatcher()
+{
+    stop();
+}
+
+void uvgrtp::rtcp_dispatcher::push(const rtcp_hook_event& event)
+{
+    if (stop_.load(std::memory_order_relaxed))
+    {
+        rtcp_hook_event late = event;
+        discard_(late);
+        return;
+    }
+
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    cell *c    = nullptr;
+
+    for (;;)
+    {
+        c = &cells_[pos & mask_];
+        intptr_t diff = (intptr_t)c->sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            /* the dispatcher has not yet taken the packet pushed a whole queue ago */
+            rtcp_hook_event dropped = event;
+            discard_(dropped);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    c->event = event;
+    c->sequence.store(pos + 1, std::memory_order_release);
+
+    /* pairs with the fence of the dispatcher between setting "waiting_" and checking the queue */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (waiting_.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_one();
+    }
+}
+
+void uvgrtp::rtcp_dispatcher::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_.store(true, std::memory_order_relaxed);
+        cv_.notify_one();
+    }
+
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+uint64_t uvgrtp::rtcp_dispatcher::delivered() const
+{
+    return delivered_.load(std::memory_order_relaxed);
+}
+
+uint64_t uvgrtp::rtcp_dispatcher::dropped() const
+{
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+uint64_t uvgrtp::rtcp_dispatcher::coalesced() const
+{
+    return coalesced_.load(std::memory_order_relaxed);
+}
+
+bool uvgrtp::rtcp_dispatcher::pop(rtcp_hook_event& event)
+{
+    if (empty())
+    {
+        return false;
+    }
+
+    cell& c = cells_[dequeue_pos_ & mask_];
+    event = c.event;
+
+    /* the cell is free for the producer that comes around the queue next time */
+    c.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+    ++dequeue_pos_;
+
+    return true;
+}
+
+bool uvgrtp::rtcp_dispatcher::empty() const
+{
+    return cells_[dequeue_pos_ & mask_].sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1;
+}
+
+void uvgrtp::rtcp_dispatcher::coalesce()
+{
+    latest_.clear();
+
+    for (auto it = batch_.rbegin(); it != batch_.rend(); ++it)
+    {
+        if (!is_coalesced(it->type))
+        {
+            continue;
+        }
+
+        if (!latest_.insert((uint64_t)it->type << 32 | it->ssrc).second)
+        {
+            discard_(*it);
+            it->frame = nullptr;
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void uvgrtp::rtcp_dispatcher::dispatcher()
+{
+    rtcp_hook_event event;
+
+    while (!stop_.load(std::memory_order_relaxed))
+    {
+        batch_.clear();
+
+        while (pop(event))
+        {
+            batch_.push_back(event);
+        }
+
+        if (batch_.empty())
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            waiting_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (empty() && !stop_.load(std::memory_order_relaxed))
+            {
+                cv_.wait(lock);
+            }
+
+            waiting_.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (batch_.size() > 1)
+        {
+            coalesce();
+        }
+
+        for (auto& queued : batch_)
+        {
+            if (!queued.frame)
+            {
+                continue;
+            }
+
+            if (stop_.load(std::memory_order_relaxed))
+            {
+                discard_(queued);
+                continue;
+            }
+
+            deliver_(queued);
+            delivered_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    while (pop(event))
+    {
+        discard_(event);
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* A received RTCP packet waiting to be given to its hook */
+    struct rtcp_hook_event {
+        uint8_t  type  = 0;       /* RTCP_FT_* of the packet */
+        uint32_t ssrc  = 0;       /* SSRC of the participant that sent the packet */
+        void    *frame = nullptr; /* the parsed packet, e.g. rtcp_sender_report for RTCP_FT_SR */
+    };
+
+    /* Delivers received RTCP packets to the hooks of the application from a thread of its own
+     *
+     * The thread receiving RTCP puts the packets to a bounded lock-free queue and returns to
+     * its work, so a slow hook can not delay the reports or the processing of other packets.
+     * The queue is an array of cells with a sequence number each: a producer claims a cell by
+     * advancing the enqueue position and publishes it by updating the sequence number of the
+     * cell, so several threads may push at once and pushing never waits for the dispatcher.
+     *
+     * If the queue is full, the new packet is dropped. The dispatcher takes all queued packets
+     * at once and when they include several reports of one type from the same participant
+     * (SR, RR, SDES or XR), only the latest one is delivered and the older ones are coalesced.
+     * APP packets are always delivered in full. */
+    class rtcp_dispatcher {
+        public:
+            /* "capacity" is rounded up to a power of two. "deliver" is called from the dispatcher
+             * thread with each packet and "discard" with each packet that is not delivered */
+            rtcp_dispatcher(size_t capacity, std::function<void(rtcp_hook_event&)> deliver,
+                std::function<void(rtcp_hook_event&)> discard);
+            ~rtcp_dispatcher();
+
+            /* Queue "event" for delivery. If the queue is full, "event" is discarded */
+            void push(const rtcp_hook_event& event);
+
+            /* Stop the dispatcher thread and discard the packets that have not been delivered */
+            void stop();
+
+            uint64_t delivered() const;
+            uint64_t dropped() const;
+            uint64_t coalesced() const;
+
+        private:
+            struct cell {
+                std::atomic<size_t> sequence;
+                rtcp_hook_event event;
+            };
+
+            void dispatcher();
+
+            /* Only called by the dispatcher thread */
+            bool pop(rtcp_hook_event& event);
+            bool empty() const;
+
+            /* Discard the reports superseded by a later one of "batch_" */
+            void coalesce();
+
+            std::unique_ptr<cell[]> cells_;
+            size_t mask_;
+
+            std::atomic<size_t> enqueue_pos_;
+            size_t dequeue_pos_;
+
+            std::function<void(rtcp_hook_event&)> deliver_;
+            std::function<void(rtcp_hook_event&)> discard_;
+
+            /* Only used by the dispatcher thread */
+            std::vector<rtcp_hook_event> batch_;
+            std::unordered_set<uint64_t> latest_;
+
+            std::atomic<uint64_t> delivered_;
+            std::atomic<uint64_t> dropped_;
+            std::atomic<uint64_t> coalesced_;
+
+            /* The dispatcher sleeps on "cv_" when the queue is empty. "waiting_" tells the
+             * producers whether they need to wake it up */
+            std::atomic<bool> waiting_;
+            std::atomic<bool> stop_;
+
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            std::thread thread_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -5,23 +5,17 @@
 #include "uvgrtp/debug.hh"
 
 
-size_t uvgrtp::get_sr_packet_size(int flags, uint16_t reports)
+size_t uvgrtp::get_sr_packet_size(uint16_t reports)
 {
     /* Sender report is otherwise identical with receiver report, 
      * but it also includes sender info */
-    return get_rr_packet_size(flags, reports) + SENDER_INFO_SIZE;
+    return get_rr_packet_size(reports) + SENDER_INFO_SIZE;
 }
 
-size_t uvgrtp::get_rr_packet_size(int flags, uint16_t reports)
+size_t uvgrtp::get_rr_packet_size(uint16_t reports)
 {
-    size_t size = (size_t)RTCP_HEADER_SIZE + SSRC_CSRC_SIZE 
+    return (size_t)RTCP_HEADER_SIZE + SSRC_CSRC_SIZE 
         + (size_t)REPORT_BLOCK_SIZE * reports;
-    if (flags & RCE_SRTP)
-    {
-        size += UVG_SRTCP_INDEX_LENGTH + UVG_AUTH_TAG_LENGTH;
-    }
-
-    return size;
 }
 
 size_t uvgrtp::get_app_packet_size(size_t payload_len)
@@ -59,6 +53,22 @@ size_t uvgrtp::get_bye_packet_size(const std::vector<uint32_t>& ssrcs)
     return RTCP_HEADER_SIZE + ssrcs.size() * SSRC_CSRC_SIZE;
 }
 
+size_t uvgrtp::get_xr_rle_block_size(size_t chunks)
+{
+    /* the chunks are 16 bits and a null chunk is added if the count is odd */
+    return XR_RLE_HEADER_SIZE + ((chunks + 1) / 2) * sizeof(uint32_t);
+}
+
+size_t uvgrtp::get_xr_receipt_times_block_size(size_t times)
+{
+    return XR_RLE_HEADER_SIZE + times * sizeof(uint32_t);
+}
+
+size_t uvgrtp::get_fb_packet_size(size_t fci_len)
+{
+    return FB_HEADER_SIZE + fci_len;
+}
+
 bool uvgrtp::construct_rtcp_header(uint8_t* frame, int& ptr, size_t packet_size,
     uint16_t secondField,
     uvgrtp::frame::RTCP_FRAME_TYPE frame_type)
@@ -129,13 +139,19 @@ bool uvgrtp::construct_app_packet(uint8_t* frame, int& ptr,
 }
 
 bool uvgrtp::construct_sdes_chunk(uint8_t* frame, int& ptr,
-    uvgrtp::frame::rtcp_sdes_chunk chunk) {
+    const uvgrtp::frame::rtcp_sdes_chunk& chunk)
+{
+    return construct_sdes_chunk(frame, ptr, chunk.ssrc, chunk.items);
+}
 
+bool uvgrtp::construct_sdes_chunk(uint8_t* frame, int& ptr, uint32_t ssrc,
+    const std::vector<uvgrtp::frame::rtcp_sdes_item>& items)
+{
     bool have_cname = false;
 
-    construct_ssrc(frame, ptr, chunk.ssrc);
+    construct_ssrc(frame, ptr, ssrc);
 
-    for (auto& item : chunk.items)
+    for (auto& item : items)
     {
         if (item.length <= 255)
         {
@@ -151,7 +167,10 @@ bool uvgrtp::construct_sdes_chunk(uint8_t* frame, int& ptr,
         }
     }
 
-    ptr += (4 - ptr % 4);
+    /* the chunk ends with a null item and is padded to 32 bits with zeros */
+    int padding = 4 - ptr % 4;
+    memset(frame + ptr, 0, padding);
+    ptr += padding;
 
     if (!have_cname)
     {
@@ -169,4 +188,97 @@ bool uvgrtp::construct_bye_packet(uint8_t* frame, int& ptr, const std::vector<ui
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+/* Add the common header of XR report blocks, the block length is in 32-bit words - 1 */
+static void construct_xr_block_header(uint8_t* frame, int& ptr, uint8_t type,
+    uint8_t type_specific, size_t block_size)
+{
+    frame[ptr]     = type;
+    frame[ptr + 1] = type_specific;
+    *(uint16_t*)&frame[ptr + 2] = htons((uint16_t)(block_size / sizeof(uint32_t) - 1));
+    ptr += uvgrtp::XR_BLOCK_HEADER_SIZE;
+}
+
+bool uvgrtp::construct_xr_rle_block(uint8_t* frame, int& ptr, uvgrtp::frame::RTCP_XR_BLOCK_TYPE type,
+    uint32_t ssrc, uint16_t begin_seq, uint16_t end_seq, const uint16_t* chunks, size_t chunk_count)
+{
+    /* thinning is not used */
+    construct_xr_block_header(frame, ptr, type, 0, get_xr_rle_block_size(chunk_count));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(ssrc));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(begin_seq) << 16 | end_seq));
+
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        *(uint16_t*)&frame[ptr] = htons(chunks[i]);
+        ptr += sizeof(uint16_t);
+    }
+
+    if (chunk_count % 2)
+    {
+        *(uint16_t*)&frame[ptr] = 0;
+        ptr += sizeof(uint16_t);
+    }
+
+    return true;
+}
+
+bool uvgrtp::construct_xr_receipt_times_block(uint8_t* frame, int& ptr, uint32_t ssrc,
+    uint16_t begin_seq, uint16_t end_seq, const uint32_t* times, size_t time_count)
+{
+    construct_xr_block_header(frame, ptr, uvgrtp::frame::RTCP_XR_RECEIPT_TIMES, 0,
+        get_xr_receipt_times_block_size(time_count));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(ssrc));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(begin_seq) << 16 | end_seq));
+
+    for (size_t i = 0; i < time_count; ++i)
+    {
+        SET_NEXT_FIELD_32(frame, ptr, htonl(times[i]));
+    }
+
+    return true;
+}
+
+bool uvgrtp::construct_xr_voip_metrics_block(uint8_t* frame, int& ptr,
+    const uvgrtp::frame::rtcp_xr_voip_metrics_block& m)
+{
+    construct_xr_block_header(frame, ptr, uvgrtp::frame::RTCP_XR_VOIP_METRICS, 0, XR_VOIP_METRICS_SIZE);
+    SET_NEXT_FIELD_32(frame, ptr, htonl(m.ssrc));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(m.loss_rate) << 24 | uint32_t(m.discard_rate) << 16 |
+        uint32_t(m.burst_density) << 8 | m.gap_density));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(m.burst_duration) << 16 | m.gap_duration));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(m.round_trip_delay) << 16 | m.end_system_delay));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(m.signal_level) << 24 | uint32_t(m.noise_level) << 16 |
+        uint32_t(m.rerl) << 8 | m.gmin));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(m.r_factor) << 24 | uint32_t(m.ext_r_factor) << 16 |
+        uint32_t(m.mos_lq) << 8 | m.mos_cq));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(m.rx_config) << 24 | m.jb_nominal));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(m.jb_maximum) << 16 | m.jb_abs_max));
+
+    return true;
+}
+
+bool uvgrtp::construct_fb_packet(uint8_t* frame, int& ptr, uvgrtp::frame::RTCP_FRAME_TYPE type, uint8_t fmt,
+    uint32_t sender_ssrc, uint32_t media_ssrc, const uint8_t* fci, size_t fci_len)
+{
+    if (fci_len % 4 != 0)
+    {
+        LOG_ERROR("Feedback Control Information must be a multiple of 32 bits");
+        return false;
+    }
+
+    if (!construct_rtcp_header(frame, ptr, get_fb_packet_size(fci_len), fmt & 0x1f, type) ||
+        !construct_ssrc(frame, ptr, sender_ssrc) ||
+        !construct_ssrc(frame, ptr, media_ssrc))
+    {
+        return false;
+    }
+
+    if (fci_len)
+    {
+        memcpy(&frame[ptr], fci, fci_len);
+        ptr += (int)fci_len;
+    }
+
+    return true;
+}
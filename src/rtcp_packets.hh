@@ -12,13 +12,27 @@ namespace uvgrtp
     const uint16_t SENDER_INFO_SIZE = 20;
     const uint16_t REPORT_BLOCK_SIZE = 24;
     const uint16_t APP_NAME_SIZE = 4;
+    const uint16_t XR_BLOCK_HEADER_SIZE = 4;
+    const uint16_t XR_RLE_HEADER_SIZE = 12;      /* block header, SSRC of source and the sequence numbers */
+    const uint16_t XR_VOIP_METRICS_SIZE = 36;
+    const uint16_t FB_HEADER_SIZE = 12;          /* RTCP header, SSRC of packet sender and SSRC of media source */
 
-    size_t get_sr_packet_size(int flags, uint16_t reports);
-    size_t get_rr_packet_size(int flags, uint16_t reports);
+    size_t get_sr_packet_size(uint16_t reports);
+    size_t get_rr_packet_size(uint16_t reports);
     size_t get_sdes_packet_size(const std::vector<uvgrtp::frame::rtcp_sdes_item>& items);
     size_t get_app_packet_size(size_t payload_len);
     size_t get_bye_packet_size(const std::vector<uint32_t>& ssrcs);
 
+    /* Size of an XR Loss or Duplicate RLE block with "chunks" chunks,
+     * including the null chunk that pads the block to 32 bits */
+    size_t get_xr_rle_block_size(size_t chunks);
+
+    /* Size of an XR Packet Receipt Times block with "times" receipt times */
+    size_t get_xr_receipt_times_block_size(size_t times);
+
+    /* Size of a feedback message with "fci_len" bytes of Feedback Control Information */
+    size_t get_fb_packet_size(size_t fci_len);
+
     // Add the RTCP header
     bool construct_rtcp_header(uint8_t* frame, int& ptr, size_t packet_size,
         uint16_t secondField, uvgrtp::frame::RTCP_FRAME_TYPE frame_type);
@@ -36,7 +50,9 @@ namespace uvgrtp
         uint32_t lsr, uint32_t dlsr);
 
     // Add the items to the frame
-    bool construct_sdes_chunk(uint8_t* frame, int& ptr, uvgrtp::frame::rtcp_sdes_chunk chunk);
+    bool construct_sdes_chunk(uint8_t* frame, int& ptr, const uvgrtp::frame::rtcp_sdes_chunk& chunk);
+    bool construct_sdes_chunk(uint8_t* frame, int& ptr, uint32_t ssrc,
+        const std::vector<uvgrtp::frame::rtcp_sdes_item>& items);
 
     // Add the name and payload to APP packet, remember to also add SSRC separately
     bool construct_app_packet(uint8_t* frame, int& ptr,
@@ -44,4 +60,20 @@ namespace uvgrtp
 
     // Add BYE ssrcs, should probably be removed
     bool construct_bye_packet(uint8_t* frame, int& ptr, const std::vector<uint32_t>& ssrcs);
+
+    // Add an XR Loss or Duplicate RLE block with the chunks of packets from begin_seq up to end_seq
+    bool construct_xr_rle_block(uint8_t* frame, int& ptr, uvgrtp::frame::RTCP_XR_BLOCK_TYPE type,
+        uint32_t ssrc, uint16_t begin_seq, uint16_t end_seq, const uint16_t* chunks, size_t chunk_count);
+
+    // Add an XR Packet Receipt Times block with the times of the packets received from begin_seq up to end_seq
+    bool construct_xr_receipt_times_block(uint8_t* frame, int& ptr, uint32_t ssrc,
+        uint16_t begin_seq, uint16_t end_seq, const uint32_t* times, size_t time_count);
+
+    // Add an XR VoIP Metrics block
+    bool construct_xr_voip_metrics_block(uint8_t* frame, int& ptr,
+        const uvgrtp::frame::rtcp_xr_voip_metrics_block& metrics);
+
+    // Add a whole feedback message, "fci_len" must be a multiple of 4
+    bool construct_fb_packet(uint8_t* frame, int& ptr, uvgrtp::frame::RTCP_FRAME_TYPE type, uint8_t fmt,
+        uint32_t sender_ssrc, uint32_t media_ssrc, const uint8_t* fci, size_t fci_len);
 }
\ No newline at end of file
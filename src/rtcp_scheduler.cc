@@ -0,0 +1,457 @@
+#include "rtcp_scheduler.hh"
+
+#include "uvgrtp/rtcp.hh"
+#include "uvgrtp/socket.hh"
+#include "uvgrtp/debug.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+/* Resolution of the report timers */
+constexpr uint64_t TICK_MS = 10;
+
+/* The sockets are polled at most this long at a time so that new
+ * instances and stopping the scheduler are noticed in time.
+ * Rescheduled timers wake the thread up from the poll */
+constexpr uint64_t MAX_POLL_MS = 100;
+
+
+uvgrtp::timer_wheel::timer_wheel(uint64_t now):
+    current_(now)
+{
+}
+
+void uvgrtp::timer_wheel::insert(uvgrtp::rtcp *owner, timer& t, uint64_t earliest)
+{
+    const uint64_t reach = (uint64_t)1 << (SLOT_BITS * LEVELS);
+
+    uint64_t at = std::max(t.expiry, earliest);
+
+    if (at - current_ >= reach)
+    {
+        at = current_ + reach - 1;
+    }
+
+    size_t level = 0;
+    while (level < LEVELS - 1 && at - current_ >= ((uint64_t)1 << (SLOT_BITS * (level + 1))))
+    {
+        ++level;
+    }
+
+    t.level = level;
+    t.slot  = (at >> (SLOT_BITS * level)) & (SLOTS - 1);
+
+    wheels_[t.level][t.slot].push_back(owner);
+}
+
+void uvgrtp::timer_wheel::unlink(uvgrtp::rtcp *owner, const timer& t)
+{
+    auto& slot = wheels_[t.level][t.slot];
+    auto it    = std::find(slot.begin(), slot.end(), owner);
+
+    if (it != slot.end())
+    {
+        *it = slot.back();
+        slot.pop_back();
+    }
+}
+
+void uvgrtp::timer_wheel::schedule(uvgrtp::rtcp *owner, uint64_t expiry)
+{
+    auto it = timers_.find(owner);
+
+    if (it != timers_.end())
+    {
+        unlink(owner, it->second);
+    }
+
+    timer& t = timers_[owner];
+    t.expiry = expiry;
+
+    /* the slot of the current tick has already been processed */
+    insert(owner, t, current_ + 1);
+}
+
+void uvgrtp::timer_wheel::cancel(uvgrtp::rtcp *owner)
+{
+    auto it = timers_.find(owner);
+
+    if (it != timers_.end())
+    {
+        unlink(owner, it->second);
+        timers_.erase(it);
+    }
+}
+
+uint64_t uvgrtp::timer_wheel::expiry(uvgrtp::rtcp *owner) const
+{
+    auto it = timers_.find(owner);
+
+    return it != timers_.end() ? it->second.expiry : 0;
+}
+
+void uvgrtp::timer_wheel::advance(uint64_t now, std::vector<uvgrtp::rtcp *>& expired)
+{
+    std::vector<uvgrtp::rtcp *> moved;
+
+    if (timers_.empty())
+    {
+        current_ = std::max(current_, now);
+        return;
+    }
+
+    while (current_ < now)
+    {
+        ++current_;
+
+        /* move the timers of the higher wheels down when the wheels below have turned around */
+        for (size_t level = 1; level < LEVELS; ++level)
+        {
+            if (current_ & (((uint64_t)1 << (SLOT_BITS * level)) - 1))
+            {
+                break;
+            }
+
+            moved.clear();
+            moved.swap(wheels_[level][(current_ >> (SLOT_BITS * level)) & (SLOTS - 1)]);
+
+            for (auto& owner : moved)
+            {
+                insert(owner, timers_[owner], current_);
+            }
+        }
+
+        moved.clear();
+        moved.swap(wheels_[0][current_ & (SLOTS - 1)]);
+
+        for (auto& owner : moved)
+        {
+            timer& t = timers_[owner];
+
+            /* the timer was beyond the reach of the wheels */
+            if (t.expiry > current_)
+            {
+                insert(owner, t, current_ + 1);
+                continue;
+            }
+
+            timers_.erase(owner);
+            expired.push_back(owner);
+        }
+    }
+}
+
+uint64_t uvgrtp::timer_wheel::next_expiry(uint64_t limit) const
+{
+    if (timers_.empty())
+    {
+        return limit;
+    }
+
+    for (uint64_t tick = current_ + 1; tick < limit; ++tick)
+    {
+        /* either a timer expires or the higher wheels have to be advanced */
+        if (!wheels_[0][tick & (SLOTS - 1)].empty() || (tick & (SLOTS - 1)) == 0)
+        {
+            return tick;
+        }
+    }
+
+    return limit;
+}
+
+uvgrtp::rtcp_scheduler::rtcp_scheduler():
+    stop_(false),
+    changed_(false),
+    wheel_(now() / TICK_MS),
+    wakeup_addr_(),
+    woken_(false),
+    calling_(nullptr)
+{
+    create_wakeup();
+}
+
+uvgrtp::rtcp_scheduler::~rtcp_scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+uint64_t uvgrtp::rtcp_scheduler::now()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+rtp_error_t uvgrtp::rtcp_scheduler::add(uvgrtp::rtcp *rtcp,
+    std::vector<std::shared_ptr<uvgrtp::socket>> sockets, uint64_t first_report)
+{
+    if (!rtcp || sockets.empty())
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+
+        /* the wheel has not been advanced while it had no timers */
+        if (instances_.empty())
+        {
+            wheel_ = timer_wheel(now() / TICK_MS);
+        }
+
+        instances_[rtcp] = sockets;
+        changed_ = true;
+        wheel_.schedule(rtcp, (first_report + TICK_MS - 1) / TICK_MS);
+
+        /* the thread is only started when the first RTCP instance is added */
+        if (!thread_.joinable())
+        {
+            thread_ = std::thread(&uvgrtp::rtcp_scheduler::scheduler, this);
+        }
+    }
+    cv_.notify_one();
+
+    return RTP_OK;
+}
+
+void uvgrtp::rtcp_scheduler::remove(uvgrtp::rtcp *rtcp)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+
+    wheel_.cancel(rtcp);
+
+    if (instances_.erase(rtcp))
+    {
+        changed_ = true;
+    }
+
+    /* a hook of another instance may remove this one from the scheduler thread */
+    if (std::this_thread::get_id() != thread_.get_id())
+    {
+        call_cv_.wait(lock, [this, rtcp] { return calling_ != rtcp; });
+    }
+}
+
+void uvgrtp::rtcp_scheduler::reschedule(uvgrtp::rtcp *rtcp, uint64_t time)
+{
+    if (std::this_thread::get_id() == thread_.get_id())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    uint64_t tick = (time + TICK_MS - 1) / TICK_MS;
+
+    if (instances_.find(rtcp) != instances_.end() && tick < wheel_.expiry(rtcp))
+    {
+        wheel_.schedule(rtcp, tick);
+        wakeup();
+    }
+}
+
+void uvgrtp::rtcp_scheduler::create_wakeup()
+{
+    auto wakeup = std::make_shared<uvgrtp::socket>(0);
+    sockaddr_in addr = {};
+    socklen_t len    = sizeof(addr);
+
+    if (wakeup->init(AF_INET, SOCK_DGRAM, 0) != RTP_OK ||
+        wakeup->bind(AF_INET, INADDR_LOOPBACK, 0) != RTP_OK ||
+#ifdef _WIN32
+        ::getsockname(wakeup->get_raw_socket(), (sockaddr *)&addr, (int *)&len) != 0)
+#else
+        ::getsockname(wakeup->get_raw_socket(), (sockaddr *)&addr, &len) != 0)
+#endif
+    {
+        LOG_ERROR("Failed to create the wakeup socket of the RTCP scheduler, rescheduling is delayed");
+        return;
+    }
+
+    wakeup_      = wakeup;
+    wakeup_addr_ = addr;
+}
+
+void uvgrtp::rtcp_scheduler::wakeup()
+{
+    if (!wakeup_ || woken_)
+    {
+        return;
+    }
+
+    uint8_t byte = 0;
+
+    if (wakeup_->sendto(wakeup_addr_, &byte, sizeof(byte), 0) == RTP_OK)
+    {
+        woken_ = true;
+    }
+}
+
+void uvgrtp::rtcp_scheduler::update_poll_set()
+{
+    fds_.clear();
+    fd_owners_.clear();
+    fd_sockets_.clear();
+
+    if (wakeup_)
+    {
+        fds_.push_back({});
+        fds_.back().fd     = wakeup_->get_raw_socket();
+        fds_.back().events = POLLIN;
+
+        fd_owners_.push_back(nullptr);
+        fd_sockets_.push_back(wakeup_);
+    }
+
+    for (auto& instance : instances_)
+    {
+        for (auto& socket : instance.second)
+        {
+            fds_.push_back({});
+            fds_.back().fd     = socket->get_raw_socket();
+            fds_.back().events = POLLIN;
+
+            fd_owners_.push_back(instance.first);
+            fd_sockets_.push_back(socket);
+        }
+    }
+
+    changed_ = false;
+}
+
+bool uvgrtp::rtcp_scheduler::begin_call(uvgrtp::rtcp *rtcp, std::unique_lock<std::mutex>& lock)
+{
+    if (instances_.find(rtcp) == instances_.end())
+    {
+        return false;
+    }
+
+    calling_ = rtcp;
+    lock.unlock();
+
+    return true;
+}
+
+void uvgrtp::rtcp_scheduler::end_call(std::unique_lock<std::mutex>& lock)
+{
+    lock.lock();
+    calling_ = nullptr;
+    call_cv_.notify_all();
+}
+
+void uvgrtp::rtcp_scheduler::scheduler()
+{
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[MAX_PACKET]);
+    std::vector<uvgrtp::rtcp *> expired;
+    std::unique_lock<std::mutex> lock(mtx_);
+
+    while (!stop_)
+    {
+        if (instances_.empty())
+        {
+            cv_.wait(lock, [this] { return stop_ || !instances_.empty(); });
+            continue;
+        }
+
+        if (changed_)
+        {
+            update_poll_set();
+        }
+
+        uint64_t current = now();
+        uint64_t wake    = wheel_.next_expiry((current + MAX_POLL_MS) / TICK_MS) * TICK_MS;
+        int timeout      = wake > current ? (int)(wake - current) : 0;
+
+        /* fds_ is only modified by this thread so it can be polled without the lock */
+        lock.unlock();
+#ifdef _WIN32
+        int ready = WSAPoll(fds_.data(), (ULONG)fds_.size(), timeout);
+#else
+        int ready = ::poll(fds_.data(), fds_.size(), timeout);
+#endif
+        lock.lock();
+
+        if (ready < 0)
+        {
+            LOG_ERROR("poll(2) failed for RTCP sockets");
+        }
+
+        /* The poll set is out of date if an instance was added or removed during the poll,
+         * or during one of the calls below. Any packets are still in the sockets and are
+         * received on the next round */
+        for (size_t i = 0; ready > 0 && !changed_ && i < fds_.size(); ++i)
+        {
+            if (!(fds_[i].revents & POLLIN))
+            {
+                continue;
+            }
+
+            uvgrtp::rtcp *rtcp = fd_owners_[i];
+
+            if (!rtcp)
+            {
+                (void)fd_sockets_[i]->recvfrom(buffer.get(), MAX_PACKET, 0);
+                woken_ = false;
+                continue;
+            }
+
+            if (!begin_call(rtcp, lock))
+            {
+                continue;
+            }
+
+            int nread = 0;
+            sockaddr_in sender = {};
+            uint64_t next_report = 0;
+
+            if (fd_sockets_[i]->recvfrom(buffer.get(), MAX_PACKET, 0, &sender, &nread) == RTP_OK && nread > 0)
+            {
+                (void)rtcp->handle_incoming_packet(buffer.get(), (size_t)nread, &sender);
+
+                /* a BYE may have brought the next report closer */
+                next_report = (rtcp->next_report() + TICK_MS - 1) / TICK_MS;
+            }
+
+            end_call(lock);
+
+            if (next_report && instances_.find(rtcp) != instances_.end() && next_report < wheel_.expiry(rtcp))
+            {
+                wheel_.schedule(rtcp, next_report);
+            }
+        }
+
+        expired.clear();
+        wheel_.advance(now() / TICK_MS, expired);
+
+        for (auto& rtcp : expired)
+        {
+            if (!begin_call(rtcp, lock))
+            {
+                continue;
+            }
+
+            uint64_t next_report = rtcp->report_timer_expired(now());
+
+            end_call(lock);
+
+            /* the instance may have been rescheduled or removed during the call */
+            uint64_t tick = (next_report + TICK_MS - 1) / TICK_MS;
+            uint64_t current = wheel_.expiry(rtcp);
+
+            if (instances_.find(rtcp) != instances_.end() && (!current || tick < current))
+            {
+                wheel_.schedule(rtcp, tick);
+            }
+        }
+    }
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#include <poll.h>
+#endif
+
+#include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace uvgrtp {
+
+    class rtcp;
+    class socket;
+
+    /* Hierarchical timer wheel for the report timers of RTCP instances
+     *
+     * Time advances in ticks. Each of the LEVELS wheels has SLOTS slots and one slot of
+     * a wheel spans a whole turn of the wheel below it, so together the wheels reach
+     * SLOTS^LEVELS ticks ahead. A timer is put to the lowest wheel that can hold its
+     * expiry and it moves down a level when the wheel below has turned around to it.
+     * Scheduling and cancelling do not depend on the number of timers and advancing
+     * the time only touches the timers that expire or move down.
+     *
+     * A timer further away than the wheels reach is put to the last slot it can reach
+     * and rescheduled from there */
+    class timer_wheel {
+        public:
+            timer_wheel(uint64_t now);
+
+            /* Schedule the timer of "owner" to expire at tick "expiry",
+             * replacing its previous expiry if it has one */
+            void schedule(uvgrtp::rtcp *owner, uint64_t expiry);
+
+            /* Cancel the timer of "owner" if it is scheduled */
+            void cancel(uvgrtp::rtcp *owner);
+
+            /* Return the tick when the timer of "owner" expires or 0 if it is not scheduled */
+            uint64_t expiry(uvgrtp::rtcp *owner) const;
+
+            /* Advance the time to tick "now" and append the owners of the expired timers to "expired" */
+            void advance(uint64_t now, std::vector<uvgrtp::rtcp *>& expired);
+
+            /* Return the tick when advance() should be called next, at the latest "limit" */
+            uint64_t next_expiry(uint64_t limit) const;
+
+        private:
+            static constexpr size_t SLOT_BITS = 6;
+            static constexpr size_t SLOTS     = 1 << SLOT_BITS;
+            static constexpr size_t LEVELS    = 4;
+
+            struct timer {
+                uint64_t expiry = 0;
+                size_t level    = 0;
+                size_t slot     = 0;
+            };
+
+            /* Put the timer of "owner" to a slot, expiring at tick "earliest" at the soonest */
+            void insert(uvgrtp::rtcp *owner, timer& t, uint64_t earliest);
+
+            /* Take the timer of "owner" out of its slot */
+            void unlink(uvgrtp::rtcp *owner, const timer& t);
+
+            uint64_t current_;
+
+            std::array<std::array<std::vector<uvgrtp::rtcp *>, SLOTS>, LEVELS> wheels_;
+            std::unordered_map<uvgrtp::rtcp *, timer> timers_;
+    };
+
+    /* Context-wide RTCP scheduler
+     *
+     * One thread sends the reports of all RTCP instances registered to the scheduler
+     * and receives the RTCP packets arriving to their sockets, instead of each media
+     * stream running a thread of its own.
+     *
+     * The report timers are kept in a timer_wheel. When the timer of an instance
+     * expires, the scheduler calls rtcp::report_timer_expired() which sends a report
+     * if it is due and returns the time of its next report.
+     *
+     * The sockets of all instances are listened to with one poll(2) between the timers
+     * and the packets are given to rtcp::handle_incoming_packet() of their owners. If a
+     * packet moves the next report of its owner, the timer is rescheduled.
+     *
+     * The RTCP instances are called without the lock of the scheduler held so that they, and
+     * the RTCP hooks of the application called from them, may add, remove and reschedule
+     * instances. The instances are still called one at a time from the one thread: an RTCP
+     * hook that takes long delays the reports and packets of all media streams of the context,
+     * unless the hooks are called from a thread of their own with RCE_RTCP_ASYNC_HOOKS.
+     * A hook must not destroy the media stream it was called for */
+    class rtcp_scheduler {
+        public:
+            rtcp_scheduler();
+            ~rtcp_scheduler();
+
+            /* Start sending reports of "rtcp" and receiving its packets from "sockets"
+             *
+             * "first_report" is the time of the first report (see now())
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "rtcp" is nullptr or it has no sockets */
+            rtp_error_t add(uvgrtp::rtcp *rtcp, std::vector<std::shared_ptr<uvgrtp::socket>> sockets,
+                uint64_t first_report);
+
+            /* Stop scheduling "rtcp". Once this has returned, the scheduler no longer calls it
+             *
+             * If the scheduler thread is calling "rtcp", wait for the call to return first */
+            void remove(uvgrtp::rtcp *rtcp);
+
+            /* Call "rtcp" at "time" (see now()) if its timer expires later than that
+             *
+             * The thread may be polling the sockets when the timer is moved so it is
+             * woken up to notice the new expiry. On the scheduler thread this does
+             * nothing: the scheduler reads rtcp::next_report() after each call */
+            void reschedule(uvgrtp::rtcp *rtcp, uint64_t time);
+
+            /* Return the current time of the scheduler in milliseconds */
+            static uint64_t now();
+
+        private:
+            void scheduler();
+
+            /* Build the poll set from the sockets of the registered instances */
+            void update_poll_set();
+
+            /* Create the loopback socket that wakes the scheduler thread up from poll(2) */
+            void create_wakeup();
+
+            /* Wake the scheduler thread up if it is polling the sockets (mtx_ must be held) */
+            void wakeup();
+
+            /* Mark "rtcp" as being called and release "lock" for the call, return false if
+             * "rtcp" has been removed. end_call() retakes the lock and clears the mark */
+            bool begin_call(uvgrtp::rtcp *rtcp, std::unique_lock<std::mutex>& lock);
+            void end_call(std::unique_lock<std::mutex>& lock);
+
+            bool stop_;
+
+            /* Has an instance been added or removed since the poll set was built */
+            bool changed_;
+
+            timer_wheel wheel_;
+
+            std::unordered_map<uvgrtp::rtcp *, std::vector<std::shared_ptr<uvgrtp::socket>>> instances_;
+
+            /* Only used by the scheduler thread */
+#ifdef _WIN32
+            std::vector<WSAPOLLFD> fds_;
+#else
+            std::vector<pollfd> fds_;
+#endif
+            /* The owner of the wakeup socket is nullptr */
+            std::vector<uvgrtp::rtcp *> fd_owners_;
+            std::vector<std::shared_ptr<uvgrtp::socket>> fd_sockets_;
+
+            /* A byte sent to the wakeup socket ends the poll, nullptr if it could not be created */
+            std::shared_ptr<uvgrtp::socket> wakeup_;
+            sockaddr_in wakeup_addr_;
+
+            /* Has a byte been sent to the wakeup socket that has not been received yet */
+            bool woken_;
+
+            /* The instance the scheduler thread is calling, remove() waits on "call_cv_" until
+             * the call has returned. The instances are called with "mtx_" released */
+            uvgrtp::rtcp *calling_;
+
+            std::mutex mtx_;
+            std::condition_variable cv_;
+            std::condition_variable call_cv_;
+            std::thread thread_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,327 @@
+#include "rtcp_xr.hh"
+
+#include <algorithm>
+
+/* Lost packets with fewer received packets than this between them belong
+ * to the same burst (RFC 3611 section 4.7.2 recommends 16) */
+constexpr uint32_t GMIN = 16;
+
+/* The longest run a run length chunk can hold */
+constexpr uint32_t MAX_RUN_LENGTH = 0x3fff;
+
+/* The number of packets in a bit vector chunk */
+constexpr uint32_t BIT_VECTOR_LENGTH = 15;
+
+static size_t word_of(uint32_t seq)
+{
+    return (seq / 64) % uvgrtp::receive_history::WORDS;
+}
+
+static uint64_t bit_of(uint32_t seq)
+{
+    return (uint64_t)1 << (seq % 64);
+}
+
+/* The value is 0 to 256 but the fields are 8 bits */
+static uint8_t fraction_of(uint32_t part, uint32_t total)
+{
+    return total ? (uint8_t)std::min<uint32_t>(255, (uint32_t)((uint64_t)part * 256 / total)) : 0;
+}
+
+static uint16_t milliseconds_of(double ms)
+{
+    return (uint16_t)std::min(65535.0, std::max(0.0, ms));
+}
+
+bool uvgrtp::receive_history::range::is_received(uint32_t seq) const
+{
+    return received[word_of(seq)] & bit_of(seq);
+}
+
+bool uvgrtp::receive_history::range::is_duplicate(uint32_t seq) const
+{
+    return duplicates[word_of(seq)] & bit_of(seq);
+}
+
+uint32_t uvgrtp::receive_history::range::receipt_time(uint32_t seq) const
+{
+    return receipt_times[seq % RECEIPT_TIMES];
+}
+
+uvgrtp::receive_history::receive_history():
+    end_(0),
+    first_(0),
+    reported_(0),
+    has_reported_(false)
+{
+    for (size_t i = 0; i < WORDS; ++i)
+    {
+        received_[i].store(0, std::memory_order_relaxed);
+        duplicates_[i].store(0, std::memory_order_relaxed);
+    }
+
+    for (auto& time : receipt_times_)
+    {
+        time.store(0, std::memory_order_relaxed);
+    }
+}
+
+void uvgrtp::receive_history::record(uint32_t seq, uint32_t receipt_time)
+{
+    /* only this thread writes so the bits are updated without read-modify-write operations */
+    auto set = [](std::atomic<uint64_t>& word, uint64_t bit) {
+        word.store(word.load(std::memory_order_relaxed) | bit, std::memory_order_relaxed);
+    };
+    auto clear = [](std::atomic<uint64_t>& word, uint64_t bit) {
+        word.store(word.load(std::memory_order_relaxed) & ~bit, std::memory_order_relaxed);
+    };
+
+    uint32_t end = end_.load(std::memory_order_relaxed);
+
+    if (end == 0)
+    {
+        first_.store(seq, std::memory_order_relaxed);
+        end = seq;
+    }
+
+    if ((int32_t)(seq - end) >= 0)
+    {
+        /* The slots of the sequence numbers skipped over still hold the packets
+         * of a window ago. If the jump is longer than the window, all are cleared */
+        uint32_t from = (seq - end >= WINDOW) ? seq - WINDOW + 1 : end;
+
+        for (uint32_t skipped = from; skipped != seq; ++skipped)
+        {
+            clear(received_[word_of(skipped)], bit_of(skipped));
+            clear(duplicates_[word_of(skipped)], bit_of(skipped));
+        }
+
+        set(received_[word_of(seq)], bit_of(seq));
+        clear(duplicates_[word_of(seq)], bit_of(seq));
+        receipt_times_[seq % RECEIPT_TIMES].store(receipt_time, std::memory_order_relaxed);
+
+        end_.store(seq + 1, std::memory_order_release);
+    }
+    else if (end - seq <= WINDOW)
+    {
+        /* a reordered or a duplicate packet */
+        if (received_[word_of(seq)].load(std::memory_order_relaxed) & bit_of(seq))
+        {
+            set(duplicates_[word_of(seq)], bit_of(seq));
+        }
+        else
+        {
+            set(received_[word_of(seq)], bit_of(seq));
+            receipt_times_[seq % RECEIPT_TIMES].store(receipt_time, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool uvgrtp::receive_history::take_range(range& out)
+{
+    uint32_t end = end_.load(std::memory_order_acquire);
+
+    if (end == 0)
+    {
+        return false;
+    }
+
+    uint32_t begin = has_reported_ ? reported_ : first_.load(std::memory_order_relaxed);
+
+    if ((int32_t)(end - begin) <= 0)
+    {
+        return false;
+    }
+
+    if (end - begin > MAX_RANGE)
+    {
+        begin = end - MAX_RANGE;
+    }
+
+    for (size_t i = 0; i < WORDS; ++i)
+    {
+        out.received[i]   = received_[i].load(std::memory_order_relaxed);
+        out.duplicates[i] = duplicates_[i].load(std::memory_order_relaxed);
+    }
+
+    for (size_t i = 0; i < RECEIPT_TIMES; ++i)
+    {
+        out.receipt_times[i] = receipt_times_[i].load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t moved = end_.load(std::memory_order_relaxed) - end;
+
+    reported_     = end;
+    has_reported_ = true;
+
+    /* the writer may have cleared bits of the range */
+    if (moved > WINDOW - MAX_RANGE)
+    {
+        return false;
+    }
+
+    out.begin = begin;
+    out.end   = end;
+
+    /* the receipt times of the range are overwritten once the writer is half the ring ahead */
+    if (moved > RECEIPT_TIMES / 2)
+    {
+        out.receipt_begin = end;
+    }
+    else
+    {
+        out.receipt_begin = (end - begin > RECEIPT_TIMES / 2) ? end - RECEIPT_TIMES / 2 : begin;
+    }
+
+    return true;
+}
+
+size_t uvgrtp::encode_rle_chunks(const receive_history::range& r, bool duplicates,
+    uint16_t* chunks, size_t max_chunks)
+{
+    auto value_of = [&](uint32_t seq) {
+        return duplicates ? r.is_duplicate(seq) : r.is_received(seq);
+    };
+
+    size_t count = 0;
+
+    for (uint32_t seq = r.begin; seq != r.end;)
+    {
+        if (count == max_chunks)
+        {
+            return 0;
+        }
+
+        bool value   = value_of(seq);
+        uint32_t run = 1;
+
+        while (seq + run != r.end && run < MAX_RUN_LENGTH && value_of(seq + run) == value)
+        {
+            ++run;
+        }
+
+        /* runs shorter than a bit vector are put to one, except at the end of the range */
+        if (run >= BIT_VECTOR_LENGTH || seq + run == r.end)
+        {
+            chunks[count++] = (uint16_t)((value ? 0x4000 : 0) | run);
+            seq += run;
+            continue;
+        }
+
+        uint16_t chunk = 0x8000;
+
+        for (int bit = BIT_VECTOR_LENGTH - 1; bit >= 0 && seq != r.end; --bit, ++seq)
+        {
+            if (value_of(seq))
+            {
+                chunk |= (uint16_t)(1 << bit);
+            }
+        }
+
+        chunks[count++] = chunk;
+    }
+
+    return count;
+}
+
+uvgrtp::frame::rtcp_xr_voip_metrics_block uvgrtp::compute_voip_metrics(const receive_history::range& r,
+    uint32_t ssrc, uint32_t clock_rate, double rtt_ms)
+{
+    uvgrtp::frame::rtcp_xr_voip_metrics_block metrics;
+    metrics.ssrc = ssrc;
+    metrics.gmin = GMIN;
+
+    uint32_t packets       = r.end - r.begin;
+    uint32_t lost          = 0;
+    uint32_t bursts        = 0;
+    uint32_t burst_packets = 0;
+    uint32_t burst_lost    = 0;
+
+    /* The losses with fewer than GMIN received packets between them form a group.
+     * A group of one loss is an isolated loss within a gap, larger ones are bursts */
+    uint32_t group_first  = 0;
+    uint32_t group_last   = 0;
+    uint32_t group_lost   = 0;
+    uint32_t received_run = 0;
+
+    auto end_group = [&]() {
+        if (group_lost > 1)
+        {
+            ++bursts;
+            burst_packets += group_last - group_first + 1;
+            burst_lost    += group_lost;
+        }
+    };
+
+    for (uint32_t seq = r.begin; seq != r.end; ++seq)
+    {
+        if (r.is_received(seq))
+        {
+            ++received_run;
+            continue;
+        }
+
+        ++lost;
+
+        if (group_lost && received_run < GMIN)
+        {
+            group_last = seq;
+            ++group_lost;
+        }
+        else
+        {
+            end_group();
+            group_first = group_last = seq;
+            group_lost  = 1;
+        }
+
+        received_run = 0;
+    }
+    end_group();
+
+    uint32_t gap_packets = packets - burst_packets;
+
+    metrics.loss_rate     = fraction_of(lost, packets);
+    metrics.burst_density = fraction_of(burst_lost, burst_packets);
+    metrics.gap_density   = fraction_of(lost - burst_lost, gap_packets);
+
+    /* the durations are estimated from the packet interval of the latest receipt times */
+    uint32_t first_seq = 0;
+    uint32_t last_seq  = 0;
+    bool have_first    = false;
+
+    for (uint32_t seq = r.receipt_begin; seq != r.end; ++seq)
+    {
+        if (r.is_received(seq))
+        {
+            if (!have_first)
+            {
+                first_seq  = seq;
+                have_first = true;
+            }
+            last_seq = seq;
+        }
+    }
+
+    if (clock_rate && have_first && last_seq != first_seq)
+    {
+        double interval_ms = (double)(r.receipt_time(last_seq) - r.receipt_time(first_seq)) * 1000
+            / clock_rate / (last_seq - first_seq);
+
+        if (bursts)
+        {
+            metrics.burst_duration = milliseconds_of(interval_ms * burst_packets / bursts);
+        }
+
+        /* the gaps are between and around the bursts */
+        metrics.gap_duration = milliseconds_of(interval_ms * gap_packets / (bursts + 1));
+    }
+
+    if (rtt_ms >= 0)
+    {
+        metrics.round_trip_delay = milliseconds_of(rtt_ms);
+    }
+
+    return metrics;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "uvgrtp/frame.hh"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace uvgrtp {
+
+    /* Receive history of one source for RTCP Extended Reports (RFC 3611)
+     *
+     * The packets received from the source are kept in a bitmap of the latest WINDOW
+     * sequence numbers, indexed by the sequence number, and the duplicates in another
+     * one like it. The receipt times of the latest RECEIPT_TIMES packets are kept in a
+     * ring next to them. The history is allocated with the participant and never grows,
+     * recording a packet touches one word of each bitmap and one slot of the ring.
+     *
+     * The packet processing thread is the only writer. Report generation copies the
+     * packets it has not reported yet with take_range() without locking: the writer
+     * clears the bits of the sequence numbers ahead of it, so a copy is only used if the
+     * writer did not get far enough during the copy to reach the copied range */
+    class receive_history {
+        public:
+            /* Number of sequence numbers remembered */
+            static constexpr uint32_t WINDOW = 1024;
+
+            /* At most this many sequence numbers are reported at a time */
+            static constexpr uint32_t MAX_RANGE = WINDOW / 2;
+
+            /* Number of receipt times remembered, the latest RECEIPT_TIMES / 2 are reported */
+            static constexpr uint32_t RECEIPT_TIMES = 64;
+
+            static constexpr uint32_t WORDS = WINDOW / 64;
+
+            /* The packets from "begin" up to "end" (extended sequence numbers) */
+            struct range {
+                uint32_t begin = 0;
+                uint32_t end = 0;
+
+                /* The receipt times are only valid from "receipt_begin" up to "end" */
+                uint32_t receipt_begin = 0;
+
+                std::array<uint64_t, WORDS> received;
+                std::array<uint64_t, WORDS> duplicates;
+                std::array<uint32_t, RECEIPT_TIMES> receipt_times;
+
+                bool is_received(uint32_t seq) const;
+                bool is_duplicate(uint32_t seq) const;
+                uint32_t receipt_time(uint32_t seq) const;
+            };
+
+            receive_history();
+
+            /* Record the packet with extended sequence number "seq" received at
+             * "receipt_time" in the RTP timestamp units of the source */
+            void record(uint32_t seq, uint32_t receipt_time);
+
+            /* Copy the packets received since the previous call to "out"
+             *
+             * Return false if no packets have been received since or
+             * the writer overtook the copy */
+            bool take_range(range& out);
+
+        private:
+            std::array<std::atomic<uint64_t>, WORDS> received_;
+            std::array<std::atomic<uint64_t>, WORDS> duplicates_;
+            std::array<std::atomic<uint32_t>, RECEIPT_TIMES> receipt_times_;
+
+            /* The highest extended sequence number received + 1, zero before the first packet */
+            std::atomic<uint32_t> end_;
+            std::atomic<uint32_t> first_;
+
+            /* The end of the previous range, only used by report generation */
+            uint32_t reported_;
+            bool has_reported_;
+    };
+
+    /* Run-length encode the packets of "r" to at most "max_chunks" chunks (RFC 3611 section 4.1)
+     *
+     * The value of a packet is whether it was received or, if "duplicates" is true, whether
+     * it was duplicated. Return the number of chunks or 0 if they do not fit to "max_chunks" */
+    size_t encode_rle_chunks(const receive_history::range& r, bool duplicates,
+        uint16_t* chunks, size_t max_chunks);
+
+    /* Compute the VoIP metrics of "r" (RFC 3611 section 4.7)
+     *
+     * "clock_rate" is the clock rate of the source used to turn the receipt times to
+     * milliseconds and "rtt_ms" the round-trip time to the source or negative if unknown */
+    uvgrtp::frame::rtcp_xr_voip_metrics_block compute_voip_metrics(const receive_history::range& r,
+        uint32_t ssrc, uint32_t clock_rate, double rtt_ms);
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -11,6 +11,7 @@
 #endif
 
 #include <chrono>
+#include <cstring>
 
 
 
@@ -39,6 +40,11 @@ uint32_t uvgrtp::rtp::get_ssrc() const
     return ssrc_;
 }
 
+void uvgrtp::rtp::set_ssrc(uint32_t ssrc)
+{
+    ssrc_ = ssrc;
+}
+
 uint16_t uvgrtp::rtp::get_sequence() const
 {
     return seq_;
@@ -132,14 +138,30 @@ uint32_t uvgrtp::rtp::get_clock_rate() const
     return clock_rate_;
 }
 
-void uvgrtp::rtp::set_payload_size(size_t payload_size)
+rtp_error_t uvgrtp::rtp::set_payload_size(size_t payload_size)
 {
+    std::lock_guard<std::mutex> lock(ext_mutex_);
+
+    if (payload_size <= ext_block_.size()) {
+        LOG_ERROR("Payload size %zu does not fit the header extension block of %zu bytes",
+                payload_size, ext_block_.size());
+        return RTP_INVALID_VALUE;
+    }
+
     payload_size_ = payload_size;
+    update_payload_size();
+    return RTP_OK;
 }
 
 size_t uvgrtp::rtp::get_payload_size() const
 {
-    return payload_size_;
+    return ext_payload_size_.load(std::memory_order_relaxed);
+}
+
+void uvgrtp::rtp::update_payload_size()
+{
+    /* the extension block is sent in every packet so it's taken from the payload */
+    ext_payload_size_.store(payload_size_ - ext_block_.size(), std::memory_order_relaxed);
 }
 
 rtp_format_t uvgrtp::rtp::get_payload() const
@@ -157,6 +179,204 @@ size_t uvgrtp::rtp::get_pkt_max_delay() const
     return delay_;
 }
 
+rtp_error_t uvgrtp::rtp::register_extension(uint8_t id, const std::string& uri)
+{
+    if (id == 0 || uri.empty())
+        return RTP_INVALID_VALUE;
+
+    std::lock_guard<std::mutex> lock(ext_mutex_);
+
+    for (auto& ext : ext_uris_) {
+        if (ext.first == id || ext.second == uri) {
+            LOG_ERROR("Header extension %u has already been registered", ext.first);
+            return RTP_INVALID_VALUE;
+        }
+    }
+
+    ext_uris_[id] = uri;
+    return RTP_OK;
+}
+
+uint8_t uvgrtp::rtp::get_extension_id(const std::string& uri) const
+{
+    std::lock_guard<std::mutex> lock(ext_mutex_);
+
+    for (auto& ext : ext_uris_) {
+        if (ext.second == uri)
+            return ext.first;
+    }
+
+    return 0;
+}
+
+rtp_error_t uvgrtp::rtp::set_extension(uint8_t id, const uint8_t *data, size_t len)
+{
+    if (len > UINT8_MAX || (!data && len))
+        return RTP_INVALID_VALUE;
+
+    std::lock_guard<std::mutex> lock(ext_mutex_);
+
+    if (ext_uris_.find(id) == ext_uris_.end()) {
+        LOG_ERROR("Header extension %u has not been registered", id);
+        return RTP_NOT_FOUND;
+    }
+
+    auto values = ext_values_;
+    std::vector<uint8_t> block;
+
+    values[id].assign(data, data + len);
+
+    if (build_extension_block(values, block) != RTP_OK || block.size() >= payload_size_) {
+        LOG_ERROR("Header extensions do not fit to the extension block");
+        return RTP_MEMORY_ERROR;
+    }
+
+    ext_values_ = std::move(values);
+    ext_block_  = std::move(block);
+    update_payload_size();
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtp::clear_extension(uint8_t id)
+{
+    std::lock_guard<std::mutex> lock(ext_mutex_);
+
+    if (!ext_values_.erase(id))
+        return RTP_NOT_FOUND;
+
+    rtp_error_t ret = build_extension_block(ext_values_, ext_block_);
+    update_payload_size();
+    return ret;
+}
+
+size_t uvgrtp::rtp::fill_extensions(uint8_t *buffer)
+{
+    if (!buffer)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(ext_mutex_);
+
+    if (!ext_block_.empty())
+        std::memcpy(buffer, ext_block_.data(), ext_block_.size());
+
+    return ext_block_.size();
+}
+
+rtp_error_t uvgrtp::rtp::build_extension_block(const std::map<uint8_t, std::vector<uint8_t>>& values,
+    std::vector<uint8_t>& block)
+{
+    bool one_byte = true;
+    size_t size   = 0;
+
+    if (values.size() > uvgrtp::frame::RTP_EXT_MAX_ELEMENTS)
+        return RTP_MEMORY_ERROR;
+
+    /* RFC 8285 one-byte form is used when all elements can be expressed with it */
+    for (auto& ext : values) {
+        if (ext.first > 14 || ext.second.empty() || ext.second.size() > 16)
+            one_byte = false;
+    }
+
+    for (auto& ext : values)
+        size += (one_byte ? 1 : 2) + ext.second.size();
+
+    /* the extension block is expressed in 32-bit words */
+    size = (size + 3) & ~(size_t)3;
+
+    if (size > uvgrtp::frame::RTP_EXT_MAX_DATA_SIZE)
+        return RTP_MEMORY_ERROR;
+
+    block.clear();
+
+    if (values.empty())
+        return RTP_OK;
+
+    block.resize(2 * sizeof(uint16_t) + size, 0);
+
+    uint8_t *ptr = block.data();
+
+    *(uint16_t *)&ptr[0] = htons(one_byte ? uvgrtp::frame::RTP_EXT_ONE_BYTE : uvgrtp::frame::RTP_EXT_TWO_BYTE);
+    *(uint16_t *)&ptr[2] = htons((uint16_t)(size / sizeof(uint32_t)));
+    ptr += 2 * sizeof(uint16_t);
+
+    for (auto& ext : values) {
+        if (one_byte) {
+            *ptr++ = (uint8_t)((ext.first << 4) | (ext.second.size() - 1));
+        } else {
+            *ptr++ = ext.first;
+            *ptr++ = (uint8_t)ext.second.size();
+        }
+
+        if (!ext.second.empty()) {
+            std::memcpy(ptr, ext.second.data(), ext.second.size());
+            ptr += ext.second.size();
+        }
+    }
+
+    return RTP_OK;
+}
+
+/* Parse the RFC 8285 elements of the extension block of "frame" to "frame->ext_elements"
+ * The elements point to the extension data of the frame so no memory is allocated */
+static void parse_ext_elements(uvgrtp::frame::rtp_frame *frame)
+{
+    bool one_byte = false;
+    uint8_t *data = frame->ext->data;
+    size_t len    = frame->ext->len;
+    size_t off    = 0;
+
+    if (frame->ext->type == uvgrtp::frame::RTP_EXT_ONE_BYTE)
+        one_byte = true;
+    else if ((frame->ext->type & 0xfff0) != uvgrtp::frame::RTP_EXT_TWO_BYTE)
+        return;
+
+    while (off < len) {
+        uint8_t id       = 0;
+        size_t  elem_len = 0;
+
+        /* padding */
+        if (data[off] == 0) {
+            ++off;
+            continue;
+        }
+
+        if (one_byte) {
+            id       = data[off] >> 4;
+            elem_len = (size_t)(data[off] & 0x0f) + 1;
+
+            /* ID 15 terminates the processing of the block */
+            if (id == 15)
+                break;
+
+            off += 1;
+        } else {
+            if (off + 2 > len)
+                break;
+
+            id       = data[off];
+            elem_len = data[off + 1];
+            off     += 2;
+        }
+
+        if (off + elem_len > len) {
+            LOG_DEBUG("Malformed header extension element %u", id);
+            break;
+        }
+
+        if (frame->ext_count == uvgrtp::frame::RTP_EXT_MAX_ELEMENTS) {
+            LOG_DEBUG("Too many header extension elements, ignoring the rest");
+            break;
+        }
+
+        frame->ext_elements[frame->ext_count].id   = id;
+        frame->ext_elements[frame->ext_count].len  = (uint8_t)elem_len;
+        frame->ext_elements[frame->ext_count].data = data + off;
+        frame->ext_count++;
+
+        off += elem_len;
+    }
+}
+
 rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, uvgrtp::frame::rtp_frame **out)
 {
     (void)flags;
@@ -217,13 +437,34 @@ rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, u
 
     if ((*out)->header.ext) {
         LOG_DEBUG("Frame contains extension information");
-        (*out)->ext = new uvgrtp::frame::ext_header;
 
-        (*out)->ext->type    = ntohs(*(uint16_t *)&ptr[0]);
-        (*out)->ext->len     = ntohs(*(uint16_t *)&ptr[2]) * sizeof(uint32_t);
-        (*out)->ext->data    = (uint8_t *)memdup(ptr + 2 * sizeof(uint16_t), (*out)->ext->len);
-        (*out)->payload_len -= 2 * sizeof(uint16_t) + (*out)->ext->len;
-        ptr                 += 2 * sizeof(uint16_t) + (*out)->ext->len;
+        if ((*out)->payload_len < 2 * sizeof(uint16_t) ||
+            (*out)->payload_len - 2 * sizeof(uint16_t) < ntohs(*(uint16_t *)&ptr[2]) * sizeof(uint32_t)) {
+            LOG_DEBUG("Invalid frame length, extension block does not fit to the packet");
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            return RTP_GENERIC_ERROR;
+        }
+
+        uint16_t ext_type = ntohs(*(uint16_t *)&ptr[0]);
+        uint16_t ext_len  = (uint16_t)(ntohs(*(uint16_t *)&ptr[2]) * sizeof(uint32_t));
+
+        /* Extension blocks that fit inside the frame are copied there,
+         * only unusually large blocks require an allocation */
+        if (ext_len <= uvgrtp::frame::RTP_EXT_MAX_DATA_SIZE) {
+            (*out)->ext       = &(*out)->ext_inline;
+            (*out)->ext->data = (*out)->ext_data;
+            std::memcpy((*out)->ext_data, ptr + 2 * sizeof(uint16_t), ext_len);
+        } else {
+            (*out)->ext       = new uvgrtp::frame::ext_header;
+            (*out)->ext->data = (uint8_t *)memdup(ptr + 2 * sizeof(uint16_t), ext_len);
+        }
+
+        (*out)->ext->type    = ext_type;
+        (*out)->ext->len     = ext_len;
+        (*out)->payload_len -= 2 * sizeof(uint16_t) + ext_len;
+        ptr                 += 2 * sizeof(uint16_t) + ext_len;
+
+        parse_ext_elements(*out);
     }
 
     /* If padding is set to 1, the last byte of the payload indicates
@@ -231,7 +472,13 @@ rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, u
      * valid and subtract the amount of padding bytes from payload length */
     if ((*out)->header.padding) {
         LOG_DEBUG("Frame contains padding");
-        uint8_t padding_len = (*out)->payload[(*out)->payload_len - 1];
+
+        if (!(*out)->payload_len) {
+            uvgrtp::frame::dealloc_frame(*out);
+            return RTP_GENERIC_ERROR;
+        }
+
+        uint8_t padding_len = ptr[(*out)->payload_len - 1];
 
         if (!padding_len || (*out)->payload_len <= padding_len) {
             uvgrtp::frame::dealloc_frame(*out);
@@ -3,6 +3,12 @@
 #include "uvgrtp/clock.hh"
 #include "uvgrtp/util.hh"
 
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
 namespace uvgrtp {
 
     namespace frame
@@ -25,22 +31,69 @@ namespace uvgrtp {
             void inc_sent_pkts();
             void inc_sequence();
 
+            /* Change our SSRC, e.g. after a collision. The packets sent after this carry "ssrc" */
+            void set_ssrc(uint32_t ssrc);
             void set_clock_rate(size_t rate);
             void set_payload(rtp_format_t fmt);
             void set_dynamic_payload(uint8_t payload);
             void set_timestamp(uint64_t timestamp);
-            void set_payload_size(size_t payload_size);
             void set_pkt_max_delay(size_t delay);
 
+            /* Set the maximum payload size of a packet, the header extension block included
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the extension block currently set does not leave room for payload */
+            rtp_error_t set_payload_size(size_t payload_size);
+
             void fill_header(uint8_t *buffer);
             void update_sequence(uint8_t *buffer);
 
+            /* Map RFC 8285 header extension identifier "id" to "uri"
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "id" is 0, "uri" is empty or either is already mapped */
+            rtp_error_t register_extension(uint8_t id, const std::string& uri);
+
+            /* Return the identifier registered for "uri" or 0 if "uri" is not registered */
+            uint8_t get_extension_id(const std::string& uri) const;
+
+            /* Attach extension "id" with "data" to all outgoing packets
+             * until it's cleared or replaced by another call to set_extension()
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "len" is larger than 255 or "data" is nullptr and "len" is not 0
+             * Return RTP_NOT_FOUND if "id" has not been registered
+             * Return RTP_MEMORY_ERROR if the extension block would grow too large */
+            rtp_error_t set_extension(uint8_t id, const uint8_t *data, size_t len);
+
+            /* Stop sending extension "id"
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_FOUND if the extension was not set */
+            rtp_error_t clear_extension(uint8_t id);
+
+            /* Write the extension block of outgoing packets (header included) to "buffer"
+             * which must hold at least 4 + RTP_EXT_MAX_DATA_SIZE bytes
+             *
+             * Return the size of the written block, 0 if there are no active extensions */
+            size_t fill_extensions(uint8_t *buffer);
+
             /* Validates the RTP header pointed to by "packet" */
             static rtp_error_t packet_handler(ssize_t size, void *packet, int flags, frame::rtp_frame **out);
 
         private:
 
-            uint32_t ssrc_;
+            /* Serialize extension "values" to "block"
+             *
+             * Return RTP_OK on success
+             * Return RTP_MEMORY_ERROR if the values don't fit to one extension block */
+            static rtp_error_t build_extension_block(const std::map<uint8_t, std::vector<uint8_t>>& values,
+                std::vector<uint8_t>& block);
+
+            /* Update the payload size left for media after the extension block, ext_mutex_ must be held */
+            void update_payload_size();
+
+            std::atomic<uint32_t> ssrc_;
             uint32_t ts_;
             uint16_t seq_;
             uint8_t fmt_;
@@ -61,12 +114,24 @@ namespace uvgrtp {
              * (maximum amount of payload bytes when MTU is 1500) */
             size_t payload_size_;
 
+            /* Payload size minus the extension block, updated whenever either changes so that
+             * the packetizers can read it without taking ext_mutex_ for every packet */
+            std::atomic<size_t> ext_payload_size_;
+
             /* What is the maximum delay allowed for each frame
              * i.e. how long does the packet receiver wait for
              * all fragments of a frame until it's considered late and dropped
              *
              * Default value is 100ms */
             size_t delay_;
+
+            /* Registered header extensions and the extension values of outgoing packets.
+             * The extension block is serialized when the values change so
+             * it can be copied as is to each packet of a frame */
+            mutable std::mutex ext_mutex_;
+            std::map<uint8_t, std::string> ext_uris_;
+            std::map<uint8_t, std::vector<uint8_t>> ext_values_;
+            std::vector<uint8_t> ext_block_;
     };
 }
 
@@ -6,18 +6,24 @@
 #include "uvgrtp/debug.hh"
 
 
-uvgrtp::session::session(std::string cname, std::string addr):
+uvgrtp::session::session(std::string cname, std::string addr,
+    std::shared_ptr<uvgrtp::keypair_pool> keypool,
+    std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler):
 #ifdef __RTP_CRYPTO__
-    zrtp_(new uvgrtp::zrtp()),
+    zrtp_(new uvgrtp::zrtp(keypool)),
 #endif
+    keypool_(keypool),
+    rtcp_scheduler_(rtcp_scheduler),
     addr_(addr),
     laddr_(""),
     cname_(cname)
 {
 }
 
-uvgrtp::session::session(std::string cname, std::string remote_addr, std::string local_addr):
-    session(cname, remote_addr)
+uvgrtp::session::session(std::string cname, std::string remote_addr, std::string local_addr,
+    std::shared_ptr<uvgrtp::keypair_pool> keypool,
+    std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler):
+    session(cname, remote_addr, keypool, rtcp_scheduler)
 {
     laddr_ = local_addr;
 }
@@ -42,10 +48,22 @@ uvgrtp::media_stream *uvgrtp::session::create_stream(int r_port, int s_port, rtp
         return nullptr;
     }
 
+    if (flags & RCE_SRTP) {
+        if ((flags & RCE_SRTP_AES_GCM) && (flags & (RCE_SRTP_NULL_CIPHER | RCE_SRTP_KEYSIZE_192))) {
+            LOG_ERROR("AES-GCM cannot be used with NULL cipher or 192-bit keys");
+            rtp_errno = RTP_INVALID_VALUE;
+            return nullptr;
+        }
+
+        /* the flags must be adjusted before the stream is created so they are visible to the stream */
+        if (flags & RCE_SRTP_REPLAY_PROTECTION)
+            flags |= RCE_SRTP_AUTHENTICATE_RTP;
+    }
+
     if (laddr_ == "")
-        stream = new uvgrtp::media_stream(cname_, addr_, r_port, s_port, fmt, flags);
+        stream = new uvgrtp::media_stream(cname_, addr_, r_port, s_port, fmt, flags, rtcp_scheduler_);
     else
-        stream = new uvgrtp::media_stream(cname_, addr_, laddr_, r_port, s_port, fmt, flags);
+        stream = new uvgrtp::media_stream(cname_, addr_, laddr_, r_port, s_port, fmt, flags, rtcp_scheduler_);
 
     if (flags & RCE_SRTP) {
         if (!uvgrtp::crypto::enabled()) {
@@ -54,9 +72,6 @@ uvgrtp::media_stream *uvgrtp::session::create_stream(int r_port, int s_port, rtp
             return nullptr;
         }
 
-        if (flags & RCE_SRTP_REPLAY_PROTECTION)
-            flags |= RCE_SRTP_AUTHENTICATE_RTP;
-
         if (flags & RCE_SRTP_KMNGMNT_ZRTP) {
 
             if (flags & (RCE_SRTP_KEYSIZE_192 | RCE_SRTP_KEYSIZE_256)) {
@@ -64,8 +79,13 @@ uvgrtp::media_stream *uvgrtp::session::create_stream(int r_port, int s_port, rtp
                 return nullptr;
             }
 
+            if (flags & RCE_SRTP_MKI) {
+                LOG_ERROR("MKI can only be used with user-managed keys");
+                return nullptr;
+            }
+
             if (!zrtp_) {
-                zrtp_ = std::shared_ptr<uvgrtp::zrtp> (new uvgrtp::zrtp());
+                zrtp_ = std::shared_ptr<uvgrtp::zrtp> (new uvgrtp::zrtp(keypool_));
             }
 
             if (stream->init(zrtp_) != RTP_OK) {
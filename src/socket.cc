@@ -150,6 +150,21 @@ rtp_error_t uvgrtp::socket::install_handler(void *arg, packet_handler_vec handle
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::socket::install_handler(void *arg, packet_handler_vec handler, packet_handler_batch batch_handler)
+{
+    if (!handler || !batch_handler)
+        return RTP_INVALID_VALUE;
+
+    socket_packet_handler hndlr;
+
+    hndlr.arg = arg;
+    hndlr.handler = handler;
+    hndlr.batch_handler = batch_handler;
+    vec_handlers_.push_back(hndlr);
+
+    return RTP_OK;
+}
+
 rtp_error_t uvgrtp::socket::__sendto(sockaddr_in& addr, uint8_t *buf, size_t buf_len, int flags, int *bytes_sent)
 {
     int nsend = 0;
@@ -430,12 +445,20 @@ send_:
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::socket::sendto(pkt_vec& buffers, int flags)
+rtp_error_t uvgrtp::socket::call_handlers(pkt_vec& buffers)
 {
     rtp_error_t ret = RTP_OK;
 
-    for (auto& buffer : buffers) {
-        for (auto& handler : vec_handlers_) {
+    for (auto& handler : vec_handlers_) {
+        if (handler.batch_handler) {
+            if ((ret = (*handler.batch_handler)(handler.arg, buffers)) != RTP_OK) {
+                LOG_ERROR("Malformed packet");
+                return ret;
+            }
+            continue;
+        }
+
+        for (auto& buffer : buffers) {
             if ((ret = (*handler.handler)(handler.arg, buffer)) != RTP_OK) {
                 LOG_ERROR("Malformed packet");
                 return ret;
@@ -443,6 +466,16 @@ rtp_error_t uvgrtp::socket::sendto(pkt_vec& buffers, int flags)
         }
     }
 
+    return ret;
+}
+
+rtp_error_t uvgrtp::socket::sendto(pkt_vec& buffers, int flags)
+{
+    rtp_error_t ret = RTP_OK;
+
+    if ((ret = call_handlers(buffers)) != RTP_OK)
+        return ret;
+
     return __sendtov(addr_, buffers, flags, nullptr);
 }
 
@@ -450,14 +483,8 @@ rtp_error_t uvgrtp::socket::sendto(pkt_vec& buffers, int flags, int *bytes_sent)
 {
     rtp_error_t ret = RTP_OK;
 
-    for (auto& buffer : buffers) {
-        for (auto& handler : vec_handlers_) {
-            if ((ret = (*handler.handler)(handler.arg, buffer)) != RTP_OK) {
-                LOG_ERROR("Malformed packet");
-                return ret;
-            }
-        }
-    }
+    if ((ret = call_handlers(buffers)) != RTP_OK)
+        return ret;
 
     return __sendtov(addr_, buffers, flags, bytes_sent);
 }
@@ -466,14 +493,8 @@ rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, pkt_vec& buffers, int flag
 {
     rtp_error_t ret = RTP_OK;
 
-    for (auto& buffer : buffers) {
-        for (auto& handler : vec_handlers_) {
-            if ((ret = (*handler.handler)(handler.arg, buffer)) != RTP_OK) {
-                LOG_ERROR("Malformed packet");
-                return ret;
-            }
-        }
-    }
+    if ((ret = call_handlers(buffers)) != RTP_OK)
+        return ret;
 
     return __sendtov(addr, buffers, flags, nullptr);
 }
@@ -482,14 +503,8 @@ rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, pkt_vec& buffers, int flag
 {
     rtp_error_t ret = RTP_OK;
 
-    for (auto& buffer : buffers) {
-        for (auto& handler : vec_handlers_) {
-            if ((ret = (*handler.handler)(handler.arg, buffer)) != RTP_OK) {
-                LOG_ERROR("Malformed packet");
-                return ret;
-            }
-        }
-    }
+    if ((ret = call_handlers(buffers)) != RTP_OK)
+        return ret;
 
     return __sendtov(addr, buffers, flags, bytes_sent);
 }
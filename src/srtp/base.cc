@@ -3,29 +3,26 @@
 #include "uvgrtp/crypto.hh"
 #include "uvgrtp/debug.hh"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
 uvgrtp::base_srtp::base_srtp():
     srtp_ctx_(new uvgrtp::srtp_ctx_t),
-    use_null_cipher_(false)
+    use_null_cipher_(false),
+    use_aead_(false),
+    latest_index_(0),
+    kdr_(0),
+    generations_(0),
+    replay_bitmap_((UVG_REPLAY_WINDOW_SIZE + 63) / 64, 0),
+    replay_window_size_(UVG_REPLAY_WINDOW_SIZE),
+    replay_highest_(0),
+    replay_started_(false)
 {}
 
 uvgrtp::base_srtp::~base_srtp()
 {
-    if (srtp_ctx_)
-    {
-        if (srtp_ctx_->key_ctx.master.local_key)
-            delete[] srtp_ctx_->key_ctx.master.local_key;
-        if (srtp_ctx_->key_ctx.master.remote_key)
-            delete[] srtp_ctx_->key_ctx.master.remote_key;
-        if (srtp_ctx_->key_ctx.local.enc_key)
-            delete[] srtp_ctx_->key_ctx.local.enc_key;
-        if (srtp_ctx_->key_ctx.remote.enc_key)
-            delete[] srtp_ctx_->key_ctx.remote.enc_key;
-
-        delete srtp_ctx_;
-    }
+    delete srtp_ctx_;
 }
 
 bool uvgrtp::base_srtp::use_null_cipher()
@@ -33,12 +30,43 @@ bool uvgrtp::base_srtp::use_null_cipher()
     return use_null_cipher_;
 }
 
+bool uvgrtp::base_srtp::use_aead() const
+{
+    return use_aead_;
+}
+
+size_t uvgrtp::base_srtp::get_auth_tag_length(int flags)
+{
+    return (flags & RCE_SRTP_AES_GCM) ? UVG_AEAD_TAG_LENGTH : UVG_AUTH_TAG_LENGTH;
+}
+
+bool uvgrtp::base_srtp::is_rtp_authenticated(int flags)
+{
+    return flags & (RCE_SRTP_AUTHENTICATE_RTP | RCE_SRTP_AES_GCM);
+}
+
+size_t uvgrtp::base_srtp::get_mki_length(int flags)
+{
+    return (flags & RCE_SRTP_MKI) ? UVG_MKI_LENGTH : 0;
+}
+
+size_t uvgrtp::base_srtp::get_rtp_trailer_length(int flags)
+{
+    return get_mki_length(flags) + (is_rtp_authenticated(flags) ? get_auth_tag_length(flags) : 0);
+}
+
+size_t uvgrtp::base_srtp::get_rtcp_trailer_length(int flags)
+{
+    return UVG_SRTCP_INDEX_LENGTH + get_mki_length(flags) + get_auth_tag_length(flags);
+}
+
 uvgrtp::srtp_ctx_t *uvgrtp::base_srtp::get_ctx()
 {
     return srtp_ctx_;
 }
 
-rtp_error_t uvgrtp::base_srtp::derive_key(int label, uint8_t *key, uint8_t *salt, uint8_t *out, size_t out_len)
+rtp_error_t uvgrtp::base_srtp::derive_key(int label, const uint8_t *key, const uint8_t *salt, uint64_t r,
+                                          uint8_t *out, size_t out_len)
 {
     uint8_t input[UVG_IV_LENGTH]    = { 0 };
     uint8_t ks[AES256_KEY_SIZE] = { 0 };
@@ -46,22 +74,218 @@ rtp_error_t uvgrtp::base_srtp::derive_key(int label, uint8_t *key, uint8_t *salt
     memcpy(input, salt, UVG_SALT_LENGTH);
     memset(out, 0, out_len);
 
+    /* key_id = label || r, where r is 48 bits, is XORed to the end of the salt */
     input[7] ^= label;
 
+    for (int i = 0; i < 6; i++)
+        input[8 + i] ^= (uint8_t)(r >> (40 - 8 * i));
+
     uvgrtp::crypto::aes::ecb ecb(key, srtp_ctx_->n_e);
 
     for (size_t i = 0, written_len = 0; written_len < out_len; ++i, written_len += UVG_IV_LENGTH)
     {
         reinterpret_cast<uint16_t&>(input[UVG_SALT_LENGTH]) = htons(i);
         ecb.encrypt(ks, input, UVG_IV_LENGTH);
-        memcpy(out, ks, min(out_len, UVG_IV_LENGTH));
+        memcpy(out, ks, std::min(out_len - written_len, (size_t)UVG_IV_LENGTH));
         out += UVG_IV_LENGTH;
     }
 
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::base_srtp::create_iv(uint8_t *out, uint32_t ssrc, uint64_t index, uint8_t *salt)
+void uvgrtp::base_srtp::derive_session(srtp_session_ctx_t& session, const uint8_t *master_key,
+                                       const uint8_t *master_salt, uint64_t r)
+{
+    int label_enc  = SRTP_ENCRYPTION;
+    int label_auth = SRTP_AUTHENTICATION;
+    int label_salt = SRTP_SALTING;
+
+    if (srtp_ctx_->type == SRTCP) {
+        label_enc  = SRTCP_ENCRYPTION;
+        label_auth = SRTCP_AUTHENTICATION;
+        label_salt = SRTCP_SALTING;
+    }
+
+    /* AES-GCM uses a 96-bit salt. The session keys are derived
+     * with the key derivation function of RFC 3711 so the salt is zero-padded */
+    size_t salt_len = use_aead_ ? UVG_AEAD_SALT_LENGTH : UVG_SALT_LENGTH;
+
+    (void)derive_key(label_enc,  master_key, master_salt, r, session.enc_key,  srtp_ctx_->n_e);
+    (void)derive_key(label_auth, master_key, master_salt, r, session.auth_key, UVG_AUTH_LENGTH);
+    (void)derive_key(label_salt, master_key, master_salt, r, session.salt_key, salt_len);
+
+    session.r          = r;
+    session.generation = ++generations_;
+
+    create_session_crypto(session);
+}
+
+void uvgrtp::base_srtp::create_session_crypto(srtp_session_ctx_t& session)
+{
+    if (use_aead_) {
+        session.aead = std::unique_ptr<uvgrtp::crypto::aes::gcm>(
+            new uvgrtp::crypto::aes::gcm(session.enc_key, srtp_ctx_->n_e));
+        return;
+    }
+
+    session.cipher = std::unique_ptr<uvgrtp::crypto::aes::ctr>(
+        new uvgrtp::crypto::aes::ctr(session.enc_key, srtp_ctx_->n_e));
+    session.hmac   = std::unique_ptr<uvgrtp::crypto::hmac::sha1>(
+        new uvgrtp::crypto::hmac::sha1(session.auth_key, UVG_AUTH_LENGTH));
+}
+
+uint64_t uvgrtp::base_srtp::get_derivation_index(uint64_t index) const
+{
+    uint64_t kdr = kdr_;
+
+    return kdr ? index / kdr : 0;
+}
+
+uvgrtp::srtp_session_ctx_t *uvgrtp::base_srtp::get_local_session(srtp_master_ctx_t& key, uint64_t index)
+{
+    uint64_t r = get_derivation_index(index);
+
+    if (!key.local.generation || key.local.r != r)
+        derive_session(key.local, key.local_key, key.local_salt, r);
+
+    return &key.local;
+}
+
+uvgrtp::srtp_session_ctx_t *uvgrtp::base_srtp::get_remote_session(srtp_master_ctx_t& key, uint64_t index)
+{
+    uint64_t r = get_derivation_index(index);
+
+    if (!key.remote.generation || key.remote.r != r)
+        derive_session(key.remote, key.remote_key, key.remote_salt, r);
+
+    return &key.remote;
+}
+
+std::shared_ptr<uvgrtp::srtp_master_ctx_t> uvgrtp::base_srtp::find_key(uint64_t index) const
+{
+    for (auto it = keys_.rbegin(); it != keys_.rend(); ++it) {
+        if ((*it)->from <= index)
+            return *it;
+    }
+
+    /* the packet is older than any key we have, its key has already been removed */
+    return nullptr;
+}
+
+std::shared_ptr<uvgrtp::srtp_master_ctx_t> uvgrtp::base_srtp::get_local_key(uint64_t index)
+{
+    std::lock_guard<std::mutex> lock(keys_mutex_);
+
+    latest_index_ = std::max(latest_index_, index);
+
+    return find_key(index);
+}
+
+std::shared_ptr<uvgrtp::srtp_master_ctx_t> uvgrtp::base_srtp::get_remote_key(uint64_t index, uint32_t mki)
+{
+    if (!srtp_ctx_->mki_size)
+        return get_local_key(index);
+
+    std::lock_guard<std::mutex> lock(keys_mutex_);
+
+    latest_index_ = std::max(latest_index_, index);
+
+    for (auto& key : keys_) {
+        if (key->mki == mki)
+            return key;
+    }
+
+    return nullptr;
+}
+
+bool uvgrtp::base_srtp::has_keys()
+{
+    std::lock_guard<std::mutex> lock(keys_mutex_);
+
+    return !keys_.empty();
+}
+
+size_t uvgrtp::base_srtp::get_keys(std::shared_ptr<srtp_master_ctx_t> *keys)
+{
+    std::lock_guard<std::mutex> lock(keys_mutex_);
+    size_t count = 0;
+
+    for (auto it = keys_.rbegin(); it != keys_.rend() && count < UVG_MAX_MASTER_KEYS; ++it)
+        keys[count++] = *it;
+
+    return count;
+}
+
+rtp_error_t uvgrtp::base_srtp::add_master_key(uint8_t *local_key, uint8_t *remote_key,
+                                              uint8_t *local_salt, uint8_t *remote_salt,
+                                              uint32_t mki, uint64_t from)
+{
+    if (!local_key || !remote_key || !local_salt || !remote_salt)
+        return RTP_INVALID_VALUE;
+
+    auto key = std::make_shared<srtp_master_ctx_t>();
+
+    key->mki  = mki;
+    key->from = from;
+
+    memcpy(key->local_key,   local_key,   srtp_ctx_->n_e);
+    memcpy(key->remote_key,  remote_key,  srtp_ctx_->n_e);
+    memcpy(key->local_salt,  local_salt,  UVG_SALT_LENGTH);
+    memcpy(key->remote_salt, remote_salt, UVG_SALT_LENGTH);
+
+    if (use_aead_) {
+        memset(&key->local_salt[UVG_AEAD_SALT_LENGTH],  0, UVG_SALT_LENGTH - UVG_AEAD_SALT_LENGTH);
+        memset(&key->remote_salt[UVG_AEAD_SALT_LENGTH], 0, UVG_SALT_LENGTH - UVG_AEAD_SALT_LENGTH);
+    }
+
+    std::lock_guard<std::mutex> lock(keys_mutex_);
+
+    if (!keys_.empty() && keys_.back()->from > from) {
+        LOG_ERROR("Master key cannot be taken into use before the previous one");
+        return RTP_INVALID_VALUE;
+    }
+
+    for (auto& k : keys_) {
+        if (srtp_ctx_->mki_size && k->mki == mki) {
+            LOG_ERROR("Master key with MKI %u already exists", mki);
+            return RTP_INVALID_VALUE;
+        }
+    }
+
+    /* The oldest key makes room for the new one if packets are no longer expected to be
+     * protected with it: the active key and the key it replaced are kept so that late
+     * packets can still be received. If the sending or receiving thread is still
+     * using the removed key, it is released once they are done */
+    if (keys_.size() == UVG_MAX_MASTER_KEYS) {
+        size_t active = 0;
+
+        while (active + 1 < keys_.size() && keys_[active + 1]->from <= latest_index_)
+            ++active;
+
+        if (active < 2) {
+            LOG_ERROR("Master key cannot be added before the packets of the oldest key are no longer expected");
+            return RTP_NOT_READY;
+        }
+
+        keys_.erase(keys_.begin());
+    }
+
+    keys_.push_back(key);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::base_srtp::set_key_derivation_rate(uint64_t kdr)
+{
+    if (kdr > UVG_MAX_KDR || (kdr & (kdr - 1)))
+        return RTP_INVALID_VALUE;
+
+    kdr_ = kdr;
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::base_srtp::create_iv(uint8_t *out, uint32_t ssrc, uint64_t index, const uint8_t *salt)
 {
     if (!out || !salt)
         return RTP_INVALID_VALUE;
@@ -74,8 +298,9 @@ rtp_error_t uvgrtp::base_srtp::create_iv(uint8_t *out, uint32_t ssrc, uint64_t i
     ssrc = htonl(ssrc);
     memcpy(&out[4], &ssrc,  sizeof(uint32_t));
 
-    index = htonll(index);
-    memcpy(buf,     &index, sizeof(uint64_t));
+    /* write the 48-bit packet index in network byte order */
+    for (i = 0; i < 8; i++)
+        buf[i] = (uint8_t)(index >> (56 - 8 * i));
 
     for (i = 0; i < 8; i++)
         out[6 + i] ^= buf[i];
@@ -86,25 +311,93 @@ rtp_error_t uvgrtp::base_srtp::create_iv(uint8_t *out, uint32_t ssrc, uint64_t i
     return RTP_OK;
 }
 
-bool uvgrtp::base_srtp::is_replayed_packet(uint8_t *digest)
+rtp_error_t uvgrtp::base_srtp::create_aead_iv(uint8_t *out, uint32_t ssrc, uint64_t index, const uint8_t *salt)
+{
+    if (!out || !salt)
+        return RTP_INVALID_VALUE;
+
+    /* 00 00 || SSRC || 48-bit packet index (ROC || SEQ for SRTP, 0 || SRTCP index for SRTCP) */
+    memset(out, 0, UVG_AEAD_IV_LENGTH);
+
+    ssrc = htonl(ssrc);
+    memcpy(&out[2], &ssrc, sizeof(uint32_t));
+
+    for (int i = 0; i < 6; i++)
+        out[6 + i] = (uint8_t)(index >> (40 - 8 * i));
+
+    for (int i = 0; i < UVG_AEAD_IV_LENGTH; i++)
+        out[i] ^= salt[i];
+
+    return RTP_OK;
+}
+
+bool uvgrtp::base_srtp::is_replayed_packet(uint64_t index)
 {
     if (!(srtp_ctx_->flags & RCE_SRTP_REPLAY_PROTECTION))
         return false;
 
-    uint64_t truncated;
-    memcpy(&truncated, digest, sizeof(uint64_t));
+    std::lock_guard<std::mutex> lock(replay_mutex_);
+
+    if (!replay_started_ || index > replay_highest_)
+        return false;
+
+    if (replay_highest_ - index >= replay_window_size_) {
+        LOG_WARN("Packet %llu is older than the replay window, discarding!", (unsigned long long)index);
+        return true;
+    }
+
+    size_t bit = index % (replay_bitmap_.size() * 64);
 
-    if (replay_list_.find(truncated) != replay_list_.end()) {
+    if ((replay_bitmap_[bit / 64] >> (bit % 64)) & 1) {
         LOG_ERROR("Replayed packet received, discarding!");
         return true;
     }
 
-    replay_list_.insert(truncated);
     return false;
 }
 
+void uvgrtp::base_srtp::update_replay_window(uint64_t index)
+{
+    if (!(srtp_ctx_->flags & RCE_SRTP_REPLAY_PROTECTION))
+        return;
+
+    std::lock_guard<std::mutex> lock(replay_mutex_);
+
+    size_t bits = replay_bitmap_.size() * 64;
+
+    if (!replay_started_ || (index > replay_highest_ && index - replay_highest_ >= bits)) {
+        std::fill(replay_bitmap_.begin(), replay_bitmap_.end(), 0);
+        replay_highest_ = index;
+        replay_started_ = true;
+    } else if (index > replay_highest_) {
+        /* the window slides forward, forget the packets that fall out of it */
+        for (uint64_t i = replay_highest_ + 1; i < index; ++i)
+            replay_bitmap_[(i % bits) / 64] &= ~(1ULL << (i % 64));
+
+        replay_highest_ = index;
+    }
+
+    size_t bit = index % bits;
+    replay_bitmap_[bit / 64] |= (1ULL << (bit % 64));
+}
+
+rtp_error_t uvgrtp::base_srtp::set_replay_window_size(size_t size)
+{
+    if (!size)
+        return RTP_INVALID_VALUE;
+
+    std::lock_guard<std::mutex> lock(replay_mutex_);
+
+    replay_bitmap_.assign((size + 63) / 64, 0);
+    replay_window_size_ = size;
+    replay_highest_     = 0;
+    replay_started_     = false;
+
+    return RTP_OK;
+}
+
 rtp_error_t uvgrtp::base_srtp::init(int type, int flags, uint8_t* local_key, uint8_t* remote_key,
-                                    uint8_t* local_salt, uint8_t* remote_salt)
+                                    uint8_t* local_salt, uint8_t* remote_salt, uint32_t mki)
 {
     srtp_ctx_->roc  = 0;
     srtp_ctx_->rts  = 0;
@@ -113,10 +406,6 @@ rtp_error_t uvgrtp::base_srtp::init(int type, int flags, uint8_t* local_key, uin
 
     size_t key_size = get_key_size(flags);
 
-    rtp_error_t ret = RTP_OK;
-    if ((ret = set_master_keys(key_size, local_key, remote_key, local_salt, remote_salt)) != RTP_OK)
-        return ret;
-
     switch (key_size) {
         case AES128_KEY_SIZE:
             srtp_ctx_->enc  = AES_128;
@@ -131,13 +420,7 @@ rtp_error_t uvgrtp::base_srtp::init(int type, int flags, uint8_t* local_key, uin
             break;
     }
 
-    srtp_ctx_->mki_size    = 0;
-    srtp_ctx_->mki_present = false;
-    srtp_ctx_->mki         = nullptr;
-
-    srtp_ctx_->master_key  = srtp_ctx_->key_ctx.master.local_key;
-    srtp_ctx_->master_salt = srtp_ctx_->key_ctx.master.local_salt;
-    srtp_ctx_->mk_cnt      = 0;
+    srtp_ctx_->mki_size = get_mki_length(flags);
 
     srtp_ctx_->n_e = key_size;
     srtp_ctx_->n_a = UVG_HMAC_KEY_LENGTH;
@@ -146,82 +429,22 @@ rtp_error_t uvgrtp::base_srtp::init(int type, int flags, uint8_t* local_key, uin
     srtp_ctx_->replay = nullptr;
 
     use_null_cipher_  = (flags & RCE_SRTP_NULL_CIPHER);
+    use_aead_         = (flags & RCE_SRTP_AES_GCM);
     srtp_ctx_->flags  = flags;
 
-    int label_enc  = 0;
-    int label_auth = 0;
-    int label_salt = 0;
+    rtp_error_t ret = RTP_OK;
+    if ((ret = add_master_key(local_key, remote_key, local_salt, remote_salt, mki, 0)) != RTP_OK)
+        return ret;
 
-    if (type == SRTP) {
-        label_enc  = SRTP_ENCRYPTION;
-        label_auth = SRTP_AUTHENTICATION;
-        label_salt = SRTP_SALTING;
-    } else {
-        label_enc  = SRTCP_ENCRYPTION;
-        label_auth = SRTCP_AUTHENTICATION;
-        label_salt = SRTCP_SALTING;
-    }
+    /* derive the session keys of the first master key right away so the first packets are not delayed */
+    auto key = get_local_key(0);
 
-    /* Local aka encryption keys */
-    (void)derive_key(
-        label_enc,
-        srtp_ctx_->key_ctx.master.local_key,
-        srtp_ctx_->key_ctx.master.local_salt,
-        srtp_ctx_->key_ctx.local.enc_key,
-        key_size
-    );
-    (void)derive_key(
-        label_auth,
-        srtp_ctx_->key_ctx.master.local_key,
-        srtp_ctx_->key_ctx.master.local_salt,
-        srtp_ctx_->key_ctx.local.auth_key,
-        UVG_AUTH_LENGTH
-    );
-    (void)derive_key(
-        label_salt,
-        srtp_ctx_->key_ctx.master.local_key,
-        srtp_ctx_->key_ctx.master.local_salt,
-        srtp_ctx_->key_ctx.local.salt_key,
-        UVG_SALT_LENGTH
-    );
-
-    /* Remote aka decryption keys */
-    (void)derive_key(
-        label_enc,
-        srtp_ctx_->key_ctx.master.remote_key,
-        srtp_ctx_->key_ctx.master.remote_salt,
-        srtp_ctx_->key_ctx.remote.enc_key,
-        key_size
-    );
-    (void)derive_key(
-        label_auth,
-        srtp_ctx_->key_ctx.master.remote_key,
-        srtp_ctx_->key_ctx.master.remote_salt,
-        srtp_ctx_->key_ctx.remote.auth_key,
-        UVG_AUTH_LENGTH
-    );
-    (void)derive_key(
-        label_salt,
-        srtp_ctx_->key_ctx.master.remote_key,
-        srtp_ctx_->key_ctx.master.remote_salt,
-        srtp_ctx_->key_ctx.remote.salt_key,
-        UVG_SALT_LENGTH
-    );
+    (void)get_local_session(*key, 0);
+    (void)get_remote_session(*key, 0);
 
     return ret;
 }
 
-rtp_error_t uvgrtp::base_srtp::allocate_crypto_ctx(size_t key_size)
-{
-    srtp_ctx_->key_ctx.master.local_key = new uint8_t[key_size];
-    srtp_ctx_->key_ctx.master.remote_key = new uint8_t[key_size];
-
-    srtp_ctx_->key_ctx.local.enc_key = new uint8_t[key_size];
-    srtp_ctx_->key_ctx.remote.enc_key = new uint8_t[key_size];
-
-    return RTP_OK;
-}
-
 size_t uvgrtp::base_srtp::get_key_size(int flags) const
 {
     size_t key_size = AES128_KEY_SIZE;
@@ -236,21 +459,3 @@ size_t uvgrtp::base_srtp::get_key_size(int flags) const
 
     return key_size;
 }
-
-rtp_error_t uvgrtp::base_srtp::set_master_keys(size_t key_size, uint8_t* local_key, uint8_t* remote_key,
-    uint8_t* local_salt, uint8_t* remote_salt)
-{
-  if (!local_key || !remote_key || !local_salt || !remote_salt)
-    return RTP_INVALID_VALUE;
-
-  rtp_error_t ret = RTP_OK;
-  if ((ret = allocate_crypto_ctx(key_size)) != RTP_OK)
-      return ret;
-
-  memcpy(srtp_ctx_->key_ctx.master.local_key,    local_key,   key_size);
-  memcpy(srtp_ctx_->key_ctx.master.remote_key,   remote_key,  key_size);
-  memcpy(srtp_ctx_->key_ctx.master.local_salt,   local_salt,  UVG_SALT_LENGTH);
-  memcpy(srtp_ctx_->key_ctx.master.remote_salt,  remote_salt, UVG_SALT_LENGTH);
-
-  return ret;
-}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "uvgrtp/crypto.hh"
 #include "uvgrtp/util.hh"
 
 #ifdef _WIN32
@@ -11,8 +12,10 @@
 #include <arpa/inet.h>
 #endif
 
+#include <atomic>
 #include <cstdint>
-#include <unordered_set>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 
@@ -30,6 +33,13 @@ enum {
 #define UVG_IV_LENGTH           16
 #define UVG_AUTH_TAG_LENGTH     10
 #define UVG_SRTCP_INDEX_LENGTH   4
+#define UVG_AEAD_TAG_LENGTH     16 /* AES-GCM, RFC 7714 */
+#define UVG_AEAD_SALT_LENGTH    12 /* 96 bits */
+#define UVG_AEAD_IV_LENGTH      12
+#define UVG_REPLAY_WINDOW_SIZE 1024 /* packets */
+#define UVG_MKI_LENGTH           4
+#define UVG_MAX_MASTER_KEYS      4 /* the active key, the ones it replaced and the ones waiting to be used */
+#define UVG_MAX_KDR      (1 << 24) /* RFC 3711 section 4.3.1 */
 
 namespace uvgrtp {
 
@@ -60,38 +70,49 @@ namespace uvgrtp {
         SRTCP_SALTING        = 0x5
     };
 
-    /* Key context for SRTP keys,
-     * ZRTP generates two keys: one for initiator and one for responder
+    /* Session keys derived from a master key for one direction (RFC 3711 section 4.3)
+     * and the ciphers and HMAC keyed with them.
+     *
+     * The key schedule and HMAC key are reused for every packet and only the IV is set per packet.
+     * The objects keep per-packet state so only one thread may use a session at a time */
+    typedef struct srtp_session_ctx {
+        uint64_t r = 0;          /* packet index DIV key derivation rate the keys were derived for */
+        uint64_t generation = 0; /* unique number of the derivation, 0 if the keys have not been derived */
+
+        uint8_t enc_key[AES256_KEY_SIZE];
+        uint8_t auth_key[UVG_AUTH_LENGTH];
+        uint8_t salt_key[UVG_SALT_LENGTH];
+
+        std::unique_ptr<uvgrtp::crypto::aes::ctr> cipher;
+        std::unique_ptr<uvgrtp::crypto::hmac::sha1> hmac;
+
+        /* Used instead of the cipher and HMAC above if AES-GCM has been enabled */
+        std::unique_ptr<uvgrtp::crypto::aes::gcm> aead;
+    } srtp_session_ctx_t;
+
+    /* Master key context. ZRTP generates two master keys: one for initiator and
+     * one for responder, with user-managed keys both directions use the same key.
      *
      * Master key is not directly used to encrypt packets but it is used
      * to create session keys for the SRTP/SRTCP */
-    typedef struct srtp_key_ctx {
-        /* Keys negotiated by ZRTP */
-        struct {
-            /* Our master key and salt */
-            uint8_t *local_key = nullptr;
-            uint8_t local_salt[UVG_SALT_LENGTH];
-
-            /* Remote's master key and salt */
-            uint8_t *remote_key = nullptr;
-            uint8_t remote_salt[UVG_SALT_LENGTH];
-        } master;
+    typedef struct srtp_master_ctx {
+        uint32_t mki  = 0; /* master key identifier, sent in packets if RCE_SRTP_MKI is given */
+        uint64_t from = 0; /* index of the first packet protected with this key */
 
-        /* Used to encrypt/authenticate packets sent by us */
-        struct {
-            uint8_t *enc_key = nullptr;
-            uint8_t auth_key[UVG_AUTH_LENGTH];
-            uint8_t salt_key[UVG_SALT_LENGTH];
-        } local;
+        /* Our master key and salt */
+        uint8_t local_key[AES256_KEY_SIZE];
+        uint8_t local_salt[UVG_SALT_LENGTH];
 
-        /* Used to decrypt/Authenticate packets sent by remote */
-        struct {
-            uint8_t *enc_key = nullptr;
-            uint8_t auth_key[UVG_AUTH_LENGTH];
-            uint8_t salt_key[UVG_SALT_LENGTH];
-        } remote;
+        /* Remote's master key and salt */
+        uint8_t remote_key[AES256_KEY_SIZE];
+        uint8_t remote_salt[UVG_SALT_LENGTH];
 
-    } srtp_key_ctx_t;
+        /* Used to encrypt/authenticate packets sent by us */
+        srtp_session_ctx_t local;
+
+        /* Used to decrypt/authenticate packets sent by remote */
+        srtp_session_ctx_t remote;
+    } srtp_master_ctx_t;
 
     typedef struct srtp_ctx {
         int type = 0;     /* srtp or srtcp */
@@ -101,13 +122,7 @@ namespace uvgrtp {
         int enc = 0;   /* identifier for encryption algorithm */
         int hmac = 0;  /* identifier for message authentication algorithm */
 
-        bool mki_present = 0; /* is MKI present in SRTP packets */
-        size_t mki_size = 0;  /* length of the MKI field in bytes if it's present */
-        uint8_t *mki = nullptr;     /* master key identifier */
-
-        uint8_t *master_key = nullptr;  /* master key */
-        uint8_t *master_salt = nullptr; /* master salt */
-        size_t  mk_cnt = 0;       /* how many packets have been encrypted with master key */
+        size_t mki_size = 0;  /* length of the MKI field in bytes, 0 if MKI is not present */
 
         size_t n_e = 0; /* size of encryption key */
         size_t n_a = 0; /* size of hmac key */
@@ -117,8 +132,6 @@ namespace uvgrtp {
         uint8_t *replay = nullptr; /* list of recently received and authenticated SRTP packets */
 
         int flags = 0; /* context configuration flags */
-
-        srtp_key_ctx_t key_ctx;
     } srtp_ctx_t;
 
     class base_srtp {
@@ -135,28 +148,118 @@ namespace uvgrtp {
              * Return RTP_INVALID_VALUE if "key" or "salt" is nullptr
              * Return RTP_MEMORY allocation failed */
             rtp_error_t init(int type, int flags, uint8_t *local_key, uint8_t *remote_key,
-                             uint8_t *local_salt, uint8_t *remote_salt);
+                             uint8_t *local_salt, uint8_t *remote_salt, uint32_t mki = 0);
+
+            /* Add a master key that protects the packets from index "from" onwards
+             *
+             * The packets sent before "from" are protected with the key that was active before,
+             * and that key is kept for a while so late packets can still be received.
+             * If MKI is used, received packets are matched to the keys by "mki" and "from"
+             * only determines when we start to use the key.
+             *
+             * At most UVG_MAX_MASTER_KEYS keys are kept. If there is no room for the new key,
+             * the oldest key is removed unless it is the active key or the key the active key replaced.
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if a key is nullptr, if "from" is smaller than the index
+             * of the previously added key or if a key with the same MKI already exists
+             * Return RTP_NOT_READY if the oldest key is still needed */
+            rtp_error_t add_master_key(uint8_t *local_key, uint8_t *remote_key,
+                                       uint8_t *local_salt, uint8_t *remote_salt,
+                                       uint32_t mki, uint64_t from);
+
+            /* Set the key derivation rate of RFC 3711 section 4.3.1, 0 disables rekeying
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "kdr" is not a power of two or if it is larger than 2^24 */
+            rtp_error_t set_key_derivation_rate(uint64_t kdr);
 
             /* Has RTP packet encryption been disabled? */
             bool use_null_cipher();
 
+            /* Are packets protected with AES-GCM instead of AES-CM and HMAC-SHA1? */
+            bool use_aead() const;
+
+            /* Return the length of the authentication tag of packets protected according to "flags" */
+            static size_t get_auth_tag_length(int flags);
+
+            /* Return true if RTP packets protected according to "flags" carry an authentication tag */
+            static bool is_rtp_authenticated(int flags);
+
+            /* Return the length of the MKI field of packets protected according to "flags" */
+            static size_t get_mki_length(int flags);
+
+            /* Return the length of the fields (MKI and authentication tag)
+             * that follow the payload of RTP packets protected according to "flags" */
+            static size_t get_rtp_trailer_length(int flags);
+
+            /* Return the length of the fields (E-flag and SRTCP index, MKI and authentication tag)
+             * that follow the compound RTCP packets protected according to "flags" */
+            static size_t get_rtcp_trailer_length(int flags);
+
 
             /* Get reference to the SRTP context (including session keys) */
             srtp_ctx_t *get_ctx();
 
-            /* Returns true if the packet having this HMAC digest is replayed
-             * Returns false if replay protection has not been enabled */
-            bool is_replayed_packet(uint8_t *digest);
+            /* Replay protection as described in RFC 3711 section 3.3.2
+             *
+             * "index" is the packet index of SRTP (ROC || SEQ) or SRTCP (SRTCP index).
+             * is_replayed_packet() should be called before the packet is authenticated
+             * and update_replay_window() after the authentication has succeeded
+             *
+             * Return true if the packet has already been received or if it's older than the replay window
+             * Return false if the packet is new or if replay protection has not been enabled */
+            bool is_replayed_packet(uint64_t index);
+            void update_replay_window(uint64_t index);
+
+            /* Set the number of packets the replay window covers and reset the window
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "size" is 0 */
+            rtp_error_t set_replay_window_size(size_t size);
 
             size_t get_key_size(int flags) const;
 
         protected:
 
+            /* Return the master key that protects our packet "index" or nullptr
+             * if no keys have been added or the key of "index" has been removed */
+            std::shared_ptr<srtp_master_ctx_t> get_local_key(uint64_t index);
+
+            /* Return the master key of a received packet, either the key identified by "mki"
+             * or, if MKI is not used, the key that protects packet "index".
+             * Return nullptr if there is no such key */
+            std::shared_ptr<srtp_master_ctx_t> get_remote_key(uint64_t index, uint32_t mki);
+
+            /* Copy all master keys to "keys", the newest first, and return their number.
+             * "keys" must have room for UVG_MAX_MASTER_KEYS keys */
+            size_t get_keys(std::shared_ptr<srtp_master_ctx_t> *keys);
+
+            /* Return true if at least one master key has been added */
+            bool has_keys();
+
+            /* Return the key derivation index r of packet "index" (RFC 3711 section 4.3.1) */
+            uint64_t get_derivation_index(uint64_t index) const;
+
+            /* Return the session keys of "key" for packet "index". The keys are derived
+             * again if the key derivation rate says they have changed since the last packet */
+            srtp_session_ctx_t *get_local_session(srtp_master_ctx_t& key, uint64_t index);
+            srtp_session_ctx_t *get_remote_session(srtp_master_ctx_t& key, uint64_t index);
+
+            /* Create the ciphers and HMAC of "session" from its session keys */
+            void create_session_crypto(srtp_session_ctx_t& session);
+
             /* Create IV for the packet that is about to be encrypted
              *
              * Return RTP_OK on success and place the iv to "out"
              * Return RTP_INVALID_VALUE if one of the parameters is invalid */
-            rtp_error_t create_iv(uint8_t *out, uint32_t ssrc, uint64_t index, uint8_t *salt);
+            rtp_error_t create_iv(uint8_t *out, uint32_t ssrc, uint64_t index, const uint8_t *salt);
+
+            /* Create the 96-bit IV of AES-GCM (RFC 7714 sections 8.1 and 9.1)
+             *
+             * Return RTP_OK on success and place the iv to "out"
+             * Return RTP_INVALID_VALUE if one of the parameters is invalid */
+            rtp_error_t create_aead_iv(uint8_t *out, uint32_t ssrc, uint64_t index, const uint8_t *salt);
 
             /* SRTP context containing all session information and keys */
             srtp_ctx_t *srtp_ctx_;
@@ -165,19 +268,45 @@ namespace uvgrtp {
              * encrypted but other security mechanisms described in RFC 3711 may be used */
             bool use_null_cipher_;
 
+            /* AES-GCM has been enabled with RCE_SRTP_AES_GCM */
+            bool use_aead_;
+
         private:
-            rtp_error_t set_master_keys(size_t key_size, uint8_t* local_key, uint8_t* remote_key,
-                                 uint8_t* local_salt, uint8_t* remote_salt);
+            /* Derive the session keys of "session" from "master_key" and "master_salt" for
+             * key derivation index "r" and key the ciphers and HMAC with them */
+            void derive_session(srtp_session_ctx_t& session, const uint8_t *master_key,
+                                const uint8_t *master_salt, uint64_t r);
+
+            /* Return the newest key of "keys_" that protects packet "index", keys_mutex_ must be held */
+            std::shared_ptr<srtp_master_ctx_t> find_key(uint64_t index) const;
+
+            rtp_error_t derive_key(int label, const uint8_t *key, const uint8_t *salt, uint64_t r,
+                                   uint8_t *out, size_t len);
+
+            /* Master keys ordered by the index they are taken into use at. The lists are
+             * updated by the application while packets are sent and received */
+            std::vector<std::shared_ptr<srtp_master_ctx_t>> keys_;
+            std::mutex keys_mutex_;
+
+            /* The highest packet index a key has been looked up for, tells which key is active */
+            uint64_t latest_index_;
 
-            rtp_error_t derive_key(int label, uint8_t *key, uint8_t *salt, uint8_t *out, size_t len);
+            /* Key derivation rate, 0 if the session keys are derived only once */
+            std::atomic<uint64_t> kdr_;
 
-            /* Allocate space for master/session encryption keys */
-            rtp_error_t allocate_crypto_ctx(size_t key_size);
+            /* Numbers the derivations of session keys so that copies of sessions can be kept up to date */
+            std::atomic<uint64_t> generations_;
 
+            /* Replay window (separate for SRTP and SRTCP). Bit "index % bits" of the bitmap
+             * tells whether packet "index" has been received, the bitmap covers
+             * "replay_window_size_" packets before the highest received index */
+            std::vector<uint64_t> replay_bitmap_;
+            size_t replay_window_size_;
+            uint64_t replay_highest_;
+            bool replay_started_;
 
-            /* Map containing all authentication tags of received packets (separate for SRTP and SRTCP)
-             * Used to implement replay protection */
-            std::unordered_set<uint64_t> replay_list_;
+            /* the window can be resized by the application while packets are received */
+            std::mutex replay_mutex_;
     };
 }
 
@@ -1,4 +1,5 @@
 SOURCES += \
 	src/srtp/base.cc \
 	src/srtp/srtp.cc \
-	src/srtp/srtcp.cc
+	src/srtp/srtcp.cc \
+	src/srtp/worker_pool.cc
@@ -20,23 +20,44 @@ rtp_error_t uvgrtp::srtcp::handle_rtcp_encryption(int flags, uint64_t packet_num
 {
     auto ret = RTP_OK;
 
+    if (!(flags & RCE_SRTP))
+        return ret;
+
+    auto key      = get_local_key(packet_number);
+
+    if (!key) {
+        LOG_ERROR("No master key for SRTCP packet %llu", (unsigned long long)packet_number);
+        return RTP_GENERIC_ERROR;
+    }
+
+    auto session  = get_local_session(*key, packet_number);
+    auto mki_be   = htonl(key->mki);
+    size_t mki_size = srtp_ctx_->mki_size;
+
+    if (use_aead_) {
+        if ((ret = encrypt_aead(*session, ssrc, packet_number, frame, frame_size - mki_size)) == RTP_OK && mki_size)
+            memcpy(&frame[frame_size - mki_size], &mki_be, UVG_MKI_LENGTH);
+
+        return ret;
+    }
+
     /* Encrypt the packet if NULL cipher has not been enabled,
      * calculate authentication tag for the packet and add SRTCP index at the end */
-    if (flags & RCE_SRTP) {
-        if (!(RCE_SRTP & RCE_SRTP_NULL_CIPHER)) {
-            ret = encrypt(ssrc, packet_number, &frame[8], 
-                frame_size - 8 - UVG_SRTCP_INDEX_LENGTH - UVG_AUTH_TAG_LENGTH);
-            SET_FIELD_32(frame, frame_size - UVG_SRTCP_INDEX_LENGTH - UVG_AUTH_TAG_LENGTH, 
-                (1 << 31) | packet_number);
-        }
-        else {
-            SET_FIELD_32(frame, frame_size - UVG_SRTCP_INDEX_LENGTH - UVG_AUTH_TAG_LENGTH, 
-                (0 << 31) | packet_number);
-        }
+    size_t index_off = frame_size - UVG_AUTH_TAG_LENGTH - mki_size - UVG_SRTCP_INDEX_LENGTH;
 
-        if (ret == RTP_OK)
-            ret = add_auth_tag(frame, frame_size);
+    if (!(flags & RCE_SRTP_NULL_CIPHER)) {
+        ret = encrypt(*session, ssrc, packet_number, &frame[8], index_off - 8);
+        SET_FIELD_32(frame, index_off, htonl((1u << 31) | (uint32_t)(packet_number & 0x7fffffff)));
     }
+    else {
+        SET_FIELD_32(frame, index_off, htonl((0u << 31) | (uint32_t)(packet_number & 0x7fffffff)));
+    }
+
+    if (mki_size)
+        memcpy(&frame[index_off + UVG_SRTCP_INDEX_LENGTH], &mki_be, UVG_MKI_LENGTH);
+
+    if (ret == RTP_OK)
+        ret = add_auth_tag(*session, frame, frame_size);
 
     return ret;
 }
@@ -45,87 +66,202 @@ rtp_error_t uvgrtp::srtcp::handle_rtcp_decryption(int flags, uint32_t ssrc,
     uint8_t* packet, size_t packet_size)
 {
     auto ret = RTP_OK;
-    auto srtpi = (*(uint32_t*)&packet[packet_size - UVG_SRTCP_INDEX_LENGTH - UVG_AUTH_TAG_LENGTH]);
 
-    if (flags & RCE_SRTP) {
-        if ((ret = verify_auth_tag(packet, packet_size)) != RTP_OK) {
-            LOG_ERROR("Failed to verify RTCP authentication tag!");
-            return RTP_AUTH_TAG_MISMATCH;
+    if (!(flags & RCE_SRTP))
+        return ret;
+
+    size_t mki_size = srtp_ctx_->mki_size;
+    size_t tag_len  = get_auth_tag_length(flags);
+
+    if (packet_size < 8 + tag_len + UVG_SRTCP_INDEX_LENGTH + mki_size) {
+        LOG_ERROR("SRTCP packet is too small to contain an authentication tag!");
+        return RTP_INVALID_VALUE;
+    }
+
+    /* The E-flag and SRTCP index are followed by MKI and the authentication tag.
+     * With AES-GCM, the authentication tag precedes the E-flag */
+    size_t index_off = packet_size - mki_size - UVG_SRTCP_INDEX_LENGTH - (use_aead_ ? 0 : tag_len);
+
+    auto srtpi = ntohl(*(uint32_t*)&packet[index_off]);
+    uint64_t index = srtpi & 0x7fffffff;
+
+    if (is_replayed_packet(index))
+        return RTP_INVALID_VALUE;
+
+    std::shared_ptr<srtp_master_ctx_t> keys[UVG_MAX_MASTER_KEYS];
+    size_t key_count = 0;
+
+    if (mki_size) {
+        uint32_t mki = 0;
+        memcpy(&mki, &packet[index_off + UVG_SRTCP_INDEX_LENGTH], UVG_MKI_LENGTH);
+
+        keys[0] = get_remote_key(index, ntohl(mki));
+
+        if (!keys[0]) {
+            LOG_ERROR("No master key with MKI %u, discarding the SRTCP packet!", ntohl(mki));
+            return RTP_INVALID_VALUE;
+        }
+
+        key_count = 1;
+    } else {
+        /* Without MKI there is no way to know when the remote took a new master key into use.
+         * RTCP packets are sent rarely so the keys are tried from the newest to the oldest */
+        key_count = get_keys(keys);
+    }
+
+    /* AES-GCM decrypts the packet before the tag can be verified so if there are
+     * several keys to try, the ciphertext and the tag are saved for the next attempt.
+     * The buffer is kept between packets so that the common case does not allocate */
+    size_t cipher_len = index_off - 8;
+
+    if (use_aead_ && key_count > 1)
+        retry_buffer_.assign(&packet[8], &packet[8] + cipher_len);
+
+    srtp_session_ctx_t *session = nullptr;
+    ret = RTP_AUTH_TAG_MISMATCH;
+
+    for (size_t i = 0; i < key_count && ret != RTP_OK; ++i) {
+        session = get_remote_session(*keys[i], index);
+
+        if (use_aead_) {
+            if (i > 0)
+                memcpy(&packet[8], retry_buffer_.data(), cipher_len);
+
+            ret = decrypt_aead(*session, ssrc, packet, packet_size - mki_size);
+        } else {
+            ret = verify_auth_tag(*session, packet, packet_size);
         }
+    }
+
+    if (ret != RTP_OK) {
+        LOG_ERROR("Failed to verify RTCP authentication tag!");
+        return RTP_AUTH_TAG_MISMATCH;
+    }
+
+    update_replay_window(index);
 
-        if (((srtpi >> 31) & 0x1) && !(flags & RCE_SRTP_NULL_CIPHER)) {
-            if (decrypt(ssrc, srtpi & 0x7fffffff, packet, packet_size) != RTP_OK) {
-                LOG_ERROR("Failed to decrypt RTCP Sender Report");
-                return ret;
-            }
+    if (!use_aead_ && ((srtpi >> 31) & 0x1) && !(flags & RCE_SRTP_NULL_CIPHER)) {
+        if (decrypt(*session, ssrc, srtpi & 0x7fffffff, &packet[8], index_off - 8) != RTP_OK) {
+            LOG_ERROR("Failed to decrypt RTCP Sender Report");
+            return ret;
         }
     }
 
     return ret;
 }
 
-rtp_error_t uvgrtp::srtcp::encrypt(uint32_t ssrc, uint64_t seq, uint8_t *buffer, size_t len)
+rtp_error_t uvgrtp::srtcp::encrypt(srtp_session_ctx_t& session, uint32_t ssrc, uint64_t seq,
+                                   uint8_t *buffer, size_t len)
 {
     if (use_null_cipher_)
         return RTP_OK;
 
     uint8_t iv[UVG_IV_LENGTH] = { 0 };
 
-    if (create_iv(iv, ssrc, seq, srtp_ctx_->key_ctx.local.salt_key) != RTP_OK) {
+    if (create_iv(iv, ssrc, seq, session.salt_key) != RTP_OK) {
         LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
         return RTP_INVALID_VALUE;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(srtp_ctx_->key_ctx.local.enc_key, srtp_ctx_->n_e, iv);
-    ctr.encrypt(buffer, buffer, len);
+    session.cipher->set_iv(iv);
+    session.cipher->encrypt(buffer, buffer, len);
 
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::srtcp::add_auth_tag(uint8_t *buffer, size_t len)
+rtp_error_t uvgrtp::srtcp::add_auth_tag(srtp_session_ctx_t& session, uint8_t *buffer, size_t len)
 {
-    auto hmac_sha1 = uvgrtp::crypto::hmac::sha1(srtp_ctx_->key_ctx.local.auth_key, UVG_AES_KEY_LENGTH);
+    auto hmac_sha1 = session.hmac.get();
 
-    hmac_sha1.update(buffer, len - UVG_AUTH_TAG_LENGTH);
-    hmac_sha1.update((uint8_t *)&srtp_ctx_->roc, sizeof(srtp_ctx_->roc));
-    hmac_sha1.final((uint8_t *)&buffer[len - UVG_AUTH_TAG_LENGTH], UVG_AUTH_TAG_LENGTH);
+    /* SRTCP packets carry their own index so, unlike in SRTP, ROC is not authenticated. Neither is MKI */
+    hmac_sha1->update(buffer, len - UVG_AUTH_TAG_LENGTH - srtp_ctx_->mki_size);
+    hmac_sha1->final((uint8_t *)&buffer[len - UVG_AUTH_TAG_LENGTH], UVG_AUTH_TAG_LENGTH);
 
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::srtcp::verify_auth_tag(uint8_t *buffer, size_t len)
+rtp_error_t uvgrtp::srtcp::verify_auth_tag(srtp_session_ctx_t& session, uint8_t *buffer, size_t len)
 {
     uint8_t digest[10] = { 0 };
-    auto hmac_sha1     = uvgrtp::crypto::hmac::sha1(srtp_ctx_->key_ctx.remote.auth_key, UVG_AUTH_LENGTH);
+    auto hmac_sha1     = session.hmac.get();
 
-    hmac_sha1.update(buffer, len - UVG_AUTH_TAG_LENGTH);
-    hmac_sha1.final(digest, UVG_AUTH_TAG_LENGTH);
+    hmac_sha1->update(buffer, len - UVG_AUTH_TAG_LENGTH - srtp_ctx_->mki_size);
+    hmac_sha1->final(digest, UVG_AUTH_TAG_LENGTH);
 
-    if (memcmp(digest, &buffer[len - UVG_AUTH_TAG_LENGTH], UVG_AUTH_TAG_LENGTH)) {
-        LOG_ERROR("STCP authentication tag mismatch!");
+    if (memcmp(digest, &buffer[len - UVG_AUTH_TAG_LENGTH], UVG_AUTH_TAG_LENGTH))
         return RTP_AUTH_TAG_MISMATCH;
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::srtcp::decrypt(srtp_session_ctx_t& session, uint32_t ssrc, uint32_t seq,
+                                   uint8_t *buffer, size_t len)
+{
+    uint8_t iv[UVG_IV_LENGTH]  = { 0 };
+
+    if (create_iv(iv, ssrc, seq, session.salt_key) != RTP_OK) {
+        LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
+        return RTP_INVALID_VALUE;
     }
 
-    if (is_replayed_packet(digest)) {
-        LOG_ERROR("Replayed packet received, discarding!");
+    session.cipher->set_iv(iv);
+    session.cipher->decrypt(buffer, buffer, len);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::srtcp::encrypt_aead(srtp_session_ctx_t& session, uint32_t ssrc, uint64_t seq,
+                                        uint8_t *buffer, size_t size)
+{
+    uint8_t iv[UVG_AEAD_IV_LENGTH] = { 0 };
+    uint32_t index = seq & 0x7fffffff;
+    size_t enc_len = size - 8 - UVG_AEAD_TAG_LENGTH - UVG_SRTCP_INDEX_LENGTH;
+    auto gcm       = session.aead.get();
+
+    if (create_aead_iv(iv, ssrc, index, session.salt_key) != RTP_OK) {
+        LOG_ERROR("Failed to create IV, unable to encrypt the RTCP packet!");
         return RTP_INVALID_VALUE;
     }
 
+    SET_FIELD_32(buffer, size - UVG_SRTCP_INDEX_LENGTH, htonl((1u << 31) | index));
+
+    /* header and sender ssrc, and the E-flag and SRTCP index are authenticated but not encrypted */
+    gcm->encrypt_init(iv, UVG_AEAD_IV_LENGTH);
+    gcm->update_aad(buffer, 8);
+    gcm->update_aad(&buffer[size - UVG_SRTCP_INDEX_LENGTH], UVG_SRTCP_INDEX_LENGTH);
+    gcm->encrypt(&buffer[8], &buffer[8], enc_len);
+    gcm->final(&buffer[8 + enc_len], UVG_AEAD_TAG_LENGTH);
+
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::srtcp::decrypt(uint32_t ssrc, uint32_t seq, uint8_t *buffer, size_t size)
+rtp_error_t uvgrtp::srtcp::decrypt_aead(srtp_session_ctx_t& session, uint32_t ssrc, uint8_t *buffer, size_t size)
 {
-    uint8_t iv[UVG_IV_LENGTH]  = { 0 };
+    uint8_t iv[UVG_AEAD_IV_LENGTH] = { 0 };
+    uint32_t srtpi = ntohl(*(uint32_t *)&buffer[size - UVG_SRTCP_INDEX_LENGTH]);
+    uint32_t index = srtpi & 0x7fffffff;
+    size_t data_len = size - 8 - UVG_AEAD_TAG_LENGTH - UVG_SRTCP_INDEX_LENGTH;
+    auto gcm        = session.aead.get();
 
-    if (create_iv(iv, ssrc, seq, srtp_ctx_->key_ctx.remote.salt_key) != RTP_OK) {
-        LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
+    if (create_aead_iv(iv, ssrc, index, session.salt_key) != RTP_OK) {
+        LOG_ERROR("Failed to create IV, unable to decrypt the RTCP packet!");
         return RTP_INVALID_VALUE;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(srtp_ctx_->key_ctx.remote.enc_key, srtp_ctx_->n_e, iv);
+    gcm->decrypt_init(iv, UVG_AEAD_IV_LENGTH);
+
+    /* if the packet is not encrypted (E-flag is 0), the whole packet is associated data */
+    if ((srtpi >> 31) & 0x1) {
+        gcm->update_aad(buffer, 8);
+        gcm->update_aad(&buffer[size - UVG_SRTCP_INDEX_LENGTH], UVG_SRTCP_INDEX_LENGTH);
+        gcm->decrypt(&buffer[8], &buffer[8], data_len);
+    } else {
+        gcm->update_aad(buffer, 8 + data_len);
+        gcm->update_aad(&buffer[size - UVG_SRTCP_INDEX_LENGTH], UVG_SRTCP_INDEX_LENGTH);
+    }
+
+    if (!gcm->verify(&buffer[8 + data_len], UVG_AEAD_TAG_LENGTH))
+        return RTP_AUTH_TAG_MISMATCH;
 
-    /* skip header and sender ssrc */
-    ctr.decrypt(&buffer[8], &buffer[8], size - 8 - UVG_AUTH_TAG_LENGTH - UVG_SRTCP_INDEX_LENGTH);
     return RTP_OK;
 }
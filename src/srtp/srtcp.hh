@@ -26,11 +26,22 @@ namespace uvgrtp {
 
     private:
 
-        rtp_error_t encrypt(uint32_t ssrc, uint64_t seq, uint8_t* buffer, size_t len);
-        rtp_error_t decrypt(uint32_t ssrc, uint32_t seq, uint8_t* buffer, size_t len);
+        rtp_error_t encrypt(srtp_session_ctx_t& session, uint32_t ssrc, uint64_t seq, uint8_t* buffer, size_t len);
+        rtp_error_t decrypt(srtp_session_ctx_t& session, uint32_t ssrc, uint32_t seq, uint8_t* buffer, size_t len);
 
-        rtp_error_t add_auth_tag(uint8_t* buffer, size_t len);
-        rtp_error_t verify_auth_tag(uint8_t* buffer, size_t len);
+        rtp_error_t add_auth_tag(srtp_session_ctx_t& session, uint8_t* buffer, size_t len);
+
+        /* Return RTP_AUTH_TAG_MISMATCH if the packet was not protected with the keys of "session" */
+        rtp_error_t verify_auth_tag(srtp_session_ctx_t& session, uint8_t* buffer, size_t len);
+
+        /* AES-GCM (RFC 7714 section 9) protects the packet in one pass,
+         * the E-flag and SRTCP index follow the authentication tag.
+         * "len" does not include the MKI that follows the SRTCP index */
+        rtp_error_t encrypt_aead(srtp_session_ctx_t& session, uint32_t ssrc, uint64_t seq, uint8_t* buffer, size_t len);
+        rtp_error_t decrypt_aead(srtp_session_ctx_t& session, uint32_t ssrc, uint8_t* buffer, size_t len);
+
+        /* Ciphertext of the received AES-GCM packet for trying the next master key */
+        std::vector<uint8_t> retry_buffer_;
     };
 }
 
@@ -6,82 +6,173 @@
 #include "uvgrtp/debug.hh"
 #include "uvgrtp/frame.hh"
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
 
 
 #define MAX_OFF 10000
 
+/* A worker thread is given at least this many packets to protect */
+#define MIN_BATCH_PER_THREAD 16
+
 uvgrtp::srtp::srtp(int flags):base_srtp(),
-      authenticate_rtp_(flags & RCE_SRTP_AUTHENTICATE_RTP)
+      authenticate_rtp_(is_rtp_authenticated(flags)),
+      has_trailer_(get_rtp_trailer_length(flags) > 0)
 {}
 
 uvgrtp::srtp::~srtp()
 {}
 
-rtp_error_t uvgrtp::srtp::encrypt(uint32_t ssrc, uint16_t seq, uint8_t *buffer, size_t len)
+rtp_error_t uvgrtp::srtp::encrypt(srtp_session_ctx_t& session, uint32_t ssrc, uint64_t index,
+                                  uint8_t *buffer, size_t len)
 {
-    if (use_null_cipher_)
-        return RTP_OK;
-
     uint8_t iv[UVG_IV_LENGTH] = { 0 };
-    uint64_t index = (((uint64_t)srtp_ctx_->roc) << 16) + seq;
 
-    /* Sequence number has wrapped around, update Roll-over Counter */
-    if (seq == 0xffff)
-        srtp_ctx_->roc++;
+    if (create_iv(iv, ssrc, index, session.salt_key) != RTP_OK) {
+        LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
+        return RTP_INVALID_VALUE;
+    }
+
+    session.cipher->set_iv(iv);
+    session.cipher->encrypt(buffer, buffer, len);
 
-    if (create_iv(iv, ssrc, index, srtp_ctx_->key_ctx.local.salt_key) != RTP_OK) {
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::srtp::encrypt_aead(srtp_session_ctx_t& session, uint32_t ssrc, uint64_t index,
+                                       uvgrtp::buf_vec& buffers)
+{
+    uint8_t iv[UVG_AEAD_IV_LENGTH] = { 0 };
+    auto aead = session.aead.get();
+
+    if (create_aead_iv(iv, ssrc, index, session.salt_key) != RTP_OK) {
         LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
         return RTP_INVALID_VALUE;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(srtp_ctx_->key_ctx.local.enc_key, srtp_ctx_->n_e, iv);
-    ctr.encrypt(buffer, buffer, len);
+    aead->encrypt_init(iv, UVG_AEAD_IV_LENGTH);
+
+    /* RTP header (including CSRCs and the extension) is authenticated but not encrypted */
+    aead->update_aad(buffers[0].second, buffers[0].first);
+
+    for (size_t i = 1; i < buffers.size() - 1; ++i)
+        aead->encrypt(buffers[i].second, buffers[i].second, buffers[i].first);
+
+    aead->final(buffers[buffers.size() - 1].second, UVG_AEAD_TAG_LENGTH);
 
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::srtp::recv_packet_handler(void *arg, int flags, frame::rtp_frame **out)
+rtp_error_t uvgrtp::srtp::protect_packet(srtp_session_ctx_t& session, uint32_t mki,
+                                         uvgrtp::buf_vec& buffers, uint64_t index)
 {
-    (void)flags;
+    auto frame      = (uvgrtp::frame::rtp_frame *)buffers.at(0).second;
+    auto ssrc       = ntohl(frame->header.ssrc);
+    auto trailer    = buffers.at(buffers.size() - 1).second;
+    auto mki_be     = htonl(mki);
+    rtp_error_t ret = RTP_OK;
 
-    auto srtp  = (uvgrtp::srtp *)arg;
-    auto ctx   = srtp->get_ctx();
-    auto frame = *out;
+    /* With AES-GCM, MKI follows the authentication tag (RFC 7714 section 8),
+     * otherwise it precedes it (RFC 3711 section 3.1) */
+    if (use_aead_) {
+        if ((ret = encrypt_aead(session, ssrc, index, buffers)) == RTP_OK && srtp_ctx_->mki_size)
+            memcpy(&trailer[UVG_AEAD_TAG_LENGTH], &mki_be, UVG_MKI_LENGTH);
 
-    /* Calculate authentication tag for the packet and compare it against the one we received */
-    if (srtp->authenticate_rtp()) {
-        uint8_t digest[10] = { 0 };
-        auto hmac_sha1     = uvgrtp::crypto::hmac::sha1(ctx->key_ctx.remote.auth_key, UVG_AUTH_LENGTH);
+        return ret;
+    }
 
-        hmac_sha1.update(frame->dgram, frame->dgram_size - UVG_AUTH_TAG_LENGTH);
-        {
-            const uint32_t roc_be = htonl(ctx->roc);
-            hmac_sha1.update((const uint8_t *)&roc_be, sizeof(roc_be));
-        }
-        hmac_sha1.final((uint8_t *)digest, UVG_AUTH_TAG_LENGTH);
+    if (!use_null_cipher_) {
+        auto data = buffers.at(buffers.size() - (has_trailer_ ? 2 : 1));
 
-        if (memcmp(digest, &frame->dgram[frame->dgram_size - UVG_AUTH_TAG_LENGTH], UVG_AUTH_TAG_LENGTH)) {
-            LOG_ERROR("Authentication tag mismatch!");
-            return RTP_GENERIC_ERROR;
-        }
+        if ((ret = encrypt(session, ssrc, index, data.second, data.first)) != RTP_OK)
+            return ret;
+    }
 
-        if (srtp->is_replayed_packet(digest)) {
-            LOG_ERROR("Replayed packet received, discarding!");
-            return RTP_GENERIC_ERROR;
-        }
-        frame->payload_len -= UVG_AUTH_TAG_LENGTH;
+    if (srtp_ctx_->mki_size)
+        memcpy(trailer, &mki_be, UVG_MKI_LENGTH);
+
+    if (authenticate_rtp_) {
+        auto roc_be = htonl((uint32_t)(index >> 16));
+        auto hmac   = session.hmac.get();
+
+        for (size_t i = 0; i < buffers.size() - 1; ++i)
+            hmac->update((uint8_t *)buffers[i].second, buffers[i].first);
+
+        hmac->update((const uint8_t *)&roc_be, sizeof(roc_be));
+        hmac->final(&trailer[srtp_ctx_->mki_size], UVG_AUTH_TAG_LENGTH);
     }
 
-    if (srtp->use_null_cipher())
-        return RTP_PKT_NOT_HANDLED;
+    return ret;
+}
+
+rtp_error_t uvgrtp::srtp::protect_packet(uvgrtp::buf_vec& buffers, uint64_t index)
+{
+    auto key = get_local_key(index);
+
+    if (!key) {
+        LOG_ERROR("No master key for packet %llu", (unsigned long long)index);
+        return RTP_GENERIC_ERROR;
+    }
+
+    return protect_packet(*get_local_session(*key, index), key->mki, buffers, index);
+}
+
+rtp_error_t uvgrtp::srtp::decrypt_aead(srtp_session_ctx_t& session, uvgrtp::frame::rtp_frame *frame, uint64_t index)
+{
+    uint8_t iv[UVG_AEAD_IV_LENGTH] = { 0 };
+    auto gcm = session.aead.get();
+
+    if (is_replayed_packet(index))
+        return RTP_GENERIC_ERROR;
+
+    if (create_aead_iv(iv, frame->header.ssrc, index, session.salt_key) != RTP_OK) {
+        LOG_ERROR("Failed to create IV, unable to decrypt the RTP packet!");
+        return RTP_GENERIC_ERROR;
+    }
+
+    size_t hdr_len = frame->dgram_size - frame->payload_len - frame->padding_len;
+    frame->payload_len -= UVG_AEAD_TAG_LENGTH + srtp_ctx_->mki_size;
+
+    gcm->decrypt_init(iv, UVG_AEAD_IV_LENGTH);
+    gcm->update_aad(frame->dgram, hdr_len);
+    gcm->decrypt(frame->payload, frame->payload, frame->payload_len);
+
+    if (!gcm->verify(&frame->payload[frame->payload_len], UVG_AEAD_TAG_LENGTH)) {
+        LOG_ERROR("Authentication tag mismatch!");
+        return RTP_GENERIC_ERROR;
+    }
+
+    update_replay_window(index);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::srtp::recv_packet_handler(void *arg, int flags, frame::rtp_frame **out)
+{
+    (void)flags;
+
+    rtp_error_t ret = ((uvgrtp::srtp *)arg)->unprotect_packet(*out);
+
+    /* the packet must not reach the media handlers */
+    if (ret == RTP_GENERIC_ERROR) {
+        (void)uvgrtp::frame::dealloc_frame(*out);
+        *out = nullptr;
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::srtp::unprotect_packet(frame::rtp_frame *frame)
+{
+    auto ctx = srtp_ctx_;
 
     uint8_t iv[UVG_IV_LENGTH] = { 0 };
     uint16_t seq          = frame->header.seq;
     uint32_t ssrc         = frame->header.ssrc;
     uint32_t ts           = frame->header.timestamp;
     uint64_t index        = 0;
+    uint32_t mki          = 0;
 
     /* as the sequence number approaches 0xffff and is close to wrapping around,
      * special care must be taken to use correct roll-over counter as it's entirely
@@ -99,19 +190,84 @@ rtp_error_t uvgrtp::srtp::recv_packet_handler(void *arg, int flags, frame::rtp_f
     else
         index = (((uint64_t)ctx->roc) << 16) + seq;
 
+    size_t tag_len = authenticate_rtp_ ? get_auth_tag_length(ctx->flags) : 0;
+
+    if (frame->payload_len < tag_len + ctx->mki_size) {
+        LOG_ERROR("RTP packet is too small to contain an authentication tag!");
+        return RTP_GENERIC_ERROR;
+    }
+
+    if (ctx->mki_size) {
+        size_t mki_off = frame->dgram_size - ctx->mki_size;
+
+        /* without AES-GCM, MKI precedes the authentication tag */
+        if (!use_aead_)
+            mki_off -= tag_len;
+
+        memcpy(&mki, &frame->dgram[mki_off], UVG_MKI_LENGTH);
+        mki = ntohl(mki);
+    }
+
+    auto key = get_remote_key(index, mki);
+
+    if (!key) {
+        LOG_ERROR("No master key with MKI %u, discarding the packet!", mki);
+        return RTP_GENERIC_ERROR;
+    }
+
+    auto session = get_remote_session(*key, index);
+
+    if (use_aead_) {
+        /* AES-GCM verifies the authentication tag and decrypts the payload in one pass */
+        if (decrypt_aead(*session, frame, index) != RTP_OK)
+            return RTP_GENERIC_ERROR;
+    } else if (authenticate_rtp_) {
+        /* Calculate authentication tag for the packet and compare it against the one we received.
+         * The replay window is cheap to check so do it before computing the authentication tag */
+        if (is_replayed_packet(index))
+            return RTP_GENERIC_ERROR;
+
+        uint8_t digest[10] = { 0 };
+        auto hmac_sha1     = session->hmac.get();
+
+        /* MKI is not authenticated */
+        hmac_sha1->update(frame->dgram, frame->dgram_size - UVG_AUTH_TAG_LENGTH - ctx->mki_size);
+        {
+            const uint32_t roc_be = htonl((uint32_t)(index >> 16));
+            hmac_sha1->update((const uint8_t *)&roc_be, sizeof(roc_be));
+        }
+        hmac_sha1->final((uint8_t *)digest, UVG_AUTH_TAG_LENGTH);
+
+        if (memcmp(digest, &frame->dgram[frame->dgram_size - UVG_AUTH_TAG_LENGTH], UVG_AUTH_TAG_LENGTH)) {
+            LOG_ERROR("Authentication tag mismatch!");
+            return RTP_GENERIC_ERROR;
+        }
+
+        update_replay_window(index);
+        frame->payload_len -= UVG_AUTH_TAG_LENGTH + ctx->mki_size;
+    } else {
+        frame->payload_len -= ctx->mki_size;
+    }
+
     /* Sequence number has wrapped around, update Roll-over Counter */
     if (seq == 0xffff) {
         ctx->roc++;
         ctx->rts = ts;
     }
 
-    if (srtp->create_iv(iv, ssrc, index, ctx->key_ctx.remote.salt_key) != RTP_OK) {
+    if (use_aead_)
+        return RTP_PKT_MODIFIED;
+
+    if (use_null_cipher_)
+        return RTP_PKT_NOT_HANDLED;
+
+    if (create_iv(iv, ssrc, index, session->salt_key) != RTP_OK) {
         LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
         return RTP_GENERIC_ERROR;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(ctx->key_ctx.remote.enc_key, ctx->n_e, iv);
-    ctr.decrypt(frame->payload, frame->payload, frame->payload_len);
+    session->cipher->set_iv(iv);
+    session->cipher->decrypt(frame->payload, frame->payload, frame->payload_len);
 
     return RTP_PKT_MODIFIED;
 }
@@ -121,38 +277,115 @@ rtp_error_t uvgrtp::srtp::send_packet_handler(void *arg, uvgrtp::buf_vec& buffer
     auto srtp       = (uvgrtp::srtp *)arg;
     auto frame      = (uvgrtp::frame::rtp_frame *)buffers.at(0).second;
     auto ctx        = srtp->get_ctx();
-    auto off        = srtp->authenticate_rtp() ? 2 : 1;
-    auto data       = buffers.at(buffers.size() - off);
-    auto hmac_sha1  = uvgrtp::crypto::hmac::sha1(ctx->key_ctx.local.auth_key, UVG_AUTH_LENGTH);
-    auto roc_be     = htonl(ctx->roc);
+    auto seq        = ntohs(frame->header.seq);
+    uint64_t index  = (((uint64_t)ctx->roc) << 16) + seq;
     rtp_error_t ret = RTP_OK;
 
-    if (srtp->use_null_cipher())
-        goto authenticate;
-
-    ret = srtp->encrypt(
-        ntohl(frame->header.ssrc),
-        ntohs(frame->header.seq),
-        data.second,
-        data.first
-    );
-
-    if (ret != RTP_OK) {
+    if ((ret = srtp->protect_packet(buffers, index)) != RTP_OK) {
         LOG_ERROR("Failed to encrypt RTP packet!");
         return ret;
     }
 
-authenticate:
-    if (!srtp->authenticate_rtp())
+    /* Sequence number has wrapped around, update Roll-over Counter.
+     * This is done for NULL cipher too so that the packet index used for
+     * authentication and replay protection matches the one of the receiver */
+    if (seq == 0xffff)
+        ctx->roc++;
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::srtp::send_batch_handler(void *arg, uvgrtp::pkt_vec& packets)
+{
+    auto srtp = (uvgrtp::srtp *)arg;
+    auto ctx  = srtp->get_ctx();
+    auto& indices = srtp->batch_indices_;
+
+    /* The index of a packet depends on the ROC updates of the packets sent before it
+     * so the indices are assigned in order before any packet is protected */
+    indices.resize(packets.size());
+
+    for (size_t i = 0; i < packets.size(); ++i) {
+        auto frame = (uvgrtp::frame::rtp_frame *)packets[i].at(0).second;
+        auto seq   = ntohs(frame->header.seq);
+
+        indices[i] = (((uint64_t)ctx->roc) << 16) + seq;
+
+        if (seq == 0xffff)
+            ctx->roc++;
+    }
+
+    /* The workers are given one session so the batch must not cross a master key
+     * switch or a key derivation. The keys are ordered by their starting index so
+     * the first and the last packet are protected with the same key only if all are */
+    auto key     = srtp->get_local_key(indices.front());
+    bool uniform = key && key == srtp->get_local_key(indices.back()) &&
+                   srtp->get_derivation_index(indices.front()) == srtp->get_derivation_index(indices.back());
+
+    /* Small frames are not worth waking up the workers for */
+    if (!uniform || !srtp->workers_ || packets.size() < srtp->workers_->parts() * MIN_BATCH_PER_THREAD) {
+        for (size_t i = 0; i < packets.size(); ++i) {
+            if (srtp->protect_packet(packets[i], indices[i]) != RTP_OK) {
+                LOG_ERROR("Failed to encrypt RTP packet!");
+                return RTP_INVALID_VALUE;
+            }
+        }
+
         return RTP_OK;
+    }
 
-    for (size_t i = 0; i < buffers.size() - 1; ++i)
-        hmac_sha1.update((uint8_t *)buffers[i].second, buffers[i].first);
+    auto session = srtp->get_local_session(*key, indices.front());
 
-    hmac_sha1.update((const uint8_t *)&roc_be, sizeof(roc_be));
-    hmac_sha1.final((uint8_t *)buffers[buffers.size() - 1].second, UVG_AUTH_TAG_LENGTH);
+    for (auto& copy : srtp->worker_sessions_) {
+        if (copy.generation == session->generation)
+            continue;
 
-    return ret;
+        memcpy(copy.enc_key,  session->enc_key,  sizeof(copy.enc_key));
+        memcpy(copy.auth_key, session->auth_key, sizeof(copy.auth_key));
+        memcpy(copy.salt_key, session->salt_key, sizeof(copy.salt_key));
+
+        copy.r          = session->r;
+        copy.generation = session->generation;
+
+        srtp->create_session_crypto(copy);
+    }
+
+    std::atomic<int> ret(RTP_OK);
+
+    srtp->workers_->run(packets.size(), [&](size_t part, size_t begin, size_t end) {
+        auto& s = (part > 0) ? srtp->worker_sessions_[part - 1] : *session;
+
+        for (size_t i = begin; i < end; ++i) {
+            rtp_error_t r = srtp->protect_packet(s, key->mki, packets[i], indices[i]);
+
+            if (r != RTP_OK)
+                ret = r;
+        }
+    });
+
+    if (ret != RTP_OK)
+        LOG_ERROR("Failed to encrypt RTP packet!");
+
+    return (rtp_error_t)ret.load();
+}
+
+rtp_error_t uvgrtp::srtp::set_crypto_threads(size_t threads)
+{
+    if (!has_keys())
+        return RTP_NOT_INITIALIZED;
+
+    /* stop the old workers before their sessions are released */
+    workers_.reset();
+    worker_sessions_.clear();
+
+    if (!threads)
+        return RTP_OK;
+
+    /* the sessions are keyed when the workers are needed for the first time */
+    worker_sessions_.resize(threads);
+    workers_ = std::unique_ptr<uvgrtp::worker_pool>(new uvgrtp::worker_pool(threads));
+
+    return RTP_OK;
 }
 
 bool uvgrtp::srtp::authenticate_rtp() const
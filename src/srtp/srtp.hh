@@ -1,6 +1,12 @@
 #pragma once
 
 #include "base.hh"
+#include "worker_pool.hh"
+
+#include "uvgrtp/socket.hh"
+
+#include <memory>
+#include <vector>
 
 namespace uvgrtp {
 
@@ -13,15 +19,66 @@ namespace uvgrtp {
             srtp(int flags);
             ~srtp();
 
-            /* Decrypt the payload of an RTP packet and verify authentication tag (if enabled) */
+            /* Decrypt the payload of an RTP packet and verify authentication tag (if enabled).
+             * If the packet is rejected, it is deallocated and "out" is set to nullptr */
             static rtp_error_t recv_packet_handler(void *arg, int flags, frame::rtp_frame **out);
 
             /* Encrypt the payload of an RTP packet and add authentication tag (if enabled) */
             static rtp_error_t send_packet_handler(void *arg, buf_vec& buffers);
 
+            /* Encrypt the payloads and add authentication tags (if enabled) to all packets of a frame.
+             *
+             * The packet indices (ROC || SEQ) are assigned in order, after which the packets are
+             * protected independently of each other, in parallel if crypto threads have been set */
+            static rtp_error_t send_batch_handler(void *arg, pkt_vec& packets);
+
+            /* Set the number of worker threads used by send_batch_handler()
+             * in addition to the sending thread. 0 disables the worker threads
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_INITIALIZED if the SRTP context has not been initialized */
+            rtp_error_t set_crypto_threads(size_t threads);
+
         private:
-            /* TODO:  */
-            rtp_error_t encrypt(uint32_t ssrc, uint16_t seq, uint8_t* buffer, size_t len);
+            /* Verify the authentication tag (if enabled) and decrypt the payload of a received RTP packet
+             *
+             * Return RTP_PKT_MODIFIED if the packet was decrypted
+             * Return RTP_PKT_NOT_HANDLED if the payload is not encrypted
+             * Return RTP_GENERIC_ERROR if the packet has been replayed, if its key is unknown
+             * or if the authentication tag does not match */
+            rtp_error_t unprotect_packet(frame::rtp_frame *frame);
+
+            /* Encrypt the payload and add the MKI and authentication tag (if enabled) of an RTP packet
+             * with packet index "index" using the session keys and ciphers of "session"
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if IV creation fails */
+            rtp_error_t protect_packet(srtp_session_ctx_t& session, uint32_t mki, buf_vec& buffers, uint64_t index);
+
+            /* Protect an RTP packet with the master key that is active at packet index "index"
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if IV creation fails */
+            rtp_error_t protect_packet(buf_vec& buffers, uint64_t index);
+
+            /* Encrypt "len" bytes of "buffer" with AES-CM */
+            rtp_error_t encrypt(srtp_session_ctx_t& session, uint32_t ssrc, uint64_t index,
+                                uint8_t* buffer, size_t len);
+
+            /* Encrypt the payload of an RTP packet and write the authentication tag
+             * to the last buffer of "buffers" using AES-GCM (RFC 7714)
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if IV creation fails */
+            rtp_error_t encrypt_aead(srtp_session_ctx_t& session, uint32_t ssrc, uint64_t index,
+                                     buf_vec& buffers);
+
+            /* Verify the authentication tag and decrypt the payload of a received
+             * RTP packet using AES-GCM (RFC 7714)
+             *
+             * Return RTP_OK on success
+             * Return RTP_GENERIC_ERROR if the packet has been replayed or if the tag does not match */
+            rtp_error_t decrypt_aead(srtp_session_ctx_t& session, frame::rtp_frame *frame, uint64_t index);
 
             /* Has RTP packet authentication been enabled? */
             bool authenticate_rtp() const;
@@ -29,9 +86,22 @@ namespace uvgrtp {
             /* By default RTP packet authentication is disabled but by
              * giving RCE_SRTP_AUTHENTICATE_RTP to create_stream() user can enable it.
              *
-             * The authentication tag will occupy the last 8 bytes of the RTP packet */
+             * The authentication tag will occupy the last 10 bytes of the RTP packet,
+             * or the last 16 bytes if AES-GCM is used (authentication cannot be disabled then) */
             bool authenticate_rtp_;
 
+            /* Does the last buffer of a packet hold the MKI and/or the authentication tag? */
+            bool has_trailer_;
+
+            /* Copies of the local session that is used to protect the batch, one for each worker
+             * thread. The sending thread uses the session of the master key. The copies are
+             * updated when their generation no longer matches the one of the master key */
+            std::vector<srtp_session_ctx_t> worker_sessions_;
+            std::unique_ptr<uvgrtp::worker_pool> workers_;
+
+            /* Packet indices of the batch that is being protected */
+            std::vector<uint64_t> batch_indices_;
+
     };
 }
 
@@ -0,0 +1,81 @@
+#include "worker_pool.hh"
+
+uvgrtp::worker_pool::worker_pool(size_t threads):
+    task_(nullptr),
+    count_(0),
+    generation_(0),
+    pending_(0),
+    stop_(false)
+{
+    for (size_t i = 1; i <= threads; ++i)
+        threads_.emplace_back(&uvgrtp::worker_pool::worker, this, i);
+}
+
+uvgrtp::worker_pool::~worker_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+
+    for (auto& thread : threads_)
+        thread.join();
+}
+
+size_t uvgrtp::worker_pool::parts() const
+{
+    return threads_.size() + 1;
+}
+
+void uvgrtp::worker_pool::run(size_t count, const std::function<void(size_t, size_t, size_t)>& task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        task_    = &task;
+        count_   = count;
+        pending_ = threads_.size();
+        ++generation_;
+    }
+    start_cv_.notify_all();
+
+    if (count / parts() > 0)
+        task(0, 0, count / parts());
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    done_cv_.wait(lock, [this] { return pending_ == 0; });
+    task_ = nullptr;
+}
+
+void uvgrtp::worker_pool::worker(size_t part)
+{
+    size_t generation = 0;
+
+    while (true) {
+        const std::function<void(size_t, size_t, size_t)> *task = nullptr;
+        size_t count = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            start_cv_.wait(lock, [&] { return stop_ || generation_ != generation; });
+
+            if (stop_)
+                return;
+
+            generation = generation_;
+            task       = task_;
+            count      = count_;
+        }
+
+        size_t begin = count * part / parts();
+        size_t end   = count * (part + 1) / parts();
+
+        if (begin < end)
+            (*task)(part, begin, end);
+
+        std::lock_guard<std::mutex> lock(mtx_);
+
+        if (--pending_ == 0)
+            done_cv_.notify_one();
+    }
+}
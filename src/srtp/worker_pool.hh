@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* A small pool of threads that process a batch of independent items together with
+     * the calling thread. Used to spread the cryptographic work of a large frame
+     * (e.g. an intra frame of hundreds of packets) over multiple cores. */
+    class worker_pool {
+        public:
+            /* Create "threads" worker threads. The calling thread of run() participates too
+             * so the batch is split to "threads + 1" parts */
+            worker_pool(size_t threads);
+            ~worker_pool();
+
+            /* Number of parts a batch is split to */
+            size_t parts() const;
+
+            /* Split items [0, count) into parts() contiguous ranges and call
+             * task(part, begin, end) for each range. Part 0 is processed by the calling thread
+             * and the other parts by the worker threads. Returns when all parts are done */
+            void run(size_t count, const std::function<void(size_t, size_t, size_t)>& task);
+
+        private:
+            void worker(size_t part);
+
+            std::vector<std::thread> threads_;
+
+            std::mutex mtx_;
+            std::condition_variable start_cv_;
+            std::condition_variable done_cv_;
+
+            const std::function<void(size_t, size_t, size_t)> *task_;
+            size_t count_;
+            size_t generation_;
+            size_t pending_;
+            bool stop_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -6,6 +6,7 @@
 #include "zrtp/dh_kxchng.hh"
 #include "zrtp/hello.hh"
 #include "zrtp/hello_ack.hh"
+#include "zrtp/keypair_pool.hh"
 
 #include "random.hh"
 
@@ -15,6 +16,7 @@
 
 
 
+#include <algorithm>
 #include <cstring>
 #include <thread>
 
@@ -27,18 +29,26 @@ using namespace uvgrtp::zrtp_msg;
 
 #define ZRTP_VERSION 110
 
-uvgrtp::zrtp::zrtp():
+uvgrtp::zrtp::zrtp(std::shared_ptr<uvgrtp::keypair_pool> keypool):
     initialized_(false),
-    receiver_()
+    receiver_(),
+    next_ticket_(0),
+    serving_(0),
+    finished_(0),
+    keypool_(keypool)
 {
     cctx_.sha256 = new uvgrtp::crypto::sha256;
     cctx_.dh     = new uvgrtp::crypto::dh;
+    cctx_.ec25   = new uvgrtp::crypto::ecdh::p256;
+    cctx_.e255   = new uvgrtp::crypto::ecdh::x25519;
 }
 
 uvgrtp::zrtp::~zrtp()
 {
     delete cctx_.sha256;
     delete cctx_.dh;
+    delete cctx_.ec25;
+    delete cctx_.e255;
 
     if (session_.r_msg.commit.second)
         delete[] session_.r_msg.commit.second;
@@ -72,7 +82,12 @@ void uvgrtp::zrtp::generate_zid()
  */
 void uvgrtp::zrtp::derive_key(const char *label, uint32_t key_len, uint8_t *out_key)
 {
-    auto hmac_sha256 = uvgrtp::crypto::hmac::sha256(session_.secrets.s0, 32);
+    derive_key(session_.secrets.s0, label, key_len, out_key);
+}
+
+void uvgrtp::zrtp::derive_key(const uint8_t *ki, const char *label, uint32_t key_len, uint8_t *out_key)
+{
+    auto hmac_sha256 = uvgrtp::crypto::hmac::sha256((uint8_t *)ki, 32);
     uint8_t tmp[32]  = { 0 };
     uint32_t length  = htonl(key_len);
     uint32_t counter = 0x1;
@@ -107,9 +122,6 @@ void uvgrtp::zrtp::derive_key(const char *label, uint32_t key_len, uint8_t *out_
 
 void uvgrtp::zrtp::generate_secrets()
 {
-    cctx_.dh->generate_keys();
-    cctx_.dh->get_pk(session_.dh_ctx.public_key, 384);
-
     /* uvgRTP does not support Preshared mode (for now at least) so
      * there will be no shared secrets between the endpoints.
      *
@@ -121,10 +133,95 @@ void uvgrtp::zrtp::generate_secrets()
     uvgrtp::crypto::random::generate_random(session_.secrets.rpbx, 32);
 }
 
-void uvgrtp::zrtp::generate_shared_secrets_dh()
+uint32_t uvgrtp::zrtp::select_key_agreement()
+{
+    auto& r_types = session_.capabilities.key_agreements;
+
+    for (auto& type : session_.key_agreements) {
+        if (std::find(r_types.begin(), r_types.end(), type) != r_types.end())
+            return type;
+    }
+
+    /* DH3k is mandatory so remote must support it even if we did not offer it */
+    return DH3k;
+}
+
+/* Replace "keys" with a key pair taken from the pool or, if there was none, generate new keys */
+template <typename T>
+static void renew_keys(T *&keys, std::unique_ptr<T> pooled)
 {
-    cctx_.dh->set_remote_pk(session_.dh_ctx.remote_public, 384);
-    cctx_.dh->get_shared_secret(session_.dh_ctx.dh_result, 384);
+    if (pooled) {
+        delete keys;
+        keys = pooled.release();
+    } else {
+        keys->generate_keys();
+    }
+}
+
+rtp_error_t uvgrtp::zrtp::generate_keys(uint32_t key_agreement)
+{
+    zrtp_dh_ctx_t& ctx = session_.dh_ctx;
+
+    switch (key_agreement) {
+        case DH3k:
+            ctx.pk_len     = 384;
+            ctx.result_len = 384;
+
+            renew_keys(cctx_.dh, keypool_ ? keypool_->take_dh() : nullptr);
+            cctx_.dh->get_pk(ctx.public_key, ctx.pk_len);
+            break;
+
+        case EC25:
+            ctx.pk_len     = uvgrtp::crypto::ecdh::p256::PK_SIZE;
+            ctx.result_len = uvgrtp::crypto::ecdh::p256::SS_SIZE;
+
+            renew_keys(cctx_.ec25, keypool_ ? keypool_->take_p256() : nullptr);
+            cctx_.ec25->get_pk(ctx.public_key, ctx.pk_len);
+            break;
+
+        case E255:
+            ctx.pk_len     = uvgrtp::crypto::ecdh::x25519::PK_SIZE;
+            ctx.result_len = uvgrtp::crypto::ecdh::x25519::SS_SIZE;
+
+            renew_keys(cctx_.e255, keypool_ ? keypool_->take_x25519() : nullptr);
+            cctx_.e255->get_pk(ctx.public_key, ctx.pk_len);
+            break;
+
+        default:
+            LOG_ERROR("Key agreement type 0x%x is not supported!", key_agreement);
+            return RTP_NOT_SUPPORTED;
+    }
+
+    ctx.type = key_agreement;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::zrtp::generate_shared_secrets_dh()
+{
+    zrtp_dh_ctx_t& ctx = session_.dh_ctx;
+    bool valid         = true;
+
+    switch (ctx.type) {
+        case DH3k:
+            cctx_.dh->set_remote_pk(ctx.remote_public, ctx.pk_len);
+            cctx_.dh->get_shared_secret(ctx.dh_result, ctx.result_len);
+            break;
+
+        case EC25:
+            valid = cctx_.ec25->set_remote_pk(ctx.remote_public, ctx.pk_len) &&
+                    cctx_.ec25->get_shared_secret(ctx.dh_result, ctx.result_len);
+            break;
+
+        case E255:
+            valid = cctx_.e255->set_remote_pk(ctx.remote_public, ctx.pk_len) &&
+                    cctx_.e255->get_shared_secret(ctx.dh_result, ctx.result_len);
+            break;
+    }
+
+    if (!valid) {
+        LOG_ERROR("Remote sent an invalid public value, session cannot continue");
+        return RTP_INVALID_VALUE;
+    }
 
     /* Section 4.4.1.4, calculation of total_hash includes:
      *    - Hello   (responder)
@@ -165,7 +262,7 @@ void uvgrtp::zrtp::generate_shared_secrets_dh()
     const char *kdf = "ZRTP-HMAC-KDF";
 
     cctx_.sha256->update((uint8_t *)&value,                    sizeof(value));              /* counter */
-    cctx_.sha256->update((uint8_t *)session_.dh_ctx.dh_result, sizeof(session_.dh_ctx.dh_result));
+    cctx_.sha256->update((uint8_t *)session_.dh_ctx.dh_result, session_.dh_ctx.result_len);
     cctx_.sha256->update((uint8_t *)kdf,                       13);
 
     if (session_.role == INITIATOR) {
@@ -191,8 +288,14 @@ void uvgrtp::zrtp::generate_shared_secrets_dh()
     derive_key("ZRTP Session Key", 256, session_.key_ctx.zrtp_sess_key);
     derive_key("SAS",              256, session_.key_ctx.sas_hash); /* TODO: crc32? */
 
-    /* Finally derive ZRTP keys and HMAC keys
-     * which are used to encrypt and authenticate Confirm messages */
+    derive_confirm_keys();
+
+    return RTP_OK;
+}
+
+void uvgrtp::zrtp::derive_confirm_keys()
+{
+    /* ZRTP keys and HMAC keys are used to encrypt and authenticate Confirm messages */
     derive_key("Initiator ZRTP key", 128, session_.key_ctx.zrtp_keyi);
     derive_key("Responder ZRTP key", 128, session_.key_ctx.zrtp_keyr);
     derive_key("Initiator HMAC key", 256, session_.key_ctx.hmac_keyi);
@@ -212,33 +315,14 @@ void uvgrtp::zrtp::generate_shared_secrets_msm()
 
     /* Finally calculate s0 which is considered to be the final keying material (Section 4.4.3.2)
      *
-     * It consist of the following information:
-     *    - "ZRTP MSK"
-     *    - ZID of initiator
-     *    - ZID of responder
-     *    - total hash (calculated above)
-     *    - negotiated hash length (256)
-     */
-    uint32_t length = htonl(256);
-    const char *kdf = "ZRTP MSK";
-
-    cctx_.sha256->update((uint8_t *)kdf, strlen(kdf));
-
-    if (session_.role == INITIATOR) {
-        cctx_.sha256->update((uint8_t *)session_.o_zid, 12);
-        cctx_.sha256->update((uint8_t *)session_.r_zid, 12);
-    } else {
-        cctx_.sha256->update((uint8_t *)session_.r_zid, 12);
-        cctx_.sha256->update((uint8_t *)session_.o_zid, 12);
-    }
-
-    cctx_.sha256->update((uint8_t *)session_.hash_ctx.total_hash, sizeof(session_.hash_ctx.total_hash));
-    cctx_.sha256->update((uint8_t *)&length, sizeof(length));
-
-    /* Calculate digest for s0
+     * s0 = KDF(ZRTPSess, "ZRTP MSK", ZIDi || ZIDr || total_hash, 256)
      *
-     * Caller can now generate SRTP session keys for the media stream */
-    cctx_.sha256->final((uint8_t *)session_.secrets.s0);
+     * The ZRTP Session Key of the DH handshake ties the stream to the session and
+     * the total hash makes the keys of each stream different */
+    derive_key(session_.key_ctx.zrtp_sess_key, "ZRTP MSK", 256, session_.secrets.s0);
+
+    /* Caller can now generate SRTP session keys for the media stream */
+    derive_confirm_keys();
 }
 
 rtp_error_t uvgrtp::zrtp::verify_hash(uint8_t *key, uint8_t *buf, size_t len, uint64_t mac)
@@ -268,11 +352,11 @@ rtp_error_t uvgrtp::zrtp::validate_session()
         cctx_.sha256->final(hashes[i]);
     }
 
-    /* Hello message */
+    /* Hello message, the MAC covers the algorithm lists too */
     if (RTP_INVALID_VALUE == verify_hash(
             (uint8_t *)hashes[2],
             (uint8_t *)session_.r_msg.hello.second,
-            81,
+            session_.r_msg.hello.first - 8 - 4,
             session_.hash_ctx.r_mac[3]
         ))
     {
@@ -295,8 +379,8 @@ rtp_error_t uvgrtp::zrtp::validate_session()
         }
     }
 
-    /* DHPart1/DHPart2 message */
-    if (RTP_INVALID_VALUE == verify_hash(
+    /* DHPart1/DHPart2 message, not sent in Multistream Mode */
+    if (session_.key_agreement_type != MULT && RTP_INVALID_VALUE == verify_hash(
             (uint8_t *)hashes[0],
             (uint8_t *)session_.r_msg.dh.second,
             session_.r_msg.dh.first - 8 - 4,
@@ -418,6 +502,12 @@ rtp_error_t uvgrtp::zrtp::init_session(int key_agreement)
     session_.key_agreement_type = key_agreement;
     session_.sas_type           = B32;
 
+    /* AES-GCM is selected only if both participants offered it in their Hello messages */
+    auto& r_tags = session_.capabilities.auth_tags;
+
+    if (session_.offer_aead && std::find(r_tags.begin(), r_tags.end(), GC16) != r_tags.end())
+        session_.auth_tag_type = GC16;
+
     int type        = 0;
     int rto         = 0;
     rtp_error_t ret = RTP_OK;
@@ -459,6 +549,9 @@ rtp_error_t uvgrtp::zrtp::init_session(int key_agreement)
                     session_.role = RESPONDER;
                     return RTP_OK;
                 }
+
+                /* we remain the initiator so our Commit, not remote's, decides the key agreement */
+                session_.key_agreement_type = key_agreement;
             } else if (type == ZRTP_FT_DH_PART1 || type == ZRTP_FT_CONFIRM1) {
                 return RTP_OK;
             }
@@ -495,9 +588,7 @@ rtp_error_t uvgrtp::zrtp::dh_part1()
 
                 /* parse_msg() above extracted the public key of remote and saved it to session_.
                  * Now we must generate shared secrets (DHResult, total_hash, and s0) */
-                generate_shared_secrets_dh();
-
-                return RTP_OK;
+                return generate_shared_secrets_dh();
             }
         }
 
@@ -522,7 +613,8 @@ rtp_error_t uvgrtp::zrtp::dh_part2()
 
     /* parse_msg() above extracted the public key of remote and saved it to session_.
      * Now we must generate shared secrets (DHResult, total_hash, and s0) */
-    generate_shared_secrets_dh();
+    if ((ret = generate_shared_secrets_dh()) != RTP_OK)
+        return ret;
 
     for (int i = 0; i < 10; ++i) {
         if ((ret = dhpart.send_msg(socket_, addr_)) != RTP_OK) {
@@ -617,10 +709,18 @@ rtp_error_t uvgrtp::zrtp::initiator_finalize_session()
     return RTP_TIMEOUT;
 }
 
-rtp_error_t uvgrtp::zrtp::init(uint32_t ssrc, std::shared_ptr<uvgrtp::socket> socket, sockaddr_in& addr)
+rtp_error_t uvgrtp::zrtp::init(uint32_t ssrc, std::shared_ptr<uvgrtp::socket> socket, sockaddr_in& addr, int flags)
 {
     std::lock_guard<std::mutex> lock(zrtp_mtx_);
 
+    session_.offer_aead = (flags & RCE_SRTP_AES_GCM);
+
+    /* The elliptic curve key agreements are an order of magnitude faster than DH3k */
+    if (flags & RCE_ZRTP_DH3K_ONLY)
+        session_.key_agreements = { DH3k };
+    else
+        session_.key_agreements = { E255, EC25, DH3k };
+
     if (!initialized_)
         return init_dhm(ssrc, socket, addr);
     return init_msm(ssrc, socket, addr);
@@ -633,7 +733,8 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
     /* TODO: set all fields initially to zero */
     memset(session_.hash_ctx.o_hvi, 0, sizeof(session_.hash_ctx.o_hvi));
 
-    /* Generate ZID and random data for the retained secrets */
+    /* Generate ZID and random data for the retained secrets. The key pair is generated
+     * once remote's Hello has told which key agreement types it supports */
     generate_zid();
     generate_secrets();
 
@@ -655,6 +756,11 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
         return ret;
     }
 
+    uint32_t key_agreement = select_key_agreement();
+
+    if ((ret = generate_keys(key_agreement)) != RTP_OK)
+        return ret;
+
     /* After begin_session() we have remote's Hello message and we can craft
      * DHPart2 in the hopes that we're the Initiator.
      *
@@ -680,7 +786,7 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
      *
      * init_session() will exchange the Commit messages and select roles for the
      * participants (initiator/responder) based on rules determined in RFC 6189 */
-    if ((ret = init_session(DH3k)) != RTP_OK) {
+    if ((ret = init_session(key_agreement)) != RTP_OK) {
         LOG_ERROR("Could not agree on ZRTP session parameters or roles of participants!");
         return ret;
     }
@@ -699,6 +805,14 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
         }
 
     } else {
+        /* Remote's Commit may have selected another key agreement type than we
+         * anticipated, in which case our key pair must be generated again */
+        if (session_.key_agreement_type != session_.dh_ctx.type &&
+            (ret = generate_keys(session_.key_agreement_type)) != RTP_OK) {
+            LOG_ERROR("Remote selected a key agreement type that we do not support");
+            return ret;
+        }
+
         if ((ret = dh_part1()) != RTP_OK) {
             LOG_ERROR("Failed to perform Diffie-Hellman key exchange Part1");
             return ret;
@@ -710,6 +824,8 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
         }
     }
 
+    LOG_DEBUG("Key agreement %.4s completed", (const char *)&session_.key_agreement_type);
+
     /* ZRTP has been initialized using DHMode */
     initialized_ = true;
 
@@ -726,6 +842,13 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
 rtp_error_t uvgrtp::zrtp::init_msm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket> socket, sockaddr_in& addr)
 {
     rtp_error_t ret;
+    uint8_t dh_zid[12];
+
+    memcpy(dh_zid, session_.r_zid, sizeof(dh_zid));
+    memset(session_.hash_ctx.o_hvi, 0, sizeof(session_.hash_ctx.o_hvi));
+
+    /* Every stream has its own hash chain (Section 9 of RFC 6189) */
+    init_session_hashes();
 
     socket_ = socket;
     addr_   = addr;
@@ -738,6 +861,12 @@ rtp_error_t uvgrtp::zrtp::init_msm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
         return ret;
     }
 
+    /* The ZRTP Session Key is only shared with the endpoint of the DH handshake */
+    if (memcmp(dh_zid, session_.r_zid, sizeof(dh_zid))) {
+        LOG_ERROR("Multistream Mode handshake with a different endpoint than the DH handshake");
+        return RTP_INVALID_VALUE;
+    }
+
     if ((ret = init_session(MULT)) != RTP_OK) {
         LOG_ERROR("Could not agree on ZRTP session parameters or roles of participants!");
         return ret;
@@ -762,6 +891,60 @@ rtp_error_t uvgrtp::zrtp::init_msm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
     return RTP_OK;
 }
 
+uint64_t uvgrtp::zrtp::take_ticket()
+{
+    std::lock_guard<std::mutex> lock(turn_mtx_);
+
+    if (next_ticket_ == finished_)
+        started_ = std::chrono::steady_clock::now();
+
+    return next_ticket_++;
+}
+
+void uvgrtp::zrtp::wait_turn(uint64_t ticket)
+{
+    std::unique_lock<std::mutex> lock(turn_mtx_);
+    turn_cv_.wait(lock, [this, ticket] { return serving_ == ticket || initialized_; });
+}
+
+void uvgrtp::zrtp::end_turn()
+{
+    {
+        std::lock_guard<std::mutex> lock(turn_mtx_);
+        ++serving_;
+
+        if (++finished_ == next_ticket_) {
+            LOG_DEBUG("ZRTP handshakes of %llu streams finished in %lld ms", (unsigned long long)finished_,
+                (long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - started_).count());
+        }
+    }
+    turn_cv_.notify_all();
+}
+
+std::shared_ptr<uvgrtp::zrtp> uvgrtp::zrtp::multistream()
+{
+    if (!initialized_)
+        return nullptr;
+
+    auto stream = std::shared_ptr<uvgrtp::zrtp>(new uvgrtp::zrtp(nullptr));
+
+    /* the DH handshake has completed so these do not change anymore */
+    memcpy(stream->session_.o_zid, session_.o_zid, sizeof(session_.o_zid));
+    memcpy(stream->session_.r_zid, session_.r_zid, sizeof(session_.r_zid));
+    memcpy(stream->session_.key_ctx.zrtp_sess_key, session_.key_ctx.zrtp_sess_key,
+           sizeof(session_.key_ctx.zrtp_sess_key));
+
+    stream->initialized_ = true;
+
+    return stream;
+}
+
+bool uvgrtp::zrtp::aead_negotiated() const
+{
+    return session_.auth_tag_type == GC16;
+}
+
 rtp_error_t uvgrtp::zrtp::get_srtp_keys(
     uint8_t *our_mkey,    uint32_t okey_len,
     uint8_t *their_mkey,  uint32_t tkey_len,
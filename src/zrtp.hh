@@ -13,6 +13,9 @@
 #include <arpa/inet.h>
 #endif
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <vector>
 #include <memory>
@@ -31,20 +34,50 @@ namespace uvgrtp {
         RESPONDER
     };
 
+    class keypair_pool;
+
     class zrtp {
         public:
-            zrtp();
+            /* "keypool" provides key pairs generated ahead of time, it may be nullptr */
+            zrtp(std::shared_ptr<uvgrtp::keypair_pool> keypool);
             ~zrtp();
 
             /* Initialize ZRTP for a multimedia session
              *
              * If this the first ZRTP session initialization for this object,
              * ZRTP will perform DHMode initialization, otherwise Multistream Mode
-             * initialization is performed.
+             * initialization is performed. Objects returned by multistream() always
+             * perform Multistream Mode initialization.
+             *
+             * "flags" are the RCE_* flags of the media stream. If RCE_SRTP_AES_GCM is given,
+             * AES-GCM is offered to remote and aead_negotiated() tells whether it was selected
              *
              * Return RTP_OK on success
              * Return RTP_TIMEOUT if remote did not send messages in timely manner */
-            rtp_error_t init(uint32_t ssrc, std::shared_ptr<uvgrtp::socket> socket, sockaddr_in& addr);
+            rtp_error_t init(uint32_t ssrc, std::shared_ptr<uvgrtp::socket> socket, sockaddr_in& addr, int flags);
+
+            /* The first media stream of a session uses Diffie-Hellman Mode and the rest use
+             * Multistream Mode, which requires the ZRTP Session Key of the DH handshake.
+             *
+             * take_ticket() reserves a place in the queue in the order in which the streams
+             * were created, wait_turn() blocks until either it is the caller's turn or the DH
+             * handshake has completed and end_turn() lets the next stream continue. Only the DH
+             * handshake is serialized: once it is done, every waiting stream continues at once and
+             * runs its Multistream handshake concurrently with the others using multistream().
+             * Each ticket must be given to wait_turn() and end_turn() once */
+            uint64_t take_ticket();
+            void wait_turn(uint64_t ticket);
+            void end_turn();
+
+            /* Return the ZRTP state for the Multistream Mode handshake of one more media stream
+             * of the session or nullptr if the DH handshake has not completed yet.
+             *
+             * The returned object shares only the ZIDs and the ZRTP Session Key with this one,
+             * so the handshakes of different streams can be performed concurrently */
+            std::shared_ptr<zrtp> multistream();
+
+            /* Return true if the session that was just initialized selected AES-GCM for SRTP */
+            bool aead_negotiated() const;
 
             /* Get SRTP keys for the session that was just initialized
              *
@@ -88,12 +121,26 @@ namespace uvgrtp {
             /* Generate zid for this ZRTP instance. ZID is a unique, 96-bit long ID */
             void generate_zid();
 
-            /* Create private/public key pair and generate random values for retained secrets */
+            /* Generate random values for retained secrets */
             void generate_secrets();
 
+            /* Select the key agreement type for the session: the first type in our
+             * preference list that remote also listed in its Hello message */
+            uint32_t select_key_agreement();
+
+            /* Create private/public key pair for "key_agreement" (DH3k, EC25 or E255)
+             * or take one from the key pair pool if there is one ready
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the key agreement type is not supported */
+            rtp_error_t generate_keys(uint32_t key_agreement);
+
             /* Calculate DHResult, total_hash, and s0
-             * according to rules defined in RFC 6189 for Diffie-Hellman mode*/
-            void generate_shared_secrets_dh();
+             * according to rules defined in RFC 6189 for Diffie-Hellman mode
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the public value of remote is not valid */
+            rtp_error_t generate_shared_secrets_dh();
 
             /* Calculate shared secrets for Multistream Mode */
             void generate_shared_secrets_msm();
@@ -107,6 +154,12 @@ namespace uvgrtp {
             /* Derive new key using s0 as HMAC key */
             void derive_key(const char *label, uint32_t key_len, uint8_t *key);
 
+            /* Derive new key using "ki" as HMAC key (the ZRTP KDF of Section 4.5.1) */
+            void derive_key(const uint8_t *ki, const char *label, uint32_t key_len, uint8_t *key);
+
+            /* Derive the keys that protect the Confirm messages from s0 */
+            void derive_confirm_keys();
+
             /* Being the ZRTP session by sending a Hello message to remote,
              * and responding to remote's Hello message using HelloAck message
              *
@@ -162,7 +215,7 @@ namespace uvgrtp {
             sockaddr_in addr_;
 
             /* Has the ZRTP connection been initialized using DH */
-            bool initialized_;
+            std::atomic<bool> initialized_;
 
             /* Our own and remote capability structs */
             zrtp_capab_t capab_;
@@ -175,6 +228,19 @@ namespace uvgrtp {
             zrtp_session_t session_;
 
             std::mutex zrtp_mtx_;
+
+            /* Queue of media streams waiting for their handshake */
+            std::mutex turn_mtx_;
+            std::condition_variable turn_cv_;
+            uint64_t next_ticket_;
+            uint64_t serving_;
+
+            /* For reporting how long keying all the streams of the session took */
+            uint64_t finished_;
+            std::chrono::steady_clock::time_point started_;
+
+            /* Ephemeral key pairs generated ahead of time, nullptr if not in use */
+            std::shared_ptr<uvgrtp::keypair_pool> keypool_;
     };
 }
 
@@ -92,7 +92,11 @@ namespace uvgrtp {
             HS32 = 0x32335348,
             HS80 = 0x30385348,
             SK32 = 0x32334b53,
-            SK64 = 0x34364b53
+            SK64 = 0x34364b53,
+
+            /* AES-GCM with a 16-byte tag (RFC 7714). This type is not registered
+             * in RFC 6189 and is only understood by other uvgRTP instances */
+            GC16 = 0x36314347
         };
 
         enum KEY_AGREEMENT {
@@ -102,7 +106,11 @@ namespace uvgrtp {
             EC38 = 0x38334345,
             EC52 = 0x32354345,
             PRSH = 0x68737250,
-            MULT = 0x746c754d
+            MULT = 0x746c754d,
+
+            /* ECDH with Curve25519 (X25519). This type is not registered in RFC 6189
+             * but other ZRTP implementations use the same name for it */
+            E255 = 0x35353245
         };
 
         enum SAS_TYPES {
@@ -139,19 +147,19 @@ namespace uvgrtp {
         /* Supported ZRTP version */
         uint32_t version = 0;
 
-        /* Supported hash algorithms (empty for us) */
+        /* Supported hash algorithms */
         std::vector<uint32_t> hash_algos;
 
-        /* Supported cipher algorithms (empty for us) */
+        /* Supported cipher algorithms */
         std::vector<uint32_t> cipher_algos;
 
-        /* Supported authentication tag types (empty for us) */
+        /* Supported authentication tag types */
         std::vector<uint32_t> auth_tags;
 
-        /* Supported Key Agreement types (empty for us) */
+        /* Supported Key Agreement types */
         std::vector<uint32_t> key_agreements;
 
-        /* Supported SAS types (empty for us) */
+        /* Supported SAS types */
         std::vector<uint32_t> sas_types;
     } zrtp_capab_t;
 
@@ -161,6 +169,11 @@ namespace uvgrtp {
             class sha256;
         }
 
+        namespace ecdh {
+            class p256;
+            class x25519;
+        }
+
         class sha256;
         class dh;
     }
@@ -169,6 +182,8 @@ namespace uvgrtp {
         uvgrtp::crypto::hmac::sha256* hmac_sha256 = nullptr;
         uvgrtp::crypto::sha256* sha256 = nullptr;
         uvgrtp::crypto::dh* dh = nullptr;
+        uvgrtp::crypto::ecdh::p256* ec25 = nullptr;
+        uvgrtp::crypto::ecdh::x25519* e255 = nullptr;
     } zrtp_crypto_ctx_t;
 
     typedef struct zrtp_secrets {
@@ -209,16 +224,26 @@ namespace uvgrtp {
         uint8_t hmac_keyr[32];
     } zrtp_key_ctx_t;
 
-    /* Diffie-Hellman context for the ZRTP session */
+    /* Diffie-Hellman context for the ZRTP session
+     *
+     * The buffers are large enough for DH3k, the elliptic curve key agreements use
+     * only the first "pk_len" and "result_len" bytes of them */
     typedef struct zrtp_dh_ctx {
-        /* Our public/private key pair */
-        uint8_t private_key[22];
+        /* Key agreement type the key pair below was generated for */
+        uint32_t type = 0;
+
+        /* Length of the public values (pvi/pvr) and DHResult of "type" */
+        size_t pk_len = 0;
+        size_t result_len = 0;
+
+        /* Our public key */
         uint8_t public_key[384];
 
         /* Remote public key received in DHPart1/DHPart2 Message */
         uint8_t remote_public[384];
 
-        /* DHResult aka "remote_public ^ private_key mod p" (see src/crypto/crypto.cc) */
+        /* DHResult, "remote_public ^ secret exponent mod p" for DH3k and
+         * the x-coordinate of the shared point for EC25 and E255 */
         uint8_t dh_result[384];
     } zrtp_dh_ctx_t;
 
@@ -249,6 +274,12 @@ namespace uvgrtp {
         uint32_t key_agreement_type = 0;
         uint32_t sas_type = 0;
 
+        /* Should AES-GCM be offered to remote in our Hello message */
+        bool offer_aead = false;
+
+        /* Key agreement types we offer in our Hello message, most preferred first */
+        std::vector<uint32_t> key_agreements;
+
         /* Session capabilities */
         zrtp_capab_t capabilities;
 
@@ -26,13 +26,17 @@ uvgrtp::zrtp_msg::dh_key_exchange::dh_key_exchange(zrtp_session_t& session, int
 
     LOG_DEBUG("Create ZRTP DHPart%d message", part);
 
-    allocate_frame(sizeof(zrtp_dh));
+    size_t pk_len = session.dh_ctx.pk_len;
+
+    allocate_frame(dh_msg_size(pk_len));
     zrtp_dh* msg = (zrtp_dh*)frame_;
     set_zrtp_start(msg->msg_start, session, strs[part - 1][0]);
 
-    msg->crc = 0;
     memcpy(msg->hash,                session.hash_ctx.o_hash[1], 32);
 
+    /* the public value pushes the MAC and CRC forward */
+    uint8_t *mac = msg->pk + pk_len;
+
     /* Calculate hashes for the secrets (as defined in Section 4.3.1)
      *
      * These hashes are truncated to 64 bits so we use one temporary
@@ -41,41 +45,42 @@ uvgrtp::zrtp_msg::dh_key_exchange::dh_key_exchange(zrtp_session_t& session, int
     uint8_t mac_full[32];
 
     /* rs1IDr */
-    auto hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.secrets.rs1, 32);
-    hmac_sha256.update((uint8_t *)strs[part - 1][1], 9);
-    hmac_sha256.final(mac_full);
+    auto rs1_hmac = uvgrtp::crypto::hmac::sha256(session.secrets.rs1, 32);
+    rs1_hmac.update((uint8_t *)strs[part - 1][1], 9);
+    rs1_hmac.final(mac_full);
     memcpy(msg->rs1_id, mac_full, 8);
 
     /* rs2IDr */
-    hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.secrets.rs2, 32);
-    hmac_sha256.update((uint8_t *)strs[part - 1][1], 9);
-    hmac_sha256.final(mac_full);
+    auto rs2_hmac = uvgrtp::crypto::hmac::sha256(session.secrets.rs2, 32);
+    rs2_hmac.update((uint8_t *)strs[part - 1][1], 9);
+    rs2_hmac.final(mac_full);
     memcpy(msg->rs2_id, mac_full, 8);
 
     /* auxsecretIDr */
-    hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.secrets.raux, 32);
-    hmac_sha256.update(session.hash_ctx.o_hash[3], 32);
-    hmac_sha256.final(mac_full);
+    auto aux_hmac = uvgrtp::crypto::hmac::sha256(session.secrets.raux, 32);
+    aux_hmac.update(session.hash_ctx.o_hash[3], 32);
+    aux_hmac.final(mac_full);
     memcpy(msg->aux_secret, mac_full, 8);
 
     /* pbxsecretIDr */
-    hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.secrets.rpbx, 32);
-    hmac_sha256.update((uint8_t *)strs[part - 1][1], 9);
-    hmac_sha256.final(mac_full);
+    auto pbx_hmac = uvgrtp::crypto::hmac::sha256(session.secrets.rpbx, 32);
+    pbx_hmac.update((uint8_t *)strs[part - 1][1], 9);
+    pbx_hmac.final(mac_full);
     memcpy(msg->pbx_secret, mac_full, 8);
 
     /* public key */
-    memcpy(msg->pk, session.dh_ctx.public_key, sizeof(session.dh_ctx.public_key));
+    memcpy(msg->pk, session.dh_ctx.public_key, pk_len);
 
     /* Calculate truncated HMAC-SHA256 for the Commit Message */
-    hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.hash_ctx.o_hash[0], 32);
-    hmac_sha256.update((uint8_t *)frame_, len_ - 8 - 4);
-    hmac_sha256.final(mac_full);
+    auto msg_hmac = uvgrtp::crypto::hmac::sha256(session.hash_ctx.o_hash[0], 32);
+    msg_hmac.update((uint8_t *)frame_, len_ - 8 - 4);
+    msg_hmac.final(mac_full);
 
-    memcpy(msg->mac, mac_full, 8);
+    memcpy(mac, mac_full, 8);
 
     /* Calculate CRC32 for the whole ZRTP packet */
-    msg->crc = uvgrtp::crypto::crc32::calculate_crc32((uint8_t *)frame_, len_ - sizeof(uint32_t));
+    uint32_t crc = uvgrtp::crypto::crc32::calculate_crc32((uint8_t *)frame_, len_ - sizeof(uint32_t));
+    memcpy(mac + 8, &crc, sizeof(uint32_t));
 
     /* Finally make a copy of the message and save it for later use */
     if (session.l_msg.dh.second)
@@ -108,7 +113,16 @@ rtp_error_t uvgrtp::zrtp_msg::dh_key_exchange::parse_msg(uvgrtp::zrtp_msg::recei
 
     zrtp_dh *msg = (zrtp_dh *)rframe_;
 
-    memcpy(session.dh_ctx.remote_public, msg->pk, 384);
+    /* remote uses the key agreement type of the Commit message so its public value
+     * must be as long as ours, anything else is a malformed message */
+    size_t pk_len = session.dh_ctx.pk_len;
+
+    if ((size_t)len != dh_msg_size(pk_len)) {
+        LOG_ERROR("DHPart message has an invalid length for the key agreement type: %zd", len);
+        return RTP_INVALID_VALUE;
+    }
+
+    memcpy(session.dh_ctx.remote_public, msg->pk, pk_len);
 
     /* Because uvgRTP only supports DH mode, the retained secrets sent in this
      * DHPartN message are not going to match our own so there not point in parsing them.
@@ -119,7 +133,7 @@ rtp_error_t uvgrtp::zrtp_msg::dh_key_exchange::parse_msg(uvgrtp::zrtp_msg::recei
     session.secrets.s3 = nullptr;
 
     /* Save the MAC value so we can check if later */
-    memcpy(&session.hash_ctx.r_mac[1],  &msg->mac,  8);
+    memcpy(&session.hash_ctx.r_mac[1],  msg->pk + pk_len, 8);
     memcpy(&session.hash_ctx.r_hash[1], msg->hash, 32);
 
     /* Finally make a copy of the message and save it for later use */
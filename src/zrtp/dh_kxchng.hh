@@ -30,11 +30,22 @@ namespace uvgrtp {
             uint8_t rs2_id[8];
             uint8_t aux_secret[8];
             uint8_t pbx_secret[8];
+
+            /* The length of the public value depends on the key agreement type:
+             * 384 bytes for DH3k, 64 bytes for EC25 and 32 bytes for E255.
+             *
+             * The location of "mac" and "crc" below is valid only for DH3k */
             uint8_t pk[384];
             uint8_t mac[8];
             uint32_t crc = 0;
         });
 
+        /* Size of a DHPart1/DHPart2 message carrying a public value of "pk_len" bytes */
+        inline size_t dh_msg_size(size_t pk_len)
+        {
+            return sizeof(zrtp_dh) - sizeof(zrtp_dh::pk) + pk_len;
+        }
+
         class dh_key_exchange : public zrtp_message {
             public:
                 dh_key_exchange(zrtp_session_t& session, int part);
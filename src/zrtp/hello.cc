@@ -13,6 +13,9 @@
 #define ZRTP_HELLO       "Hello   "
 #define ZRTP_CLIENT_ID   "uvgRTP,UVG,TUNI "
 
+/* The algorithm lists start where "mac" is located in a Hello message without them */
+#define HELLO_ALGOS_OFFSET (sizeof(uvgrtp::zrtp_msg::zrtp_hello) - sizeof(uint64_t) - sizeof(uint32_t))
+
 using namespace uvgrtp::zrtp_msg;
 
 uvgrtp::zrtp_msg::hello::hello(zrtp_session_t& session):
@@ -21,13 +24,18 @@ uvgrtp::zrtp_msg::hello::hello(zrtp_session_t& session):
     /* temporary storage for the full hmac hash */
     uint8_t mac_full[32];
 
-    /* We support only the mandatory algorithms etc. defined in RFC 6189
-     * so for us all the hash algos and key agreement types are set to zero 
-     *
-     * We need to assume that remote supports everything and thus need to
-     * allocate the maximum amount of memory for the message  */
+    /* The mandatory algorithms defined in RFC 6189 are implied and need not be listed
+     * so we list only the AES-GCM auth tag type, if it's offered, and the key agreement
+     * types. DH3k is among the key agreements so that its place in our preference is known */
+    std::vector<uint32_t> auth_tags;
+
+    if (session.offer_aead)
+        auth_tags.push_back(GC16);
+
+    const std::vector<uint32_t>& key_agreements = session.key_agreements;
+    size_t n_algos = auth_tags.size() + key_agreements.size();
 
-    allocate_frame(sizeof(zrtp_hello));
+    allocate_frame(sizeof(zrtp_hello) + n_algos * sizeof(uint32_t));
 
     zrtp_hello* msg = (zrtp_hello*)frame_;
     set_zrtp_start(msg->msg_start, session, ZRTP_HELLO);
@@ -43,20 +51,34 @@ uvgrtp::zrtp_msg::hello::hello(zrtp_session_t& session):
     msg->p      = 0;
     msg->unused = 0;
     msg->hc     = 0;
-    msg->ac     = 0;
-    msg->kc     = 0;
+    msg->cc     = 0;
+    msg->ac     = (uint32_t)auth_tags.size();
+    msg->kc     = (uint32_t)key_agreements.size();
     msg->sc     = 0;
 
-    /* Calculate MAC for the Hello message (only the ZRTP message part) */
+    /* The algorithm lists push the MAC and CRC forward so they are located from the end of the
+     * frame. The MAC covers the whole message up to the MAC, the algorithm lists included */
+    uint8_t *algos   = (uint8_t *)frame_ + HELLO_ALGOS_OFFSET;
+    size_t   mac_off = len_ - sizeof(uint64_t) - sizeof(uint32_t);
+
+    if (!auth_tags.empty())
+        memcpy(algos, auth_tags.data(), auth_tags.size() * sizeof(uint32_t));
+
+    if (!key_agreements.empty())
+        memcpy(algos + auth_tags.size() * sizeof(uint32_t), key_agreements.data(),
+               key_agreements.size() * sizeof(uint32_t));
+
+    /* Calculate MAC for the Hello message */
     auto hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.hash_ctx.o_hash[2], 32);
 
-    hmac_sha256.update((uint8_t *)frame_, 81);
+    hmac_sha256.update((uint8_t *)frame_, mac_off);
     hmac_sha256.final(mac_full);
 
-    memcpy(&msg->mac, mac_full, sizeof(uint64_t));
+    memcpy((uint8_t *)frame_ + mac_off, mac_full, sizeof(uint64_t));
 
     /* Calculate CRC32 of the whole packet (excluding crc) */
-    msg->crc = uvgrtp::crypto::crc32::calculate_crc32((uint8_t *)frame_, len_ - sizeof(uint32_t));
+    uint32_t crc = uvgrtp::crypto::crc32::calculate_crc32((uint8_t *)frame_, len_ - sizeof(uint32_t));
+    memcpy((uint8_t *)frame_ + len_ - sizeof(uint32_t), &crc, sizeof(uint32_t));
 
     /* Finally make a copy of the message and save it for later use */
     session.l_msg.hello.first  = len_;
@@ -70,7 +92,7 @@ uvgrtp::zrtp_msg::hello::~hello()
 rtp_error_t uvgrtp::zrtp_msg::hello::parse_msg(uvgrtp::zrtp_msg::receiver& receiver, zrtp_session_t& session)
 {
     ssize_t len = 0;
-    allocate_rframe(sizeof(zrtp_hello) + 5 * 8);
+    allocate_rframe(sizeof(zrtp_hello) + 5 * 15 * sizeof(uint32_t));
     if ((len = receiver.get_msg(rframe_, rlen_)) < 0) {
         LOG_ERROR("Failed to get message from ZRTP receiver");
         return RTP_INVALID_VALUE;
@@ -85,6 +107,36 @@ rtp_error_t uvgrtp::zrtp_msg::hello::parse_msg(uvgrtp::zrtp_msg::receiver& recei
         session.capabilities.version = 110;
     }
 
+    size_t n_algos = msg->hc + msg->cc + msg->ac + msg->kc + msg->sc;
+
+    if ((size_t)len < sizeof(zrtp_hello) + n_algos * sizeof(uint32_t)) {
+        LOG_ERROR("Hello message is too short for its algorithm lists");
+        return RTP_INVALID_VALUE;
+    }
+
+    session.capabilities.hash_algos.clear();
+    session.capabilities.cipher_algos.clear();
+    session.capabilities.auth_tags.clear();
+    session.capabilities.key_agreements.clear();
+    session.capabilities.sas_types.clear();
+
+    /* the algorithm lists are located between the flags and the MAC, in this order */
+    uint8_t *algos = (uint8_t *)rframe_ + HELLO_ALGOS_OFFSET;
+
+    auto read_algos = [&algos](std::vector<uint32_t>& list, size_t count) {
+        for (size_t i = 0; i < count; ++i, algos += sizeof(uint32_t)) {
+            uint32_t algo = 0;
+            memcpy(&algo, algos, sizeof(uint32_t));
+            list.push_back(algo);
+        }
+    };
+
+    read_algos(session.capabilities.hash_algos,     msg->hc);
+    read_algos(session.capabilities.cipher_algos,   msg->cc);
+    read_algos(session.capabilities.auth_tags,      msg->ac);
+    read_algos(session.capabilities.key_agreements, msg->kc);
+    read_algos(session.capabilities.sas_types,      msg->sc);
+
     /* finally add mandatory algorithms required by the specification to remote capabilities */
     session.capabilities.hash_algos.push_back(S256);
     session.capabilities.cipher_algos.push_back(AES1);
@@ -94,7 +146,7 @@ rtp_error_t uvgrtp::zrtp_msg::hello::parse_msg(uvgrtp::zrtp_msg::receiver& recei
     session.capabilities.sas_types.push_back(B32);
 
     /* Save the MAC value so we can check if later */
-    memcpy(&session.hash_ctx.r_mac[3],  &msg->mac,  8);
+    memcpy(&session.hash_ctx.r_mac[3],  algos,      8);
     memcpy(&session.hash_ctx.r_hash[3], msg->hash, 32);
 
     /* Save ZID */
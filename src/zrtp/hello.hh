@@ -44,12 +44,14 @@ namespace uvgrtp {
             uint32_t sc:4;
 
             
-            /* The following fields could be here if they were not 0:
+            /* hc + cc + ac + kc + sc algorithm identifiers are located here, before the MAC:
             *  hash algorithms
             *  cipher algorithms
             *  auth tag types
             *  Key Agreement Types
             *  SAS Types
+            *
+            * The location of "mac" and "crc" below is valid only if all counts are 0
             */
 
             uint64_t mac = 0;
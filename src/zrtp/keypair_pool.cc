@@ -0,0 +1,131 @@
+#include "keypair_pool.hh"
+
+#include "uvgrtp/debug.hh"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+uvgrtp::keypair_pool::keypair_pool(size_t depth):
+    depth_(depth),
+    stop_(false),
+    generated_(0),
+    taken_(0),
+    missed_(0)
+{
+    generator_ = std::thread(&uvgrtp::keypair_pool::generator, this);
+
+    /* The key pairs are generated only when the CPU has nothing else to do
+     * so that refilling the pool does not slow down the handshakes in progress */
+#ifdef _WIN32
+    SetThreadPriority(generator_.native_handle(), THREAD_PRIORITY_IDLE);
+#elif defined(SCHED_IDLE)
+    struct sched_param params;
+    params.sched_priority = 0;
+    pthread_setschedparam(generator_.native_handle(), SCHED_IDLE, &params);
+#endif
+}
+
+uvgrtp::keypair_pool::~keypair_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+
+    if (generator_.joinable())
+        generator_.join();
+}
+
+template <typename T>
+std::unique_ptr<T> uvgrtp::keypair_pool::take(std::deque<std::unique_ptr<T>>& pool)
+{
+    std::unique_ptr<T> keys = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+
+        if (pool.empty()) {
+            LOG_DEBUG("Key pair pool has run out");
+            ++missed_;
+        } else {
+            keys = std::move(pool.front());
+            pool.pop_front();
+            ++taken_;
+        }
+    }
+
+    /* wake up the generator to replace the key pair */
+    cv_.notify_one();
+    return keys;
+}
+
+std::unique_ptr<uvgrtp::crypto::dh> uvgrtp::keypair_pool::take_dh()
+{
+    return take(dh_);
+}
+
+std::unique_ptr<uvgrtp::crypto::ecdh::p256> uvgrtp::keypair_pool::take_p256()
+{
+    return take(p256_);
+}
+
+std::unique_ptr<uvgrtp::crypto::ecdh::x25519> uvgrtp::keypair_pool::take_x25519()
+{
+    return take(x25519_);
+}
+
+uvgrtp::keypair_pool_statistics uvgrtp::keypair_pool::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    uvgrtp::keypair_pool_statistics stats;
+    stats.generated = generated_;
+    stats.taken     = taken_;
+    stats.missed    = missed_;
+    stats.ready     = dh_.size() + p256_.size() + x25519_.size();
+
+    return stats;
+}
+
+template <typename T>
+void uvgrtp::keypair_pool::fill(std::deque<std::unique_ptr<T>>& pool, std::unique_lock<std::mutex>& lock)
+{
+    /* the keys are generated without holding the lock so that taking a key pair never waits */
+    lock.unlock();
+
+    std::unique_ptr<T> keys = std::unique_ptr<T>(new T());
+    keys->generate_keys();
+
+    lock.lock();
+    pool.push_back(std::move(keys));
+    ++generated_;
+}
+
+void uvgrtp::keypair_pool::generator()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+
+    while (true) {
+        cv_.wait(lock, [this] {
+            return stop_ || x25519_.size() < depth_ || p256_.size() < depth_ || dh_.size() < depth_;
+        });
+
+        if (stop_)
+            break;
+
+        /* One key pair at a time, the cheapest and most preferred key agreement first
+         * so that a burst of sessions never waits behind a DH3k key pair */
+        if (x25519_.size() < depth_)
+            fill(x25519_, lock);
+        else if (p256_.size() < depth_)
+            fill(p256_, lock);
+        else
+            fill(dh_, lock);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "uvgrtp/context.hh"
+#include "uvgrtp/crypto.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace uvgrtp {
+
+    /* Pool of ephemeral key pairs for the ZRTP key agreements
+     *
+     * Generating a key pair, a 3072-bit modular exponentiation for DH3k, is on the
+     * critical path of the handshake. The pool generates key pairs for DH3k, EC25
+     * and E255 in a background thread ahead of time so that a session starting
+     * its handshake can take one that is ready.
+     *
+     * Each key pair is handed out only once and is removed from the pool when taken.
+     * The pool is then refilled in the background */
+    class keypair_pool {
+        public:
+            /* Keep "depth" key pairs of each type ready */
+            keypair_pool(size_t depth);
+            ~keypair_pool();
+
+            /* Take a key pair from the pool. The keys of the returned object have been
+             * generated. Return nullptr if the pool has run out, the caller must
+             * then generate the keys itself */
+            std::unique_ptr<uvgrtp::crypto::dh>            take_dh();
+            std::unique_ptr<uvgrtp::crypto::ecdh::p256>    take_p256();
+            std::unique_ptr<uvgrtp::crypto::ecdh::x25519>  take_x25519();
+
+            uvgrtp::keypair_pool_statistics statistics() const;
+
+        private:
+            template <typename T>
+            std::unique_ptr<T> take(std::deque<std::unique_ptr<T>>& pool);
+
+            template <typename T>
+            void fill(std::deque<std::unique_ptr<T>>& pool, std::unique_lock<std::mutex>& lock);
+
+            void generator();
+
+            size_t depth_;
+            bool stop_;
+
+            std::deque<std::unique_ptr<uvgrtp::crypto::dh>>           dh_;
+            std::deque<std::unique_ptr<uvgrtp::crypto::ecdh::p256>>   p256_;
+            std::deque<std::unique_ptr<uvgrtp::crypto::ecdh::x25519>> x25519_;
+
+            uint64_t generated_;
+            uint64_t taken_;
+            uint64_t missed_;
+
+            mutable std::mutex mtx_;
+            std::condition_variable cv_;
+            std::thread generator_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
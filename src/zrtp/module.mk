@@ -6,4 +6,5 @@ SOURCES += \
 	src/zrtp/dh_kxchng.cc \
 	src/zrtp/confirm.cc \
 	src/zrtp/confack.cc \
-	src/zrtp/error.cc
+	src/zrtp/error.cc \
+	src/zrtp/keypair_pool.cc
@@ -98,9 +98,11 @@ int uvgrtp::zrtp_msg::receiver::recv_msg(std::shared_ptr<uvgrtp::socket> socket,
         {
             LOG_DEBUG("Hello message received, verify CRC32!");
 
-            zrtp_hello *hello = (zrtp_hello *)msg;
+            /* the CRC is not at a fixed offset because Hello may contain algorithm lists */
+            uint32_t crc = 0;
+            memcpy(&crc, &mem_[rlen_ - 4], sizeof(uint32_t));
 
-            if (!uvgrtp::crypto::crc32::verify_crc32(mem_, rlen_ - 4, hello->crc))
+            if (!uvgrtp::crypto::crc32::verify_crc32(mem_, rlen_ - 4, crc))
                 return RTP_NOT_SUPPORTED;
         }
         return ZRTP_FT_HELLO;
@@ -131,9 +133,11 @@ int uvgrtp::zrtp_msg::receiver::recv_msg(std::shared_ptr<uvgrtp::socket> socket,
         {
             LOG_DEBUG("DH Part1 message received, verify CRC32!");
 
-            zrtp_dh *dh = (zrtp_dh *)msg;
+            /* the CRC is not at a fixed offset because the length of the public value varies */
+            uint32_t crc = 0;
+            memcpy(&crc, &mem_[rlen_ - 4], sizeof(uint32_t));
 
-            if (!uvgrtp::crypto::crc32::verify_crc32(mem_, rlen_ - 4, dh->crc))
+            if (!uvgrtp::crypto::crc32::verify_crc32(mem_, rlen_ - 4, crc))
                 return RTP_NOT_SUPPORTED;
         }
         return ZRTP_FT_DH_PART1;
@@ -142,9 +146,11 @@ int uvgrtp::zrtp_msg::receiver::recv_msg(std::shared_ptr<uvgrtp::socket> socket,
         {
             LOG_DEBUG("DH Part2 message received, verify CRC32!");
 
-            zrtp_dh *dh = (zrtp_dh *)msg;
+            /* the CRC is not at a fixed offset because the length of the public value varies */
+            uint32_t crc = 0;
+            memcpy(&crc, &mem_[rlen_ - 4], sizeof(uint32_t));
 
-            if (!uvgrtp::crypto::crc32::verify_crc32(mem_, rlen_ - 4, dh->crc))
+            if (!uvgrtp::crypto::crc32::verify_crc32(mem_, rlen_ - 4, crc))
                 return RTP_NOT_SUPPORTED;
         }
         return ZRTP_FT_DH_PART2;
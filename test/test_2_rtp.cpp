@@ -222,4 +222,239 @@ TEST(RTPTests, send_large_amounts)
     cleanup_ms(sess, sender);
     cleanup_ms(sess, receiver);
     cleanup_sess(ctx, sess);
-}
\ No newline at end of file
+}
+
+TEST(RTPTests, rtp_fragment_reassembly)
+{
+    // Tests that fragmented generic frames are reassembled from reordered, duplicated and lost
+    // fragments and across sequence number wraparound. Only the first and the last fragment
+    // have the marker bit set and the fragments of a frame have consecutive sequence numbers
+    std::cout << "Starting RTP fragment reassembly test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+    ASSERT_NE(nullptr, sess);
+
+    uvgrtp::media_stream* receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+    ASSERT_NE(nullptr, receiver);
+    EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_PKT_MAX_DELAY, 50));
+
+    uvgrtp::socket peer(0);
+    ASSERT_EQ(RTP_OK, peer.init(AF_INET, SOCK_DGRAM, 0));
+    sockaddr_in receiver_addr = peer.create_sockaddr(AF_INET, REMOTE_ADDRESS, SEND_PORT);
+
+    // the payload of each fragment is filled with the low byte of its sequence number
+    auto send_fragment = [&](uint16_t seq, uint32_t ts, bool marker, size_t len) {
+        std::vector<uint8_t> packet(12 + len, (uint8_t)seq);
+        packet[0] = 0x80;
+        packet[1] = (marker ? 0x80 : 0) | 96;
+        *(uint16_t*)&packet[2] = htons(seq);
+        *(uint32_t*)&packet[4] = htonl(ts);
+        *(uint32_t*)&packet[8] = htonl(0x1234);
+
+        EXPECT_EQ(RTP_OK, peer.sendto(receiver_addr, packet.data(), packet.size(), 0));
+    };
+
+    // all fragments except the last one are "len" bytes long
+    auto expect_frame = [&](std::vector<uint16_t> seqs, size_t len, size_t last_len) {
+        uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(100);
+        ASSERT_NE(nullptr, frame);
+
+        size_t expected_len = (seqs.size() - 1) * len + last_len;
+        EXPECT_EQ(expected_len, frame->payload_len);
+
+        for (size_t i = 0; i < seqs.size() && frame->payload_len == expected_len; ++i)
+        {
+            EXPECT_EQ((uint8_t)seqs[i], frame->payload[i * len]) << "Fragment " << seqs[i];
+        }
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    };
+
+    // the first packet of the stream is a complete frame if it doesn't have the marker bit set
+    send_fragment(99, 500, false, MAX_PAYLOAD);
+    expect_frame({ 99 }, MAX_PAYLOAD, MAX_PAYLOAD);
+
+    // reordered, the middle fragment arrives first and waits for its neighbours
+    send_fragment(101, 1000, false, MAX_PAYLOAD);
+    send_fragment(102, 1000, true, 100);
+    send_fragment(100, 1000, true, MAX_PAYLOAD);
+    expect_frame({ 100, 101, 102 }, MAX_PAYLOAD, 100);
+
+    // sequence number wraps around in the middle of the frame and a fragment is duplicated
+    send_fragment(65534, 2000, true, MAX_PAYLOAD);
+    send_fragment(0, 2000, false, MAX_PAYLOAD);
+    send_fragment(0, 2000, false, MAX_PAYLOAD);
+    send_fragment(65535, 2000, false, MAX_PAYLOAD);
+    send_fragment(1, 2000, true, 200);
+    expect_frame({ 65534, 65535, 0, 1 }, MAX_PAYLOAD, 200);
+
+    // the frame boundaries don't depend on the payload size of the receiver
+    send_fragment(151, 1500, false, 400);
+    send_fragment(152, 1500, true, 10);
+    send_fragment(150, 1500, true, 400);
+    expect_frame({ 150, 151, 152 }, 400, 10);
+
+    // the last fragment is lost so the frame is dropped once it has been waited for too long
+    send_fragment(200, 3000, true, MAX_PAYLOAD);
+    send_fragment(201, 3000, false, MAX_PAYLOAD);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // An unmarked packet after a gap may be a fragment whose first fragment is late so it waits
+    // until the next packet with another timestamp tells that it is a complete frame. It also
+    // lets the receiver notice the timeout
+    send_fragment(300, 4000, false, 50);
+    EXPECT_EQ(nullptr, receiver->pull_frame(20));
+    send_fragment(301, 4100, false, 60);
+    expect_frame({ 300 }, 50, 50);
+    expect_frame({ 301 }, 60, 60);
+
+    // a fragment of the dropped frame arrives late
+    send_fragment(201, 3000, false, MAX_PAYLOAD);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    uvgrtp::reassembly_statistics stats = receiver->get_reassembly_statistics();
+    EXPECT_EQ(3u, stats.completed_frames);
+    EXPECT_EQ(1u, stats.dropped_frames);
+    EXPECT_EQ(1u, stats.lost_fragments);
+    EXPECT_EQ(1u, stats.late_fragments);
+    EXPECT_EQ(1u, stats.duplicate_fragments);
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_fragment_mtu_mismatch)
+{
+    // Tests that generic frames are reassembled when the sender has a smaller MTU than the receiver
+    std::cout << "Starting RTP fragment MTU mismatch test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+    ASSERT_NE(nullptr, sess);
+
+    uvgrtp::media_stream* sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+    uvgrtp::media_stream* receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+    ASSERT_NE(nullptr, sender);
+    ASSERT_NE(nullptr, receiver);
+    EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_MTU_SIZE, 500));
+
+    // Ethernet, IPv4, UDP and RTP headers take 54 bytes of the MTU
+    // and a frame filling exactly one payload is sent in one packet
+    for (size_t size : { (size_t)500 - 54, (size_t)3 * MAX_PAYLOAD + 10, (size_t)100 })
+    {
+        std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[size]);
+
+        for (size_t i = 0; i < size; ++i)
+            test_frame[i] = (uint8_t)(i * 7);
+
+        EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+
+        uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(100);
+        EXPECT_NE(nullptr, frame);
+        if (frame)
+        {
+            EXPECT_EQ(size, frame->payload_len);
+            EXPECT_EQ(0, memcmp(frame->payload, test_frame.get(), std::min(size, frame->payload_len)));
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+    }
+    EXPECT_EQ(1u, receiver->get_reassembly_statistics().completed_frames);
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_header_extensions)
+{
+    // Tests that RFC 8285 header extensions set by the sender are parsed by the receiver
+    std::cout << "Starting RTP header extension test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_NO_FLAGS;
+
+    EXPECT_NE(nullptr, sess);
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+    EXPECT_NE(nullptr, sender);
+    if (sender && receiver)
+    {
+        const std::string toffset = "urn:ietf:params:rtp-hdrext:toffset";
+        const std::string mid     = "urn:ietf:params:rtp-hdrext:sdes:mid";
+
+        EXPECT_EQ(RTP_OK, sender->register_header_extension(2, toffset));
+        EXPECT_EQ(RTP_OK, receiver->register_header_extension(2, toffset));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->register_header_extension(2, mid));
+        EXPECT_EQ(RTP_NOT_FOUND, sender->set_header_extension(3, nullptr, 0));
+        EXPECT_EQ(2, receiver->get_header_extension_id(toffset));
+
+        uint8_t offset[3] = { 0x01, 0x02, 0x03 };
+        EXPECT_EQ(RTP_OK, sender->set_header_extension(2, offset, sizeof(offset)));
+
+        // the 8-byte extension block does not fit a 60-byte MTU with 54 bytes of headers
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_MTU_SIZE, 60));
+
+        const size_t frame_size = 500;
+        std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
+        memset(test_frame.get(), 'b', frame_size);
+        EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), frame_size, RTP_NO_FLAGS));
+
+        uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(100);
+        EXPECT_NE(nullptr, frame);
+        if (frame)
+        {
+            const uvgrtp::frame::ext_element* ext = uvgrtp::frame::get_ext_element(frame, 2);
+
+            EXPECT_EQ(1, frame->header.ext);
+            EXPECT_EQ(frame_size, frame->payload_len);
+            EXPECT_NE(nullptr, ext);
+            if (ext)
+            {
+                EXPECT_EQ(sizeof(offset), ext->len);
+                EXPECT_EQ(0, memcmp(ext->data, offset, sizeof(offset)));
+            }
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+
+        // identifiers above 14 require the two-byte format
+        uint8_t name[2] = { 'a', 'v' };
+        EXPECT_EQ(RTP_OK, sender->register_header_extension(20, mid));
+        EXPECT_EQ(RTP_OK, sender->set_header_extension(20, name, sizeof(name)));
+        EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), frame_size, RTP_NO_FLAGS));
+
+        frame = receiver->pull_frame(100);
+        EXPECT_NE(nullptr, frame);
+        if (frame)
+        {
+            EXPECT_EQ(2, frame->ext_count);
+            EXPECT_NE(nullptr, uvgrtp::frame::get_ext_element(frame, 2));
+            EXPECT_NE(nullptr, uvgrtp::frame::get_ext_element(frame, 20));
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+
+        // without extensions the header is sent without extension block
+        EXPECT_EQ(RTP_OK, sender->clear_header_extension(2));
+        EXPECT_EQ(RTP_OK, sender->clear_header_extension(20));
+        EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), frame_size, RTP_NO_FLAGS));
+
+        frame = receiver->pull_frame(100);
+        EXPECT_NE(nullptr, frame);
+        if (frame)
+        {
+            EXPECT_EQ(0, frame->header.ext);
+            EXPECT_EQ(0, frame->ext_count);
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
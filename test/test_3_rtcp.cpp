@@ -107,6 +107,1112 @@ TEST(RTCPTests, rtcp_app) {
     cleanup(ctx, local_session, remote_session, local_stream, remote_stream);
 }
 
+TEST(RTCPTests, rtcp_receiver_statistics) {
+    // The receiver reports of the remote end tell what it measured from our RTP packets
+    uvgrtp::context ctx;
+    uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+    int flags = RCE_RTCP;
+
+    uvgrtp::media_stream* local_stream = nullptr;
+    if (local_session)
+    {
+        local_stream = local_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    uvgrtp::media_stream* remote_stream = nullptr;
+    if (remote_session)
+    {
+        remote_stream = remote_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    ASSERT_NE(nullptr, local_stream);
+    ASSERT_NE(nullptr, remote_stream);
+
+    std::atomic<int> blocks(0);
+    std::atomic<int> lost(0);
+    std::atomic<uint32_t> last_seq(0);
+    std::atomic<uint32_t> jitter(0);
+    uint32_t ssrc = local_stream->get_ssrc();
+
+    EXPECT_EQ(RTP_OK, local_stream->get_rtcp()->install_receiver_hook(
+        [&](std::unique_ptr<uvgrtp::frame::rtcp_receiver_report> frame) {
+            for (auto& block : frame->report_blocks)
+            {
+                if (block.ssrc == ssrc)
+                {
+                    ++blocks;
+                    lost = block.lost;
+                    last_seq = block.last_seq;
+                    jitter = block.jitter;
+                }
+            }
+        }));
+
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, local_session, local_stream, 5 * FRAME_RATE, PACKET_INTERVAL_MS, false, RTP_NO_FLAGS);
+
+    cleanup(ctx, local_session, remote_session, local_stream, remote_stream);
+
+    std::cout << "Report blocks: " << blocks << ", lost: " << lost << ", last seq: " << last_seq
+              << ", jitter: " << jitter << std::endl;
+
+    /* nothing is lost over loopback and the packets are sent at even intervals */
+    EXPECT_LT(0, blocks.load());
+    EXPECT_EQ(0, lost.load());
+    EXPECT_NE(0u, last_seq.load());
+    EXPECT_GT(1000u, jitter.load());
+}
+
+TEST(RTCPTests, rtcp_report_views) {
+    // The reports are given to the view hooks straight from the receive buffer
+    uvgrtp::context ctx;
+    uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+    int flags = RCE_RTCP;
+
+    uvgrtp::media_stream* local_stream = nullptr;
+    if (local_session)
+    {
+        local_stream = local_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    uvgrtp::media_stream* remote_stream = nullptr;
+    if (remote_session)
+    {
+        remote_stream = remote_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    ASSERT_NE(nullptr, local_stream);
+    ASSERT_NE(nullptr, remote_stream);
+
+    uint32_t local_ssrc = local_stream->get_ssrc();
+    uint32_t remote_ssrc = remote_stream->get_ssrc();
+
+    std::atomic<int> sender_reports(0);
+    std::atomic<uint32_t> sent_packets(0);
+    std::atomic<int> receiver_reports(0);
+    std::atomic<int> blocks(0);
+
+    // we send RTP so the remote end gets our SRs
+    EXPECT_EQ(RTP_OK, remote_stream->get_rtcp()->install_report_view_hook(
+        [&](const uvgrtp::frame::rtcp_report_view& view) {
+            if (view.ssrc == local_ssrc && view.sender_info)
+            {
+                ++sender_reports;
+                sent_packets = uvgrtp::frame::get_sender_info(view).pkt_cnt;
+            }
+        }));
+
+    // and we get RRs with a report block about our stream from the remote end
+    EXPECT_EQ(RTP_OK, local_stream->get_rtcp()->install_report_view_hook(
+        [&](const uvgrtp::frame::rtcp_report_view& view) {
+            if (view.ssrc != remote_ssrc || view.sender_info)
+            {
+                return;
+            }
+
+            ++receiver_reports;
+            for (size_t i = 0; i < view.header.count; ++i)
+            {
+                uvgrtp::frame::rtcp_report_block block = uvgrtp::frame::get_report_block(view, i);
+                if (block.ssrc == local_ssrc && block.lost == 0 && block.last_seq != 0)
+                {
+                    ++blocks;
+                }
+            }
+        }));
+
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, local_session, local_stream, SEND_TEST_PACKETS, PACKET_INTERVAL_MS, false, RTP_NO_FLAGS);
+
+    cleanup(ctx, local_session, remote_session, local_stream, remote_stream);
+
+    std::cout << "Sender reports: " << sender_reports << " (" << sent_packets << " packets sent), receiver reports: "
+              << receiver_reports << ", report blocks: " << blocks << std::endl;
+
+    EXPECT_LT(0, sender_reports.load());
+    EXPECT_NE(0u, sent_packets.load());
+    EXPECT_LT(0, receiver_reports.load());
+    EXPECT_LT(0, blocks.load());
+}
+
+TEST(RTCPTests, rtcp_analytics) {
+    // The analytics are computed from the reports of both ends
+    uvgrtp::context ctx;
+    uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+    int flags = RCE_RTCP;
+
+    uvgrtp::media_stream* local_stream = nullptr;
+    if (local_session)
+    {
+        local_stream = local_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    uvgrtp::media_stream* remote_stream = nullptr;
+    if (remote_session)
+    {
+        remote_stream = remote_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    ASSERT_NE(nullptr, local_stream);
+    ASSERT_NE(nullptr, remote_stream);
+
+    uint32_t local_ssrc = local_stream->get_ssrc();
+    uint32_t remote_ssrc = remote_stream->get_ssrc();
+
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, local_session, local_stream, SEND_TEST_PACKETS, PACKET_INTERVAL_MS, false, RTP_NO_FLAGS);
+
+    uvgrtp::rtcp_analytics receiver;
+    uvgrtp::rtcp_analytics sender;
+
+    // wait until the remote end has reported on our SR and we have sent two SRs
+    for (int i = 0; i < 200; ++i)
+    {
+        if (local_stream->get_rtcp()->get_analytics(remote_ssrc, receiver) == RTP_OK &&
+            remote_stream->get_rtcp()->get_analytics(local_ssrc, sender) == RTP_OK &&
+            receiver.rtt_ms >= 0 && sender.bitrate_kbps > 0)
+        {
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    std::cout << "RTT: " << receiver.rtt_ms << " ms, reports: " << receiver.reports << ", lost: "
+              << receiver.cumulative_lost << ", jitter: " << receiver.jitter_ms << " ms, bitrate: "
+              << sender.bitrate_kbps << " kbps" << std::endl;
+
+    EXPECT_EQ(remote_ssrc, receiver.ssrc);
+    EXPECT_LT(0u, receiver.reports);
+    EXPECT_LE(0.0, receiver.rtt_ms);
+    EXPECT_GT(100.0, receiver.rtt_ms);
+    EXPECT_EQ(0, receiver.cumulative_lost);
+    EXPECT_EQ(0.0, receiver.smoothed_fraction_lost);
+    EXPECT_NE(0u, receiver.highest_seq);
+    EXPECT_LT(0.0, sender.bitrate_kbps);
+
+    uvgrtp::rtcp_analytics unknown;
+    EXPECT_EQ(RTP_INVALID_VALUE, local_stream->get_rtcp()->get_analytics(local_ssrc, unknown));
+    EXPECT_EQ(1u, local_stream->get_rtcp()->get_analytics().size());
+
+    cleanup(ctx, local_session, remote_session, local_stream, remote_stream);
+}
+
+TEST(RTCPTests, rtcp_shared_scheduler) {
+    // The RTCP of all streams of a context is handled by one thread, every stream must still get reports
+    constexpr int STREAMS = 8;
+    constexpr uint16_t BASE_PORT = 9400;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+    ASSERT_NE(nullptr, local_session);
+    ASSERT_NE(nullptr, remote_session);
+
+    int flags = RCE_RTCP;
+
+    std::vector<uvgrtp::media_stream*> local_streams;
+    std::vector<uvgrtp::media_stream*> remote_streams;
+    std::vector<std::atomic<int>> reports(STREAMS);
+
+    for (int i = 0; i < STREAMS; ++i)
+    {
+        uint16_t local_port = BASE_PORT + 4 * i;
+        uint16_t remote_port = local_port + 2;
+
+        local_streams.push_back(local_session->create_stream(local_port, remote_port, RTP_FORMAT_GENERIC, flags));
+        remote_streams.push_back(remote_session->create_stream(remote_port, local_port, RTP_FORMAT_GENERIC, flags));
+
+        ASSERT_NE(nullptr, local_streams.back());
+        ASSERT_NE(nullptr, remote_streams.back());
+
+        std::atomic<int>& count = reports[i];
+        EXPECT_EQ(RTP_OK, local_streams.back()->get_rtcp()->install_sdes_hook(
+            [&count](std::unique_ptr<uvgrtp::frame::rtcp_sdes_packet> frame) {
+                (void)frame;
+                ++count;
+            }));
+    }
+
+    // the remote ends only report to us once they have received our RTP packets
+    uint8_t payload[PAYLOAD_LEN];
+    memset(payload, 'b', PAYLOAD_LEN);
+
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        for (auto& stream : local_streams)
+        {
+            EXPECT_EQ(RTP_OK, stream->push_frame(payload, PAYLOAD_LEN, RTP_NO_FLAGS));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(PACKET_INTERVAL_MS));
+    }
+
+    // the first reports are sent within 1.5 * 2.5 s / (e - 1.5)
+    std::this_thread::sleep_for(std::chrono::milliseconds(4000));
+
+    for (int i = 0; i < STREAMS; ++i)
+    {
+        cleanup_ms(local_session, local_streams[i]);
+        cleanup_ms(remote_session, remote_streams[i]);
+    }
+    cleanup_sess(ctx, local_session);
+    cleanup_sess(ctx, remote_session);
+
+    for (int i = 0; i < STREAMS; ++i)
+    {
+        EXPECT_LT(0, reports[i].load()) << "Stream " << i << " did not receive RTCP reports";
+    }
+}
+
+TEST(RTCPTests, rtcp_large_session) {
+    // Thousands of sources send RTP to one stream. The reports of all of them do not fit in one
+    // compound packet so every report carries as many as fit and the rest follow in the next ones
+    constexpr int SOURCES = 2000;
+    constexpr uint16_t STREAM_PORT = 9500;
+    constexpr uint16_t PEER_PORT = 9502;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* session = ctx.create_session(REMOTE_ADDRESS);
+    ASSERT_NE(nullptr, session);
+
+    uvgrtp::media_stream* stream = session->create_stream(STREAM_PORT, PEER_PORT, RTP_FORMAT_GENERIC, RCE_RTCP);
+    ASSERT_NE(nullptr, stream);
+
+    // a high session bandwidth keeps the report interval short even with thousands of members
+    stream->get_rtcp()->set_session_bandwidth(10000000);
+
+    EXPECT_EQ(RTP_OK, stream->install_receive_hook(nullptr, [](void*, uvgrtp::frame::rtp_frame* frame) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }));
+
+    // the RTCP socket of the stream is bound to the port following the peer port and it sends
+    // to the port following the stream port
+    uvgrtp::socket monitor(0);
+    ASSERT_EQ(RTP_OK, monitor.init(AF_INET, SOCK_DGRAM, 0));
+    ASSERT_EQ(RTP_OK, monitor.bind(AF_INET, INADDR_ANY, STREAM_PORT + 1));
+
+#ifdef _WIN32
+    DWORD timeout = 100;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100 * 1000;
+#endif
+    ASSERT_EQ(RTP_OK, monitor.setsockopt(SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)));
+
+    uvgrtp::socket peer(0);
+    ASSERT_EQ(RTP_OK, peer.init(AF_INET, SOCK_DGRAM, 0));
+    sockaddr_in stream_addr = peer.create_sockaddr(AF_INET, REMOTE_ADDRESS, STREAM_PORT);
+
+    uint8_t packet[12 + 20] = { 0 };
+    for (int i = 0; i < SOURCES; ++i)
+    {
+        for (uint16_t seq = 0; seq < 3; ++seq)
+        {
+            packet[0] = 0x80;
+            packet[1] = 96;
+            *(uint16_t*)&packet[2] = htons(seq);
+            *(uint32_t*)&packet[4] = htonl(seq * 3000);
+            *(uint32_t*)&packet[8] = htonl(0x10000 + i);
+
+            EXPECT_EQ(RTP_OK, peer.sendto(stream_addr, packet, sizeof(packet), 0));
+        }
+
+        // do not overflow the receive buffer of the stream
+        if (i % 20 == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // two NACKs of 64 entries wait for the next report, they take the place of some report blocks
+    std::vector<uint16_t> lost;
+    for (uint16_t seq = 0; seq < 128; ++seq)
+    {
+        lost.push_back(seq * 20);
+    }
+    EXPECT_EQ(RTP_OK, stream->get_rtcp()->send_nack(0x10000, lost));
+
+    std::map<uint32_t, int> reported;
+    size_t reports = 0;
+    size_t max_blocks = 0;
+    size_t nacks = 0;
+    uint8_t buffer[MAX_PACKET];
+
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < end && reported.size() < (size_t)SOURCES)
+    {
+        int nread = 0;
+        if (monitor.recv(buffer, sizeof(buffer), 0, &nread) != RTP_OK || nread <= 0)
+        {
+            continue;
+        }
+
+        EXPECT_GE(MAX_PAYLOAD, nread);
+
+        size_t blocks = 0;
+        for (int offset = 0; offset + 4 <= nread;)
+        {
+            uint8_t count = buffer[offset] & 0x1f;
+            uint8_t type = buffer[offset + 1];
+            int length = (ntohs(*(uint16_t*)&buffer[offset + 2]) + 1) * 4;
+
+            // the report blocks follow the sender info in SRs and the SSRC in RRs
+            int block = offset + (type == 200 ? 28 : 8);
+            if (type == 200 || type == 201)
+            {
+                for (int j = 0; j < count && block + 24 <= nread; ++j, block += 24)
+                {
+                    ++reported[ntohl(*(uint32_t*)&buffer[block])];
+                    ++blocks;
+                }
+            }
+            else if (type == 205)
+            {
+                ++nacks;
+            }
+            offset += length;
+        }
+
+        ++reports;
+        max_blocks = std::max(max_blocks, blocks);
+    }
+
+    std::cout << "Reports: " << reports << ", sources reported: " << reported.size()
+              << ", most blocks in a report: " << max_blocks << std::endl;
+
+    // the report blocks continue in additional RRs after the 31 of the first packet
+    EXPECT_LT(31u, max_blocks);
+    EXPECT_LT(max_blocks, reported.size());
+    EXPECT_EQ((size_t)SOURCES, reported.size());
+    EXPECT_EQ(2u, nacks);
+
+    // every source sent RTP only once so it is reported once
+    for (auto& source : reported)
+    {
+        EXPECT_EQ(1, source.second) << "Source " << source.first;
+    }
+
+    // the report interval is a few milliseconds so the silent sources time out soon. The first
+    // source took the place of the peer given to create_stream() so it stays a member
+    auto has_source = [&](uint32_t first, uint32_t count) {
+        for (auto& participant : stream->get_rtcp()->get_analytics())
+        {
+            if (participant.ssrc >= first && participant.ssrc < first + count)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    for (int i = 0; i < 100 && has_source(0x10001, SOURCES - 1); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    EXPECT_FALSE(has_source(0x10001, SOURCES - 1));
+
+    // with the default interval the sources do not time out during the test and leave with BYE
+    constexpr uint32_t LEAVING = 10;
+    stream->get_rtcp()->set_session_bandwidth(64);
+
+    for (uint32_t i = 0; i < LEAVING; ++i)
+    {
+        *(uint32_t*)&packet[8] = htonl(0x20000 + i);
+        EXPECT_EQ(RTP_OK, peer.sendto(stream_addr, packet, sizeof(packet), 0));
+    }
+
+    for (int i = 0; i < 100 && !has_source(0x20000, LEAVING); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_TRUE(has_source(0x20000, LEAVING));
+
+    // an empty RR of the first source and a BYE of all of them
+    uint8_t bye[8 + 4 + 4 * LEAVING] = { 0 };
+    bye[0] = 0x80;
+    bye[1] = 201;
+    *(uint16_t*)&bye[2] = htons(1);
+    *(uint32_t*)&bye[4] = htonl(0x20000);
+    bye[8] = 0x80 | LEAVING;
+    bye[9] = 203;
+    *(uint16_t*)&bye[10] = htons(LEAVING);
+    for (uint32_t i = 0; i < LEAVING; ++i)
+    {
+        *(uint32_t*)&bye[12 + 4 * i] = htonl(0x20000 + i);
+    }
+
+    sockaddr_in rtcp_addr = peer.create_sockaddr(AF_INET, REMOTE_ADDRESS, PEER_PORT + 1);
+    EXPECT_EQ(RTP_OK, peer.sendto(rtcp_addr, bye, sizeof(bye), 0));
+
+    for (int i = 0; i < 100 && has_source(0x20000, LEAVING); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_FALSE(has_source(0x20000, LEAVING));
+
+    cleanup_ms(session, stream);
+    cleanup_sess(ctx, session);
+}
+
+TEST(RTCPTests, rtcp_interval_scaling) {
+    // At a realistic session bandwidth the report interval follows RFC 3550 section 6.3.1: it grows
+    // with the number of members and, once the stream sends RTP, with the number of senders
+    constexpr uint32_t SESSION_BANDWIDTH_KBPS = 1000;
+    constexpr uint32_t MEMBERS = 200;
+    constexpr uint32_t SENDERS = 40;
+    constexpr uint16_t STREAM_PORT = 9520;
+    constexpr uint16_t PEER_PORT = 9522;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* session = ctx.create_session(REMOTE_ADDRESS);
+    ASSERT_NE(nullptr, session);
+
+    uvgrtp::media_stream* stream = session->create_stream(STREAM_PORT, PEER_PORT, RTP_FORMAT_GENERIC, RCE_RTCP);
+    ASSERT_NE(nullptr, stream);
+
+    // the minimum interval is 360 ms at 1 Mbps
+    stream->get_rtcp()->set_session_bandwidth(SESSION_BANDWIDTH_KBPS);
+
+    EXPECT_EQ(RTP_OK, stream->install_receive_hook(nullptr, [](void*, uvgrtp::frame::rtp_frame* frame) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }));
+
+    uvgrtp::socket monitor(0);
+    ASSERT_EQ(RTP_OK, monitor.init(AF_INET, SOCK_DGRAM, 0));
+    ASSERT_EQ(RTP_OK, monitor.bind(AF_INET, INADDR_ANY, STREAM_PORT + 1));
+
+#ifdef _WIN32
+    DWORD timeout = 100;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100 * 1000;
+#endif
+    ASSERT_EQ(RTP_OK, monitor.setsockopt(SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)));
+
+    uvgrtp::socket peer(0);
+    ASSERT_EQ(RTP_OK, peer.init(AF_INET, SOCK_DGRAM, 0));
+    sockaddr_in stream_addr = peer.create_sockaddr(AF_INET, REMOTE_ADDRESS, STREAM_PORT);
+    sockaddr_in rtcp_addr = peer.create_sockaddr(AF_INET, REMOTE_ADDRESS, PEER_PORT + 1);
+
+    // the members send empty RRs and the senders RTP often enough that none of them time out.
+    // The first member gives the peer of the stream its SSRC so that the reports are sent
+    std::atomic<uint32_t> members(1);
+    std::atomic<uint32_t> senders(0);
+    std::atomic<bool> active(true);
+
+    std::thread sources([&]() {
+        uint8_t rr[8] = { 0x80, 201, 0, 1 };
+        uint8_t rtp[12 + 20] = { 0x80, 96 };
+
+        for (uint16_t seq = 0; active; ++seq)
+        {
+            for (uint32_t i = 0; i < members; ++i)
+            {
+                *(uint32_t*)&rr[4] = htonl(0x30000 + i);
+                (void)peer.sendto(rtcp_addr, rr, sizeof(rr), 0);
+            }
+
+            for (uint32_t i = 0; i < senders; ++i)
+            {
+                *(uint16_t*)&rtp[2] = htons(seq);
+                *(uint32_t*)&rtp[4] = htonl(seq * 3000);
+                *(uint32_t*)&rtp[8] = htonl(0x40000 + i);
+                (void)peer.sendto(stream_addr, rtp, sizeof(rtp), 0);
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+    });
+
+    // the average time between the reports of the stream after the session has settled
+    auto report_spacing = [&](int gaps) {
+        uint8_t buffer[MAX_PACKET];
+        std::vector<std::chrono::steady_clock::time_point> reports;
+
+        auto end = std::chrono::steady_clock::now() + std::chrono::seconds(15);
+        while (std::chrono::steady_clock::now() < end && reports.size() < (size_t)gaps + 2)
+        {
+            int nread = 0;
+            if (monitor.recv(buffer, sizeof(buffer), 0, &nread) == RTP_OK && nread > 0)
+            {
+                reports.push_back(std::chrono::steady_clock::now());
+            }
+        }
+
+        if (reports.size() < (size_t)gaps + 2)
+        {
+            return std::chrono::milliseconds(0).count();
+        }
+
+        // the first report may have been scheduled before the session changed
+        return std::chrono::duration_cast<std::chrono::milliseconds>(reports.back() - reports.at(1)).count() / gaps;
+    };
+
+    auto one_member = report_spacing(3);
+
+    members = MEMBERS;
+    auto with_members = report_spacing(2);
+
+    // the senders get a quarter of the RTCP bandwidth so the interval depends only on their number
+    std::unique_ptr<uint8_t[]> frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, PAYLOAD_LEN, RTP_NO_FLAGS);
+    EXPECT_EQ(RTP_OK, stream->push_frame(frame.get(), PAYLOAD_LEN, RTP_NO_FLAGS));
+    auto sending = report_spacing(3);
+
+    senders = SENDERS;
+    auto with_senders = report_spacing(2);
+
+    active = false;
+    sources.join();
+
+    std::cout << "Report spacing with one member: " << one_member << " ms, with " << MEMBERS << " members: " << with_members
+              << " ms, sending: " << sending << " ms, with " << SENDERS << " senders: " << with_senders << " ms" << std::endl;
+
+    EXPECT_LT(0, one_member);
+    EXPECT_LT(0, sending);
+    EXPECT_LT(2 * one_member, with_members);
+    EXPECT_LT(2 * sending, with_senders);
+
+    cleanup_ms(session, stream);
+    cleanup_sess(ctx, session);
+}
+
+TEST(RTCPTests, rtcp_xr) {
+    // A stream with Extended Reports enabled reports the packets it lost and got twice
+    constexpr uint16_t STREAM_PORT = 9600;
+    constexpr uint16_t MONITOR_PORT = 9602;
+    constexpr uint16_t FIRST_SEQ = 1000;
+    constexpr uint16_t LAST_SEQ = 1299;
+
+    const std::set<uint16_t> dropped = { 1050, 1100, 1200, 1201, 1202, 1203, 1206 };
+    const uint16_t duplicated = 1150;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* monitor_session = ctx.create_session(LOCAL_INTERFACE);
+    ASSERT_NE(nullptr, session);
+    ASSERT_NE(nullptr, monitor_session);
+
+    uvgrtp::media_stream* stream = session->create_stream(STREAM_PORT, MONITOR_PORT, RTP_FORMAT_GENERIC, RCE_RTCP | RCE_RTCP_XR);
+    uvgrtp::media_stream* monitor = monitor_session->create_stream(MONITOR_PORT, STREAM_PORT, RTP_FORMAT_GENERIC, RCE_RTCP);
+    ASSERT_NE(nullptr, stream);
+    ASSERT_NE(nullptr, monitor);
+
+    stream->get_rtcp()->set_session_bandwidth(10000000);
+
+    EXPECT_EQ(RTP_OK, stream->install_receive_hook(nullptr, [](void*, uvgrtp::frame::rtp_frame* frame) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }));
+
+    std::mutex mutex;
+    std::map<uint16_t, bool> received;
+    std::set<uint16_t> duplicates;
+    size_t voip_blocks = 0;
+    uint8_t loss_rate = 0;
+
+    EXPECT_EQ(RTP_OK, monitor->get_rtcp()->install_xr_hook([&](std::unique_ptr<uvgrtp::frame::rtcp_xr_packet> xr) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (auto& block : xr->loss_rle)
+        {
+            std::vector<bool> packets = uvgrtp::frame::get_rle_packets(block);
+            for (size_t i = 0; i < packets.size(); ++i)
+            {
+                received[(uint16_t)(block.begin_seq + i)] = packets[i];
+            }
+        }
+
+        for (auto& block : xr->duplicate_rle)
+        {
+            std::vector<bool> packets = uvgrtp::frame::get_rle_packets(block);
+            for (size_t i = 0; i < packets.size(); ++i)
+            {
+                if (packets[i])
+                {
+                    duplicates.insert((uint16_t)(block.begin_seq + i));
+                }
+            }
+        }
+
+        for (auto& block : xr->voip_metrics)
+        {
+            ++voip_blocks;
+            loss_rate = std::max(loss_rate, block.loss_rate);
+        }
+    }));
+
+    uvgrtp::socket peer(0);
+    ASSERT_EQ(RTP_OK, peer.init(AF_INET, SOCK_DGRAM, 0));
+    sockaddr_in stream_addr = peer.create_sockaddr(AF_INET, REMOTE_ADDRESS, STREAM_PORT);
+
+    uint8_t packet[12 + 20] = { 0 };
+    for (uint16_t seq = FIRST_SEQ; seq <= LAST_SEQ; ++seq)
+    {
+        if (dropped.count(seq))
+        {
+            continue;
+        }
+
+        packet[0] = 0x80;
+        packet[1] = 96;
+        *(uint16_t*)&packet[2] = htons(seq);
+        *(uint32_t*)&packet[4] = htonl(seq * 3000);
+        *(uint32_t*)&packet[8] = htonl(0x12345678);
+
+        EXPECT_EQ(RTP_OK, peer.sendto(stream_addr, packet, sizeof(packet), 0));
+
+        if (seq == duplicated)
+        {
+            EXPECT_EQ(RTP_OK, peer.sendto(stream_addr, packet, sizeof(packet), 0));
+        }
+
+        if (seq % 20 == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    for (int i = 0; i < 100; ++i)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (received.count(LAST_SEQ))
+            {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    cleanup(ctx, session, monitor_session, stream, monitor);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // the source is validated with the first two packets so the history starts from the third
+    ASSERT_FALSE(received.empty());
+    EXPECT_EQ(FIRST_SEQ + 2, received.begin()->first);
+    EXPECT_EQ(LAST_SEQ, received.rbegin()->first);
+
+    for (auto& seq : received)
+    {
+        EXPECT_EQ(!dropped.count(seq.first), seq.second) << "Sequence number " << seq.first;
+    }
+
+    EXPECT_EQ(std::set<uint16_t>({ duplicated }), duplicates);
+    EXPECT_LT(0u, voip_blocks);
+    EXPECT_LT(0, loss_rate);
+}
+
+TEST(RTCPTests, rtcp_async_hooks) {
+    // A slow hook is called from the dispatcher thread and the reports it can not keep up with
+    // are coalesced, while the RTCP of the stream keeps running
+    constexpr uint16_t SENDER_PORT = 9700;
+    constexpr uint16_t RECEIVER_PORT = 9702;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(LOCAL_INTERFACE);
+    ASSERT_NE(nullptr, sender_session);
+    ASSERT_NE(nullptr, receiver_session);
+
+    uvgrtp::media_stream* sender = sender_session->create_stream(SENDER_PORT, RECEIVER_PORT, RTP_FORMAT_GENERIC, RCE_RTCP);
+    uvgrtp::media_stream* receiver = receiver_session->create_stream(RECEIVER_PORT, SENDER_PORT, RTP_FORMAT_GENERIC,
+        RCE_RTCP | RCE_RTCP_ASYNC_HOOKS);
+    ASSERT_NE(nullptr, sender);
+    ASSERT_NE(nullptr, receiver);
+
+    // frequent Sender Reports
+    sender->get_rtcp()->set_session_bandwidth(10000000);
+
+    std::atomic<int> hook_calls(0);
+    std::atomic<uint32_t> latest_packets(0);
+
+    EXPECT_EQ(RTP_OK, receiver->get_rtcp()->install_sender_hook([&](std::unique_ptr<uvgrtp::frame::rtcp_sender_report> sr) {
+        // the reports are delivered in order, skipping the coalesced ones
+        EXPECT_LE(latest_packets.load(), sr->sender_info.pkt_cnt);
+        latest_packets = sr->sender_info.pkt_cnt;
+        ++hook_calls;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }));
+
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, sender_session, sender, 5 * FRAME_RATE, PACKET_INTERVAL_MS, false, RTP_NO_FLAGS);
+
+    for (int i = 0; i < 50 && receiver->get_rtcp()->get_hook_statistics().coalesced == 0; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    // the analytics are updated by the thread receiving RTCP whatever the hook is doing
+    uvgrtp::rtcp_analytics analytics;
+    EXPECT_EQ(RTP_OK, receiver->get_rtcp()->get_analytics(sender->get_ssrc(), analytics));
+    EXPECT_LT(0.0, analytics.bitrate_kbps);
+
+    uvgrtp::rtcp_hook_statistics statistics = receiver->get_rtcp()->get_hook_statistics();
+
+    // the hooks of the sender are called synchronously
+    EXPECT_EQ(0u, sender->get_rtcp()->get_hook_statistics().delivered);
+
+    std::cout << "Hook calls: " << hook_calls << ", delivered: " << statistics.delivered << ", coalesced: "
+              << statistics.coalesced << ", dropped: " << statistics.dropped << std::endl;
+
+    cleanup(ctx, sender_session, receiver_session, sender, receiver);
+
+    EXPECT_LT(0, hook_calls.load());
+    EXPECT_LT(0u, statistics.delivered);
+    EXPECT_LT(0u, statistics.coalesced);
+    EXPECT_EQ(0u, statistics.dropped);
+}
+
+TEST(RTCPTests, rtcp_feedback) {
+    // NACK and PLI are sent in a reduced-size packet as soon as they are requested
+    // instead of waiting for the next regular report
+    constexpr uint16_t SENDER_PORT = 9800;
+    constexpr uint16_t RECEIVER_PORT = 9802;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(LOCAL_INTERFACE);
+    ASSERT_NE(nullptr, sender_session);
+    ASSERT_NE(nullptr, receiver_session);
+
+    int flags = RCE_RTCP | RCE_RTCP_FEEDBACK | RCE_RTCP_REDUCED_SIZE;
+    uvgrtp::media_stream* sender = sender_session->create_stream(SENDER_PORT, RECEIVER_PORT, RTP_FORMAT_GENERIC, flags);
+    uvgrtp::media_stream* receiver = receiver_session->create_stream(RECEIVER_PORT, SENDER_PORT, RTP_FORMAT_GENERIC, flags);
+    ASSERT_NE(nullptr, sender);
+    ASSERT_NE(nullptr, receiver);
+
+    std::mutex fb_mutex;
+    std::vector<uvgrtp::frame::rtcp_fb_packet> received;
+    std::vector<std::chrono::steady_clock::time_point> arrivals;
+
+    EXPECT_EQ(RTP_OK, sender->get_rtcp()->install_fb_hook([&](std::unique_ptr<uvgrtp::frame::rtcp_fb_packet> fb) {
+        std::lock_guard<std::mutex> lock(fb_mutex);
+        received.push_back(*fb);
+        arrivals.push_back(std::chrono::steady_clock::now());
+    }));
+
+    // the receiver learns the SSRC of the sender from its packets
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, sender_session, sender, 10, PACKET_INTERVAL_MS, false, RTP_NO_FLAGS);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto requested = std::chrono::steady_clock::now();
+    EXPECT_EQ(RTP_OK, receiver->get_rtcp()->send_nack(sender->get_ssrc(), { 10, 11, 13, 40 }));
+    EXPECT_EQ(RTP_OK, receiver->get_rtcp()->send_pli(sender->get_ssrc()));
+
+    for (int i = 0; i < 100; ++i)
+    {
+        {
+            std::lock_guard<std::mutex> lock(fb_mutex);
+            if (received.size() >= 2)
+            {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // invalid feedback is not sent
+    EXPECT_EQ(RTP_INVALID_VALUE, receiver->get_rtcp()->send_nack(sender->get_ssrc(), {}));
+    EXPECT_EQ(RTP_INVALID_VALUE, receiver->get_rtcp()->send_fb_packet(uvgrtp::frame::RTCP_FT_APP, 1,
+        sender->get_ssrc(), nullptr, 0));
+
+    uint32_t sender_ssrc = sender->get_ssrc();
+    uint32_t receiver_ssrc = receiver->get_ssrc();
+
+    cleanup(ctx, sender_session, receiver_session, sender, receiver);
+
+    std::lock_guard<std::mutex> lock(fb_mutex);
+    ASSERT_LE(1u, received.size());
+
+    // the first regular report would only be sent after a second or so
+    auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(arrivals.front() - requested).count();
+    std::cout << "Feedback latency: " << latency << " ms" << std::endl;
+    EXPECT_GT(500, latency);
+
+    EXPECT_EQ(uvgrtp::frame::RTCP_FT_RTPFB, received.front().header.pkt_type);
+    EXPECT_EQ(uvgrtp::frame::RTCP_RTPFB_NACK, received.front().header.fmt);
+    EXPECT_EQ(receiver_ssrc, received.front().sender_ssrc);
+    EXPECT_EQ(sender_ssrc, received.front().media_ssrc);
+    EXPECT_EQ(std::vector<uint16_t>({ 10, 11, 13, 40 }), uvgrtp::frame::get_nack_packets(received.front()));
+
+    // the PLI was requested while the early packet was already sent so it may wait for the regular report
+    if (received.size() > 1)
+    {
+        EXPECT_EQ(uvgrtp::frame::RTCP_FT_PSFB, received[1].header.pkt_type);
+        EXPECT_EQ(uvgrtp::frame::RTCP_PSFB_PLI, received[1].header.fmt);
+        EXPECT_TRUE(received[1].fci.empty());
+    }
+}
+
+TEST(RTCPTests, rtcp_feedback_from_hook) {
+    // A synchronous RTCP hook runs on the thread of the RTCP scheduler. Feedback requested from
+    // there is scheduled with a dither when the session has more than two members
+    constexpr uint16_t SENDER_PORT = 9810;
+    constexpr uint16_t RECEIVER_PORT = 9812;
+    constexpr int EXTRA_SOURCES = 3;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(LOCAL_INTERFACE);
+    ASSERT_NE(nullptr, sender_session);
+    ASSERT_NE(nullptr, receiver_session);
+
+    int flags = RCE_RTCP | RCE_RTCP_FEEDBACK | RCE_RTCP_REDUCED_SIZE;
+    uvgrtp::media_stream* sender = sender_session->create_stream(SENDER_PORT, RECEIVER_PORT, RTP_FORMAT_GENERIC, flags);
+    uvgrtp::media_stream* receiver = receiver_session->create_stream(RECEIVER_PORT, SENDER_PORT, RTP_FORMAT_GENERIC, flags);
+    ASSERT_NE(nullptr, sender);
+    ASSERT_NE(nullptr, receiver);
+
+    std::atomic<int> requested{0};
+    std::atomic<int> received{0};
+
+    EXPECT_EQ(RTP_OK, receiver->install_receive_hook(nullptr, [](void*, uvgrtp::frame::rtp_frame* frame) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }));
+
+    EXPECT_EQ(RTP_OK, receiver->get_rtcp()->install_sender_hook([&](std::unique_ptr<uvgrtp::frame::rtcp_sender_report> sr) {
+        if (requested.fetch_add(1) == 0)
+        {
+            EXPECT_EQ(RTP_OK, receiver->get_rtcp()->send_pli(sr->ssrc));
+        }
+    }));
+
+    EXPECT_EQ(RTP_OK, sender->get_rtcp()->install_fb_hook([&](std::unique_ptr<uvgrtp::frame::rtcp_fb_packet> fb) {
+        if (fb->header.pkt_type == uvgrtp::frame::RTCP_FT_PSFB && fb->header.fmt == uvgrtp::frame::RTCP_PSFB_PLI)
+        {
+            ++received;
+        }
+    }));
+
+    // more sources make the receiver dither its feedback
+    uvgrtp::socket peer(0);
+    ASSERT_EQ(RTP_OK, peer.init(AF_INET, SOCK_DGRAM, 0));
+    sockaddr_in receiver_addr = peer.create_sockaddr(AF_INET, LOCAL_INTERFACE, RECEIVER_PORT);
+
+    uint8_t packet[12 + 20] = { 0 };
+    for (int i = 0; i < EXTRA_SOURCES; ++i)
+    {
+        packet[0] = 0x80;
+        packet[1] = 96;
+        *(uint32_t*)&packet[8] = htonl(0x20000 + i);
+
+        EXPECT_EQ(RTP_OK, peer.sendto(receiver_addr, packet, sizeof(packet), 0));
+    }
+
+    // the sender keeps sending RTP so that its reports are SRs also after it has heard of the receiver
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, sender_session, sender, 150, PACKET_INTERVAL_MS, false, RTP_NO_FLAGS);
+
+    for (int i = 0; i < 500 && received == 0; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    cleanup(ctx, sender_session, receiver_session, sender, receiver);
+
+    EXPECT_LE(1, requested.load());
+    EXPECT_LE(1, received.load());
+}
+
+TEST(RTCPTests, rtcp_sender_timestamps) {
+    // The Sender Reports map the RTP timestamps of the frames to the wallclock of the sender,
+    // so the receiver gets the time each frame was sent from its RTP timestamp
+    constexpr uint16_t SENDER_PORT = 9900;
+    constexpr uint16_t RECEIVER_PORT = 9902;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(LOCAL_INTERFACE);
+    ASSERT_NE(nullptr, sender_session);
+    ASSERT_NE(nullptr, receiver_session);
+
+    uvgrtp::media_stream* sender = sender_session->create_stream(SENDER_PORT, RECEIVER_PORT, RTP_FORMAT_GENERIC, RCE_RTCP);
+    uvgrtp::media_stream* receiver = receiver_session->create_stream(RECEIVER_PORT, SENDER_PORT, RTP_FORMAT_GENERIC, RCE_RTCP);
+    ASSERT_NE(nullptr, sender);
+    ASSERT_NE(nullptr, receiver);
+
+    sender->get_rtcp()->set_session_bandwidth(10000000);
+
+    // the wallclock time each frame arrived at and its RTP timestamp
+    struct arrivals {
+        std::mutex mutex;
+        std::vector<std::pair<uint64_t, uint32_t>> frames;
+    } received;
+
+    EXPECT_EQ(RTP_OK, receiver->install_receive_hook(&received, [](void* arg, uvgrtp::frame::rtp_frame* frame) {
+        auto received = (arrivals*)arg;
+        std::lock_guard<std::mutex> lock(received->mutex);
+        uint32_t rtp_ts = frame->header.timestamp;
+        received->frames.push_back({ uvgrtp::clock::ntp::now(), rtp_ts });
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }));
+
+    // the sender sends its reports to the receiver once it has heard from it
+    uint8_t hello[PAYLOAD_LEN] = { 0 };
+    EXPECT_EQ(RTP_OK, receiver->push_frame(hello, PAYLOAD_LEN, RTP_NO_FLAGS));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, sender_session, sender, 3 * FRAME_RATE, PACKET_INTERVAL_MS, false, RTP_NO_FLAGS);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    uint32_t sender_ssrc = sender->get_ssrc();
+    uvgrtp::rtcp* rtcp = receiver->get_rtcp();
+
+    uint64_t ntp_ts = 0;
+    EXPECT_EQ(RTP_INVALID_VALUE, rtcp->get_sender_ntp(sender_ssrc + 1, 0, ntp_ts));
+
+    for (int i = 0; i < 50 && rtcp->get_sender_ntp(sender_ssrc, 0, ntp_ts) == RTP_NOT_READY; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> frames;
+    {
+        std::lock_guard<std::mutex> lock(received.mutex);
+        frames = received.frames;
+    }
+    ASSERT_LT(0u, frames.size());
+
+    // every frame, including the ones before the first Sender Report, maps to the time it was sent
+    size_t mapped = 0;
+    for (auto& frame : frames)
+    {
+        if (rtcp->get_sender_ntp(sender_ssrc, frame.second, ntp_ts) != RTP_OK)
+        {
+            continue;
+        }
+
+        double delay_ms = (double)(int64_t)(frame.first - ntp_ts) / 4294967296.0 * 1000;
+        EXPECT_GT(100.0, std::abs(delay_ms));
+        ++mapped;
+    }
+
+    cleanup(ctx, sender_session, receiver_session, sender, receiver);
+
+    EXPECT_EQ(frames.size(), mapped);
+}
+
+TEST(RTCPTests, rtcp_ssrc_collision) {
+    // A participant starts sending with the SSRC of the stream. The stream leaves with a BYE for
+    // its old SSRC and continues with a new one, and later packets with its SSRC from the same
+    // address are taken as a loop
+    constexpr uint16_t STREAM_PORT = 10000;
+    constexpr uint16_t PEER_PORT = 10002;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* session = ctx.create_session(REMOTE_ADDRESS);
+    ASSERT_NE(nullptr, session);
+
+    uvgrtp::media_stream* stream = session->create_stream(STREAM_PORT, PEER_PORT, RTP_FORMAT_GENERIC, RCE_RTCP);
+    ASSERT_NE(nullptr, stream);
+
+    EXPECT_EQ(RTP_OK, stream->install_receive_hook(nullptr, [](void*, uvgrtp::frame::rtp_frame* frame) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }));
+
+    // the RTCP of the stream is sent to the port following the stream port
+    uvgrtp::socket monitor(0);
+    ASSERT_EQ(RTP_OK, monitor.init(AF_INET, SOCK_DGRAM, 0));
+    ASSERT_EQ(RTP_OK, monitor.bind(AF_INET, INADDR_ANY, STREAM_PORT + 1));
+
+#ifdef _WIN32
+    DWORD timeout = 100;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100 * 1000;
+#endif
+    ASSERT_EQ(RTP_OK, monitor.setsockopt(SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)));
+    uvgrtp::socket peer(0);
+    ASSERT_EQ(RTP_OK, peer.init(AF_INET, SOCK_DGRAM, 0));
+    ASSERT_EQ(RTP_OK, peer.bind(AF_INET, INADDR_ANY, PEER_PORT));
+    ASSERT_EQ(RTP_OK, peer.setsockopt(SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)));
+    sockaddr_in stream_addr = peer.create_sockaddr(AF_INET, REMOTE_ADDRESS, STREAM_PORT);
+
+    uint32_t old_ssrc = stream->get_ssrc();
+    uvgrtp::rtcp* rtcp = stream->get_rtcp();
+
+    uint8_t packet[12 + 20] = { 0 };
+    packet[0] = 0x80;
+    packet[1] = 96;
+    *(uint32_t*)&packet[8] = htonl(old_ssrc);
+    EXPECT_EQ(RTP_OK, peer.sendto(stream_addr, packet, sizeof(packet), 0));
+
+    for (int i = 0; i < 50 && rtcp->get_conflict_statistics().collisions == 0; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    uint32_t new_ssrc = stream->get_ssrc();
+    EXPECT_EQ(1u, rtcp->get_conflict_statistics().collisions);
+    EXPECT_NE(old_ssrc, new_ssrc);
+
+    // the BYE of the old SSRC is sent right away
+    bool bye_received = false;
+    uint8_t buffer[MAX_PACKET];
+    for (int i = 0; i < 10 && !bye_received; ++i)
+    {
+        int nread = 0;
+        if (monitor.recv(buffer, sizeof(buffer), 0, &nread) != RTP_OK || nread <= 0)
+        {
+            continue;
+        }
+
+        for (int offset = 0; offset + 8 <= nread; offset += (ntohs(*(uint16_t*)&buffer[offset + 2]) + 1) * 4)
+        {
+            if (buffer[offset + 1] == 203 && ntohl(*(uint32_t*)&buffer[offset + 4]) == old_ssrc)
+            {
+                bye_received = true;
+            }
+        }
+    }
+    EXPECT_TRUE(bye_received);
+
+    // the stream keeps its sockets and sends with the new SSRC
+    uint8_t payload[PAYLOAD_LEN] = { 0 };
+    EXPECT_EQ(RTP_OK, stream->push_frame(payload, PAYLOAD_LEN, RTP_NO_FLAGS));
+
+    int nread = 0;
+    EXPECT_EQ(RTP_OK, peer.recv(buffer, sizeof(buffer), 0, &nread));
+    EXPECT_LE(12, nread);
+    EXPECT_EQ(new_ssrc, ntohl(*(uint32_t*)&buffer[8]));
+
+    // our own packet coming back from the address that collided is a loop
+    *(uint32_t*)&packet[8] = htonl(new_ssrc);
+    EXPECT_EQ(RTP_OK, peer.sendto(stream_addr, packet, sizeof(packet), 0));
+
+    for (int i = 0; i < 50 && rtcp->get_conflict_statistics().loops == 0; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    EXPECT_EQ(1u, rtcp->get_conflict_statistics().loops);
+    EXPECT_EQ(1u, rtcp->get_conflict_statistics().collisions);
+    EXPECT_EQ(new_ssrc, stream->get_ssrc());
+
+    session->destroy_stream(stream);
+    ctx.destroy_session(session);
+}
+
 TEST(RTCP_reopen_receiver, rtcp) {
     std::cout << "Starting uvgRTP RTCP reopen receiver test" << std::endl;
 
@@ -207,4 +207,139 @@ TEST(FormatTests, h266)
     cleanup_ms(sess, sender);
     cleanup_ms(sess, receiver);
     cleanup_sess(ctx, sess);
-}
\ No newline at end of file
+}
+
+TEST(FormatTests, h265_nal_delivery)
+{
+    // Tests that each NAL unit of an access unit is returned separately
+    // and only the last NAL unit has the marker bit set
+    std::cout << "Starting h265 NAL unit delivery test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        // three fragmented slices followed by a slice that fits to one packet
+        const std::vector<size_t> nal_sizes = { 5000, 3000, 7000, 500 };
+        size_t total = 0;
+
+        for (auto& nal_size : nal_sizes)
+            total += 4 + nal_size;
+
+        std::unique_ptr<uint8_t[]> access_unit = std::unique_ptr<uint8_t[]>(new uint8_t[total]);
+        memset(access_unit.get(), 'b', total);
+
+        size_t pos = 0;
+        for (auto& nal_size : nal_sizes)
+        {
+            size_t nal_pos = pos;
+            set_nal_unit(access_unit.get(), nal_pos, true, 3, (19 << 1), 1);
+            pos += 4 + nal_size;
+        }
+
+        EXPECT_EQ(RTP_OK, sender->push_frame(access_unit.get(), total, RTP_NO_FLAGS));
+
+        uint32_t timestamp = 0;
+        for (size_t i = 0; i < nal_sizes.size(); ++i)
+        {
+            uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(100);
+            EXPECT_NE(nullptr, frame);
+            if (!frame)
+                break;
+
+            if (i == 0)
+                timestamp = frame->header.timestamp;
+
+            EXPECT_EQ(timestamp, frame->header.timestamp);
+            EXPECT_EQ(nal_sizes[i], frame->payload_len);
+            EXPECT_EQ(i == nal_sizes.size() - 1 ? 1 : 0, frame->header.marker);
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_incremental_send)
+{
+    // Tests that NAL units pushed one by one share the timestamp of the access unit,
+    // are delivered intact even if the caller reuses its buffer and that only the
+    // last NAL unit has the marker bit set
+    std::cout << "Starting h265 incremental send test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        const std::vector<size_t> nal_sizes = { 4000, 300, 6000, 200 };
+        const uint32_t timestamp = 123456;
+
+        EXPECT_EQ(RTP_NOT_INITIALIZED, sender->end_frame());
+        EXPECT_EQ(RTP_OK, sender->begin_frame(timestamp));
+        EXPECT_EQ(RTP_INITIALIZED, sender->begin_frame(timestamp));
+
+        std::unique_ptr<uint8_t[]> nal = std::unique_ptr<uint8_t[]>(new uint8_t[4 + 6000]);
+
+        for (size_t i = 0; i < nal_sizes.size(); ++i)
+        {
+            memset(nal.get(), 'a' + (int)i, 4 + nal_sizes[i]);
+
+            size_t pos = 0;
+            set_nal_unit(nal.get(), pos, true, 3, (19 << 1), 1);
+
+            EXPECT_EQ(RTP_OK, sender->push_nal(nal.get(), 4 + nal_sizes[i], RTP_NO_FLAGS));
+
+            // the held back packet must not refer to the caller's memory
+            memset(nal.get(), 0, 4 + 6000);
+        }
+
+        EXPECT_EQ(RTP_OK, sender->end_frame());
+
+        for (size_t i = 0; i < nal_sizes.size(); ++i)
+        {
+            uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(100);
+            EXPECT_NE(nullptr, frame);
+            if (!frame)
+                break;
+
+            EXPECT_EQ(timestamp, frame->header.timestamp);
+            EXPECT_EQ(nal_sizes[i], frame->payload_len);
+            EXPECT_EQ(i == nal_sizes.size() - 1 ? 1 : 0, frame->header.marker);
+
+            if (frame->payload_len == nal_sizes[i])
+            {
+                EXPECT_EQ('a' + (int)i, frame->payload[2]);
+                EXPECT_EQ('a' + (int)i, frame->payload[frame->payload_len - 1]);
+            }
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
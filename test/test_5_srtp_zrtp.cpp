@@ -21,7 +21,7 @@ void receive_func(uint8_t key[KEY_SIZE_BYTES], uint8_t salt[SALT_SIZE_BYTES]);
 
 
 std::unique_ptr<std::thread> user_initialization(uvgrtp::context& ctx, Key_length sha,
-    uvgrtp::session* sender_session, uvgrtp::media_stream* send);
+    uvgrtp::session*& sender_session, uvgrtp::media_stream*& send);
 
 TEST(EncryptionTests, no_send_user)
 {
@@ -48,8 +48,1133 @@ TEST(EncryptionTests, no_send_user)
     cleanup_sess(ctx, sender_session);
 }
 
+TEST(EncryptionTests, aes_gcm_rfc7714_vectors)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    /* RFC 7714 section 16.1.1, AEAD_AES_128_GCM encryption of an RTP packet */
+    const uint8_t key[16] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+    };
+    const uint8_t salt[12] = {
+        0x51, 0x75, 0x69, 0x64, 0x20, 0x70, 0x72, 0x6f, 0x20, 0x71, 0x75, 0x6f
+    };
+    const uint8_t header[12] = {
+        0x80, 0x40, 0xf1, 0x7b, 0x80, 0x41, 0xf8, 0xd3, 0x55, 0x01, 0xa0, 0xb2
+    };
+    const char *plaintext = "Gallia est omnis divisa in partes tres";
+    const uint8_t ciphertext[38] = {
+        0xf2, 0x4d, 0xe3, 0xa3, 0xfb, 0x34, 0xde, 0x6c, 0xac, 0xba,
+        0x86, 0x1c, 0x9d, 0x7e, 0x4b, 0xca, 0xbe, 0x63, 0x3b, 0xd5,
+        0x0d, 0x29, 0x4e, 0x6f, 0x42, 0xa5, 0xf4, 0x7a, 0x51, 0xc7,
+        0xd1, 0x9b, 0x36, 0xde, 0x3a, 0xdf, 0x88, 0x33
+    };
+    const uint8_t tag[16] = {
+        0x89, 0x9d, 0x7f, 0x27, 0xbe, 0xb1, 0x6a, 0x91,
+        0x52, 0xcf, 0x76, 0x5e, 0xe4, 0x39, 0x0c, 0xce
+    };
+    const uint8_t expected_iv[12] = {
+        0x51, 0x75, 0x3c, 0x65, 0x80, 0xc2, 0x72, 0x6f, 0x20, 0x71, 0x84, 0x14
+    };
+
+    /* IV = (00 00 || SSRC || ROC || SEQ) XOR salt, ROC is 0 */
+    uint8_t iv[12] = { 0 };
+    memcpy(&iv[2],  &header[8], 4);
+    memcpy(&iv[10], &header[2], 2);
+
+    for (int i = 0; i < 12; ++i)
+        iv[i] ^= salt[i];
+
+    EXPECT_EQ(0, memcmp(iv, expected_iv, sizeof(iv)));
+
+    size_t len = strlen(plaintext);
+    ASSERT_EQ(sizeof(ciphertext), len);
+
+    uint8_t payload[38];
+    uint8_t out_tag[16];
+    memcpy(payload, plaintext, len);
+
+    uvgrtp::crypto::aes::gcm gcm(key, sizeof(key));
+
+    gcm.encrypt_init(iv, sizeof(iv));
+    gcm.update_aad(header, sizeof(header));
+    gcm.encrypt(payload, payload, len);
+    gcm.final(out_tag, sizeof(out_tag));
+
+    EXPECT_EQ(0, memcmp(payload, ciphertext, len));
+    EXPECT_EQ(0, memcmp(out_tag, tag, sizeof(tag)));
+
+    gcm.decrypt_init(iv, sizeof(iv));
+    gcm.update_aad(header, sizeof(header));
+    gcm.decrypt(payload, payload, len);
+
+    EXPECT_TRUE(gcm.verify(tag, sizeof(tag)));
+    EXPECT_EQ(0, memcmp(payload, plaintext, len));
+
+    /* a modified tag must be rejected */
+    out_tag[0] ^= 0x01;
+
+    gcm.decrypt_init(iv, sizeof(iv));
+    gcm.update_aad(header, sizeof(header));
+    gcm.decrypt(payload, ciphertext, len);
+
+    EXPECT_FALSE(gcm.verify(out_tag, sizeof(out_tag)));
+}
+
+TEST(EncryptionTests, crypto_backend_vectors)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    std::cout << "Crypto backend: " << uvgrtp::crypto::backend() << std::endl;
+
+    /* FIPS-197 appendix C.1 */
+    const uint8_t aes_key[16] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+    };
+    const uint8_t aes_pt[16] = {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+        0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+    };
+    const uint8_t aes_ct[16] = {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+        0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+    };
+    uint8_t block[16];
+
+    uvgrtp::crypto::aes::ecb ecb(aes_key, sizeof(aes_key));
+    ecb.encrypt(block, aes_pt, sizeof(block));
+    EXPECT_EQ(0, memcmp(block, aes_ct, sizeof(block)));
+    ecb.decrypt(block, block, sizeof(block));
+    EXPECT_EQ(0, memcmp(block, aes_pt, sizeof(block)));
+
+    /* NIST SP 800-38A F.5.1, first block of CTR-AES128 */
+    const uint8_t ctr_key[16] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+    };
+    const uint8_t ctr_iv[16] = {
+        0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+        0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+    };
+    const uint8_t ctr_pt[16] = {
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+        0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a
+    };
+    const uint8_t ctr_ct[16] = {
+        0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26,
+        0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce
+    };
+
+    uvgrtp::crypto::aes::ctr ctr(ctr_key, sizeof(ctr_key), ctr_iv);
+    ctr.encrypt(block, ctr_pt, sizeof(block));
+    EXPECT_EQ(0, memcmp(block, ctr_ct, sizeof(block)));
+
+    /* SHA-256("abc"), fed in two parts */
+    const uint8_t sha_digest[32] = {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+        0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+    };
+    uint8_t digest[32];
+
+    uvgrtp::crypto::sha256 sha;
+    sha.update((const uint8_t *)"a", 1);
+    sha.update((const uint8_t *)"bc", 2);
+    sha.final(digest);
+    EXPECT_EQ(0, memcmp(digest, sha_digest, sizeof(digest)));
+
+    /* RFC 2202 and RFC 4231, test case 2 */
+    const uint8_t *hmac_key  = (const uint8_t *)"Jefe";
+    const uint8_t *hmac_data = (const uint8_t *)"what do ya want for nothing?";
+    const uint8_t sha1_mac[20] = {
+        0xef, 0xfc, 0xdf, 0x6a, 0xe5, 0xeb, 0x2f, 0xa2, 0xd2, 0x74,
+        0x16, 0xd5, 0xf1, 0x84, 0xdf, 0x9c, 0x25, 0x9a, 0x7c, 0x79
+    };
+    const uint8_t sha256_mac[32] = {
+        0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+        0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+    };
+
+    uvgrtp::crypto::hmac::sha1 hmac_sha1(hmac_key, 4);
+    hmac_sha1.update(hmac_data, 28);
+    hmac_sha1.final(digest);
+    EXPECT_EQ(0, memcmp(digest, sha1_mac, sizeof(sha1_mac)));
+
+    /* the object must be reusable after final() */
+    hmac_sha1.update(hmac_data, 28);
+    hmac_sha1.final(digest, 10);
+    EXPECT_EQ(0, memcmp(digest, sha1_mac, 10));
+
+    uvgrtp::crypto::hmac::sha256 hmac_sha256(hmac_key, 4);
+    hmac_sha256.update(hmac_data, 28);
+    hmac_sha256.final(digest);
+    EXPECT_EQ(0, memcmp(digest, sha256_mac, sizeof(sha256_mac)));
+
+    /* both ends of a DH exchange must arrive at the same secret */
+    uint8_t pk_a[384], pk_b[384], ss_a[384], ss_b[384];
+    uvgrtp::crypto::dh dh_a, dh_b;
+
+    dh_a.generate_keys();
+    dh_b.generate_keys();
+    dh_a.get_pk(pk_a, sizeof(pk_a));
+    dh_b.get_pk(pk_b, sizeof(pk_b));
+    dh_a.set_remote_pk(pk_b, sizeof(pk_b));
+    dh_b.set_remote_pk(pk_a, sizeof(pk_a));
+    dh_a.get_shared_secret(ss_a, sizeof(ss_a));
+    dh_b.get_shared_secret(ss_b, sizeof(ss_b));
+
+    EXPECT_NE(0, memcmp(pk_a, pk_b, sizeof(pk_a)));
+    EXPECT_EQ(0, memcmp(ss_a, ss_b, sizeof(ss_a)));
+}
+
+TEST(EncryptionTests, ecdh_key_agreement)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    uint8_t pk_a[64], pk_b[64], ss_a[32], ss_b[32];
+
+    /* P-256 */
+    uvgrtp::crypto::ecdh::p256 p256_a, p256_b;
+
+    p256_a.generate_keys();
+    p256_b.generate_keys();
+    p256_a.get_pk(pk_a, uvgrtp::crypto::ecdh::p256::PK_SIZE);
+    p256_b.get_pk(pk_b, uvgrtp::crypto::ecdh::p256::PK_SIZE);
+    EXPECT_TRUE(p256_a.set_remote_pk(pk_b, uvgrtp::crypto::ecdh::p256::PK_SIZE));
+    EXPECT_TRUE(p256_b.set_remote_pk(pk_a, uvgrtp::crypto::ecdh::p256::PK_SIZE));
+    EXPECT_TRUE(p256_a.get_shared_secret(ss_a, sizeof(ss_a)));
+    EXPECT_TRUE(p256_b.get_shared_secret(ss_b, sizeof(ss_b)));
+
+    EXPECT_NE(0, memcmp(pk_a, pk_b, uvgrtp::crypto::ecdh::p256::PK_SIZE));
+    EXPECT_EQ(0, memcmp(ss_a, ss_b, sizeof(ss_a)));
+
+    /* a point that is not on the curve must be refused */
+    pk_b[63] ^= 0x01;
+    EXPECT_FALSE(p256_a.set_remote_pk(pk_b, uvgrtp::crypto::ecdh::p256::PK_SIZE));
+
+    /* X25519 */
+    uvgrtp::crypto::ecdh::x25519 x25519_a, x25519_b;
+
+    x25519_a.generate_keys();
+    x25519_b.generate_keys();
+    x25519_a.get_pk(pk_a, uvgrtp::crypto::ecdh::x25519::PK_SIZE);
+    x25519_b.get_pk(pk_b, uvgrtp::crypto::ecdh::x25519::PK_SIZE);
+    EXPECT_TRUE(x25519_a.set_remote_pk(pk_b, uvgrtp::crypto::ecdh::x25519::PK_SIZE));
+    EXPECT_TRUE(x25519_b.set_remote_pk(pk_a, uvgrtp::crypto::ecdh::x25519::PK_SIZE));
+    EXPECT_TRUE(x25519_a.get_shared_secret(ss_a, sizeof(ss_a)));
+    EXPECT_TRUE(x25519_b.get_shared_secret(ss_b, sizeof(ss_b)));
+
+    EXPECT_NE(0, memcmp(pk_a, pk_b, uvgrtp::crypto::ecdh::x25519::PK_SIZE));
+    EXPECT_EQ(0, memcmp(ss_a, ss_b, sizeof(ss_a)));
+
+    /* a low-order point yields an all-zero secret which must be refused */
+    memset(pk_b, 0, uvgrtp::crypto::ecdh::x25519::PK_SIZE);
+    x25519_a.set_remote_pk(pk_b, uvgrtp::crypto::ecdh::x25519::PK_SIZE);
+    EXPECT_FALSE(x25519_a.get_shared_secret(ss_a, sizeof(ss_a)));
+}
+
+/* Negotiate keys with ZRTP between two streams of "ctx" and send one frame over them.
+ * "receiver_flags" are added to the flags of the receiving stream */
+static void zrtp_handshake(uvgrtp::context& ctx, int receiver_flags)
+{
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS);
+    uvgrtp::media_stream* send = nullptr;
+    uvgrtp::media_stream* recv = nullptr;
+
+    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP;
+
+    std::thread receiver([&] {
+        if (receiver_session)
+            recv = receiver_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags | receiver_flags);
+    });
+
+    if (sender_session)
+        send = sender_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, flags);
+
+    receiver.join();
+
+    EXPECT_NE(nullptr, send);
+    EXPECT_NE(nullptr, recv);
+
+    if (send && recv)
+    {
+        uint8_t payload[100];
+        memset(payload, 0xab, sizeof(payload));
+
+        EXPECT_EQ(RTP_OK, send->push_frame(payload, sizeof(payload), RTP_NO_FLAGS));
+
+        uvgrtp::frame::rtp_frame* frame = recv->pull_frame(1000);
+
+        EXPECT_NE(nullptr, frame);
+        if (frame)
+        {
+            EXPECT_EQ(sizeof(payload), frame->payload_len);
+            EXPECT_EQ(0, memcmp(frame->payload, payload, sizeof(payload)));
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+    }
+
+    cleanup_ms(sender_session, send);
+    cleanup_ms(receiver_session, recv);
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+}
+
+TEST(EncryptionTests, zrtp_key_agreement)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    /* First both ends offer the elliptic curves, then one of them insists on DH3k
+     * and the negotiation must fall back to it */
+    for (int dh3k_only : { 0, (int)RCE_ZRTP_DH3K_ONLY })
+    {
+        std::cout << "Negotiating ZRTP" << (dh3k_only ? " with DH3k only" : "") << std::endl;
+
+        uvgrtp::context ctx;
+        zrtp_handshake(ctx, dh3k_only);
+    }
+}
+
+/* Negotiate keys with ZRTP through a relay and return true if the handshake succeeded
+ *
+ * The relay holds back the HelloACKs of the sender until the sender has sent its Commit so that
+ * the receiver finds the Commit waiting and the sender is always the initiator. If "tamper" is
+ * true, the relay replaces the key agreement types of the sender's Hello with DH3k as an attacker
+ * forcing the weakest key agreement would. The Hello of the initiator is not part of the total
+ * hash, so only its MAC reveals the change */
+static bool zrtp_handshake_through_relay(bool tamper)
+{
+    constexpr uint16_t RELAY_PORT = 9004;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS);
+    uvgrtp::media_stream* send = nullptr;
+    uvgrtp::media_stream* recv = nullptr;
+
+    EXPECT_NE(nullptr, sender_session);
+    EXPECT_NE(nullptr, receiver_session);
+
+    uvgrtp::socket relay(0);
+    EXPECT_EQ(RTP_OK, relay.init(AF_INET, SOCK_DGRAM, 0));
+    EXPECT_EQ(RTP_OK, relay.bind(AF_INET, INADDR_ANY, RELAY_PORT));
+
+#ifdef _WIN32
+    DWORD timeout = 50;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 50 * 1000;
+#endif
+    EXPECT_EQ(RTP_OK, relay.setsockopt(SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)));
+
+    sockaddr_in sender_addr = relay.create_sockaddr(AF_INET, SENDER_ADDRESS, LOCAL_PORT);
+    sockaddr_in receiver_addr = relay.create_sockaddr(AF_INET, RECEIVER_ADDRESS, REMOTE_PORT);
+
+    std::atomic<bool> stop(false);
+    int tampered = 0;
+
+    std::thread forwarder([&] {
+        std::vector<std::vector<uint8_t>> held;
+        bool commit_sent = false;
+        uint8_t buffer[1500];
+
+        while (!stop)
+        {
+            sockaddr_in from;
+            int nread = 0;
+
+            if (relay.recvfrom(buffer, sizeof(buffer), 0, &from, &nread) != RTP_OK || nread < 24)
+                continue;
+
+            if (ntohs(from.sin_port) != LOCAL_PORT)
+            {
+                (void)relay.sendto(sender_addr, buffer, nread, 0);
+                continue;
+            }
+
+            /* the message type follows the 12-byte packet header, the preamble and the length */
+            if (!memcmp(&buffer[16], "Hello   ", 8))
+            {
+                /* the flags and counts are at offset 88 and the algorithm lists at offset 92 */
+                if (tamper && nread >= 104)
+                {
+                    uint32_t counts = 0;
+                    memcpy(&counts, &buffer[88], sizeof(counts));
+
+                    size_t hc = (counts >> 12) & 0xf;
+                    size_t cc = (counts >> 16) & 0xf;
+                    size_t ac = (counts >> 20) & 0xf;
+                    size_t kc = (counts >> 24) & 0xf;
+
+                    for (size_t i = 0; i < kc; ++i)
+                        memcpy(&buffer[92 + 4 * (hc + cc + ac + i)], "DH3k", 4);
+
+                    uint32_t crc = uvgrtp::crypto::crc32::calculate_crc32(buffer, nread - sizeof(uint32_t));
+                    memcpy(&buffer[nread - sizeof(uint32_t)], &crc, sizeof(uint32_t));
+                    ++tampered;
+                }
+            }
+            else if (!commit_sent)
+            {
+                if (memcmp(&buffer[16], "Commit  ", 8))
+                {
+                    held.emplace_back(buffer, buffer + nread);
+                    continue;
+                }
+
+                commit_sent = true;
+
+                for (auto& packet : held)
+                    (void)relay.sendto(receiver_addr, packet.data(), packet.size(), 0);
+            }
+
+            (void)relay.sendto(receiver_addr, buffer, nread, 0);
+        }
+    });
+
+    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP;
+
+    std::thread receiver([&] {
+        if (receiver_session)
+            recv = receiver_session->create_stream(REMOTE_PORT, RELAY_PORT, RTP_FORMAT_GENERIC, flags);
+    });
+
+    if (sender_session)
+        send = sender_session->create_stream(LOCAL_PORT, RELAY_PORT, RTP_FORMAT_GENERIC, flags);
+
+    receiver.join();
+
+    stop = true;
+    forwarder.join();
+
+    if (tamper)
+        EXPECT_LT(0, tampered);
+
+    bool success = send && recv;
+
+    if (send)
+        sender_session->destroy_stream(send);
+    if (recv)
+        receiver_session->destroy_stream(recv);
+
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+
+    return success;
+}
+
+TEST(EncryptionTests, zrtp_hello_tampering)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    EXPECT_TRUE(zrtp_handshake_through_relay(false));
+
+    /* The Hello MAC covers the algorithm lists, so the responder notices the change
+     * when it verifies the MACs and the handshake fails instead of falling back to DH3k */
+    EXPECT_FALSE(zrtp_handshake_through_relay(true));
+}
+
+TEST(EncryptionTests, zrtp_keypair_pool)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    uvgrtp::context ctx;
+    EXPECT_EQ(RTP_OK, ctx.enable_keypair_pool(1));
+
+    /* wait for one key pair of each type to be ready */
+    for (int i = 0; i < 500 && ctx.get_keypair_pool_statistics().ready < 3; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    ASSERT_EQ(3u, ctx.get_keypair_pool_statistics().ready);
+
+    /* The first handshakes take the key pairs that are ready and the following
+     * ones find the pool empty or only partially refilled, both must work */
+    for (int i = 0; i < 2; ++i)
+    {
+        zrtp_handshake(ctx, 0);
+        zrtp_handshake(ctx, RCE_ZRTP_DH3K_ONLY);
+    }
+
+    uvgrtp::keypair_pool_statistics stats = ctx.get_keypair_pool_statistics();
+
+    /* at least the X25519 and DH3k key pairs ready at the start were used */
+    EXPECT_LE(2u, stats.taken);
+
+    /* both ends of four handshakes needed a key pair each */
+    EXPECT_EQ(8u, stats.taken + stats.missed);
+
+    /* a key pair taken from the pool is gone from it, so none was handed out twice */
+    EXPECT_EQ(stats.generated, stats.taken + stats.ready);
+
+    EXPECT_EQ(RTP_OK, ctx.enable_keypair_pool(0));
+    EXPECT_EQ(0u, ctx.get_keypair_pool_statistics().generated);
+    zrtp_handshake(ctx, 0);
+}
+
+static bool srtp_exchange(uvgrtp::media_stream* send, uvgrtp::media_stream* recv, uint16_t* seq = nullptr)
+{
+    uint8_t payload[100];
+    memset(payload, 0xcd, sizeof(payload));
+
+    EXPECT_EQ(RTP_OK, send->push_frame(payload, sizeof(payload), RTP_NO_FLAGS));
+
+    uvgrtp::frame::rtp_frame* frame = recv->pull_frame(200);
+
+    if (!frame)
+        return false;
+
+    EXPECT_EQ(sizeof(payload), frame->payload_len);
+    EXPECT_EQ(0, memcmp(frame->payload, payload, sizeof(payload)));
+
+    if (seq)
+        *seq = frame->header.seq;
+
+    (void)uvgrtp::frame::dealloc_frame(frame);
+    return true;
+}
+
+static void srtp_rekey(int flags, ssize_t kdr)
+{
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS);
+    uvgrtp::media_stream* send = nullptr;
+    uvgrtp::media_stream* recv = nullptr;
+
+    flags |= RCE_SRTP | RCE_SRTP_KMNGMNT_USER;
+
+    if (sender_session)
+        send = sender_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, flags);
+    if (receiver_session)
+        recv = receiver_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+
+    EXPECT_NE(nullptr, send);
+    EXPECT_NE(nullptr, recv);
+
+    uint8_t keys[3][KEY_SIZE_BYTES];
+    uint8_t salt[SALT_SIZE_BYTES];
+
+    for (int i = 0; i < KEY_SIZE_BYTES; ++i)
+    {
+        keys[0][i] = i;
+        keys[1][i] = 0x40 + i;
+        keys[2][i] = 0x80 + i;
+    }
+
+    for (int i = 0; i < SALT_SIZE_BYTES; ++i)
+        salt[i] = i * 2;
+
+    if (send && recv)
+    {
+        EXPECT_EQ(RTP_OK, send->add_srtp_ctx(keys[0], salt, 1));
+        EXPECT_EQ(RTP_OK, recv->add_srtp_ctx(keys[0], salt, 1));
+
+        if (kdr)
+        {
+            EXPECT_EQ(RTP_INVALID_VALUE, send->configure_ctx(RCC_SRTP_KEY_DERIVATION_RATE, 3));
+            EXPECT_EQ(RTP_OK, send->configure_ctx(RCC_SRTP_KEY_DERIVATION_RATE, kdr));
+            EXPECT_EQ(RTP_OK, recv->configure_ctx(RCC_SRTP_KEY_DERIVATION_RATE, kdr));
+        }
+
+        /* ROC is zero at first so the index of a packet is its sequence number,
+         * counting past 0xffff if the sequence number wraps around */
+        uint16_t seq = 0;
+        EXPECT_TRUE(srtp_exchange(send, recv, &seq));
+
+        uint64_t from = (uint64_t)seq + 5;
+
+        /* the packets before "from" are protected with the old key and the rest with the new one.
+         * Without MKI, the receiver fails to authenticate the packets if the sender does not switch */
+        EXPECT_EQ(RTP_OK, recv->add_srtp_key(keys[1], salt, 2, from));
+        EXPECT_EQ(RTP_OK, send->add_srtp_key(keys[1], salt, 2, from));
+
+        /* a key cannot be taken into use before the previous one */
+        EXPECT_EQ(RTP_INVALID_VALUE, send->add_srtp_key(keys[2], salt, 3, from - 1));
+
+        for (int i = 0; i < 10; ++i)
+            EXPECT_TRUE(srtp_exchange(send, recv));
+
+        if (flags & RCE_SRTP_MKI)
+        {
+            /* the sender switches right away to a key the receiver does not know yet */
+            uint64_t next = (uint64_t)seq + 11;
+
+            EXPECT_EQ(RTP_INVALID_VALUE, send->add_srtp_key(keys[2], salt, 2, next));
+            EXPECT_EQ(RTP_OK, send->add_srtp_key(keys[2], salt, 3, next));
+            EXPECT_FALSE(srtp_exchange(send, recv));
+
+            EXPECT_EQ(RTP_OK, recv->add_srtp_key(keys[2], salt, 3, next));
+            EXPECT_TRUE(srtp_exchange(send, recv));
+        }
+    }
+
+    cleanup_ms(sender_session, send);
+    cleanup_ms(receiver_session, recv);
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+}
+
+TEST(EncryptionTests, srtp_rekey)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    srtp_rekey(RCE_SRTP_AUTHENTICATE_RTP, 0);
+    srtp_rekey(RCE_SRTP_AUTHENTICATE_RTP | RCE_SRTP_MKI, 0);
+    srtp_rekey(RCE_SRTP_AES_GCM | RCE_SRTP_MKI, 0);
+}
+
+/* Send "packets" frames from a stream with key derivation rate "send_kdr" to a stream
+ * with "recv_kdr" and return the number of frames the receiver could authenticate */
+static int srtp_kdr_received(int flags, ssize_t send_kdr, ssize_t recv_kdr, int packets)
+{
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS);
+    uvgrtp::media_stream* send = nullptr;
+    uvgrtp::media_stream* recv = nullptr;
+    int received = 0;
+
+    flags |= RCE_SRTP | RCE_SRTP_KMNGMNT_USER;
+
+    if (sender_session)
+        send = sender_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, flags);
+    if (receiver_session)
+        recv = receiver_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+
+    EXPECT_NE(nullptr, send);
+    EXPECT_NE(nullptr, recv);
+
+    uint8_t key[KEY_SIZE_BYTES];
+    uint8_t salt[SALT_SIZE_BYTES];
+
+    for (int i = 0; i < KEY_SIZE_BYTES; ++i)
+        key[i] = i;
+
+    for (int i = 0; i < SALT_SIZE_BYTES; ++i)
+        salt[i] = i * 2;
+
+    if (send && recv)
+    {
+        EXPECT_EQ(RTP_OK, send->add_srtp_ctx(key, salt));
+        EXPECT_EQ(RTP_OK, recv->add_srtp_ctx(key, salt));
+
+        if (send_kdr)
+            EXPECT_EQ(RTP_OK, send->configure_ctx(RCC_SRTP_KEY_DERIVATION_RATE, send_kdr));
+        if (recv_kdr)
+            EXPECT_EQ(RTP_OK, recv->configure_ctx(RCC_SRTP_KEY_DERIVATION_RATE, recv_kdr));
+
+        for (int i = 0; i < packets; ++i)
+        {
+            if (srtp_exchange(send, recv))
+                ++received;
+        }
+    }
+
+    cleanup_ms(sender_session, send);
+    cleanup_ms(receiver_session, recv);
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+
+    return received;
+}
+
+TEST(EncryptionTests, srtp_key_derivation_rate)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    /* the session keys change every fourth packet */
+    srtp_rekey(RCE_SRTP_AUTHENTICATE_RTP, 4);
+    srtp_rekey(RCE_SRTP_AES_GCM | RCE_SRTP_MKI, 4);
+
+    /* The packet index stays below 2^24 so the keys are those of the first period,
+     * which are the same as the keys derived without a key derivation rate */
+    EXPECT_EQ(8, srtp_kdr_received(RCE_SRTP_AUTHENTICATE_RTP, 1 << 24, 0, 8));
+
+    /* From packet index 4 onwards, the sender and a receiver with twice the rate are in different
+     * periods. If the session keys did not change at the boundaries, the receiver would get all */
+    EXPECT_GE(4, srtp_kdr_received(RCE_SRTP_AUTHENTICATE_RTP, 4, 8, 8));
+    EXPECT_GE(4, srtp_kdr_received(RCE_SRTP_AUTHENTICATE_RTP, 4, 0, 8));
+}
+
+static void srtp_late_packet(int flags)
+{
+    /* The packets of the sender go through a relay that holds one packet back
+     * and forwards it only after the master key has been changed */
+    constexpr uint16_t RELAY_PORT = 9004;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS);
+
+    ASSERT_NE(nullptr, sender_session);
+    ASSERT_NE(nullptr, receiver_session);
+
+    flags |= RCE_SRTP | RCE_SRTP_KMNGMNT_USER;
+
+    uvgrtp::media_stream* send = sender_session->create_stream(LOCAL_PORT, RELAY_PORT, RTP_FORMAT_GENERIC, flags);
+    uvgrtp::media_stream* recv = receiver_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+
+    ASSERT_NE(nullptr, send);
+    ASSERT_NE(nullptr, recv);
+
+    uvgrtp::socket relay(0);
+    ASSERT_EQ(RTP_OK, relay.init(AF_INET, SOCK_DGRAM, 0));
+    ASSERT_EQ(RTP_OK, relay.bind(AF_INET, INADDR_ANY, RELAY_PORT));
+
+#ifdef _WIN32
+    DWORD timeout = 500;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 500 * 1000;
+#endif
+    ASSERT_EQ(RTP_OK, relay.setsockopt(SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)));
+    sockaddr_in recv_addr = relay.create_sockaddr(AF_INET, RECEIVER_ADDRESS, REMOTE_PORT);
+
+    uint8_t keys[6][KEY_SIZE_BYTES];
+    uint8_t salt[SALT_SIZE_BYTES];
+
+    for (int i = 0; i < KEY_SIZE_BYTES; ++i)
+    {
+        for (int k = 0; k < 6; ++k)
+            keys[k][i] = 0x20 * k + i;
+    }
+
+    for (int i = 0; i < SALT_SIZE_BYTES; ++i)
+        salt[i] = i * 2;
+
+    ASSERT_EQ(RTP_OK, send->add_srtp_ctx(keys[0], salt, 1));
+    ASSERT_EQ(RTP_OK, recv->add_srtp_ctx(keys[0], salt, 1));
+
+    uint8_t payload[100];
+    uint8_t buffer[1500];
+    int nread = 0;
+
+    /* send the packet with "marker" as payload and return it as it arrived to the relay */
+    auto send_packet = [&](uint8_t marker) {
+        memset(payload, marker, sizeof(payload));
+        EXPECT_EQ(RTP_OK, send->push_frame(payload, sizeof(payload), RTP_NO_FLAGS));
+        EXPECT_EQ(RTP_OK, relay.recv(buffer, sizeof(buffer), 0, &nread));
+        return std::vector<uint8_t>(buffer, buffer + std::max(nread, 0));
+    };
+
+    /* forward the packet and check that the receiver gets "marker" out of it */
+    auto forward_packet = [&](const std::vector<uint8_t>& packet, uint8_t marker) {
+        EXPECT_EQ(RTP_OK, relay.sendto(recv_addr, (uint8_t*)packet.data(), packet.size(), 0));
+
+        uvgrtp::frame::rtp_frame* frame = recv->pull_frame(200);
+        EXPECT_NE(nullptr, frame);
+
+        if (frame)
+        {
+            memset(payload, marker, sizeof(payload));
+            EXPECT_EQ(sizeof(payload), frame->payload_len);
+            EXPECT_EQ(0, memcmp(frame->payload, payload, sizeof(payload)));
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+    };
+
+    std::vector<uint8_t> first = send_packet(1);
+    ASSERT_LE(RTP_HDR_SIZE, first.size());
+    forward_packet(first, 1);
+
+    uint16_t seq = ntohs(*(uint16_t*)&first[2]);
+    uint64_t from = (uint64_t)seq + 3;
+
+    /* packet 2 is protected with the first key and arrives late, after packet 4 of the second key */
+    EXPECT_EQ(RTP_OK, send->add_srtp_key(keys[1], salt, 2, from));
+    EXPECT_EQ(RTP_OK, recv->add_srtp_key(keys[1], salt, 2, from));
+
+    std::vector<uint8_t> late = send_packet(2);
+    forward_packet(send_packet(3), 3);
+    forward_packet(send_packet(4), 4);
+
+    /* The next keys fill the list of keys. Another key would not fit without
+     * removing the first key while its packets are still expected */
+    EXPECT_EQ(RTP_OK, send->add_srtp_key(keys[2], salt, 3, from + 1000));
+    EXPECT_EQ(RTP_OK, recv->add_srtp_key(keys[2], salt, 3, from + 1000));
+    EXPECT_EQ(RTP_OK, send->add_srtp_key(keys[3], salt, 4, from + 2000));
+    EXPECT_EQ(RTP_OK, recv->add_srtp_key(keys[3], salt, 4, from + 2000));
+    EXPECT_EQ(RTP_NOT_READY, send->add_srtp_key(keys[4], salt, 5, from + 3000));
+    EXPECT_EQ(RTP_NOT_READY, recv->add_srtp_key(keys[4], salt, 5, from + 3000));
+
+    forward_packet(late, 2);
+
+    cleanup_ms(sender_session, send);
+    cleanup_ms(receiver_session, recv);
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+}
+
+TEST(EncryptionTests, srtp_late_packet)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    srtp_late_packet(RCE_SRTP_AUTHENTICATE_RTP);
+    srtp_late_packet(RCE_SRTP_AES_GCM | RCE_SRTP_MKI);
+}
+
+TEST(EncryptionTests, srtp_replay_window)
+{
+    /* The relay records the protected packets of the sender and forwards
+     * them to the receiver again and out of order */
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    constexpr uint16_t RELAY_PORT = 9004;
+    constexpr int WINDOW = 64;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS);
+
+    ASSERT_NE(nullptr, sender_session);
+    ASSERT_NE(nullptr, receiver_session);
+
+    int flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_AUTHENTICATE_RTP | RCE_SRTP_REPLAY_PROTECTION;
+
+    uvgrtp::media_stream* send = sender_session->create_stream(LOCAL_PORT, RELAY_PORT, RTP_FORMAT_GENERIC, flags);
+    uvgrtp::media_stream* recv = receiver_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+
+    ASSERT_NE(nullptr, send);
+    ASSERT_NE(nullptr, recv);
+
+    uvgrtp::socket relay(0);
+    ASSERT_EQ(RTP_OK, relay.init(AF_INET, SOCK_DGRAM, 0));
+    ASSERT_EQ(RTP_OK, relay.bind(AF_INET, INADDR_ANY, RELAY_PORT));
+
+#ifdef _WIN32
+    DWORD timeout = 500;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 500 * 1000;
+#endif
+    ASSERT_EQ(RTP_OK, relay.setsockopt(SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)));
+    sockaddr_in recv_addr = relay.create_sockaddr(AF_INET, RECEIVER_ADDRESS, REMOTE_PORT);
+
+    uint8_t key[KEY_SIZE_BYTES];
+    uint8_t salt[SALT_SIZE_BYTES];
+
+    for (int i = 0; i < KEY_SIZE_BYTES; ++i)
+        key[i] = i;
+
+    for (int i = 0; i < SALT_SIZE_BYTES; ++i)
+        salt[i] = i * 2;
+
+    ASSERT_EQ(RTP_OK, send->add_srtp_ctx(key, salt));
+    ASSERT_EQ(RTP_OK, recv->add_srtp_ctx(key, salt));
+    ASSERT_EQ(RTP_OK, recv->configure_ctx(RCC_SRTP_REPLAY_WINDOW, WINDOW));
+
+    /* packet "k" carries "k" in its payload */
+    std::vector<std::vector<uint8_t>> packets;
+    uint8_t payload[100] = { 0 };
+    uint8_t buffer[1500];
+
+    auto send_packets = [&](size_t count) {
+        while (packets.size() < count)
+        {
+            int nread = 0;
+            *(uint32_t*)payload = (uint32_t)packets.size();
+
+            ASSERT_EQ(RTP_OK, send->push_frame(payload, sizeof(payload), RTP_NO_FLAGS));
+            ASSERT_EQ(RTP_OK, relay.recv(buffer, sizeof(buffer), 0, &nread));
+            packets.emplace_back(buffer, buffer + nread);
+        }
+    };
+
+    /* forward packet "k" and return true if the receiver accepted it */
+    auto forward = [&](size_t k) {
+        EXPECT_EQ(RTP_OK, relay.sendto(recv_addr, packets[k].data(), packets[k].size(), 0));
+
+        uvgrtp::frame::rtp_frame* frame = recv->pull_frame(50);
+        if (!frame)
+            return false;
+
+        EXPECT_EQ(k, *(uint32_t*)frame->payload);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return true;
+    };
+
+    send_packets(200);
+    ASSERT_EQ(200u, packets.size());
+
+    /* duplicates */
+    EXPECT_TRUE(forward(0));
+    EXPECT_FALSE(forward(0));
+
+    /* the window ends WINDOW - 1 packets behind the highest one */
+    EXPECT_TRUE(forward(100));
+    EXPECT_FALSE(forward(30));
+    EXPECT_TRUE(forward(100 - WINDOW + 1));
+    EXPECT_FALSE(forward(100 - WINDOW));
+    EXPECT_FALSE(forward(100 - WINDOW + 1));
+
+    /* The window advances and the bitmap turns around. The bit of packet 101 was last used
+     * by packet 37, which has to be forgotten so that packet 101 is not taken as a replay */
+    EXPECT_TRUE(forward(150));
+    EXPECT_TRUE(forward(101));
+    EXPECT_FALSE(forward(100));
+    EXPECT_FALSE(forward(150));
+
+    /* the sequence number wraps around, the packet index continues from 65535 to 65536 */
+    uint16_t first_seq = ntohs(*(uint16_t*)&packets[0][2]);
+    size_t wrap = (size_t)(uint16_t)(0 - first_seq);
+
+    if (wrap < 200)
+        wrap += 65536;
+
+    send_packets(wrap + 4);
+    ASSERT_EQ(wrap + 4, packets.size());
+    EXPECT_EQ(0, ntohs(*(uint16_t*)&packets[wrap][2]));
+
+    /* The receiver only accepts sequence number jumps shorter than the RTP dropout limit
+     * and increments the rollover counter when it sees sequence number 0xffff */
+    for (size_t k = 150 + 2000; k < wrap - 6; k += 2000)
+        EXPECT_TRUE(forward(k));
+
+    EXPECT_TRUE(forward(wrap - 6));
+    EXPECT_TRUE(forward(wrap - 3));
+    EXPECT_FALSE(forward(wrap - 6));
+    EXPECT_TRUE(forward(wrap - 1));
+    EXPECT_TRUE(forward(wrap + 3));
+    EXPECT_TRUE(forward(wrap + 1));
+    EXPECT_FALSE(forward(wrap + 3));
+    EXPECT_FALSE(forward(wrap + 1));
+    EXPECT_FALSE(forward(wrap - 1));
+
+    cleanup_ms(sender_session, send);
+    cleanup_ms(receiver_session, recv);
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+}
+
+static void srtp_batch(int flags)
+{
+    /* The sender protects the fragments of large frames with several worker threads.
+     * The relay records the protected packets and forwards them to the receiver,
+     * once as they are and once with one of them tampered with */
+    constexpr uint16_t RELAY_PORT = 9004;
+    constexpr size_t FRAME_SIZE = 100000;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS);
+
+    ASSERT_NE(nullptr, sender_session);
+    ASSERT_NE(nullptr, receiver_session);
+
+    flags |= RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_FRAGMENT_GENERIC;
+
+    uvgrtp::media_stream* send = sender_session->create_stream(LOCAL_PORT, RELAY_PORT, RTP_FORMAT_GENERIC, flags);
+    uvgrtp::media_stream* recv = receiver_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+
+    ASSERT_NE(nullptr, send);
+    ASSERT_NE(nullptr, recv);
+
+    uvgrtp::socket relay(0);
+    ASSERT_EQ(RTP_OK, relay.init(AF_INET, SOCK_DGRAM, 0));
+    ASSERT_EQ(RTP_OK, relay.bind(AF_INET, INADDR_ANY, RELAY_PORT));
+
+#ifdef _WIN32
+    DWORD timeout = 200;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 200 * 1000;
+#endif
+    ASSERT_EQ(RTP_OK, relay.setsockopt(SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)));
+    sockaddr_in recv_addr = relay.create_sockaddr(AF_INET, RECEIVER_ADDRESS, REMOTE_PORT);
+
+    uint8_t key[KEY_SIZE_BYTES];
+    uint8_t salt[SALT_SIZE_BYTES];
+
+    for (int i = 0; i < KEY_SIZE_BYTES; ++i)
+        key[i] = i;
+
+    for (int i = 0; i < SALT_SIZE_BYTES; ++i)
+        salt[i] = i * 2;
+
+    ASSERT_EQ(RTP_OK, send->add_srtp_ctx(key, salt));
+    ASSERT_EQ(RTP_OK, recv->add_srtp_ctx(key, salt));
+    ASSERT_EQ(RTP_OK, send->configure_ctx(RCC_SRTP_CRYPTO_THREADS, 2));
+
+    std::unique_ptr<uint8_t[]> data(new uint8_t[FRAME_SIZE]);
+
+    /* push a frame and return its packets as they arrived to the relay */
+    auto send_frame = [&](uint8_t seed) {
+        std::vector<std::vector<uint8_t>> packets;
+
+        for (size_t i = 0; i < FRAME_SIZE; ++i)
+            data[i] = (uint8_t)(seed + i * 7);
+
+        /* the packets are read while the frame is sent so that the receive buffer of the relay does not overflow */
+        std::thread reader([&]() {
+            uint8_t buffer[1500];
+            int nread = 0;
+
+            while (relay.recv(buffer, sizeof(buffer), 0, &nread) == RTP_OK && nread > 0)
+                packets.emplace_back(buffer, buffer + nread);
+        });
+
+        EXPECT_EQ(RTP_OK, send->push_frame(data.get(), FRAME_SIZE, RTP_NO_FLAGS));
+        reader.join();
+        return packets;
+    };
+
+    auto forward = [&](const std::vector<uint8_t>& packet) {
+        EXPECT_EQ(RTP_OK, relay.sendto(recv_addr, (uint8_t*)packet.data(), packet.size(), 0));
+    };
+
+    /* check that the receiver reassembled the frame that was sent last */
+    auto check_frame = [&]() {
+        uvgrtp::frame::rtp_frame* frame = recv->pull_frame(200);
+        EXPECT_NE(nullptr, frame);
+
+        if (frame)
+        {
+            EXPECT_EQ(FRAME_SIZE, frame->payload_len);
+            EXPECT_EQ(0, memcmp(frame->payload, data.get(), FRAME_SIZE));
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+    };
+
+    /* the batch is large enough to be split between the workers */
+    std::vector<std::vector<uint8_t>> packets = send_frame(1);
+    ASSERT_LE(64u, packets.size());
+
+    for (auto& packet : packets)
+        forward(packet);
+
+    check_frame();
+
+    /* a tampered packet fails the authentication and the frame stays incomplete until the original arrives */
+    packets = send_frame(2);
+    ASSERT_LE(64u, packets.size());
+
+    std::vector<uint8_t> tampered = packets[packets.size() / 2];
+    tampered[RTP_HDR_SIZE + 10] ^= 0x01;
+
+    for (size_t i = 0; i < packets.size(); ++i)
+        forward(i == packets.size() / 2 ? tampered : packets[i]);
+
+    EXPECT_EQ(nullptr, recv->pull_frame(100));
+
+    forward(packets[packets.size() / 2]);
+    check_frame();
+
+    cleanup_ms(sender_session, send);
+    cleanup_ms(receiver_session, recv);
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+}
+
+TEST(EncryptionTests, srtp_batch)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    srtp_batch(RCE_SRTP_AUTHENTICATE_RTP);
+    srtp_batch(RCE_SRTP_AES_GCM);
+}
+
+static void srtcp_reports(int flags)
+{
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS);
+    uvgrtp::media_stream* send = nullptr;
+    uvgrtp::media_stream* recv = nullptr;
+
+    /* H.265 has a high enough session bandwidth for reports to be sent every few hundred milliseconds */
+    flags |= RCE_RTCP | RCE_SRTP | RCE_SRTP_KMNGMNT_USER;
+
+    ASSERT_NE(nullptr, sender_session);
+    ASSERT_NE(nullptr, receiver_session);
+
+    send = sender_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_H265, flags);
+    recv = receiver_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_H265, flags);
+
+    ASSERT_NE(nullptr, send);
+    ASSERT_NE(nullptr, recv);
+
+    uint8_t key[KEY_SIZE_BYTES];
+    uint8_t salt[SALT_SIZE_BYTES];
+
+    for (int i = 0; i < KEY_SIZE_BYTES; ++i)
+        key[i] = i;
+
+    for (int i = 0; i < SALT_SIZE_BYTES; ++i)
+        salt[i] = i * 2;
+
+    std::atomic<int> sender_reports(0);
+    std::atomic<int> receiver_reports(0);
+
+    /* RTCP only exists once the SRTP context has been added */
+    ASSERT_EQ(RTP_OK, send->add_srtp_ctx(key, salt));
+    ASSERT_EQ(RTP_OK, recv->add_srtp_ctx(key, salt));
+    ASSERT_NE(nullptr, send->get_rtcp());
+    ASSERT_NE(nullptr, recv->get_rtcp());
+
+    EXPECT_EQ(RTP_OK, recv->get_rtcp()->install_sender_hook(
+        [&](std::unique_ptr<uvgrtp::frame::rtcp_sender_report> sr) {
+            EXPECT_EQ(send->get_ssrc(), sr->ssrc);
+            ++sender_reports;
+        }));
+    EXPECT_EQ(RTP_OK, send->get_rtcp()->install_receiver_hook(
+        [&](std::unique_ptr<uvgrtp::frame::rtcp_receiver_report> rr) {
+            EXPECT_EQ(recv->get_ssrc(), rr->ssrc);
+            ++receiver_reports;
+        }));
+
+    uint8_t payload[100];
+    memset(payload, 0xcd, sizeof(payload));
+
+    for (int i = 0; i < 100 && (!sender_reports || !receiver_reports); ++i)
+    {
+        EXPECT_EQ(RTP_OK, send->push_frame(payload, sizeof(payload), RTP_NO_H26X_SCL));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        while ((frame = recv->pull_frame(0)) != nullptr)
+            (void)uvgrtp::frame::dealloc_frame(frame);
+    }
+
+    (void)recv->get_rtcp()->remove_all_hooks();
+    (void)send->get_rtcp()->remove_all_hooks();
+
+    EXPECT_LT(0, sender_reports);
+    EXPECT_LT(0, receiver_reports);
+
+    cleanup_ms(sender_session, send);
+    cleanup_ms(receiver_session, recv);
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+}
+
+TEST(EncryptionTests, srtcp_reports)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    srtcp_reports(RCE_SRTP_AUTHENTICATE_RTP);
+    srtcp_reports(RCE_SRTP_AES_GCM | RCE_SRTP_MKI);
+}
+
 std::unique_ptr<std::thread> user_initialization(uvgrtp::context& ctx, Key_length sha, 
-    uvgrtp::session* sender_session, uvgrtp::media_stream* send)
+    uvgrtp::session*& sender_session, uvgrtp::media_stream*& send)
 {
     uint8_t key[KEY_SIZE_BYTES] = { 0 };
     uint8_t salt[SALT_SIZE_BYTES] = { 0 };
@@ -122,4 +1247,90 @@ void receive_func(uint8_t key[KEY_SIZE_BYTES], uint8_t salt[SALT_SIZE_BYTES])
 
     cleanup_ms(receiver_session, recv);
     cleanup_sess(ctx, receiver_session);
-}
\ No newline at end of file
+}
+
+static void zrtp_ready_hook(void* arg, rtp_error_t ret)
+{
+    if (ret == RTP_OK)
+        ++*(std::atomic<int>*)arg;
+}
+
+static void zrtp_async_streams(int streams)
+{
+    /* Both ends of all streams are created from this thread which only works
+     * if create_stream() does not wait for the handshake. The first stream pair
+     * uses Diffie-Hellman Mode and the rest use Multistream Mode */
+    constexpr uint16_t BASE_PORT = 9100;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS);
+    std::vector<uvgrtp::media_stream*> send(streams, nullptr);
+    std::vector<uvgrtp::media_stream*> recv(streams, nullptr);
+    std::atomic<int> ready(0);
+
+    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP | RCE_ZRTP_ASYNC;
+
+    ASSERT_NE(nullptr, sender_session);
+    ASSERT_NE(nullptr, receiver_session);
+
+    for (int i = 0; i < streams; ++i)
+    {
+        uint16_t port = BASE_PORT + 4 * i;
+
+        send[i] = sender_session->create_stream(port, port + 2, RTP_FORMAT_GENERIC, flags);
+        recv[i] = receiver_session->create_stream(port + 2, port, RTP_FORMAT_GENERIC, flags);
+
+        ASSERT_NE(nullptr, send[i]);
+        ASSERT_NE(nullptr, recv[i]);
+
+        EXPECT_EQ(RTP_OK, recv[i]->install_zrtp_hook(&ready, zrtp_ready_hook));
+    }
+
+    uint8_t payload[100];
+    memset(payload, 0xab, sizeof(payload));
+
+    for (int i = 0; i < streams; ++i)
+    {
+        EXPECT_EQ(RTP_OK, send[i]->wait_for_zrtp(10000));
+        EXPECT_EQ(RTP_OK, recv[i]->wait_for_zrtp(10000));
+        EXPECT_EQ(RTP_OK, send[i]->push_frame(payload, sizeof(payload), RTP_NO_FLAGS));
+
+        uvgrtp::frame::rtp_frame* frame = recv[i]->pull_frame(1000);
+
+        EXPECT_NE(nullptr, frame);
+        if (frame)
+        {
+            EXPECT_EQ(0, memcmp(frame->payload, payload, sizeof(payload)));
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+    }
+
+    for (int i = 0; i < streams; ++i)
+    {
+        cleanup_ms(sender_session, send[i]);
+        cleanup_ms(receiver_session, recv[i]);
+    }
+
+    /* the handshake threads, and thus the hooks, have finished once the streams are destroyed */
+    EXPECT_EQ(streams, ready.load());
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+}
+
+TEST(EncryptionTests, zrtp_async)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    zrtp_async_streams(3);
+}
+
+TEST(EncryptionTests, zrtp_multistream)
+{
+    if (!uvgrtp::crypto::enabled())
+        GTEST_SKIP() << "uvgRTP was built without crypto support";
+
+    /* the Multistream Mode handshakes of the secondary streams run concurrently */
+    zrtp_async_streams(16);
+}
@@ -51,6 +51,9 @@ SOURCES += \
 	src/frame_queue.cc \
 	src/random.cc \
 	src/rtcp.cc \
+	src/rtcp_scheduler.cc \
+	src/rtcp_dispatcher.cc \
+	src/rtcp_xr.cc \
 	src/rtp.cc \
 	src/session.cc \
 	src/socket.cc \
@@ -71,9 +74,19 @@ SOURCES += \
 	src/zrtp/confirm.cc \
 	src/zrtp/confack.cc \
 	src/zrtp/error.cc \
+	src/zrtp/keypair_pool.cc \
 	src/srtp/base.cc \
 	src/srtp/srtp.cc \
 	src/srtp/srtcp.cc \
+	src/srtp/worker_pool.cc \
+	src/crypto/aes.cc \
+	src/crypto/bignum.cc \
+	src/crypto/builtin.cc \
+	src/crypto/cpu.cc \
+	src/crypto/cryptopp.cc \
+	src/crypto/ec.cc \
+	src/crypto/none.cc \
+	src/crypto/sha.cc \
 
 HEADERS += \
 	include/uvgrtp/clock.hh \
@@ -95,6 +108,9 @@ HEADERS += \
 	src/poll.hh \
 	src/frame_queue.hh \
 	src/random.hh \
+	src/rtcp_scheduler.hh \
+	src/rtcp_dispatcher.hh \
+	src/rtcp_xr.hh \
 	src/rtp.hh \
 	src/zrtp.hh \
 	src/formats/media.hh \
@@ -110,9 +126,17 @@ HEADERS += \
 	src/zrtp/confirm.hh \
 	src/zrtp/confack.hh \
 	src/zrtp/error.hh \
+	src/zrtp/keypair_pool.hh \
 	src/srtp/base.hh \
 	src/srtp/srtp.hh \
 	src/srtp/srtcp.hh \
+	src/srtp/worker_pool.hh \
+	src/crypto/aes.hh \
+	src/crypto/bignum.hh \
+	src/crypto/cpu.hh \
+	src/crypto/ec.hh \
+	src/crypto/endian.hh \
+	src/crypto/sha.hh \
 
 
 unix {